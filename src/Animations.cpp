@@ -1,9 +1,13 @@
 #include "Animations.hpp"
+#include "JobSystem.hpp"
 
 #include <glm/gtc/constants.hpp>
 
 std::vector<Animations::AnimItem> Animations::s_ActiveAnimations{};
 
+// Stepping an item is a few flops, only large batches are worth splitting
+static constexpr uint32_t UPDATE_GRAIN = 1024;
+
 void Animations::DoFloat(float& value, float target, float duration, AnimType type)
 {
 	std::function<float(float, float, float)> f{};
@@ -80,19 +84,25 @@ void Animations::Clear()
 
 void Animations::Update(float ts)
 {
-	for (auto it = s_ActiveAnimations.begin(); it != s_ActiveAnimations.end();)
-	{
-		if (it->Timestamp >= it->Duration)
+	// Every item drives a value of its own, so they're stepped in parallel and the finished ones removed after
+	JobSystem::ParallelFor((uint32_t)s_ActiveAnimations.size(), [ts](uint32_t begin, uint32_t end)
 		{
-			*it->Value = it->TargetValue;
-			it = s_ActiveAnimations.erase(it);
-			continue;
-		}
-
-		it->Timestamp += ts;
-		*it->Value = it->TransformFunc(it->InitialValue, it->TargetValue, it->Timestamp / it->Duration);
-		++it;
-	}
+			for (uint32_t i = begin; i < end; i++)
+			{
+				AnimItem& item = s_ActiveAnimations[i];
+				if (item.Timestamp >= item.Duration)
+				{
+					*item.Value = item.TargetValue;
+					item.Finished = true;
+					continue;
+				}
+
+				item.Timestamp += ts;
+				*item.Value = item.TransformFunc(item.InitialValue, item.TargetValue, item.Timestamp / item.Duration);
+			}
+		}, UPDATE_GRAIN);
+
+	std::erase_if(s_ActiveAnimations, [](const AnimItem& item) { return item.Finished; });
 }
 
 float Animations::Linear(float a, float b, float t)
@@ -46,6 +46,7 @@ private:
 
 		float Duration = 1.0f;
 		float Timestamp = 0.0f;
+		bool Finished = false;
 	};
 
 	static std::vector<AnimItem> s_ActiveAnimations;
@@ -9,7 +9,9 @@
 
 #include "Application.hpp"
 #include "Animations.hpp"
+#include "JobSystem.hpp"
 #include "Logger.hpp"
+#include "RenderThread.hpp"
 #include "Timer.hpp"
 #include "TriggerClock.hpp"
 #include "layers/EditorLayer.hpp"
@@ -22,6 +24,8 @@ Application::Application(const WindowSpec& spec)
 	FUNC_PROFILE();
 	assert((s_Instance == nullptr) && "Only one instance of Application allowed!");
 
+	JobSystem::Init();
+
 	if (glfwInit() == GLFW_FALSE)
 	{
 		LOG_CRITICAL("Failed to initialize GLFW!");
@@ -69,11 +73,15 @@ Application::Application(const WindowSpec& spec)
 
 	LOG_INFO("GLAD loaded.");
 
+	m_RenderThread = std::make_unique<RenderThread>(m_Window);
 	s_Instance = this;
 }
 
 Application::~Application()
 {
+	// Takes the context back before anything releases GL objects
+	m_RenderThread = nullptr;
+
 	while (!m_Layers.empty())
 	{
 		m_Layers.pop();
@@ -90,6 +98,7 @@ Application::~Application()
 	}
 
 	glfwTerminate();
+	JobSystem::Shutdown();
 }
 
 void Application::Run()
@@ -121,7 +130,9 @@ void Application::Run()
 		{
 			Animations::Clear();
 			m_DoPopLayer = false;
-			m_Layers.pop();
+
+			// Layers own GL objects, so they're released where the context is
+			m_RenderThread->Execute([this]() { m_Layers.pop(); });
 
 			if (!m_Layers.empty())
 			{
@@ -142,6 +153,8 @@ void Application::Run()
 		Animations::Update(timestep);
 
 		m_Stats.FrameTime = timestep * 1000.0f;
+		float& averageFrameTime = m_RenderThread->Enabled() ? m_Stats.RenderThreadFrameTime : m_Stats.SingleThreadedFrameTime;
+		averageFrameTime = averageFrameTime == 0.0f ? m_Stats.FrameTime : glm::mix(averageFrameTime, m_Stats.FrameTime, 0.05f);
 
 		ImGui_ImplOpenGL3_NewFrame();
 		ImGui_ImplGlfw_NewFrame();
@@ -160,21 +173,23 @@ void Application::Run()
 		m_Layers.top()->OnUpdate((float)timestep);
 		m_Stats.UpdateTime = clock.GetElapsedTime();
 
-		clock.Restart();
+		// Layers record their GL work into the frame packet, it's drawn by the render thread or in EndFrame
 		m_Layers.top()->OnRender();
-		GLCall(glFinish());
-		m_Stats.RenderTime = clock.GetElapsedTime();
-
-		clock.Restart();
 		ImGui::PopFont();
 		ImGui::Render();
-		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-		GLCall(glFinish());
-		m_Stats.ImGuiRenderTime = clock.GetElapsedTime();
+
+		clock.Restart();
+		m_RenderThread->EndFrame(ImGui::GetDrawData());
+		m_Stats.WaitTime = clock.GetElapsedTime();
+
+		const FramePacket& drawn = m_RenderThread->LastFrame();
+		m_Stats.RenderTime = drawn.RenderTime;
+		m_Stats.ImGuiRenderTime = drawn.ImGuiRenderTime;
 
 		glfwPollEvents();
-		glfwSwapBuffers(m_Window);
 	}
+
+	m_RenderThread->SetEnabled(false);
 }
 
 void Application::Shutdown()
@@ -9,6 +9,7 @@
 
 struct GLFWwindow;
 class Layer;
+class RenderThread;
 
 struct WindowSpec
 {
@@ -23,6 +24,13 @@ struct AppStats
 	float UpdateTime;
 	float RenderTime;
 	float ImGuiRenderTime;
+
+	// Time the main thread waited for the previous frame to be drawn
+	float WaitTime;
+
+	// Frame time averaged separately with and without the render thread
+	float SingleThreadedFrameTime;
+	float RenderThreadFrameTime;
 };
 
 class Application
@@ -40,6 +48,7 @@ public:
 	inline GLFWwindow* Window()		const { return m_Window; }
 	inline const WindowSpec& Spec() const { return m_Spec;	 }
 	inline const AppStats& Stats()  const { return m_Stats;  }
+	inline RenderThread& GetRenderThread() { return *m_RenderThread; }
 
 	inline static Application* Instance() { return s_Instance; }
 
@@ -51,6 +60,7 @@ private:
 	GLFWwindow* m_Window = nullptr;
 	EventQueue m_EventQueue;
 	AppStats m_Stats{};
+	std::unique_ptr<RenderThread> m_RenderThread;
 
 	std::stack<std::unique_ptr<Layer>> m_Layers;
 	std::unique_ptr<Layer> m_NextLayer;
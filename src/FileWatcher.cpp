@@ -0,0 +1,133 @@
+#include "FileWatcher.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+
+#ifdef TARGET_LINUX
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+FileWatcher::FileWatcher(const std::filesystem::path& directory)
+	: m_Directory(directory)
+{
+#ifdef TARGET_LINUX
+	m_Handle = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_Handle < 0)
+	{
+		LOG_WARN("Failed to watch {}: {}", directory.string(), strerror(errno));
+		return;
+	}
+
+	Watch(directory);
+
+	std::error_code ec;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(directory, ec))
+	{
+		if (entry.is_directory(ec))
+		{
+			Watch(entry.path());
+		}
+	}
+#else
+	Scan(nullptr);
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef TARGET_LINUX
+	if (m_Handle >= 0)
+	{
+		close(m_Handle);
+	}
+#endif
+}
+
+std::vector<std::filesystem::path> FileWatcher::Changes()
+{
+	std::vector<std::filesystem::path> changes;
+#ifdef TARGET_LINUX
+	if (m_Handle < 0)
+	{
+		return changes;
+	}
+
+	alignas(inotify_event) char buffer[4096];
+	ssize_t length = 0;
+	while ((length = read(m_Handle, buffer, sizeof(buffer))) > 0)
+	{
+		for (const char* ptr = buffer; ptr < buffer + length; )
+		{
+			const inotify_event* event = (const inotify_event*)ptr;
+			ptr += sizeof(inotify_event) + event->len;
+
+			auto it = m_Watches.find(event->wd);
+			if (it == m_Watches.end() || event->len == 0)
+			{
+				continue;
+			}
+
+			std::filesystem::path path = it->second / event->name;
+			if (event->mask & IN_ISDIR)
+			{
+				Watch(path);
+			}
+			else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+			{
+				changes.push_back(path);
+			}
+		}
+	}
+#else
+	if (m_PollClock.GetElapsedTime() < PollInterval)
+	{
+		return changes;
+	}
+	m_PollClock.Restart();
+
+	Scan(&changes);
+#endif
+
+	// Editors tend to write a file in a few steps when saving it once
+	std::sort(changes.begin(), changes.end());
+	changes.erase(std::unique(changes.begin(), changes.end()), changes.end());
+
+	return changes;
+}
+
+#ifdef TARGET_LINUX
+void FileWatcher::Watch(const std::filesystem::path& directory)
+{
+	int32_t wd = inotify_add_watch(m_Handle, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR);
+	if (wd < 0)
+	{
+		LOG_WARN("Failed to watch {}: {}", directory.string(), strerror(errno));
+		return;
+	}
+
+	m_Watches[wd] = directory;
+}
+#else
+void FileWatcher::Scan(std::vector<std::filesystem::path>* changes)
+{
+	std::error_code ec;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(m_Directory, ec))
+	{
+		if (!entry.is_regular_file(ec))
+		{
+			continue;
+		}
+
+		std::filesystem::file_time_type writeTime = entry.last_write_time(ec);
+		auto [it, inserted] = m_WriteTimes.try_emplace(entry.path().generic_string(), writeTime);
+		if (changes != nullptr && (inserted || it->second != writeTime))
+		{
+			it->second = writeTime;
+			changes->push_back(entry.path());
+		}
+	}
+}
+#endif
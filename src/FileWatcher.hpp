@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Clock.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <unordered_map>
+
+// Files under a directory, subdirectories included, that were written or moved in since the last call to Changes.
+// Backed by inotify on Linux, elsewhere the write times are compared at most every PollInterval milliseconds
+class FileWatcher
+{
+public:
+	FileWatcher(const std::filesystem::path& directory);
+	~FileWatcher();
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	// Never blocks, every file is reported once however many times it was written
+	std::vector<std::filesystem::path> Changes();
+
+	static constexpr float PollInterval = 500.0f;
+
+private:
+	// Each platform uses only its half, the members stay unconditional so the layout doesn't depend on who includes the header
+	void Watch(const std::filesystem::path& directory);
+	void Scan(std::vector<std::filesystem::path>* changes);
+
+	std::filesystem::path m_Directory;
+
+	// inotify
+	int32_t m_Handle = -1;
+	std::unordered_map<int32_t, std::filesystem::path> m_Watches;
+
+	// Polling
+	std::unordered_map<std::string, std::filesystem::file_time_type> m_WriteTimes;
+	Clock m_PollClock;
+};
@@ -0,0 +1,292 @@
+#include "JobSystem.hpp"
+#include "Logger.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <thread>
+
+struct Job
+{
+	std::function<void()> Func;
+	JobCounter* Counter = nullptr;
+};
+
+struct JobQueue
+{
+	std::mutex Mutex;
+	std::deque<Job> Jobs;
+};
+
+struct JobSystemData
+{
+	// Queue 0 belongs to the thread that initialized the system, the rest to the workers
+	std::vector<std::unique_ptr<JobQueue>> Queues;
+	std::vector<std::thread> Workers;
+	uint32_t Users = 0;
+	std::mutex InitMutex;
+
+	// Queued can briefly drop below zero while a job is taken before its push is counted
+	std::atomic<int32_t> Queued = 0;
+	std::atomic<uint32_t> Sleeping = 0;
+	std::atomic<uint32_t> NextQueue = 0;
+	std::mutex SleepMutex;
+	std::condition_variable Wake;
+	bool Stop = false;
+};
+
+static JobSystemData s_Data{};
+static thread_local int32_t s_QueueIndex = -1;
+
+static void Push(Job&& job)
+{
+	uint32_t index = s_QueueIndex >= 0 ? (uint32_t)s_QueueIndex : s_Data.NextQueue.fetch_add(1, std::memory_order_relaxed) % s_Data.Queues.size();
+	{
+		JobQueue& queue = *s_Data.Queues[index];
+		std::lock_guard<std::mutex> lock(queue.Mutex);
+		queue.Jobs.push_back(std::move(job));
+	}
+
+	// Either a sleeping worker sees the job counted, or the push sees it sleeping
+	s_Data.Queued.fetch_add(1);
+	if (s_Data.Sleeping.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(s_Data.SleepMutex);
+		s_Data.Wake.notify_one();
+	}
+}
+
+static bool TryPop(Job& job)
+{
+	uint32_t queues = (uint32_t)s_Data.Queues.size();
+	uint32_t own = s_QueueIndex >= 0 ? (uint32_t)s_QueueIndex : 0;
+	for (uint32_t i = 0; i < queues; i++)
+	{
+		JobQueue& queue = *s_Data.Queues[(own + i) % queues];
+		std::lock_guard<std::mutex> lock(queue.Mutex);
+		if (queue.Jobs.empty())
+		{
+			continue;
+		}
+
+		bool owned = s_QueueIndex >= 0 && i == 0;
+		if (owned)
+		{
+			job = std::move(queue.Jobs.back());
+			queue.Jobs.pop_back();
+		}
+		else
+		{
+			job = std::move(queue.Jobs.front());
+			queue.Jobs.pop_front();
+		}
+
+		s_Data.Queued.fetch_sub(1);
+		return true;
+	}
+
+	return false;
+}
+
+void JobSystem::Init(uint32_t threads)
+{
+	std::lock_guard<std::mutex> lock(s_Data.InitMutex);
+	if (s_Data.Users++ > 0)
+	{
+		return;
+	}
+
+	threads = threads != 0 ? threads : std::thread::hardware_concurrency();
+	threads = threads != 0 ? threads : 1;
+
+	s_Data.Stop = false;
+	for (uint32_t i = 0; i < threads; i++)
+	{
+		s_Data.Queues.push_back(std::make_unique<JobQueue>());
+	}
+
+	s_QueueIndex = 0;
+	for (uint32_t i = 1; i < threads; i++)
+	{
+		s_Data.Workers.emplace_back(&JobSystem::WorkerLoop, (int32_t)i);
+	}
+
+	LOG_INFO("Job system started with {} threads.", threads);
+}
+
+void JobSystem::Shutdown()
+{
+	std::lock_guard<std::mutex> lock(s_Data.InitMutex);
+	if (s_Data.Users == 0 || --s_Data.Users > 0)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> sleepLock(s_Data.SleepMutex);
+		s_Data.Stop = true;
+	}
+
+	s_Data.Wake.notify_all();
+	for (std::thread& worker : s_Data.Workers)
+	{
+		worker.join();
+	}
+
+	s_Data.Workers.clear();
+	s_Data.Queues.clear();
+	s_QueueIndex = -1;
+	LOG_INFO("Job system stopped.");
+}
+
+uint32_t JobSystem::ThreadCount()
+{
+	return s_Data.Queues.empty() ? 1 : (uint32_t)s_Data.Queues.size();
+}
+
+void JobSystem::Run(std::function<void()>&& job, JobCounter* counter)
+{
+	if (counter)
+	{
+		counter->m_Pending.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	Queue(std::move(job), counter);
+}
+
+void JobSystem::RunAfter(JobCounter& dependency, std::function<void()>&& job, JobCounter* counter)
+{
+	if (counter)
+	{
+		counter->m_Pending.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	std::unique_lock<std::mutex> lock(dependency.m_Mutex);
+	if (!dependency.Done())
+	{
+		dependency.m_Continuations.push_back([job = std::move(job), counter]() mutable
+			{
+				Queue(std::move(job), counter);
+			});
+
+		return;
+	}
+
+	lock.unlock();
+	Queue(std::move(job), counter);
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	Job job;
+	while (!counter.Done())
+	{
+		if (!s_Data.Queues.empty() && TryPop(job))
+		{
+			Execute(job.Func, job.Counter);
+			continue;
+		}
+
+		std::this_thread::yield();
+	}
+
+	// The last job may still hold the lock while queuing continuations, the counter can't go away before it lets go
+	std::lock_guard<std::mutex> lock(counter.m_Mutex);
+}
+
+void JobSystem::ParallelFor(uint32_t count, const std::function<void(uint32_t begin, uint32_t end)>& func, uint32_t grainSize, uint32_t maxThreads)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	grainSize = grainSize == 0 ? 1 : grainSize;
+	uint32_t chunks = (count + grainSize - 1) / grainSize;
+	uint32_t threads = ThreadCount();
+	threads = maxThreads != 0 && maxThreads < threads ? maxThreads : threads;
+	threads = threads < chunks ? threads : chunks;
+
+	std::atomic<uint32_t> nextChunk = 0;
+	auto work = [&]()
+		{
+			uint32_t chunk = 0;
+			while ((chunk = nextChunk.fetch_add(1, std::memory_order_relaxed)) < chunks)
+			{
+				uint32_t begin = chunk * grainSize;
+				uint32_t end = begin + grainSize < count ? begin + grainSize : count;
+				func(begin, end);
+			}
+		};
+
+	// Chunks are taken from a shared index rather than queued one by one, a job per helping thread keeps the overhead flat
+	JobCounter counter;
+	for (uint32_t i = 1; i < threads; i++)
+	{
+		Run(work, &counter);
+	}
+
+	work();
+	Wait(counter);
+}
+
+void JobSystem::Queue(std::function<void()>&& job, JobCounter* counter)
+{
+	if (s_Data.Queues.empty())
+	{
+		Execute(job, counter);
+		return;
+	}
+
+	Push({ std::move(job), counter });
+}
+
+void JobSystem::WorkerLoop(int32_t index)
+{
+	s_QueueIndex = index;
+
+	Job job;
+	while (true)
+	{
+		if (TryPop(job))
+		{
+			Execute(job.Func, job.Counter);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(s_Data.SleepMutex);
+		s_Data.Sleeping++;
+		s_Data.Wake.wait(lock, []() { return s_Data.Queued.load() > 0 || s_Data.Stop; });
+		s_Data.Sleeping--;
+
+		// Queued work is finished before stopping, so nothing waited on is dropped
+		if (s_Data.Stop && s_Data.Queued.load() <= 0)
+		{
+			break;
+		}
+	}
+}
+
+void JobSystem::Execute(std::function<void()>& job, JobCounter* counter)
+{
+	job();
+	job = nullptr;
+	if (!counter)
+	{
+		return;
+	}
+
+	std::vector<std::function<void()>> continuations;
+	{
+		std::lock_guard<std::mutex> lock(counter->m_Mutex);
+		if (counter->m_Pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			continuations.swap(counter->m_Continuations);
+		}
+	}
+
+	for (std::function<void()>& continuation : continuations)
+	{
+		continuation();
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// Counts the jobs started with it that haven't finished. Has to be waited on before it goes out of scope
+class JobCounter
+{
+public:
+	inline bool Done() const { return m_Pending.load(std::memory_order_acquire) == 0; }
+
+private:
+	std::atomic<uint32_t> m_Pending = 0;
+	std::mutex m_Mutex;
+	std::vector<std::function<void()>> m_Continuations;
+
+	friend class JobSystem;
+};
+
+// Runs jobs on a thread per core, the one that initialized it included. Every thread has its own deque, it takes its newest job first
+// and steals the oldest ones of others once it runs out
+class JobSystem
+{
+public:
+	// Calls pair up, the workers start with the first Init and stop with the last Shutdown
+	static void Init(uint32_t threads = 0);
+	static void Shutdown();
+
+	static uint32_t ThreadCount();
+
+	// Runs the job inline while the system isn't initialized
+	static void Run(std::function<void()>&& job, JobCounter* counter = nullptr);
+	// Queues the job once every job counted by the dependency has finished
+	static void RunAfter(JobCounter& dependency, std::function<void()>&& job, JobCounter* counter = nullptr);
+	// Runs queued jobs until the counter reaches zero, so waiting threads keep working
+	static void Wait(JobCounter& counter);
+
+	// Splits [0, count) into chunks of grainSize taken by up to maxThreads threads (all when 0), the calling one included. Blocks until done
+	static void ParallelFor(uint32_t count, const std::function<void(uint32_t begin, uint32_t end)>& func, uint32_t grainSize = 1, uint32_t maxThreads = 0);
+
+private:
+	JobSystem() = delete;
+
+	static void Queue(std::function<void()>&& job, JobCounter* counter);
+	static void WorkerLoop(int32_t index);
+	static void Execute(std::function<void()>& job, JobCounter* counter);
+};
@@ -0,0 +1,101 @@
+#include "MappedFile.hpp"
+
+#if defined(TARGET_WINDOWS)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(TARGET_LINUX)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+MappedFile::MappedFile(const std::filesystem::path& path)
+{
+#if defined(TARGET_WINDOWS)
+	m_File = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_File == INVALID_HANDLE_VALUE)
+	{
+		m_File = nullptr;
+		return;
+	}
+
+	LARGE_INTEGER size{};
+	if (!GetFileSizeEx(m_File, &size) || size.QuadPart == 0)
+	{
+		return;
+	}
+
+	m_Mapping = CreateFileMappingW(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_Mapping)
+	{
+		m_Data = (const uint8_t*)MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0);
+		m_Size = m_Data ? (uint64_t)size.QuadPart : 0;
+	}
+#elif defined(TARGET_LINUX)
+	int32_t file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		return;
+	}
+
+	// The mapping keeps the file alive on its own
+	struct stat status{};
+	if (fstat(file, &status) == 0 && status.st_size > 0)
+	{
+		void* data = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (data != MAP_FAILED)
+		{
+			// Loaders read every byte anyway, so the whole file is read ahead instead of faulting page by page
+			madvise(data, (size_t)status.st_size, MADV_WILLNEED);
+			m_Data = (const uint8_t*)data;
+			m_Size = (uint64_t)status.st_size;
+		}
+	}
+
+	close(file);
+#else
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+	{
+		return;
+	}
+
+	m_Buffer.resize((size_t)file.tellg());
+	file.seekg(0);
+	file.read((char*)m_Buffer.data(), m_Buffer.size());
+	if (file && !m_Buffer.empty())
+	{
+		m_Data = m_Buffer.data();
+		m_Size = m_Buffer.size();
+	}
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#if defined(TARGET_WINDOWS)
+	if (m_Data)
+	{
+		UnmapViewOfFile(m_Data);
+	}
+
+	if (m_Mapping)
+	{
+		CloseHandle(m_Mapping);
+	}
+
+	if (m_File)
+	{
+		CloseHandle(m_File);
+	}
+#elif defined(TARGET_LINUX)
+	if (m_Data)
+	{
+		munmap((void*)m_Data, (size_t)m_Size);
+	}
+#endif
+}
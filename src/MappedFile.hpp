@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// Read only view of a whole file. Mapped into memory on Linux and Windows, which skips copying it through a stream,
+// elsewhere the file is read into a buffer up front
+class MappedFile
+{
+public:
+	MappedFile(const std::filesystem::path& path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Empty files can't be mapped and count as failing to open
+	inline bool IsOpen() const { return m_Data != nullptr; }
+	inline const uint8_t* Data() const { return m_Data; }
+	inline uint64_t Size() const { return m_Size; }
+
+private:
+	const uint8_t* m_Data = nullptr;
+	uint64_t m_Size = 0;
+
+	// Not every platform uses these, they're declared anyway so the layout doesn't depend on who includes the header
+	void* m_File = nullptr;		// Windows
+	void* m_Mapping = nullptr;	// Windows
+	std::vector<uint8_t> m_Buffer; // Fallback
+};
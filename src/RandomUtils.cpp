@@ -143,11 +143,12 @@ void ReplaceAll(std::string& source, const std::string& pattern, const std::stri
 		return;
 	}
 	
-	size_t start = std::string::npos;
-	while ((start = source.find(pattern)) != std::string::npos)
+	// Searching on from the end of the last replacement keeps this linear and never matches inside the inserted text
+	size_t start = 0;
+	while ((start = source.find(pattern, start)) != std::string::npos)
 	{
 		source.replace(start, pattern.length(), replacement);
-		start += pattern.length();
+		start += replacement.length();
 	}
 }
 
@@ -173,4 +174,16 @@ float LightRadius(float constantTerm, float linearTerm, float quadraticTerm, flo
 	);
 
 	return num / (2.0f * quadraticTerm);
-}
\ No newline at end of file
+}
+
+uint64_t FNV1a(const void* data, uint64_t size, uint64_t hash)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	for (uint64_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001B3ull;
+	}
+
+	return hash;
+}
@@ -16,4 +16,6 @@ float MaxComponent(const glm::vec2& vec);
 float MaxComponent(const glm::vec3& vec);
 float MaxComponent(const glm::vec4& vec);
 
+uint64_t FNV1a(const void* data, uint64_t size, uint64_t hash = 0xCBF29CE484222325ull);
+
 float LightRadius(float constantTerm, float linearTerm, float quadraticTerm, float maxBrightness);
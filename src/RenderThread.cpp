@@ -0,0 +1,204 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#define IMGUI_IMPL_OPENGL_LOADER_GLAD
+#include <imgui/imgui_impl_opengl3.h>
+
+#include <cstring>
+
+#include "RenderThread.hpp"
+#include "Clock.hpp"
+#include "Logger.hpp"
+#include "renderer/TextureResidency.hpp"
+
+template<typename T>
+static void CopyVector(ImVector<T>& destination, const ImVector<T>& source)
+{
+	// Unlike operator=, resize keeps the capacity from earlier frames
+	destination.resize(source.Size);
+	if (source.Size > 0)
+	{
+		memcpy(destination.Data, source.Data, source.size_in_bytes());
+	}
+}
+
+RenderThread::RenderThread(GLFWwindow* window)
+	: m_Window(window)
+{
+}
+
+RenderThread::~RenderThread()
+{
+	SetEnabled(false);
+}
+
+void RenderThread::SetEnabled(bool enabled)
+{
+	if (enabled == Enabled())
+	{
+		return;
+	}
+
+	if (enabled)
+	{
+		glfwMakeContextCurrent(nullptr);
+		m_Thread = std::thread(&RenderThread::Loop, this);
+		LOG_INFO("Render thread started.");
+
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stop = true;
+	}
+
+	m_Wake.notify_one();
+	m_Thread.join();
+	m_Stop = false;
+
+	glfwMakeContextCurrent(m_Window);
+	LOG_INFO("Render thread stopped.");
+}
+
+void RenderThread::Submit(std::function<void(FramePacket&)>&& command)
+{
+	Packet().Commands.push_back(std::move(command));
+}
+
+void RenderThread::Execute(const std::function<void()>& task)
+{
+	if (!Enabled() || std::this_thread::get_id() == m_Thread.get_id())
+	{
+		task();
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_Task = &task;
+	m_Wake.notify_one();
+	m_Idle.wait(lock, [this]() { return m_Task == nullptr; });
+}
+
+void RenderThread::EndFrame(const ImDrawData* ui)
+{
+	FramePacket& packet = Packet();
+	CopyDrawData(ui, packet);
+
+	if (!Enabled())
+	{
+		Draw(packet);
+		m_DrawnIndex = m_RecordIndex;
+		m_RecordIndex ^= 1;
+
+		return;
+	}
+
+	// The other packet is the previous frame, which has to be drawn before its slot is recorded into again
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_Idle.wait(lock, [this]() { return !m_Pending; });
+	m_DrawnIndex = m_RecordIndex ^ 1;
+	m_RecordIndex ^= 1;
+	m_Pending = true;
+	m_Wake.notify_one();
+}
+
+void RenderThread::Loop()
+{
+	glfwMakeContextCurrent(m_Window);
+
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	while (true)
+	{
+		m_Wake.wait(lock, [this]() { return m_Pending || m_Task || m_Stop; });
+
+		// Pending work is finished before stopping, so nothing recorded is dropped
+		if (m_Pending)
+		{
+			FramePacket& packet = m_Packets[m_RecordIndex ^ 1];
+			lock.unlock();
+			Draw(packet);
+			lock.lock();
+
+			m_Pending = false;
+			m_Idle.notify_all();
+			continue;
+		}
+
+		if (m_Task)
+		{
+			lock.unlock();
+			(*m_Task)();
+			lock.lock();
+
+			m_Task = nullptr;
+			m_Idle.notify_all();
+			continue;
+		}
+
+		break;
+	}
+
+	lock.unlock();
+	glfwMakeContextCurrent(nullptr);
+}
+
+void RenderThread::Draw(FramePacket& packet)
+{
+	Clock clock;
+	clock.Start();
+	for (std::function<void(FramePacket&)>& command : packet.Commands)
+	{
+		command(packet);
+	}
+
+	packet.Commands.clear();
+	packet.Stats = Renderer::Stats();
+	TextureResidency::EndFrame();
+	VirtualTexturing::EndFrame();
+	GLCall(glFinish());
+	packet.RenderTime = clock.GetElapsedTime();
+
+	packet.VirtualTextures = VirtualTexturing::Stats();
+	packet.TextureMemory = TextureResidency::CurrentUsage();
+	packet.TextureMemoryPeak = TextureResidency::PeakUsage();
+
+	clock.Restart();
+	ImGui_ImplOpenGL3_RenderDrawData(&packet.UI);
+	GLState::Invalidate();
+	GLCall(glFinish());
+	packet.ImGuiRenderTime = clock.GetElapsedTime();
+
+	glfwSwapBuffers(m_Window);
+}
+
+void RenderThread::CopyDrawData(const ImDrawData* source, FramePacket& packet)
+{
+	ImDrawData& ui = packet.UI;
+	ui.Valid = source->Valid;
+	ui.CmdListsCount = source->CmdListsCount;
+	ui.TotalIdxCount = source->TotalIdxCount;
+	ui.TotalVtxCount = source->TotalVtxCount;
+	ui.DisplayPos = source->DisplayPos;
+	ui.DisplaySize = source->DisplaySize;
+	ui.FramebufferScale = source->FramebufferScale;
+	ui.OwnerViewport = source->OwnerViewport;
+
+	while (packet.UILists.size() < (size_t)source->CmdListsCount)
+	{
+		packet.UILists.push_back(std::make_unique<ImDrawList>(ImGui::GetDrawListSharedData()));
+	}
+
+	ui.CmdLists.resize(source->CmdListsCount);
+	for (int32_t i = 0; i < source->CmdListsCount; i++)
+	{
+		const ImDrawList* from = source->CmdLists[i];
+		ImDrawList* to = packet.UILists[i].get();
+
+		CopyVector(to->CmdBuffer, from->CmdBuffer);
+		CopyVector(to->IdxBuffer, from->IdxBuffer);
+		CopyVector(to->VtxBuffer, from->VtxBuffer);
+		to->Flags = from->Flags;
+		ui.CmdLists[i] = to;
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <imgui/imgui.h>
+
+#include "renderer/Camera.hpp"
+#include "renderer/Renderer.hpp"
+#include "renderer/VirtualTexture.hpp"
+#include "scenes/Scene.hpp"
+
+struct GLFWwindow;
+
+// Everything needed to draw one frame, recorded by the main thread while the previous packet is drawn
+struct FramePacket
+{
+	Camera View;
+	SceneSnapshot Scene;
+
+	// GL work in the order it was submitted, run by whichever thread owns the context
+	std::vector<std::function<void(FramePacket&)>> Commands;
+
+	// ImGui rebuilds its draw lists every frame, so the packet keeps a copy
+	ImDrawData UI;
+	std::vector<std::unique_ptr<ImDrawList>> UILists;
+
+	// Filled in once the packet is drawn
+	RendererStats Stats{};
+	VirtualTexturingStats VirtualTextures{};
+	uint64_t TextureMemory = 0;
+	uint64_t TextureMemoryPeak = 0;
+	float RenderTime = 0.0f;
+	float ImGuiRenderTime = 0.0f;
+};
+
+// Draws frame packets on a thread that owns the GL context, so the next frame is simulated while the GPU work of this one is submitted.
+// Disabled, packets are drawn in place at the end of the frame
+class RenderThread
+{
+public:
+	RenderThread(GLFWwindow* window);
+	~RenderThread();
+
+	// Moves the context to the render thread, or back to the calling thread
+	void SetEnabled(bool enabled);
+	inline bool Enabled() const { return m_Thread.joinable(); }
+
+	inline FramePacket& Packet()				{ return m_Packets[m_RecordIndex]; }
+	inline const FramePacket& LastFrame() const { return m_Packets[m_DrawnIndex];  }
+
+	// Queues GL work into the packet being recorded
+	void Submit(std::function<void(FramePacket&)>&& command);
+
+	// Runs GL work on the thread owning the context and waits for it. Meant for rare actions like loading assets,
+	// it runs before anything submitted this frame
+	void Execute(const std::function<void()>& task);
+
+	// Hands the recorded packet over, waiting only until the previous one is drawn
+	void EndFrame(const ImDrawData* ui);
+
+private:
+	void Loop();
+	void Draw(FramePacket& packet);
+	void CopyDrawData(const ImDrawData* source, FramePacket& packet);
+
+	GLFWwindow* m_Window = nullptr;
+
+	std::array<FramePacket, 2> m_Packets;
+	uint32_t m_RecordIndex = 0;
+	uint32_t m_DrawnIndex = 1;
+
+	std::thread m_Thread;
+	std::mutex m_Mutex;
+	std::condition_variable m_Wake;
+	std::condition_variable m_Idle;
+	const std::function<void()>* m_Task = nullptr;
+	bool m_Pending = false;
+	bool m_Stop = false;
+};
@@ -5,8 +5,12 @@
 #include "../Animations.hpp"
 #include "../Timer.hpp"
 #include "../Logger.hpp"
+#include "../RenderThread.hpp"
 #include "../scenes/Entity.hpp"
 #include "../renderer/AssetManager.hpp"
+#include "../renderer/TextureCompressor.hpp"
+#include "../renderer/TextureResidency.hpp"
+#include "../renderer/VirtualTexture.hpp"
 #include "../RandomUtils.hpp"
 
 #include <imgui/imgui.h>
@@ -21,9 +25,7 @@ EditorLayer::EditorLayer()
 
 	m_GizmoMode = ImGuizmo::WORLD;
 
-	std::shared_ptr<Texture> hdrEnvMap = std::make_shared<Texture>("resources/textures/env_maps/default.hdr", TextureFormat::RGB16F);
-	hdrEnvMap->SetWrap(GL_CLAMP_TO_EDGE);
-	m_SkyboxFB = Renderer::CreateEnvCubemap(hdrEnvMap, { 1024, 1024 });
+	m_SkyboxFB = Renderer::CreateEnvCubemap("resources/textures/env_maps/default.hdr", { 1024, 1024 });
 
 	const WindowSpec& spec = Application::Instance()->Spec();
 	Event dummyEv{};
@@ -91,9 +93,10 @@ void EditorLayer::OnEvent(Event& ev)
 		{
 			// TODO: When bounding boxes are out (with frustrum culling), use them to determine offset
 			TransformComponent& tc = m_SelectedEntity.GetComponent<TransformComponent>();
+			glm::vec3 position = glm::vec3(m_SelectedEntity.GetComponent<WorldTransformComponent>().Matrix[3]);
 			glm::vec3 dir = -m_EditorCamera.GetForwardDirection() * MaxComponent(tc.Scale) * 2.5f;
 
-			Animations::DoVec3(m_EditorCamera.Position, tc.Position + dir, 0.25f, AnimType::EaseInOut);
+			Animations::DoVec3(m_EditorCamera.Position, position + dir, 0.25f, AnimType::EaseInOut);
 			return;
 		}
 
@@ -144,20 +147,7 @@ void EditorLayer::OnEvent(Event& ev)
 	if (!m_LockFocus && ev.Type == Event::MouseButtonPressed && ev.MouseButton.Button == MouseButton::Left && m_ViewportHovered)
 	{
 		glm::vec2 mousePos = Input::GetMousePosition() - glm::vec2(((float)Application::Instance()->Spec().Width / 5.0f), 0.0f);
-		glm::u8vec4 pixel = m_ScreenFB->GetPixelAt(mousePos, 1);
-
-		if (pixel == glm::u8vec4(0))
-		{
-			m_SelectedEntity = Entity();
-			return;
-		}
-
-		uint32_t redContrib   = pixel.r * 65025;
-		uint32_t greenContrib = pixel.g * 255;
-		uint32_t blueContrib  = pixel.b;
-		uint32_t pixelID = redContrib + greenContrib + blueContrib;
-		m_SelectedEntity = Entity((entt::entity)(uint32_t)(pixelID - 1), &m_Scene);
-
+		Pick(mousePos, [this](Entity picked) { m_SelectedEntity = picked; });
 		return;
 	}
 
@@ -165,13 +155,18 @@ void EditorLayer::OnEvent(Event& ev)
 	{
 		uint32_t width = (uint32_t)(ev.Size.Width * 0.6f);
 		uint32_t height = ev.Size.Height;
-
-		Renderer::OnWindowResize({ 0, 0, (int32_t)(ev.Size.Width * 0.6f), ev.Size.Height });
 		m_EditorCamera.OnEvent(ev);
 
-		m_ScreenFB->Bind();
-		m_ScreenFB->ResizeEverything({ width, height });
-		m_ScreenFB->Unbind();
+		Application::Instance()->GetRenderThread().Submit(
+			[this, width, height](FramePacket&)
+			{
+				Renderer::OnWindowResize({ 0, 0, (int32_t)width, (int32_t)height });
+
+				m_ScreenFB->Bind();
+				m_ScreenFB->ResizeEverything({ width, height });
+				m_ScreenFB->Unbind();
+			}
+		);
 
 		return;
 	}
@@ -181,15 +176,45 @@ void EditorLayer::OnEvent(Event& ev)
 
 void EditorLayer::OnUpdate(float ts)
 {
+	ResolvePick();
 	m_EditorCamera.OnUpdate(ts);
+	m_Scene.Update();
+	Application::Instance()->GetRenderThread().Submit([](FramePacket&) { Renderer::ReloadChangedShaders(); });
 }
 
 void EditorLayer::OnTick()
 {
 }
 
+void EditorLayer::Pick(const glm::vec2& coords, std::function<void(Entity)>&& onPicked)
+{
+	// A newer click makes the older one's result stale
+	m_PickCoords = glm::ivec2(coords);
+	m_OnPicked = std::move(onPicked);
+	m_PickSequence++;
+}
+
+void EditorLayer::ResolvePick()
+{
+	uint64_t result = m_PickResult.exchange(0);
+	if (result == 0 || (uint32_t)(result >> 32) != m_PickSequence || !m_OnPicked)
+	{
+		return;
+	}
+
+	// The entity could've been destroyed while the ID was on its way back
+	uint32_t pixelID = (uint32_t)result;
+	entt::entity handle = pixelID == 0 ? entt::null : (entt::entity)(pixelID - 1);
+	Entity picked = m_Scene.m_Registry.valid(handle) ? Entity(handle, &m_Scene) : Entity();
+
+	std::function<void(Entity)> onPicked = std::move(m_OnPicked);
+	m_OnPicked = nullptr;
+	onPicked(picked);
+}
+
 void EditorLayer::OnRender()
 {
+	m_Stats = Application::Instance()->GetRenderThread().LastFrame().Stats;
 	RenderScenePanel();
 	RenderViewport();
 
@@ -226,9 +251,37 @@ void EditorLayer::RenderScenePanel()
 		{
 			m_SelectedEntity = entity;
 		}
+
+		// Dropping an entity on another one parents it
+		if (ImGui::BeginDragDropSource())
+		{
+			entt::entity handle = entity.Handle();
+			ImGui::SetDragDropPayload("ENTITY", &handle, sizeof(handle));
+			ImGui::Text("%s", entity.GetComponent<TagComponent>().Tag.c_str());
+			ImGui::EndDragDropSource();
+		}
+
+		if (ImGui::BeginDragDropTarget())
+		{
+			if (const ImGuiPayload* payload = ImGui::AcceptDragDropPayload("ENTITY"))
+			{
+				m_Scene.SetParent(Entity(*(const entt::entity*)payload->Data, &m_Scene), entity);
+			}
+			ImGui::EndDragDropTarget();
+		}
 		ImGui::PopID();
 	}
 	ImGui::EndChild();
+
+	// Dropping it on the list itself makes it a root again
+	if (ImGui::BeginDragDropTarget())
+	{
+		if (const ImGuiPayload* payload = ImGui::AcceptDragDropPayload("ENTITY"))
+		{
+			m_Scene.SetParent(Entity(*(const entt::entity*)payload->Data, &m_Scene), Entity());
+		}
+		ImGui::EndDragDropTarget();
+	}
 	ImGui::PopStyleColor();
 
 	float buttonWidth = ImGui::GetContentRegionAvail().x / 3.0f;
@@ -238,14 +291,15 @@ void EditorLayer::RenderScenePanel()
 		ImGui::OpenPopup("new_entity_group");
 	}
 
+	RenderThread& renderThread = Application::Instance()->GetRenderThread();
 	if (ImGui::PrettyButton("Material editor", buttonSize))
 	{
-		Application::Instance()->PushLayer(std::make_unique<MaterialEditLayer>(m_Scene.m_Entities, m_SkyboxFB));
+		renderThread.Execute([this]() { Application::Instance()->PushLayer(std::make_unique<MaterialEditLayer>(m_Scene.m_Entities, m_SkyboxFB)); });
 	}
 
 	if (ImGui::PrettyButton("Reload shaders", buttonSize))
 	{
-		Renderer::ReloadShaders();
+		renderThread.Submit([](FramePacket&) { Renderer::ReloadShaders(); });
 	}
 
 	if (ImGui::BeginPopup("new_entity_group"))
@@ -314,6 +368,12 @@ void EditorLayer::RenderScenePanel()
 		}
 	);
 
+	if (!m_ModeReady)
+	{
+		ImGui::SameLine();
+		ImGui::TextDisabled("Compiling shaders...");
+	}
+
 	if (ImGui::PrettyButton("GBuffers"))
 	{
 		ImGui::OpenPopup("gbuffers_group");
@@ -323,7 +383,8 @@ void EditorLayer::RenderScenePanel()
 	{
 		ImVec4 tint{ 1.0f, 1.0f, 1.0f, 1.0f };
 		ImVec4 bord{ 0.33f, 0.33f, 0.33f, 1.0f };
-		G_BuffersIDs gs = Renderer::G_Buffers();
+		G_BuffersIDs gs{};
+		renderThread.Execute([&gs]() { gs = Renderer::G_Buffers(); });
 		ImGui::Image((ImTextureID)gs.G_Position, ImVec2(256.0f * m_EditorCamera.m_AspectRatio, 256.0f), { 0.0f, 1.0f }, { 1.0f, 0.0f }, tint, bord);
 		ImGui::SameLine();
 		ImGui::Image((ImTextureID)gs.G_Normal, ImVec2(256.0f * m_EditorCamera.m_AspectRatio, 256.0f), { 0.0f, 1.0f }, { 1.0f, 0.0f }, tint, bord);
@@ -342,9 +403,7 @@ void EditorLayer::RenderScenePanel()
 		std::optional<std::string> fileOpt = OpenFileDialog(std::filesystem::current_path().string());
 		if (fileOpt.has_value())
 		{
-			std::shared_ptr<Texture> hdrFile = std::make_shared<Texture>(fileOpt.value(), TextureFormat::RGB16F);
-			hdrFile->SetWrap(GL_CLAMP_TO_EDGE);
-			m_SkyboxFB = Renderer::CreateEnvCubemap(hdrFile, { 1024, 1024 });
+			renderThread.Execute([this, &fileOpt]() { m_SkyboxFB = Renderer::CreateEnvCubemap(fileOpt.value(), { 1024, 1024 }); });
 		}
 	}
 
@@ -361,8 +420,36 @@ void EditorLayer::RenderScenePanel()
 		ImGui::PrettyDragFloat("Pitch", &m_EditorCamera.m_Pitch, 1.0f, -FLT_MAX, FLT_MAX);
 		ImGui::PrettyDragFloat("Yaw", &m_EditorCamera.m_Yaw, 1.0f, -FLT_MAX, FLT_MAX);
 		ImGui::Checkbox("Bloom", &m_UseBloom);
+
+		bool computeBloom = Renderer::ComputeBloomEnabled();
+		if (ImGui::Checkbox("Compute bloom", &computeBloom))
+		{
+			renderThread.Execute([computeBloom]() { Renderer::SetComputeBloom(computeBloom); });
+		}
+
 		ImGui::Checkbox("Wireframe", &m_DrawWireframe);
 		ImGui::Checkbox("Grid", &m_DrawGrid);
+
+		bool irradianceSH = Renderer::IrradianceSH();
+		if (ImGui::Checkbox("SH irradiance", &irradianceSH))
+		{
+			renderThread.Execute([irradianceSH]() { Renderer::SetIrradianceSH(irradianceSH); });
+		}
+
+		// Residency runs on the render thread, the budget only changes there
+		uint64_t currentBudget = TextureResidency::Budget();
+		float budgetMB = currentBudget / (1024.0f * 1024.0f);
+		ImGui::PrettyDragFloat("Texture budget", &budgetMB, 1.0f, 16.0f, 16384.0f, "%.0f MB");
+		if (uint64_t budget = (uint64_t)(budgetMB * 1024.0f * 1024.0f); budget != currentBudget)
+		{
+			renderThread.Execute([budget]() { TextureResidency::SetBudget(budget); });
+		}
+
+		bool threaded = renderThread.Enabled();
+		if (ImGui::Checkbox("Render thread", &threaded))
+		{
+			renderThread.SetEnabled(threaded);
+		}
 		ImGui::Unindent(16.0f);
 	}
 
@@ -376,6 +463,7 @@ void EditorLayer::RenderScenePanel()
 		ImGui::TableSetupColumn("Value", ImGuiTableColumnFlags_WidthStretch);
 
 		const AppStats& stats = Application::Instance()->Stats();
+		const FramePacket& lastFrame = renderThread.LastFrame();
 
 		ImGui::TableNextColumn();
 		ImGui::Text("Frame time");
@@ -388,6 +476,18 @@ void EditorLayer::RenderScenePanel()
 		ImGui::TableNextColumn();
 		ImGui::Text("%u", static_cast<uint32_t>(1000.0f / stats.FrameTime));
 
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::Text("Frame time (one thread)");
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3fms", stats.SingleThreadedFrameTime);
+
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::Text("Frame time (render thread)");
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3fms", stats.RenderThreadFrameTime);
+
 		ImGui::TableNextRow();
 		ImGui::TableNextColumn();
 		ImGui::Text("Update time");
@@ -406,6 +506,12 @@ void EditorLayer::RenderScenePanel()
 		ImGui::TableNextColumn();
 		ImGui::Text("%.3fms", stats.ImGuiRenderTime);
 
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::Text("Render wait");
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3fms", stats.WaitTime);
+
 		ImGui::TableNextRow();
 		ImGui::TableNextColumn();
 		ImGui::Text("Point faces passed");
@@ -442,6 +548,24 @@ void EditorLayer::RenderScenePanel()
 		ImGui::TableNextColumn();
 		ImGui::Text("%.3fms", m_Stats.SpotlightShadowPassTime);
 
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::Text("Bloom (fragment)");
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3fms", m_Stats.BloomFragmentTime);
+
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::Text("Bloom (compute)");
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3fms", m_Stats.BloomComputeTime);
+
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::Text("Bloom chain");
+		ImGui::TableNextColumn();
+		ImGui::Text("%u mips, %.2fMB", m_Stats.BloomMips, m_Stats.BloomMemory / (1024.0f * 1024.0f));
+
 		ImGui::TableNextRow();
 		ImGui::TableNextColumn();
 		ImGui::Text("Draw calls");
@@ -454,12 +578,43 @@ void EditorLayer::RenderScenePanel()
 		ImGui::TableNextColumn();
 		ImGui::Text("%u", m_Stats.DrawCalls);
 
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::Text("GL state changes");
+		ImGui::TableNextColumn();
+		ImGui::Text("%u (%u redundant skipped)", m_Stats.StateChanges, m_Stats.StateChangesAvoided);
+
 		ImGui::TableNextRow();
 		ImGui::TableNextColumn();
 		ImGui::Text("Rendered meshes");
 		ImGui::TableNextColumn();
 		ImGui::Text("%u", m_Stats.ObjectsRendered);
 
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::Text("Texture memory");
+		ImGui::TableNextColumn();
+		ImGui::Text("%.2f MB", lastFrame.TextureMemory / (1024.0f * 1024.0f));
+
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::Text("Texture memory peak");
+		ImGui::TableNextColumn();
+		ImGui::Text("%.2f MB", lastFrame.TextureMemoryPeak / (1024.0f * 1024.0f));
+
+		const VirtualTexturingStats& vtStats = lastFrame.VirtualTextures;
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::Text("Virtual pages");
+		ImGui::TableNextColumn();
+		ImGui::Text("%d / %d (%d pending)", vtStats.ResidentPages, vtStats.PageCapacity, vtStats.PendingPages);
+
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::Text("Virtual page uploads");
+		ImGui::TableNextColumn();
+		ImGui::Text("%d (%d requested)", vtStats.UploadedPages, vtStats.RequestedPages);
+
 		ImGui::EndTable();
 		ImGui::Unindent(16.0f);
 	}
@@ -468,31 +623,70 @@ void EditorLayer::RenderScenePanel()
 }
 
 void EditorLayer::RenderViewport()
+{
+	RenderThread& renderThread = Application::Instance()->GetRenderThread();
+	FramePacket& packet = renderThread.Packet();
+	packet.View = m_EditorCamera.Snapshot();
+	m_Scene.Extract(packet.Scene);
+
+	ViewportFrame frame{
+		.Mode = m_Mode,
+		.BgColor = m_BgColor,
+		.ShadowOffsetsRadius = m_ShadowOffsetsRadius,
+		.DrawWireframe = m_DrawWireframe,
+		.UseBloom = m_UseBloom,
+		.BloomStrength = m_BloomStrength,
+		.BloomThreshold = m_BloomThreshold,
+		.Skybox = m_SkyboxFB,
+		.HasSelection = m_SelectedEntity.Handle() != entt::null && m_SelectedEntity.HasComponent<MeshComponent>(),
+		.PickSequence = m_PickCoords.has_value() ? m_PickSequence : 0,
+		.PickCoords = m_PickCoords.value_or(glm::ivec2(0))
+	};
+	m_PickCoords.reset();
+
+	if (frame.HasSelection)
+	{
+		TransformComponent outline = m_SelectedEntity.GetComponent<TransformComponent>();
+		outline.Scale += 0.1f;
+		frame.SelectedTransform = m_SelectedEntity.GetComponent<WorldTransformComponent>().Matrix;
+		frame.OutlineTransform = m_Scene.ParentTransform(m_SelectedEntity) * outline.ToMat4();
+		frame.SelectedMesh = m_SelectedEntity.GetComponent<MeshComponent>();
+		frame.SelectedID = (int32_t)m_SelectedEntity.Handle();
+	}
+
+	renderThread.Submit([this, frame](FramePacket& drawn) { DrawViewport(frame, drawn); });
+}
+
+void EditorLayer::DrawViewport(const ViewportFrame& frame, FramePacket& packet)
 {
 	Renderer::ResetStats();
 	Renderer::SetTargetFBO(m_ScreenFB);
 
-	m_Scene.RenderShadowMaps();
+	glm::u8vec4 pixel{};
+	if (m_PickReadback.Poll(pixel))
+	{
+		uint32_t pixelID = pixel.r * 65025 + pixel.g * 255 + pixel.b;
+		m_PickResult = ((uint64_t)m_PickInFlight << 32) | pixelID;
+	}
+
+	Scene::RenderShadowMaps(packet.Scene);
 	m_ScreenFB->Bind();
 	m_ScreenFB->BindRenderbuffer();
 	m_ScreenFB->DrawToColorAttachment(0, 0);
 	m_ScreenFB->DrawToColorAttachment(1, 1);
-	m_ScreenFB->FillDrawBuffers();
-	Renderer::ClearColor(m_BgColor);
+	GLCall(glDrawBuffer(GL_COLOR_ATTACHMENT0));
+	Renderer::ClearColor(frame.BgColor);
 	Renderer::Clear();
 
 	// Render selected entity to stencil buffer
-	if (m_SelectedEntity.Handle() != entt::null && m_SelectedEntity.HasComponent<MeshComponent>())
+	if (frame.HasSelection)
 	{
-		TransformComponent& transform = m_SelectedEntity.GetComponent<TransformComponent>();
-		MeshComponent& mesh	= m_SelectedEntity.GetComponent<MeshComponent>();
-		
 		Renderer::SetStencilFunc(GL_ALWAYS, 1, 0xFF);
 		Renderer::SetStencilMask(0xFF);
 		Renderer::DisableDepthTest();
 		Renderer::SetRenderMode(RenderMode::FLAT_SHADING);
-		Renderer::SceneBegin(m_EditorCamera);
-		Renderer::SubmitMesh(transform.ToMat4(), mesh, {}, (int32_t)m_SelectedEntity.Handle());
+		Renderer::SceneBegin(packet.View);
+		Renderer::SubmitMesh(frame.SelectedTransform, frame.SelectedMesh, {}, frame.SelectedID);
 		Renderer::SceneEnd();
 		Renderer::SetRenderMode(RenderMode::FORWARD);
 		Renderer::EnableDepthTest();
@@ -500,19 +694,40 @@ void EditorLayer::RenderViewport()
 	}
 
 	// Normal pass
-	Renderer::SetOffsetsRadius(m_ShadowOffsetsRadius);
-	Renderer::SetWireframe(m_DrawWireframe);
+	Renderer::SetOffsetsRadius(frame.ShadowOffsetsRadius);
+	Renderer::SetWireframe(frame.DrawWireframe);
 	Renderer::SetStencilFunc(GL_ALWAYS, 0, 0xFF);
 	Renderer::SetStencilMask(0x00);
-	Renderer::DrawSkybox(m_SkyboxFB);
-	m_ScreenFB->ClearColorAttachment(1);
-	m_Scene.Render(m_EditorCamera, m_Mode);
+	Renderer::DrawSkybox(frame.Skybox);
+	Scene::Render(packet.Scene, packet.View, frame.Mode);
 	Renderer::SetWireframe(false);
 
-	if (m_UseBloom)
+	// Entity IDs are drawn only for frames with a click, and only the clicked pixel gets rasterized
+	if (frame.PickSequence != 0)
 	{
-		Renderer::SetBloomStrength(m_BloomStrength);
-		Renderer::SetBloomThreshold(m_BloomThreshold);
+		glm::ivec2 coords = glm::clamp(frame.PickCoords, glm::ivec2(0), m_ScreenFB->ColorAttachmentSize(1) - 1);
+		const GLenum pickBuffers[] = { GL_NONE, GL_COLOR_ATTACHMENT1 };
+
+		m_ScreenFB->Bind();
+		m_ScreenFB->ClearColorAttachment(1);
+		GLCall(glDrawBuffers(2, pickBuffers));
+		GLState::Enable(GL_SCISSOR_TEST);
+		GLCall(glScissor(coords.x, coords.y, 1, 1));
+		Renderer::Clear(GL_DEPTH_BUFFER_BIT);
+		Renderer::SetVirtualTextureFeedback(false);
+		Scene::Render(packet.Scene, packet.View, RenderMode::FLAT_SHADING);
+		Renderer::SetVirtualTextureFeedback(true);
+		GLState::Disable(GL_SCISSOR_TEST);
+		GLCall(glDrawBuffer(GL_COLOR_ATTACHMENT0));
+
+		m_PickReadback.Request(*m_ScreenFB, 1, coords);
+		m_PickInFlight = frame.PickSequence;
+	}
+
+	if (frame.UseBloom)
+	{
+		Renderer::SetBloomStrength(frame.BloomStrength);
+		Renderer::SetBloomThreshold(frame.BloomThreshold);
 		Renderer::Bloom(m_ScreenFB);
 	}
 	else
@@ -527,13 +742,9 @@ void EditorLayer::RenderViewport()
 	Renderer::DrawScreenQuad();
 	
 	// Render selected entity outline (skip gamma correction and tone mapping for the outline)
-	if (m_SelectedEntity.Handle() != entt::null && m_SelectedEntity.HasComponent<MeshComponent>())
+	if (frame.HasSelection)
 	{
-		TransformComponent transform = m_SelectedEntity.GetComponent<TransformComponent>();
-		MeshComponent mesh = m_SelectedEntity.GetComponent<MeshComponent>();
 		Material material{};
-
-		transform.Scale += 0.1f;
 		material.Color = { 0.76f, 0.20f, 0.0f, 1.0f };
 		material.AlbedoTextureID = AssetManager::TEXTURE_WHITE;
 
@@ -542,8 +753,8 @@ void EditorLayer::RenderViewport()
 		Renderer::DisableDepthTest();
 		Renderer::DisableFaceCulling();
 		Renderer::SetRenderMode(RenderMode::FLAT_SHADING);
-		Renderer::SceneBegin(m_EditorCamera);
-		Renderer::SubmitMesh(transform.ToMat4(), mesh, material, (int32_t)m_SelectedEntity.Handle());
+		Renderer::SceneBegin(packet.View);
+		Renderer::SubmitMesh(frame.OutlineTransform, frame.SelectedMesh, material, frame.SelectedID);
 		Renderer::SceneEnd();
 		Renderer::EnableDepthTest();
 		Renderer::EnableFaceCulling();
@@ -554,7 +765,7 @@ void EditorLayer::RenderViewport()
 	Renderer::SetStencilMask(0xFF);
 	m_ScreenFB->Unbind();
 
-	m_Stats = Renderer::Stats();
+	m_ModeReady = Renderer::RenderModeReady(frame.Mode);
 }
 
 void EditorLayer::RenderEntityData()
@@ -587,6 +798,9 @@ void EditorLayer::RenderEntityData()
 		ImGui::PrettyDragFloat3("Rotation", glm::value_ptr(transform.Rotation), 0.05f);
 		ImGui::PrettyDragFloat3("Scale",    glm::value_ptr(transform.Scale),    0.05f);
 		ImGui::Unindent(16.0f);
+
+		// The drags write straight into the component
+		m_SelectedEntity.PatchComponent<TransformComponent>();
 	}
 	ImGui::PopID();
 
@@ -649,14 +863,20 @@ void EditorLayer::RenderEntityData()
 			ImVec2 buttonSize(buttonWidth, 0.0f);
 			ImGui::SetCursorPosX(ImGui::GetContentRegionAvail().x / 2.0f - buttonWidth + 16.0f);
 
+			RenderThread& renderThread = Application::Instance()->GetRenderThread();
 			if (ImGui::PrettyButton("Edit", buttonSize))
 			{
-				Application::Instance()->PushLayer(
-					std::make_unique<MaterialEditLayer>(
-						m_Scene.m_Entities,
-						m_SelectedEntity.GetComponent<MaterialComponent>().MaterialID,
-						m_SkyboxFB
-					)
+				renderThread.Execute(
+					[this]()
+					{
+						Application::Instance()->PushLayer(
+							std::make_unique<MaterialEditLayer>(
+								m_Scene.m_Entities,
+								m_SelectedEntity.GetComponent<MaterialComponent>().MaterialID,
+								m_SkyboxFB
+							)
+						);
+					}
 				);
 			}
 
@@ -665,11 +885,16 @@ void EditorLayer::RenderEntityData()
 			if (ImGui::PrettyButton("New", buttonSize))
 			{
 				m_SelectedEntity.GetComponent<MaterialComponent>().MaterialID = AssetManager::AddMaterial(AssetManager::GetMaterial(AssetManager::MATERIAL_DEFAULT));
-				Application::Instance()->PushLayer(
-					std::make_unique<MaterialEditLayer>(m_Scene.m_Entities, 
-						m_SelectedEntity.GetComponent<MaterialComponent>().MaterialID,
-						m_SkyboxFB
-					)
+				renderThread.Execute(
+					[this]()
+					{
+						Application::Instance()->PushLayer(
+							std::make_unique<MaterialEditLayer>(m_Scene.m_Entities, 
+								m_SelectedEntity.GetComponent<MaterialComponent>().MaterialID,
+								m_SkyboxFB
+							)
+						);
+					}
 				);
 			}
 
@@ -687,22 +912,32 @@ void EditorLayer::RenderEntityData()
 			};
 
 			ImGui::BeginPrettyCombo("Filtering", textures[0]->Filter() == GL_NEAREST ? "Nearest" : "Linear",
-				[this, &textures]()
+				[this, &textures, &renderThread]()
 				{
 					if (ImGui::Selectable("Nearest", textures[0]->Filter() == GL_NEAREST))
 					{
-						for (auto& tex : textures)
-						{
-							tex->SetFilter(GL_NEAREST);
-						}
+						renderThread.Execute(
+							[&textures]()
+							{
+								for (auto& tex : textures)
+								{
+									tex->SetFilter(GL_NEAREST);
+								}
+							}
+						);
 					}
 
 					if (ImGui::Selectable("Linear", textures[0]->Filter() == GL_LINEAR))
 					{
-						for (auto& tex : textures)
-						{
-							tex->SetFilter(GL_LINEAR);
-						}
+						renderThread.Execute(
+							[&textures]()
+							{
+								for (auto& tex : textures)
+								{
+									tex->SetFilter(GL_LINEAR);
+								}
+							}
+						);
 					}
 				}
 			);
@@ -717,22 +952,29 @@ void EditorLayer::RenderEntityData()
 			std::string preview = wrapToString.at(textures[0]->Wrap());
 
 			ImGui::BeginPrettyCombo("Wrapping", preview.c_str(),
-				[this, &textures, &wrapToString]()
+				[this, &textures, &wrapToString, &renderThread]()
 				{
 					for (const auto& [wrap, wrapStr] : wrapToString)
 					{
 						if (ImGui::Selectable(wrapStr.c_str(), textures[0]->Wrap() == wrap))
 						{
-							for (auto& tex : textures)
-							{
-								tex->SetWrap(wrap);
-							}
+							renderThread.Execute(
+								[&textures, wrap]()
+								{
+									for (auto& tex : textures)
+									{
+										tex->SetWrap(wrap);
+									}
+								}
+							);
 						}
 					}
 				}
 			);
 
 			static int32_t* idOfInterest = nullptr;
+			static TextureFormat formatOfInterest = TextureFormat::BC7;
+			static MipContent contentOfInterest = MipContent::COLOR_SRGB;
 			std::shared_ptr<Texture> texture = AssetManager::GetTexture(material.AlbedoTextureID);
 			if (ImGui::TextureFrame("##Albedo", (ImTextureID)texture->GetID(),
 				[this, &texture, &material]()
@@ -750,6 +992,8 @@ void EditorLayer::RenderEntityData()
 			))
 			{
 				idOfInterest = &material.AlbedoTextureID;
+				formatOfInterest = TextureFormat::BC7;
+				contentOfInterest = MipContent::COLOR_SRGB;
 				ImGui::OpenPopup("available_textures_group");
 			}
 
@@ -763,6 +1007,8 @@ void EditorLayer::RenderEntityData()
 			))
 			{
 				idOfInterest = &material.NormalTextureID;
+				formatOfInterest = TextureFormat::BC5;
+				contentOfInterest = MipContent::NORMAL_MAP;
 				ImGui::OpenPopup("available_textures_group");
 			}
 
@@ -778,6 +1024,8 @@ void EditorLayer::RenderEntityData()
 			))
 			{
 				idOfInterest = &material.HeightTextureID;
+				formatOfInterest = TextureFormat::BC4;
+				contentOfInterest = MipContent::LINEAR;
 				ImGui::OpenPopup("available_textures_group");
 			}
 
@@ -792,6 +1040,8 @@ void EditorLayer::RenderEntityData()
 			))
 			{
 				idOfInterest = &material.RoughnessTextureID;
+				formatOfInterest = TextureFormat::BC4;
+				contentOfInterest = MipContent::LINEAR;
 				ImGui::OpenPopup("available_textures_group");
 			}
 
@@ -806,6 +1056,8 @@ void EditorLayer::RenderEntityData()
 			))
 			{
 				idOfInterest = &material.MetallicTextureID;
+				formatOfInterest = TextureFormat::BC4;
+				contentOfInterest = MipContent::LINEAR;
 				ImGui::OpenPopup("available_textures_group");
 			}
 
@@ -820,9 +1072,31 @@ void EditorLayer::RenderEntityData()
 			))
 			{
 				idOfInterest = &material.AmbientOccTextureID;
+				formatOfInterest = TextureFormat::BC4;
+				contentOfInterest = MipContent::LINEAR;
 				ImGui::OpenPopup("available_textures_group");
 			}
 
+			if (material.VirtualTextureID == -1)
+			{
+				if (ImGui::PrettyButton("Stream albedo"))
+				{
+					std::optional<std::string> path = OpenFileDialog(std::filesystem::current_path().string());
+					if (path.has_value())
+					{
+						renderThread.Execute([&material, &path]() { material.VirtualTextureID = VirtualTexturing::Load(path.value()); });
+					}
+				}
+			}
+			else
+			{
+				ImGui::Text("Streamed albedo: %s", VirtualTexturing::Name(material.VirtualTextureID).c_str());
+				if (ImGui::PrettyButton("Stop streaming"))
+				{
+					material.VirtualTextureID = -1;
+				}
+			}
+
 			ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, { 10.0f, 10.0f });
 			if (ImGui::BeginPopup("available_textures_group"))
 			{
@@ -836,6 +1110,14 @@ void EditorLayer::RenderEntityData()
 						*idOfInterest = id;
 					}
 
+					if (ImGui::IsItemHovered())
+					{
+						float vramMB = texture->VRAMSize() / (1024.0f * 1024.0f);
+						float savedMB = (texture->UncompressedSize() - texture->VRAMSize()) / (1024.0f * 1024.0f);
+						ImGui::SetTooltip("%s\n%dx%d %s\nVRAM: %.2f MB (saved %.2f MB)", texture->Name().c_str(),
+							texture->GetWidth(), texture->GetHeight(), TextureCompressor::FormatName(texture->Format()), vramMB, savedMB);
+					}
+
 					if (cnt++ % 3 == 0)
 					{
 						ImGui::NewLine();
@@ -864,8 +1146,13 @@ void EditorLayer::RenderEntityData()
 
 					if (path.has_value())
 					{
-						std::shared_ptr<Texture> texture = std::make_shared<Texture>(path.value());
-						*idOfInterest = AssetManager::AddTexture(texture);
+						renderThread.Execute(
+							[&path]()
+							{
+								std::shared_ptr<Texture> texture = std::make_shared<Texture>(path.value(), formatOfInterest, contentOfInterest);
+								*idOfInterest = AssetManager::AddTexture(texture);
+							}
+						);
 						ImGui::CloseCurrentPopup();
 					}
 				}
@@ -1020,7 +1307,9 @@ void EditorLayer::RenderGizmo()
 
 	const glm::mat4& cameraProj = m_EditorCamera.GetProjection();
 	const glm::mat4& cameraView = m_EditorCamera.GetViewMatrix();
-	glm::mat4 transform = m_SelectedEntity.GetComponent<TransformComponent>().ToMat4();
+	// The gizmo works on the world transform, its result is turned back into the local one
+	glm::mat4 parentTransform = m_Scene.ParentTransform(m_SelectedEntity);
+	glm::mat4 transform = parentTransform * m_SelectedEntity.GetComponent<TransformComponent>().ToMat4();
 
 	bool doSnap = Input::IsKeyPressed(Key::LeftControl);
 	float snapStep = (m_GizmoOp == ImGuizmo::ROTATE ? 45.0f : 0.5f);
@@ -1038,11 +1327,12 @@ void EditorLayer::RenderGizmo()
 		glm::vec3 scale{};
 		TransformComponent& transformComp = m_SelectedEntity.GetComponent<TransformComponent>();
 
-		TransformDecompose(transform, translation, rotation, scale);
+		TransformDecompose(glm::inverse(parentTransform) * transform, translation, rotation, scale);
 		glm::vec3 deltaRotation = rotation - transformComp.Rotation;
 		
 		transformComp.Position = translation;
 		transformComp.Rotation = transformComp.Rotation + deltaRotation;
 		transformComp.Scale = scale;
+		m_SelectedEntity.PatchComponent<TransformComponent>();
 	}
 }
@@ -6,10 +6,14 @@
 #include "../scenes/Entity.hpp"
 #include "../renderer/Renderer.hpp"
 
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <optional>
 
 class OldFramebuffer;
 class MultisampledFramebuffer;
+struct FramePacket;
 
 class EditorLayer : public Layer
 {
@@ -23,8 +27,35 @@ public:
 	virtual void OnRender()			override;
 
 private:
+	// Settings the viewport is drawn with, copied so the render thread never reads the editor's members
+	struct ViewportFrame
+	{
+		RenderMode Mode;
+		glm::vec4 BgColor;
+		float ShadowOffsetsRadius;
+		bool DrawWireframe;
+		bool UseBloom;
+		float BloomStrength;
+		float BloomThreshold;
+		std::shared_ptr<Framebuffer> Skybox;
+
+		bool HasSelection;
+		glm::mat4 SelectedTransform; // World matrix, masks the selection in the stencil
+		glm::mat4 OutlineTransform;	 // The same, scaled up locally so it sticks out past the mask
+		MeshComponent SelectedMesh;
+		int32_t SelectedID;
+
+		uint32_t PickSequence; // 0 without a click to resolve
+		glm::ivec2 PickCoords;
+	};
+
+	// The next frame draws entity IDs under the coordinates, the callback gets the entity once they're read back a frame or two later
+	void Pick(const glm::vec2& coords, std::function<void(Entity)>&& onPicked);
+	void ResolvePick();
+
 	void RenderScenePanel();
 	void RenderViewport();
+	void DrawViewport(const ViewportFrame& frame, FramePacket& packet);
 	void RenderEntityData();
 	void RenderGizmo();
 
@@ -56,7 +87,18 @@ private:
 
 	std::shared_ptr<Framebuffer> m_ScreenFB;
 	std::shared_ptr<Framebuffer> m_SkyboxFB;
-	
+
+	// Main thread
+	std::optional<glm::ivec2> m_PickCoords;
+	std::function<void(Entity)> m_OnPicked;
+	uint32_t m_PickSequence = 0;
+	// Render thread
+	PixelReadback m_PickReadback;
+	uint32_t m_PickInFlight = 0;
+	// Click sequence in the high half, entity ID + 1 in the low one (0 for the background). Zero until a read arrives
+	std::atomic<uint64_t> m_PickResult = 0;
+
 	RenderMode m_Mode = RenderMode::FORWARD;
 	RendererStats m_Stats{};
+	std::atomic<bool> m_ModeReady = true;
 };
\ No newline at end of file
@@ -1,11 +1,13 @@
 #include "MaterialEditLayer.hpp"
 
 #include "../Application.hpp"
+#include "../RenderThread.hpp"
 #include "../Timer.hpp"
 #include "../renderer/Renderer.hpp"
 #include "../Logger.hpp"
 #include "../scenes/Entity.hpp"
 #include "../renderer/AssetManager.hpp"
+#include "../renderer/TextureCompressor.hpp"
 #include "../RandomUtils.hpp"
 
 #include <imgui/imgui.h>
@@ -116,17 +118,22 @@ void MaterialEditLayer::OnEvent(Event& ev)
 	{
 		uint32_t width = (uint32_t)(ev.Size.Width * 0.8f);
 		uint32_t height = ev.Size.Height;
-
-		Renderer::OnWindowResize({ 0, 0, (int32_t)(ev.Size.Width * 0.8f), ev.Size.Height });
 		m_Camera.OnEvent(ev);
 
-		m_ScreenFB->Bind();
-		m_ScreenFB->ResizeEverything({ width, height });
-		m_ScreenFB->Unbind();
+		Application::Instance()->GetRenderThread().Submit(
+			[this, width, height](FramePacket&)
+			{
+				Renderer::OnWindowResize({ 0, 0, (int32_t)width, (int32_t)height });
+
+				m_ScreenFB->Bind();
+				m_ScreenFB->ResizeEverything({ width, height });
+				m_ScreenFB->Unbind();
 
-		m_MainFB->Bind();
-		m_MainFB->ResizeEverything({ width, height });
-		m_MainFB->Unbind();
+				m_MainFB->Bind();
+				m_MainFB->ResizeEverything({ width, height });
+				m_MainFB->Unbind();
+			}
+		);
 
 		return;
 	}
@@ -140,6 +147,7 @@ void MaterialEditLayer::OnUpdate(float ts)
 	float distance = glm::length(m_Camera.Position);
 	m_Camera.Position = -normalizedCameraForward * distance;
 	m_Camera.OnUpdate(ts);
+	m_Scene.Update();
 }
 
 void MaterialEditLayer::OnTick()
@@ -149,41 +157,51 @@ void MaterialEditLayer::OnTick()
 void MaterialEditLayer::OnRender()
 {
 	RenderPanel();
-	
-	m_MainFB->Bind();
-	m_MainFB->BindRenderbuffer();
-	m_MainFB->DrawToColorAttachment(0, 0);
-	m_MainFB->DrawToColorAttachment(1, 1);
-	m_MainFB->FillDrawBuffers();
-	Renderer::ClearColor(glm::vec4(m_BgColor, 1.0f));
-	Renderer::Clear();
-	Renderer::DrawSkybox(m_SkyboxFBO);
-	m_MainFB->ClearColorAttachment(1);
-	m_Scene.Render(m_Camera, RenderMode::FORWARD);
-	m_MainFB->DrawToColorAttachment(0, 0);
-	m_MainFB->DrawToColorAttachment(1, 1);
-	m_ScreenFB->DrawToColorAttachment(0, 0);
-	m_ScreenFB->DrawToColorAttachment(1, 1);
-	m_MainFB->BlitColorAttachment(0, 0, *m_ScreenFB);
-	m_MainFB->BlitColorAttachment(1, 1, *m_ScreenFB);
-
-	if (m_UseBloom)
-	{
-		Renderer::SetBloomStrength(m_BloomStrength);
-		Renderer::SetBloomThreshold(m_BloomThreshold);
-		// Renderer::Bloom(m_ScreenFB);
-	}
-	else
-	{
-		Renderer::SetBloomStrength(0.0f);
-	}
-	m_MainFB->BindRenderbuffer();
-	m_ScreenFB->Bind();
-	m_ScreenFB->BindColorAttachment(0);
-	m_ScreenFB->DrawToColorAttachment(2, 2);
-	GLCall(glDrawBuffer(GL_COLOR_ATTACHMENT2));
-	Renderer::DrawScreenQuad();
-	m_ScreenFB->Unbind();
+
+	RenderThread& renderThread = Application::Instance()->GetRenderThread();
+	FramePacket& packet = renderThread.Packet();
+	packet.View = m_Camera.Snapshot();
+	m_Scene.Extract(packet.Scene);
+
+	renderThread.Submit(
+		[this, bgColor = m_BgColor, useBloom = m_UseBloom, bloomStrength = m_BloomStrength, bloomThreshold = m_BloomThreshold](FramePacket& drawn)
+		{
+			m_MainFB->Bind();
+			m_MainFB->BindRenderbuffer();
+			m_MainFB->DrawToColorAttachment(0, 0);
+			m_MainFB->DrawToColorAttachment(1, 1);
+			m_MainFB->FillDrawBuffers();
+			Renderer::ClearColor(glm::vec4(bgColor, 1.0f));
+			Renderer::Clear();
+			Renderer::DrawSkybox(m_SkyboxFBO);
+			m_MainFB->ClearColorAttachment(1);
+			Scene::Render(drawn.Scene, drawn.View, RenderMode::FORWARD);
+			m_MainFB->DrawToColorAttachment(0, 0);
+			m_MainFB->DrawToColorAttachment(1, 1);
+			m_ScreenFB->DrawToColorAttachment(0, 0);
+			m_ScreenFB->DrawToColorAttachment(1, 1);
+			m_MainFB->BlitColorAttachment(0, 0, *m_ScreenFB);
+			m_MainFB->BlitColorAttachment(1, 1, *m_ScreenFB);
+
+			if (useBloom)
+			{
+				Renderer::SetBloomStrength(bloomStrength);
+				Renderer::SetBloomThreshold(bloomThreshold);
+				// Renderer::Bloom(m_ScreenFB);
+			}
+			else
+			{
+				Renderer::SetBloomStrength(0.0f);
+			}
+			m_MainFB->BindRenderbuffer();
+			m_ScreenFB->Bind();
+			m_ScreenFB->BindColorAttachment(0);
+			m_ScreenFB->DrawToColorAttachment(2, 2);
+			GLCall(glDrawBuffer(GL_COLOR_ATTACHMENT2));
+			Renderer::DrawScreenQuad();
+			m_ScreenFB->Unbind();
+		}
+	);
 	
 	ImGui::SetNextWindowPos({ ((float)Application::Instance()->Spec().Width * 0.2f), 0.0f });
 	ImGui::SetNextWindowSize({ (float)Application::Instance()->Spec().Width * 0.8f, (float)Application::Instance()->Spec().Height });
@@ -269,6 +287,7 @@ void MaterialEditLayer::RenderPanel()
 		ImGui::Text("Light");
 		ImGui::Separator();
 		ImGui::PrettyDragFloat3("Position", glm::value_ptr(tc.Position), 0.05f);
+		m_LightEnt.PatchComponent<TransformComponent>();
 
 		ImGui::PushID(1);
 		ImGui::ColorEdit3("Color", glm::value_ptr(plc.Color), ImGuiColorEditFlags_NoInputs);
@@ -300,19 +319,18 @@ void MaterialEditLayer::RenderPanel()
 		std::shared_ptr<Texture> tex    = AssetManager::GetTexture(material.AlbedoTextureID);
 		std::shared_ptr<Texture> normal = AssetManager::GetTexture(material.NormalTextureID);
 
+		RenderThread& renderThread = Application::Instance()->GetRenderThread();
 		ImGui::BeginPrettyCombo("Filtering", tex->Filter() == GL_NEAREST ? "Nearest" : "Linear",
-			[this, &tex, &normal]()
+			[this, &tex, &normal, &renderThread]()
 			{
 				if (ImGui::Selectable("Nearest", tex->Filter() == GL_NEAREST))
 				{
-					tex->SetFilter(GL_NEAREST);
-					normal->SetFilter(GL_NEAREST);
+					renderThread.Execute([&tex, &normal]() { tex->SetFilter(GL_NEAREST); normal->SetFilter(GL_NEAREST); });
 				}
 
 				if (ImGui::Selectable("Linear", tex->Filter() == GL_LINEAR))
 				{
-					tex->SetFilter(GL_LINEAR);
-					normal->SetFilter(GL_LINEAR);
+					renderThread.Execute([&tex, &normal]() { tex->SetFilter(GL_LINEAR); normal->SetFilter(GL_LINEAR); });
 				}
 			}
 		);
@@ -327,20 +345,21 @@ void MaterialEditLayer::RenderPanel()
 		std::string preview = wrapToString.at(tex->Wrap());
 
 		ImGui::BeginPrettyCombo("Wrapping", preview.c_str(),
-			[this, &tex, &normal, &wrapToString]()
+			[this, &tex, &normal, &wrapToString, &renderThread]()
 			{
 				for (const auto& [wrap, wrapStr] : wrapToString)
 				{
 					if (ImGui::Selectable(wrapStr.c_str(), tex->Filter() == wrap))
 					{
-						tex->SetWrap(wrap);
-						normal->SetWrap(wrap);
+						renderThread.Execute([&tex, &normal, wrap]() { tex->SetWrap(wrap); normal->SetWrap(wrap); });
 					}
 				}
 			}
 		);
 
 		static int32_t* idOfInterest = nullptr;
+		static TextureFormat formatOfInterest = TextureFormat::BC7;
+		static MipContent contentOfInterest = MipContent::COLOR_SRGB;
 		std::shared_ptr<Texture> texture = AssetManager::GetTexture(material.AlbedoTextureID);
 		if (ImGui::TextureFrame("##Albedo", (ImTextureID)texture->GetID(),
 			[this, &texture, &material]()
@@ -352,6 +371,8 @@ void MaterialEditLayer::RenderPanel()
 		))
 		{
 			idOfInterest = &material.AlbedoTextureID;
+			formatOfInterest = TextureFormat::BC7;
+			contentOfInterest = MipContent::COLOR_SRGB;
 			ImGui::OpenPopup("available_textures_group");
 		}
 
@@ -365,6 +386,8 @@ void MaterialEditLayer::RenderPanel()
 		))
 		{
 			idOfInterest = &material.NormalTextureID;
+			formatOfInterest = TextureFormat::BC5;
+			contentOfInterest = MipContent::NORMAL_MAP;
 			ImGui::OpenPopup("available_textures_group");
 		}
 
@@ -380,6 +403,8 @@ void MaterialEditLayer::RenderPanel()
 		))
 		{
 			idOfInterest = &material.HeightTextureID;
+			formatOfInterest = TextureFormat::BC4;
+			contentOfInterest = MipContent::LINEAR;
 			ImGui::OpenPopup("available_textures_group");
 		}
 
@@ -394,6 +419,8 @@ void MaterialEditLayer::RenderPanel()
 		))
 		{
 			idOfInterest = &material.RoughnessTextureID;
+			formatOfInterest = TextureFormat::BC4;
+			contentOfInterest = MipContent::LINEAR;
 			ImGui::OpenPopup("available_textures_group");
 		}
 
@@ -408,6 +435,8 @@ void MaterialEditLayer::RenderPanel()
 		))
 		{
 			idOfInterest = &material.MetallicTextureID;
+			formatOfInterest = TextureFormat::BC4;
+			contentOfInterest = MipContent::LINEAR;
 			ImGui::OpenPopup("available_textures_group");
 		}
 
@@ -422,6 +451,8 @@ void MaterialEditLayer::RenderPanel()
 		))
 		{
 			idOfInterest = &material.AmbientOccTextureID;
+			formatOfInterest = TextureFormat::BC4;
+			contentOfInterest = MipContent::LINEAR;
 			ImGui::OpenPopup("available_textures_group");
 		}
 
@@ -438,6 +469,14 @@ void MaterialEditLayer::RenderPanel()
 					*idOfInterest = id;
 				}
 
+				if (ImGui::IsItemHovered())
+				{
+					float vramMB = texture->VRAMSize() / (1024.0f * 1024.0f);
+					float savedMB = (texture->UncompressedSize() - texture->VRAMSize()) / (1024.0f * 1024.0f);
+					ImGui::SetTooltip("%s\n%dx%d %s\nVRAM: %.2f MB (saved %.2f MB)", texture->Name().c_str(),
+						texture->GetWidth(), texture->GetHeight(), TextureCompressor::FormatName(texture->Format()), vramMB, savedMB);
+				}
+
 				if (cnt++ % 3 == 0)
 				{
 					ImGui::NewLine();
@@ -466,8 +505,13 @@ void MaterialEditLayer::RenderPanel()
 
 				if (path.has_value())
 				{
-					std::shared_ptr<Texture> texture = std::make_shared<Texture>(path.value());
-					*idOfInterest = AssetManager::AddTexture(texture);
+					renderThread.Execute(
+						[&path]()
+						{
+							std::shared_ptr<Texture> texture = std::make_shared<Texture>(path.value(), formatOfInterest, contentOfInterest);
+							*idOfInterest = AssetManager::AddTexture(texture);
+						}
+					);
 					ImGui::CloseCurrentPopup();
 				}
 			}
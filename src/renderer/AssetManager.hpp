@@ -39,6 +39,9 @@ struct Material
 	int32_t AmbientOccTextureID = 1;
 	float AmbientOccFactor = 1.0f;
 
+	// Albedo is streamed through VirtualTexturing instead of AlbedoTextureID when set
+	int32_t VirtualTextureID = -1;
+
 	Material() = default;
 	Material(const Material& other) = default;
 };
@@ -49,6 +49,22 @@ void Camera::SetControls(std::unique_ptr<CameraControls>&& controls)
 	m_ControlsType = std::move(controls);
 }
 
+Camera Camera::Snapshot() const
+{
+	Camera copy(m_FOV, m_AspectRatio, m_NearClip, m_FarClip);
+	copy.m_ControlsType = nullptr;
+	copy.Position = Position;
+	copy.Exposure = Exposure;
+	copy.Gamma = Gamma;
+	copy.m_Pitch = m_Pitch;
+	copy.m_Yaw = m_Yaw;
+	copy.m_ViewportSize = m_ViewportSize;
+	copy.UpdateProjection();
+	copy.UpdateView();
+
+	return copy;
+}
+
 glm::vec3 Camera::GetUpDirection() const
 {
 	return glm::rotate(GetOrientation(), glm::vec3(0.0f, 1.0f, 0.0f));
@@ -17,6 +17,9 @@ public:
 	void LookAt(const glm::vec3& point);
 	void SetControls(std::unique_ptr<CameraControls>&& controls);
 
+	// Copy of the view without the controls, for drawing it on another thread
+	Camera Snapshot() const;
+
 	glm::vec3 GetUpDirection()		const;
 	glm::vec3 GetRightDirection()	const;
 	glm::vec3 GetForwardDirection() const;
@@ -0,0 +1,305 @@
+#include "IBLCache.hpp"
+#include "OpenGL.hpp"
+#include "../Logger.hpp"
+#include "../RandomUtils.hpp"
+#include "../JobSystem.hpp"
+#include "../Clock.hpp"
+
+#include <glm/gtc/constants.hpp>
+
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+
+static const std::filesystem::path CACHE_DIRECTORY = "resources/cache/ibl";
+static constexpr uint32_t CACHE_MAGIC = 0x434C4249; // "IBLC"
+static constexpr uint32_t CACHE_VERSION = 2;
+static constexpr uint32_t BRDF_MAGIC = 0x46445242; // "BRDF"
+static constexpr uint32_t BRDF_VERSION = 1;
+static constexpr uint32_t BRDF_SAMPLES = 1024;
+
+static float RadicalInverseVdC(uint32_t bits)
+{
+	bits = (bits << 16u) | (bits >> 16u);
+	bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+	bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+	bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+	bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+	return (float)bits * 2.3283064365386963e-10f;
+}
+
+static float GeoSchlickGGX(float NV, float roughness)
+{
+	float k = roughness * roughness / 2.0f;
+	return NV / (NV * (1.0f - k) + k);
+}
+
+static bool ReadLevels(std::ifstream& file, CubemapLevels& levels)
+{
+	uint32_t header[2]{};
+	file.read((char*)header, sizeof(header));
+	if (!file || header[0] == 0 || header[0] > 16384 || header[1] == 0 || header[1] > 16)
+	{
+		return false;
+	}
+
+	levels.FaceSize = (int32_t)header[0];
+	levels.Mips = header[1];
+
+	uint64_t texels = 0;
+	for (uint32_t mip = 0; mip < levels.Mips; mip++)
+	{
+		texels += IBLCache::LevelTexels(levels.FaceSize, mip);
+	}
+	levels.Texels.resize(texels * 3);
+	file.read((char*)levels.Texels.data(), levels.Texels.size() * sizeof(uint16_t));
+
+	return (bool)file;
+}
+
+static void WriteLevels(std::ofstream& file, const CubemapLevels& levels)
+{
+	uint32_t header[2] = { (uint32_t)levels.FaceSize, levels.Mips };
+	file.write((const char*)header, sizeof(header));
+	file.write((const char*)levels.Texels.data(), levels.Texels.size() * sizeof(uint16_t));
+}
+
+std::optional<std::filesystem::path> IBLCache::EntryPath(const std::string& sourcePath, const glm::uvec2& faceSize)
+{
+	std::ifstream file(sourcePath, std::ios::binary);
+	if (!file.is_open())
+	{
+		return std::nullopt;
+	}
+
+	std::vector<uint8_t> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	uint64_t hash = FNV1a(contents.data(), contents.size());
+	hash = FNV1a(&faceSize, sizeof(faceSize), hash);
+
+	char fileName[32]{};
+	snprintf(fileName, sizeof(fileName), "%016llx.ibl", (unsigned long long)hash);
+	return CACHE_DIRECTORY / fileName;
+}
+
+std::optional<IBLData> IBLCache::Read(const std::filesystem::path& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+	{
+		return std::nullopt;
+	}
+
+	uint32_t header[2]{};
+	file.read((char*)header, sizeof(header));
+	if (!file || header[0] != CACHE_MAGIC || header[1] != CACHE_VERSION)
+	{
+		return std::nullopt;
+	}
+
+	IBLData data{};
+	file.read((char*)data.IrradianceSH.data(), sizeof(data.IrradianceSH));
+	if (!ReadLevels(file, data.Environment) || !ReadLevels(file, data.Irradiance) || !ReadLevels(file, data.Prefilter))
+	{
+		LOG_WARN("Corrupted environment cache entry {}, baking again", path.string());
+		return std::nullopt;
+	}
+
+	return data;
+}
+
+bool IBLCache::Write(const std::filesystem::path& path, const IBLData& data)
+{
+	std::error_code ec;
+	std::filesystem::create_directories(path.parent_path(), ec);
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open())
+	{
+		LOG_WARN("Failed to write environment cache entry {}", path.string());
+		return false;
+	}
+
+	uint32_t header[2] = { CACHE_MAGIC, CACHE_VERSION };
+	file.write((const char*)header, sizeof(header));
+	file.write((const char*)data.IrradianceSH.data(), sizeof(data.IrradianceSH));
+	WriteLevels(file, data.Environment);
+	WriteLevels(file, data.Irradiance);
+	WriteLevels(file, data.Prefilter);
+
+	return (bool)file;
+}
+
+CubemapLevels IBLCache::Download(uint32_t textureID)
+{
+	CubemapLevels levels{};
+	GLState::BindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+	GLCall(glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_TEXTURE_WIDTH, &levels.FaceSize));
+
+	// Levels past the allocated ones report a zero width
+	uint32_t fullChain = (uint32_t)std::log2(std::max(levels.FaceSize, 1)) + 1;
+	for (; levels.Mips < fullChain; levels.Mips++)
+	{
+		int32_t width = 0;
+		GLCall(glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, levels.Mips, GL_TEXTURE_WIDTH, &width));
+		if (width == 0)
+		{
+			break;
+		}
+	}
+
+	uint64_t texels = 0;
+	for (uint32_t mip = 0; mip < levels.Mips; mip++)
+	{
+		texels += LevelTexels(levels.FaceSize, mip);
+	}
+	levels.Texels.resize(texels * 3);
+
+	GLCall(glPixelStorei(GL_PACK_ALIGNMENT, 1));
+	uint16_t* output = levels.Texels.data();
+	for (uint32_t mip = 0; mip < levels.Mips; mip++)
+	{
+		uint64_t faceTexels = LevelTexels(levels.FaceSize, mip) / 6;
+		for (uint32_t face = 0; face < 6; face++)
+		{
+			GLCall(glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, mip, GL_RGB, GL_HALF_FLOAT, output));
+			output += faceTexels * 3;
+		}
+	}
+	GLCall(glPixelStorei(GL_PACK_ALIGNMENT, 4));
+
+	return levels;
+}
+
+void IBLCache::Upload(uint32_t textureID, const CubemapLevels& levels)
+{
+	GLState::BindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+	GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+
+	const uint16_t* input = levels.Texels.data();
+	for (uint32_t mip = 0; mip < levels.Mips; mip++)
+	{
+		int32_t size = std::max(levels.FaceSize >> mip, 1);
+		for (uint32_t face = 0; face < 6; face++)
+		{
+			GLCall(glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, mip, GL_RGB16F, size, size, 0, GL_RGB, GL_HALF_FLOAT, input));
+			input += (size_t)size * size * 3;
+		}
+	}
+
+	GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+}
+
+std::vector<float> IBLCache::DownloadFloat(uint32_t textureID, uint32_t mip)
+{
+	GLState::BindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+
+	int32_t size = 0;
+	GLCall(glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, mip, GL_TEXTURE_WIDTH, &size));
+	std::vector<float> faces(LevelTexels(size, 0) * 3);
+
+	GLCall(glPixelStorei(GL_PACK_ALIGNMENT, 1));
+	for (uint32_t face = 0; face < 6; face++)
+	{
+		GLCall(glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, mip, GL_RGB, GL_FLOAT, faces.data() + (size_t)face * size * size * 3));
+	}
+	GLCall(glPixelStorei(GL_PACK_ALIGNMENT, 4));
+
+	return faces;
+}
+
+uint64_t IBLCache::LevelTexels(int32_t faceSize, uint32_t mip)
+{
+	uint64_t size = (uint64_t)std::max(faceSize >> mip, 1);
+	return size * size * 6;
+}
+
+std::vector<float> IBLCache::IntegrateBRDF(int32_t size)
+{
+	std::vector<float> lut((size_t)size * size * 2);
+	JobSystem::ParallelFor(size,
+		[&](uint32_t begin, uint32_t end)
+		{
+			// GGX half vectors around N = +Z only depend on the roughness, so they're shared by the whole row
+			std::vector<glm::vec3> halfVectors(BRDF_SAMPLES);
+			for (uint32_t y = begin; y < end; y++)
+			{
+				float roughness = ((float)y + 0.5f) / (float)size;
+				float a = roughness * roughness;
+				for (uint32_t i = 0; i < BRDF_SAMPLES; i++)
+				{
+					float phi = 2.0f * glm::pi<float>() * (float)i / (float)BRDF_SAMPLES;
+					float xi = RadicalInverseVdC(i);
+					float cosTheta = std::sqrt((1.0f - xi) / (1.0f + (a * a - 1.0f) * xi));
+					float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+					halfVectors[i] = glm::vec3(std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, cosTheta);
+				}
+
+				for (int32_t x = 0; x < size; x++)
+				{
+					float NV = ((float)x + 0.5f) / (float)size;
+					glm::vec3 V(std::sqrt(1.0f - NV * NV), 0.0f, NV);
+					float geoV = GeoSchlickGGX(NV, roughness);
+
+					float scale = 0.0f;
+					float bias = 0.0f;
+					for (const glm::vec3& H : halfVectors)
+					{
+						float VH = V.x * H.x + V.z * H.z;
+						float NL = 2.0f * VH * H.z - V.z;
+						if (NL > 0.0f)
+						{
+							float G = GeoSchlickGGX(NL, roughness) * geoV;
+							float visibility = G * std::max(VH, 0.0f) / (H.z * NV);
+							float oneMinusVH = 1.0f - std::max(VH, 0.0f);
+							float fresnel = oneMinusVH * oneMinusVH * oneMinusVH * oneMinusVH * oneMinusVH;
+							scale += (1.0f - fresnel) * visibility;
+							bias += fresnel * visibility;
+						}
+					}
+
+					float* texel = lut.data() + ((size_t)y * size + x) * 2;
+					texel[0] = scale / (float)BRDF_SAMPLES;
+					texel[1] = bias / (float)BRDF_SAMPLES;
+				}
+			}
+		}, 4);
+
+	return lut;
+}
+
+std::vector<float> IBLCache::LoadOrIntegrateBRDF(int32_t size)
+{
+	std::filesystem::path path = CACHE_DIRECTORY / ("brdf_" + std::to_string(size) + ".lut");
+	std::vector<float> lut((size_t)size * size * 2);
+
+	std::ifstream input(path, std::ios::binary);
+	uint32_t header[3]{};
+	input.read((char*)header, sizeof(header));
+	if (input && header[0] == BRDF_MAGIC && header[1] == BRDF_VERSION && header[2] == (uint32_t)size)
+	{
+		input.read((char*)lut.data(), lut.size() * sizeof(float));
+		if (input)
+		{
+			return lut;
+		}
+	}
+
+	Clock clock;
+	lut = IntegrateBRDF(size);
+	LOG_INFO("Integrated {}x{} BRDF lookup table in {}ms", size, size, clock.GetElapsedTime());
+
+	std::error_code ec;
+	std::filesystem::create_directories(CACHE_DIRECTORY, ec);
+	std::ofstream output(path, std::ios::binary);
+	if (!output.is_open())
+	{
+		LOG_WARN("Failed to write BRDF lookup table cache {}", path.string());
+		return lut;
+	}
+
+	uint32_t outputHeader[3] = { BRDF_MAGIC, BRDF_VERSION, (uint32_t)size };
+	output.write((const char*)outputHeader, sizeof(outputHeader));
+	output.write((const char*)lut.data(), lut.size() * sizeof(float));
+
+	return lut;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "SphericalHarmonics.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <optional>
+#include <filesystem>
+
+struct CubemapLevels
+{
+	int32_t FaceSize = 0;
+	uint32_t Mips = 0;
+
+	// RGB half floats, all six faces of mip 0 followed by all six faces of mip 1 and so on
+	std::vector<uint16_t> Texels;
+};
+
+struct IBLData
+{
+	CubemapLevels Environment;
+	CubemapLevels Irradiance;
+	CubemapLevels Prefilter;
+	SH9 IrradianceSH{};
+};
+
+class IBLCache
+{
+public:
+	// Keyed by the source file contents and the face size, empty if the source can't be read
+	static std::optional<std::filesystem::path> EntryPath(const std::string& sourcePath, const glm::uvec2& faceSize);
+
+	static std::optional<IBLData> Read(const std::filesystem::path& path);
+	static bool Write(const std::filesystem::path& path, const IBLData& data);
+
+	// The texture has to be an RGB16F cube map, every allocated mip is read back
+	static CubemapLevels Download(uint32_t textureID);
+	static void Upload(uint32_t textureID, const CubemapLevels& levels);
+
+	// Single mip as float RGB faces, the layout SphericalHarmonics::ProjectIrradiance expects
+	static std::vector<float> DownloadFloat(uint32_t textureID, uint32_t mip);
+
+	static uint64_t LevelTexels(int32_t faceSize, uint32_t mip);
+
+	// Split-sum BRDF scale and bias, RG floats with NdotV along x and roughness along y. Same result on every run
+	static std::vector<float> IntegrateBRDF(int32_t size);
+
+	// Integrated on first use only, read from the cache afterwards
+	static std::vector<float> LoadOrIntegrateBRDF(int32_t size);
+};
@@ -0,0 +1,222 @@
+#include "MipGenerator.hpp"
+#include "../JobSystem.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MIPGEN_SSE 1
+#endif
+
+struct SRGBTables
+{
+	float ToLinear[256];
+	uint8_t FromLinear[4096];
+
+	SRGBTables()
+	{
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			float c = i / 255.0f;
+			ToLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+
+		for (uint32_t i = 0; i < 4096; i++)
+		{
+			float l = i / 4095.0f;
+			float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+			FromLinear[i] = (uint8_t)std::clamp(std::lround(c * 255.0f), 0l, 255l);
+		}
+	}
+};
+
+static const SRGBTables& Tables()
+{
+	static SRGBTables tables;
+	return tables;
+}
+
+// Expands a row to 4 floats per texel in the space filtering happens in
+static void DecodeRow(const uint8_t* row, int32_t width, uint32_t channels, MipContent content, float* output)
+{
+	const SRGBTables& tables = Tables();
+	for (int32_t x = 0; x < width; x++)
+	{
+		const uint8_t* texel = row + (size_t)x * channels;
+		float* out = output + (size_t)x * 4;
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			if (c >= channels)
+			{
+				out[c] = 0.0f;
+				continue;
+			}
+
+			switch (content)
+			{
+			case MipContent::COLOR_SRGB:
+				// Alpha is never sRGB encoded
+				out[c] = c == 3 ? texel[c] / 255.0f : tables.ToLinear[texel[c]];
+				break;
+			case MipContent::NORMAL_MAP:
+				out[c] = c < 3 ? texel[c] / 127.5f - 1.0f : texel[c] / 255.0f;
+				break;
+			default:
+				out[c] = texel[c] / 255.0f;
+				break;
+			}
+		}
+	}
+}
+
+static void EncodeTexel(float* texel, uint32_t channels, MipContent content, uint8_t* output)
+{
+	if (content == MipContent::NORMAL_MAP)
+	{
+		float length = std::sqrt(texel[0] * texel[0] + texel[1] * texel[1] + texel[2] * texel[2]);
+		if (length > 1e-6f)
+		{
+			texel[0] /= length;
+			texel[1] /= length;
+			texel[2] /= length;
+		}
+		else
+		{
+			texel[0] = 0.0f;
+			texel[1] = 0.0f;
+			texel[2] = 1.0f;
+		}
+	}
+
+	const SRGBTables& tables = Tables();
+	for (uint32_t c = 0; c < channels; c++)
+	{
+		float value = texel[c];
+		if (content == MipContent::COLOR_SRGB && c != 3)
+		{
+			output[c] = tables.FromLinear[std::clamp((int32_t)(value * 4095.0f + 0.5f), 0, 4095)];
+		}
+		else if (content == MipContent::NORMAL_MAP && c != 3)
+		{
+			output[c] = (uint8_t)std::clamp((int32_t)((value * 0.5f + 0.5f) * 255.0f + 0.5f), 0, 255);
+		}
+		else
+		{
+			output[c] = (uint8_t)std::clamp((int32_t)(value * 255.0f + 0.5f), 0, 255);
+		}
+	}
+}
+
+// Averages 2x2 footprints of two decoded rows (4 floats per texel), odd edges are clamped
+static void AverageRows(const float* row0, const float* row1, int32_t sourceWidth, int32_t width, float* output)
+{
+	for (int32_t x = 0; x < width; x++)
+	{
+		size_t x0 = (size_t)std::min(x * 2, sourceWidth - 1) * 4;
+		size_t x1 = (size_t)std::min(x * 2 + 1, sourceWidth - 1) * 4;
+
+#ifdef MIPGEN_SSE
+		__m128 sum = _mm_add_ps(
+			_mm_add_ps(_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1)),
+			_mm_add_ps(_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1))
+		);
+		_mm_storeu_ps(output + (size_t)x * 4, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#else
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			output[x * 4 + c] = (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c]) * 0.25f;
+		}
+#endif
+	}
+}
+
+std::vector<MipLevel<uint8_t>> MipGenerator::Generate(const uint8_t* pixels, int32_t width, int32_t height, uint32_t channels, MipContent content)
+{
+	std::vector<MipLevel<uint8_t>> levels;
+	const uint8_t* source = pixels;
+	while (width > 1 || height > 1)
+	{
+		MipLevel<uint8_t> level{ std::max(width / 2, 1), std::max(height / 2, 1) };
+		level.Data.resize((size_t)level.Width * level.Height * channels);
+
+		JobSystem::ParallelFor(level.Height,
+			[&](uint32_t begin, uint32_t end)
+			{
+				std::vector<float> row0((size_t)width * 4);
+				std::vector<float> row1((size_t)width * 4);
+				std::vector<float> averaged((size_t)level.Width * 4);
+				for (uint32_t y = begin; y < end; y++)
+				{
+					int32_t y0 = std::min((int32_t)y * 2, height - 1);
+					int32_t y1 = std::min((int32_t)y * 2 + 1, height - 1);
+					DecodeRow(source + (size_t)y0 * width * channels, width, channels, content, row0.data());
+					DecodeRow(source + (size_t)y1 * width * channels, width, channels, content, row1.data());
+					AverageRows(row0.data(), row1.data(), width, level.Width, averaged.data());
+
+					uint8_t* output = level.Data.data() + (size_t)y * level.Width * channels;
+					for (int32_t x = 0; x < level.Width; x++)
+					{
+						EncodeTexel(averaged.data() + (size_t)x * 4, channels, content, output + (size_t)x * channels);
+					}
+				}
+			}, 16);
+
+		width = level.Width;
+		height = level.Height;
+		levels.push_back(std::move(level));
+		source = levels.back().Data.data();
+	}
+
+	return levels;
+}
+
+std::vector<MipLevel<float>> MipGenerator::Generate(const float* pixels, int32_t width, int32_t height, uint32_t channels)
+{
+	std::vector<MipLevel<float>> levels;
+	const float* source = pixels;
+	while (width > 1 || height > 1)
+	{
+		MipLevel<float> level{ std::max(width / 2, 1), std::max(height / 2, 1) };
+		level.Data.resize((size_t)level.Width * level.Height * channels);
+
+		JobSystem::ParallelFor(level.Height,
+			[&](uint32_t begin, uint32_t end)
+			{
+				std::vector<float> row0((size_t)width * 4);
+				std::vector<float> row1((size_t)width * 4);
+				std::vector<float> averaged((size_t)level.Width * 4);
+				for (uint32_t y = begin; y < end; y++)
+				{
+					int32_t y0 = std::min((int32_t)y * 2, height - 1);
+					int32_t y1 = std::min((int32_t)y * 2 + 1, height - 1);
+					for (int32_t x = 0; x < width; x++)
+					{
+						for (uint32_t c = 0; c < 4; c++)
+						{
+							row0[(size_t)x * 4 + c] = c < channels ? source[((size_t)y0 * width + x) * channels + c] : 0.0f;
+							row1[(size_t)x * 4 + c] = c < channels ? source[((size_t)y1 * width + x) * channels + c] : 0.0f;
+						}
+					}
+
+					AverageRows(row0.data(), row1.data(), width, level.Width, averaged.data());
+
+					float* output = level.Data.data() + (size_t)y * level.Width * channels;
+					for (int32_t x = 0; x < level.Width; x++)
+					{
+						for (uint32_t c = 0; c < channels; c++)
+						{
+							output[(size_t)x * channels + c] = averaged[(size_t)x * 4 + c];
+						}
+					}
+				}
+			}, 16);
+
+		width = level.Width;
+		height = level.Height;
+		levels.push_back(std::move(level));
+		source = levels.back().Data.data();
+	}
+
+	return levels;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "OpenGL.hpp"
+
+#include <cstdint>
+#include <vector>
+
+template<typename T>
+struct MipLevel
+{
+	int32_t Width = 0;
+	int32_t Height = 0;
+	std::vector<T> Data;
+};
+
+class MipGenerator
+{
+public:
+	// Every level below the base one down to 1x1, each built from the previous one on worker threads
+	static std::vector<MipLevel<uint8_t>> Generate(const uint8_t* pixels, int32_t width, int32_t height, uint32_t channels, MipContent content);
+	static std::vector<MipLevel<float>> Generate(const float* pixels, int32_t width, int32_t height, uint32_t channels);
+};
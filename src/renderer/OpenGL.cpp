@@ -1,11 +1,22 @@
 #include "OpenGL.hpp"
 #include "../Logger.hpp"
 #include "../RandomUtils.hpp"
+#include "TextureCompressor.hpp"
+#include "MipGenerator.hpp"
+#include "ShaderCache.hpp"
+#include "../JobSystem.hpp"
+#include "../Clock.hpp"
 
 #include <fstream>
 #include <filesystem>
+#include <algorithm>
 #include "stb/stb_image.h"
 
+// Not every loader is generated with KHR_parallel_shader_compile
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
 void GLClearErrors()
 {
 	while (glGetError() != GL_NO_ERROR);
@@ -23,6 +34,376 @@ bool GLCheckForErrors(const char* func, const char* filename, int32_t line)
 	return true;
 }
 
+uint32_t GLState::s_Program = GLState::Unknown;
+uint32_t GLState::s_VertexArray = GLState::Unknown;
+uint32_t GLState::s_ReadFramebuffer = GLState::Unknown;
+uint32_t GLState::s_DrawFramebuffer = GLState::Unknown;
+uint32_t GLState::s_ActiveUnit = GLState::Unknown;
+std::vector<std::array<uint32_t, GLState::TextureTargetCount>> GLState::s_Textures;
+std::unordered_map<GLenum, uint32_t> GLState::s_Capabilities;
+uint32_t GLState::s_BlendSource = GLState::Unknown;
+uint32_t GLState::s_BlendDestination = GLState::Unknown;
+uint32_t GLState::s_BlendEquation = GLState::Unknown;
+uint32_t GLState::s_DepthFunc = GLState::Unknown;
+uint32_t GLState::s_DepthMask = GLState::Unknown;
+uint32_t GLState::s_CullFace = GLState::Unknown;
+uint32_t GLState::s_StencilFunc = GLState::Unknown;
+uint32_t GLState::s_StencilRef = GLState::Unknown;
+uint32_t GLState::s_StencilFuncMask = GLState::Unknown;
+uint32_t GLState::s_StencilOps[2][3] = { { GLState::Unknown, GLState::Unknown, GLState::Unknown }, { GLState::Unknown, GLState::Unknown, GLState::Unknown } };
+uint32_t GLState::s_StencilMask = GLState::Unknown;
+uint32_t GLState::s_PolygonMode = GLState::Unknown;
+uint32_t GLState::s_IssuedCalls = 0;
+uint32_t GLState::s_AvoidedCalls = 0;
+
+bool GLState::Changed(uint32_t& cached, uint32_t value)
+{
+	if (cached == value)
+	{
+		s_AvoidedCalls++;
+
+		return false;
+	}
+
+	cached = value;
+	s_IssuedCalls++;
+
+	return true;
+}
+
+int32_t GLState::TextureTargetIndex(GLenum target)
+{
+	switch (target)
+	{
+	case GL_TEXTURE_2D:				return 0;
+	case GL_TEXTURE_3D:				return 1;
+	case GL_TEXTURE_2D_ARRAY:		return 2;
+	case GL_TEXTURE_CUBE_MAP:		return 3;
+	case GL_TEXTURE_CUBE_MAP_ARRAY:	return 4;
+	case GL_TEXTURE_2D_MULTISAMPLE:	return 5;
+	}
+
+	return -1;
+}
+
+void GLState::UseProgram(uint32_t program)
+{
+	if (Changed(s_Program, program))
+	{
+		GLCall(glUseProgram(program));
+	}
+}
+
+void GLState::BindVertexArray(uint32_t vao)
+{
+	if (Changed(s_VertexArray, vao))
+	{
+		GLCall(glBindVertexArray(vao));
+	}
+}
+
+void GLState::BindFramebuffer(GLenum target, uint32_t fbo)
+{
+	if (target == GL_FRAMEBUFFER)
+	{
+		if (s_ReadFramebuffer == fbo && s_DrawFramebuffer == fbo)
+		{
+			s_AvoidedCalls++;
+
+			return;
+		}
+
+		s_ReadFramebuffer = fbo;
+		s_DrawFramebuffer = fbo;
+		s_IssuedCalls++;
+		GLCall(glBindFramebuffer(GL_FRAMEBUFFER, fbo));
+	}
+	else if (Changed(target == GL_READ_FRAMEBUFFER ? s_ReadFramebuffer : s_DrawFramebuffer, fbo))
+	{
+		GLCall(glBindFramebuffer(target, fbo));
+	}
+}
+
+void GLState::ActiveTexture(uint32_t unit)
+{
+	if (Changed(s_ActiveUnit, unit))
+	{
+		GLCall(glActiveTexture(GL_TEXTURE0 + unit));
+	}
+}
+
+void GLState::BindTexture(GLenum target, uint32_t texture)
+{
+	int32_t index = TextureTargetIndex(target);
+	if (index < 0 || s_ActiveUnit == Unknown)
+	{
+		// Untracked target, or a unit we can't tell, the binding goes through and whatever it replaced is forgotten
+		if (index >= 0)
+		{
+			ForgetTextureBindings();
+		}
+
+		s_IssuedCalls++;
+		GLCall(glBindTexture(target, texture));
+
+		return;
+	}
+
+	if (s_ActiveUnit >= s_Textures.size())
+	{
+		std::array<uint32_t, TextureTargetCount> unknown;
+		unknown.fill(Unknown);
+		s_Textures.resize((size_t)s_ActiveUnit + 1, unknown);
+	}
+
+	if (Changed(s_Textures[s_ActiveUnit][index], texture))
+	{
+		GLCall(glBindTexture(target, texture));
+	}
+}
+
+void GLState::BindTexture(uint32_t unit, GLenum target, uint32_t texture)
+{
+	ActiveTexture(unit);
+	BindTexture(target, texture);
+}
+
+void GLState::Enable(GLenum capability)
+{
+	if (Changed(s_Capabilities.try_emplace(capability, Unknown).first->second, 1))
+	{
+		GLCall(glEnable(capability));
+	}
+}
+
+void GLState::Disable(GLenum capability)
+{
+	if (Changed(s_Capabilities.try_emplace(capability, Unknown).first->second, 0))
+	{
+		GLCall(glDisable(capability));
+	}
+}
+
+void GLState::BlendFunc(GLenum source, GLenum destination)
+{
+	if (s_BlendSource == source && s_BlendDestination == destination)
+	{
+		s_AvoidedCalls++;
+
+		return;
+	}
+
+	s_BlendSource = source;
+	s_BlendDestination = destination;
+	s_IssuedCalls++;
+	GLCall(glBlendFunc(source, destination));
+}
+
+void GLState::BlendEquation(GLenum mode)
+{
+	if (Changed(s_BlendEquation, mode))
+	{
+		GLCall(glBlendEquation(mode));
+	}
+}
+
+void GLState::DepthFunc(GLenum func)
+{
+	if (Changed(s_DepthFunc, func))
+	{
+		GLCall(glDepthFunc(func));
+	}
+}
+
+void GLState::DepthMask(bool enabled)
+{
+	if (Changed(s_DepthMask, enabled ? 1 : 0))
+	{
+		GLCall(glDepthMask(enabled ? GL_TRUE : GL_FALSE));
+	}
+}
+
+void GLState::CullFace(GLenum face)
+{
+	if (Changed(s_CullFace, face))
+	{
+		GLCall(glCullFace(face));
+	}
+}
+
+void GLState::StencilFunc(GLenum func, int32_t ref, uint32_t mask)
+{
+	if (s_StencilFunc == func && s_StencilRef == (uint32_t)ref && s_StencilFuncMask == mask)
+	{
+		s_AvoidedCalls++;
+
+		return;
+	}
+
+	s_StencilFunc = func;
+	s_StencilRef = (uint32_t)ref;
+	s_StencilFuncMask = mask;
+	s_IssuedCalls++;
+	GLCall(glStencilFunc(func, ref, mask));
+}
+
+void GLState::StencilOp(GLenum stencilFail, GLenum depthFail, GLenum pass)
+{
+	uint32_t ops[3] = { stencilFail, depthFail, pass };
+	if (std::equal(ops, ops + 3, s_StencilOps[0]) && std::equal(ops, ops + 3, s_StencilOps[1]))
+	{
+		s_AvoidedCalls++;
+
+		return;
+	}
+
+	std::copy(ops, ops + 3, s_StencilOps[0]);
+	std::copy(ops, ops + 3, s_StencilOps[1]);
+	s_IssuedCalls++;
+	GLCall(glStencilOp(stencilFail, depthFail, pass));
+}
+
+void GLState::StencilOpSeparate(GLenum face, GLenum stencilFail, GLenum depthFail, GLenum pass)
+{
+	if (face == GL_FRONT_AND_BACK)
+	{
+		StencilOp(stencilFail, depthFail, pass);
+
+		return;
+	}
+
+	uint32_t ops[3] = { stencilFail, depthFail, pass };
+	uint32_t* cached = s_StencilOps[face == GL_FRONT ? 0 : 1];
+	if (std::equal(ops, ops + 3, cached))
+	{
+		s_AvoidedCalls++;
+
+		return;
+	}
+
+	std::copy(ops, ops + 3, cached);
+	s_IssuedCalls++;
+	GLCall(glStencilOpSeparate(face, stencilFail, depthFail, pass));
+}
+
+void GLState::StencilMask(uint32_t mask)
+{
+	if (Changed(s_StencilMask, mask))
+	{
+		GLCall(glStencilMask(mask));
+	}
+}
+
+void GLState::PolygonMode(GLenum mode)
+{
+	if (Changed(s_PolygonMode, mode))
+	{
+		GLCall(glPolygonMode(GL_FRONT_AND_BACK, mode));
+	}
+}
+
+void GLState::ForgetProgram(uint32_t program)
+{
+	// A deleted program stays in use until something else is bound, so it's safer to not know
+	if (s_Program == program)
+	{
+		s_Program = Unknown;
+	}
+}
+
+void GLState::ForgetVertexArray(uint32_t vao)
+{
+	if (s_VertexArray == vao)
+	{
+		s_VertexArray = 0;
+	}
+}
+
+void GLState::ForgetFramebuffer(uint32_t fbo)
+{
+	if (s_ReadFramebuffer == fbo)
+	{
+		s_ReadFramebuffer = 0;
+	}
+	if (s_DrawFramebuffer == fbo)
+	{
+		s_DrawFramebuffer = 0;
+	}
+}
+
+void GLState::ForgetTexture(uint32_t texture)
+{
+	for (std::array<uint32_t, TextureTargetCount>& unit : s_Textures)
+	{
+		std::replace(unit.begin(), unit.end(), texture, 0u);
+	}
+}
+
+void GLState::ForgetTextureBindings()
+{
+	// Keeps the storage, invalidating happens every frame and shouldn't allocate
+	for (std::array<uint32_t, TextureTargetCount>& unit : s_Textures)
+	{
+		unit.fill(Unknown);
+	}
+}
+
+void GLState::Invalidate()
+{
+	s_Program = Unknown;
+	s_VertexArray = Unknown;
+	s_ReadFramebuffer = Unknown;
+	s_DrawFramebuffer = Unknown;
+	s_ActiveUnit = Unknown;
+	ForgetTextureBindings();
+	for (auto& [capability, enabled] : s_Capabilities)
+	{
+		enabled = Unknown;
+	}
+	s_BlendSource = Unknown;
+	s_BlendDestination = Unknown;
+	s_BlendEquation = Unknown;
+	s_DepthFunc = Unknown;
+	s_DepthMask = Unknown;
+	s_CullFace = Unknown;
+	s_StencilFunc = Unknown;
+	s_StencilRef = Unknown;
+	s_StencilFuncMask = Unknown;
+	std::fill(&s_StencilOps[0][0], &s_StencilOps[0][0] + 6, Unknown);
+	s_StencilMask = Unknown;
+	s_PolygonMode = Unknown;
+}
+
+uint32_t GLState::DrawFramebuffer()
+{
+	if (s_DrawFramebuffer == Unknown)
+	{
+		int32_t fbo = 0;
+		GLCall(glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &fbo));
+		s_DrawFramebuffer = (uint32_t)fbo;
+	}
+
+	return s_DrawFramebuffer;
+}
+
+bool GLState::DepthMaskEnabled()
+{
+	if (s_DepthMask == Unknown)
+	{
+		GLboolean mask = GL_TRUE;
+		GLCall(glGetBooleanv(GL_DEPTH_WRITEMASK, &mask));
+		s_DepthMask = mask == GL_TRUE ? 1 : 0;
+	}
+
+	return s_DepthMask == 1;
+}
+
+void GLState::ResetCounters()
+{
+	s_IssuedCalls = 0;
+	s_AvoidedCalls = 0;
+}
+
 VertexBuffer::VertexBuffer(const void* data, uint64_t size, uint32_t count)
 	: m_VertexCount(count)
 {
@@ -98,7 +479,7 @@ uint32_t VertexBufferElement::GetSizeOfType(uint32_t type)
 VertexArray::VertexArray()
 {
 	GLCall(glGenVertexArrays(1, &m_ID));
-	GLCall(glBindVertexArray(m_ID));
+	GLState::BindVertexArray(m_ID);
 }
 
 VertexArray::~VertexArray()
@@ -106,6 +487,7 @@ VertexArray::~VertexArray()
 	if (m_ID != 0)
 	{
 		Unbind();
+		GLState::ForgetVertexArray(m_ID);
 		GLCall(glDeleteVertexArrays(1, &m_ID));
 	}
 }
@@ -176,12 +558,12 @@ void VertexArray::AddInstancedVertexBuffer(const std::shared_ptr<VertexBuffer>&
 
 void VertexArray::Bind() const
 {
-	GLCall(glBindVertexArray(m_ID));
+	GLState::BindVertexArray(m_ID);
 }
 
 void VertexArray::Unbind() const
 {
-	GLCall(glBindVertexArray(0));
+	GLState::BindVertexArray(0);
 }
 
 UniformBuffer::UniformBuffer(const void* data, uint64_t size)
@@ -221,112 +603,113 @@ void UniformBuffer::SetData(const void* data, uint32_t size, uint32_t offset) co
 	GLCall(glBufferSubData(GL_UNIFORM_BUFFER, (GLintptr)offset, size, data));
 }
 
+bool Shader::s_ParallelCompile = false;
+
 Shader::Shader(const ShaderSpec& spec)
 	: m_Spec(spec)
 {
-	std::optional<std::string> vertex = ParseShaderSource(spec.Vertex.Path);
-	if (!vertex.has_value())
+	if (uint32_t program = Build(); program != 0)
 	{
-		LOG_ERROR("Failed to open vertex shader file: {}", spec.Vertex.Path);
-
-		return;
+		Swap(program);
 	}
-	for (const StringReplacement& rep : spec.Vertex.Replacement)
-	{
-		ReplaceAll(vertex.value(), rep.Pattern, rep.Target);
-	}
-
-	std::optional<std::string> fragment = ParseShaderSource(spec.Fragment.Path);
-	if (!fragment.has_value())
-	{
-		LOG_ERROR("Failed to open fragment shader file: {}", spec.Fragment.Path);
-
-		return;
-	}
-	for (const StringReplacement& rep : spec.Fragment.Replacement)
-	{
-		ReplaceAll(fragment.value(), rep.Pattern, rep.Target);
-	}
-
-	std::optional<std::string> geometry{};
-	if (spec.Geometry.has_value())
-	{
-		geometry = ParseShaderSource(spec.Geometry.value().Path);
-		if (!geometry.has_value())
-		{
-			LOG_ERROR("Failed to open geometry shader file: {}", spec.Geometry.value().Path);
-
-			return;
-		}
-		for (const StringReplacement& rep : spec.Geometry.value().Replacement)
-		{
-			ReplaceAll(geometry.value(), rep.Pattern, rep.Target);
-		}
-	}
-
-	m_ID = CreateShader(vertex.value(), fragment.value(), geometry);
 }
 
 Shader::~Shader()
 {
+	Discard();
+
 	if (m_ID != 0)
 	{
 		Unbind();
+		GLState::ForgetProgram(m_ID);
 		GLCall(glDeleteProgram(m_ID));
 	}
 }
 
-void Shader::Bind() const
+void Shader::Bind()
 {
-	GLCall(glUseProgram(m_ID));
+	// The first build has to be waited for, a reload keeps drawing with the previous program until it's done
+	if (m_ID == 0)
+	{
+		Finish();
+	}
+	else
+	{
+		IsReady();
+	}
+
+	GLState::UseProgram(m_ID);
 }
 
 void Shader::Unbind() const
 {
-	GLCall(glUseProgram(0));
+	GLState::UseProgram(0);
 }
 
 void Shader::Reload()
 {
-	ASSERT(false && "Not wok 3:");
-
-	m_UniformLocations.clear();
-
-	if (m_ID != 0)
+	// A program that never linked can't be kept around, one that did stays until the new one is known to work
+	if (m_ID == 0)
 	{
-		Unbind();
-		GLCall(glDeleteProgram(m_ID));
+		Finish();
 	}
+	Discard();
 
-	std::optional<std::string> vertex = ParseShaderSource(m_Spec.Vertex.Path);
-	if (!vertex.has_value())
+	if (uint32_t program = Build(); program != 0)
 	{
-		LOG_ERROR("Failed to open vertex shader file: {}", m_Spec.Vertex.Path);
-
-		return;
+		Swap(program);
 	}
+}
 
-	std::optional<std::string> fragment = ParseShaderSource(m_Spec.Fragment.Path);
-	if (!fragment.has_value())
-	{
-		LOG_ERROR("Failed to open fragment shader file: {}", m_Spec.Fragment.Path);
+bool Shader::UsesSource(const std::string& path) const
+{
+	std::filesystem::path normalized = std::filesystem::path(path).lexically_normal();
+	auto matches = [&normalized](const ShaderDescriptor& stage)
+		{
+			return std::filesystem::path(stage.Path).lexically_normal() == normalized;
+		};
 
-		return;
+	if (m_Spec.Compute.has_value())
+	{
+		return matches(m_Spec.Compute.value());
 	}
 
-	std::optional<std::string> geometry{};
-	if (m_Spec.Geometry.has_value())
+	return matches(m_Spec.Vertex) || matches(m_Spec.Fragment) || (m_Spec.Geometry.has_value() && matches(m_Spec.Geometry.value()));
+}
+
+bool Shader::IsReady()
+{
+	if (m_Pending.has_value())
 	{
-		geometry = ParseShaderSource(m_Spec.Geometry.value().Path);
-		if (!geometry.has_value())
+		int32_t done = GL_TRUE;
+		if (s_ParallelCompile)
 		{
-			LOG_ERROR("Failed to open geometry shader file: {}", m_Spec.Geometry.value().Path);
+			GLCall(glGetProgramiv(m_Pending.value().ID, GL_COMPLETION_STATUS_KHR, &done));
+		}
 
-			return;
+		if (done == GL_FALSE)
+		{
+			return m_ID != 0;
 		}
+
+		Finish();
 	}
 
-	m_ID = CreateShader(vertex.value(), fragment.value(), geometry);
+	return true;
+}
+
+void Shader::OnLinked(std::function<void(Shader&)> setup)
+{
+	m_OnLinked = std::move(setup);
+	if (m_ID != 0)
+	{
+		m_OnLinked(*this);
+	}
+}
+
+void Shader::SetParallelCompile(bool supported)
+{
+	s_ParallelCompile = supported;
 }
 
 void Shader::SetUniform1i(const std::string& name, int32_t val)
@@ -364,162 +747,602 @@ void Shader::SetUniformBool(const std::string& name, bool flag)
 	GLCall(glUniform1i(UniformLocation(name), flag ? 1 : 0));
 }
 
+UniformHandle Shader::Uniform(std::string_view name)
+{
+	auto it = std::find(m_HandleNames.begin(), m_HandleNames.end(), name);
+	if (it != m_HandleNames.end())
+	{
+		return { (uint32_t)(it - m_HandleNames.begin()) };
+	}
+
+	// Pending programs resolve their handles along with the rest of the reflection
+	m_HandleNames.emplace_back(name);
+	m_HandleLocations.push_back(m_ID == 0 ? -1 : UniformLocation(m_HandleNames.back()));
+
+	return { (uint32_t)m_HandleNames.size() - 1 };
+}
+
+void Shader::SetUniform1i(UniformHandle handle, int32_t val)
+{
+	GLCall(glUniform1i(HandleLocation(handle), val));
+}
+
+void Shader::SetUniform1f(UniformHandle handle, float val)
+{
+	GLCall(glUniform1f(HandleLocation(handle), val));
+}
+
+void Shader::SetUniform2f(UniformHandle handle, const glm::vec2& vec)
+{
+	GLCall(glUniform2f(HandleLocation(handle), vec.r, vec.g));
+}
+
+void Shader::SetUniform3f(UniformHandle handle, const glm::vec3& vec)
+{
+	GLCall(glUniform3f(HandleLocation(handle), vec.r, vec.g, vec.b));
+}
+
+void Shader::SetUniform4f(UniformHandle handle, const glm::vec4& vec)
+{
+	GLCall(glUniform4f(HandleLocation(handle), vec.r, vec.g, vec.b, vec.a));
+}
+
+void Shader::SetUniformMat4(UniformHandle handle, const glm::mat4& mat)
+{
+	GLCall(glUniformMatrix4fv(HandleLocation(handle), 1, GL_FALSE, &mat[0][0]));
+}
+
+void Shader::SetUniformBool(UniformHandle handle, bool flag)
+{
+	GLCall(glUniform1i(HandleLocation(handle), flag ? 1 : 0));
+}
+
+void Shader::SetUniform1iv(UniformHandle handle, const int32_t* values, uint32_t count)
+{
+	GLCall(glUniform1iv(HandleLocation(handle), count, values));
+}
+
+void Shader::SetUniform1fv(UniformHandle handle, const float* values, uint32_t count)
+{
+	GLCall(glUniform1fv(HandleLocation(handle), count, values));
+}
+
+void Shader::SetUniform3fv(UniformHandle handle, const glm::vec3* values, uint32_t count)
+{
+	GLCall(glUniform3fv(HandleLocation(handle), count, &values[0].x));
+}
+
+void Shader::SetUniform4fv(UniformHandle handle, const glm::vec4* values, uint32_t count)
+{
+	GLCall(glUniform4fv(HandleLocation(handle), count, &values[0].x));
+}
+
 std::optional<std::string> Shader::ParseShaderSource(const std::string& path)
 {
-	std::ifstream shaderSourceFile(path);
+	std::ifstream shaderSourceFile(path, std::ios::binary | std::ios::ate);
 	if (!shaderSourceFile.good())
 	{
 		return {};
 	}
 
-	std::string line{};
-	std::stringstream ss{};
-	while (std::getline(shaderSourceFile, line))
+	std::string source((size_t)shaderSourceFile.tellg(), '\0');
+	shaderSourceFile.seekg(0);
+	shaderSourceFile.read(source.data(), source.size());
+
+	return source;
+}
+
+std::optional<std::string> Shader::LoadStage(const ShaderDescriptor& stage, const char* stageName)
+{
+	std::optional<std::string> source = ParseShaderSource(stage.Path);
+	if (!source.has_value())
+	{
+		LOG_ERROR("Failed to open {} shader file: {}", stageName, stage.Path);
+
+		return {};
+	}
+
+	for (const StringReplacement& rep : stage.Replacement)
 	{
-		ss << line;
-		ss << '\n';
+		ReplaceAll(source.value(), rep.Pattern, rep.Target);
 	}
 
-	return ss.str();
+	return source;
 }
 
-uint32_t Shader::CreateShader(const std::string& vsrc, const std::string& fsrc, std::optional<std::string> gsrc)
+uint32_t Shader::Build()
 {
-	GLCall(uint32_t program = glCreateProgram());
-	uint32_t vsID = CompileShader(GL_VERTEX_SHADER, vsrc);
-	uint32_t fsID = CompileShader(GL_FRAGMENT_SHADER, fsrc);
-	uint32_t gsID = 0;
+	Clock clock;
+	std::optional<std::string> compute{};
+	std::optional<std::string> vertex{};
+	std::optional<std::string> fragment{};
+	std::optional<std::string> geometry{};
+	if (m_Spec.Compute.has_value())
+	{
+		compute = LoadStage(m_Spec.Compute.value(), "compute");
+		if (!compute.has_value())
+		{
+			return 0;
+		}
+	}
+	else
+	{
+		vertex = LoadStage(m_Spec.Vertex, "vertex");
+		fragment = LoadStage(m_Spec.Fragment, "fragment");
+		if (m_Spec.Geometry.has_value())
+		{
+			geometry = LoadStage(m_Spec.Geometry.value(), "geometry");
+		}
 
-	if (gsrc.has_value())
+		if (!vertex.has_value() || !fragment.has_value() || (m_Spec.Geometry.has_value() && !geometry.has_value()))
+		{
+			return 0;
+		}
+	}
+
+	const std::string& name = compute.has_value() ? m_Spec.Compute.value().Path : m_Spec.Fragment.Path;
+	float sourceTime = clock.GetElapsedTime();
+	clock.Restart();
+
+	std::filesystem::path cachePath{};
+	bool useCache = ShaderCache::Supported();
+	if (useCache)
 	{
-		GLCall(gsID = CompileShader(GL_GEOMETRY_SHADER, gsrc.value()));
+		auto view = [](const std::optional<std::string>& source)
+			{
+				return source.has_value() ? std::string_view(source.value()) : std::string_view();
+			};
+
+		cachePath = ShaderCache::EntryPath({ view(compute), view(vertex), view(fragment), view(geometry) }, ShaderCache::Driver());
+		if (std::optional<ProgramBinary> binary = ShaderCache::Read(cachePath); binary.has_value())
+		{
+			if (uint32_t program = ShaderCache::Load(binary.value()); program != 0)
+			{
+				LOG_INFO("Shader {}: sources {}ms, loaded from cache in {}ms", name, sourceTime, clock.GetElapsedTime());
+
+				return program;
+			}
+
+			LOG_INFO("Driver rejected the cached binary of {}, compiling again", name);
+		}
 	}
 
-	GLCall(glAttachShader(program, vsID));
-	GLCall(glAttachShader(program, fsID));
+	PendingProgram pending = compute.has_value() ? CreateComputeShader(compute.value()) : CreateShader(vertex.value(), fragment.value(), geometry);
+	pending.CachePath = useCache ? cachePath.string() : std::string();
+	pending.SourceTime = sourceTime;
+	pending.IssueTime = clock.GetElapsedTime();
+	m_Pending = std::move(pending);
+
+	return 0;
+}
 
-	if (gsID != 0)
+void Shader::Finish()
+{
+	if (!m_Pending.has_value())
 	{
-		GLCall(glAttachShader(program, gsID));
+		return;
 	}
 
-	GLCall(glLinkProgram(program));
+	PendingProgram pending = std::move(m_Pending.value());
+	m_Pending.reset();
 
-	int success = 0;
-	GLCall(glGetProgramiv(program, GL_LINK_STATUS, &success));
+	// Blocks until the driver is done with the program
+	Clock clock;
+	int32_t success = 0;
+	GLCall(glGetProgramiv(pending.ID, GL_LINK_STATUS, &success));
+	float waitTime = clock.GetElapsedTime();
+
+	const std::string& name = m_Spec.Compute.has_value() ? m_Spec.Compute.value().Path : m_Spec.Fragment.Path;
 	if (success == GL_FALSE)
 	{
-		int len = 0;
-		GLCall(glGetProgramiv(program, GL_INFO_LOG_LENGTH, &len));
+		for (uint32_t stage : pending.Stages)
+		{
+			GLCall(glGetShaderiv(stage, GL_COMPILE_STATUS, &success));
+			if (success == GL_FALSE)
+			{
+				int32_t len = 0;
+				GLCall(glGetShaderiv(stage, GL_INFO_LOG_LENGTH, &len));
+
+				std::string message(len, '\0');
+				GLCall(glGetShaderInfoLog(stage, len, &len, message.data()));
+				LOG_ERROR("Failed to compile shader: {}", message);
+			}
+		}
 
-		char* message = (char*)_malloca(len * sizeof(char));
-		GLCall(glGetProgramInfoLog(program, len, &len, message));
+		int32_t len = 0;
+		GLCall(glGetProgramiv(pending.ID, GL_INFO_LOG_LENGTH, &len));
 
+		std::string message(len, '\0');
+		GLCall(glGetProgramInfoLog(pending.ID, len, &len, message.data()));
 		LOG_ERROR("Failed to link shaders: {}", message);
-		GLCall(glDeleteProgram(program));
 
-		return 0;
+		if (m_ID != 0)
+		{
+			LOG_WARN("Keeping the previous version of {}", name);
+		}
+
+		Discard(pending);
+		return;
 	}
 
-	GLCall(glValidateProgram(program));
-	GLCall(glDeleteShader(vsID));
-	GLCall(glDeleteShader(fsID));
+	for (uint32_t stage : pending.Stages)
+	{
+		GLCall(glDeleteShader(stage));
+	}
 
-	if (gsID != 0)
+	GLCall(glValidateProgram(pending.ID));
+	if (!pending.CachePath.empty())
 	{
-		GLCall(glDeleteShader(gsID));
+		if (std::optional<ProgramBinary> binary = ShaderCache::Download(pending.ID); binary.has_value())
+		{
+			ShaderCache::Write(pending.CachePath, binary.value());
+		}
 	}
 
-	return program;
+	LOG_INFO("Shader {}: sources {}ms, compile issued in {}ms, waited {}ms on first use", name, pending.SourceTime, pending.IssueTime, waitTime);
+
+	Swap(pending.ID);
+}
+
+void Shader::Swap(uint32_t program)
+{
+	if (m_ID != 0)
+	{
+		GLState::ForgetProgram(m_ID);
+		GLCall(glDeleteProgram(m_ID));
+	}
+	m_ID = program;
+
+	ReflectUniforms();
+	if (m_OnLinked)
+	{
+		m_OnLinked(*this);
+	}
+}
+
+void Shader::Discard()
+{
+	if (m_Pending.has_value())
+	{
+		Discard(m_Pending.value());
+		m_Pending.reset();
+	}
+}
+
+void Shader::Discard(const PendingProgram& pending)
+{
+	for (uint32_t stage : pending.Stages)
+	{
+		GLCall(glDeleteShader(stage));
+	}
+
+	GLCall(glDeleteProgram(pending.ID));
+}
+
+Shader::PendingProgram Shader::CreateShader(const std::string& vsrc, const std::string& fsrc, std::optional<std::string> gsrc)
+{
+	PendingProgram pending{};
+	GLCall(pending.ID = glCreateProgram());
+	pending.Stages = { CompileShader(GL_VERTEX_SHADER, vsrc), CompileShader(GL_FRAGMENT_SHADER, fsrc) };
+
+	if (gsrc.has_value())
+	{
+		pending.Stages.push_back(CompileShader(GL_GEOMETRY_SHADER, gsrc.value()));
+	}
+
+	LinkProgram(pending);
+
+	return pending;
+}
+
+Shader::PendingProgram Shader::CreateComputeShader(const std::string& csrc)
+{
+	PendingProgram pending{};
+	GLCall(pending.ID = glCreateProgram());
+	pending.Stages = { CompileShader(GL_COMPUTE_SHADER, csrc) };
+
+	LinkProgram(pending);
+
+	return pending;
+}
+
+void Shader::LinkProgram(const PendingProgram& pending)
+{
+	for (uint32_t stage : pending.Stages)
+	{
+		GLCall(glAttachShader(pending.ID, stage));
+	}
+
+	// Has to be set before linking for glGetProgramBinary to return anything
+	GLCall(glProgramParameteri(pending.ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+
+	// Statuses aren't queried here, that would wait for the driver's compiler threads
+	GLCall(glLinkProgram(pending.ID));
 }
 
 uint32_t Shader::CompileShader(uint32_t type, const std::string& source)
 {
 	GLCall(uint32_t id = glCreateShader(type));
 	const char* src = source.c_str();
-	int result = 0;
 
 	GLCall(glShaderSource(id, 1, &src, nullptr));
 	GLCall(glCompileShader(id));
-	GLCall(glGetShaderiv(id, GL_COMPILE_STATUS, &result));
 
-	if (result == GL_FALSE)
+	return id;
+}
+
+int32_t Shader::UniformLocation(const std::string& name)
+{
+	if (m_ID == 0)
+	{
+		Finish();
+	}
+
+	auto it = m_UniformLocations.find(name);
+	if (it != m_UniformLocations.end())
 	{
-		int len = 0;
-		GLCall(glGetShaderiv(id, GL_INFO_LOG_LENGTH, &len));
+		return it->second;
+	}
+
+	// Reflection already found every active uniform, so this one is missing and only gets reported once
+	LOG_WARN("Uniform {} does not exist or is not in use", name);
+	m_UniformLocations[name] = -1;
 
-		char* message = (char*)_malloca(len * sizeof(char));
-		GLCall(glGetShaderInfoLog(id, len, &len, message));
+	return -1;
+}
+
+int32_t Shader::HandleLocation(UniformHandle handle) const
+{
+	assert(handle.Index < m_HandleLocations.size() && "Uniform handle doesn't belong to this shader");
 
-		LOG_ERROR("Failed to compile shader: {}", message);
-		GLCall(glDeleteShader(id));
+	return m_HandleLocations[handle.Index];
+}
 
-		return 0;
+void Shader::ReflectUniforms()
+{
+	m_UniformLocations.clear();
+	if (m_ID == 0)
+	{
+		return;
 	}
 
-	return id;
+	int32_t count = 0;
+	int32_t maxLength = 0;
+	GLCall(glGetProgramiv(m_ID, GL_ACTIVE_UNIFORMS, &count));
+	GLCall(glGetProgramiv(m_ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength));
+
+	std::vector<char> buffer((size_t)maxLength + 1);
+	for (int32_t i = 0; i < count; i++)
+	{
+		int32_t length = 0;
+		int32_t size = 0;
+		GLenum type = 0;
+		GLCall(glGetActiveUniform(m_ID, (uint32_t)i, (int32_t)buffer.size(), &length, &size, &type, buffer.data()));
+
+		std::string name(buffer.data(), length);
+		GLCall(int32_t location = glGetUniformLocation(m_ID, name.c_str()));
+		if (location == -1)
+		{
+			// Members of uniform blocks
+			continue;
+		}
+
+		m_UniformLocations[name] = location;
+
+		// Arrays are reported by their first element, the bare name and every element can be set as well
+		if (name.ends_with("[0]"))
+		{
+			std::string base = name.substr(0, name.size() - 3);
+			m_UniformLocations[base] = location;
+			for (int32_t element = 1; element < size; element++)
+			{
+				std::string elementName = base + "[" + std::to_string(element) + "]";
+				GLCall(m_UniformLocations[elementName] = glGetUniformLocation(m_ID, elementName.c_str()));
+			}
+		}
+	}
+
+	for (size_t i = 0; i < m_HandleNames.size(); i++)
+	{
+		m_HandleLocations[i] = UniformLocation(m_HandleNames[i]);
+	}
 }
 
-int32_t Shader::UniformLocation(const std::string& name)
+SharedBuffer::SharedBuffer(const void* data, uint64_t size)
+{
+	GLCall(glGenBuffers(1, &m_ID));
+	GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_ID));
+	GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, GL_DYNAMIC_DRAW));
+}
+
+SharedBuffer::~SharedBuffer()
 {
-	if (m_UniformLocations.contains(name))
+	if (m_ID != 0)
 	{
-		return m_UniformLocations[name];
+		Unbind();
+		GLCall(glDeleteBuffers(1, &m_ID));
 	}
+}
+
+void SharedBuffer::Bind() const
+{
+	GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_ID));
+}
+
+void SharedBuffer::Unbind() const
+{
+	GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
+}
+
+void SharedBuffer::BindBufferSlot(uint32_t bufferIndex)
+{
+	GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bufferIndex, m_ID));
+}
 
-	GLCall(int32_t location = glGetUniformLocation(m_ID, name.c_str()));
-	if (location == -1)
+void SharedBuffer::ResetData(const void* data, uint64_t size) const
+{
+	Bind();
+	GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, GL_DYNAMIC_DRAW));
+}
+
+void SharedBuffer::SetData(const void* data, uint32_t size, uint32_t offset) const
+{
+	Bind();
+	GLCall(glBufferSubData(GL_SHADER_STORAGE_BUFFER, (GLintptr)offset, size, data));
+}
+
+GpuTimer::GpuTimer()
+{
+	GLCall(glGenQueries(QueryCount, m_IDs));
+}
+
+GpuTimer::~GpuTimer()
+{
+	GLCall(glDeleteQueries(QueryCount, m_IDs));
+}
+
+void GpuTimer::Begin()
+{
+	// The slot about to be reused holds the oldest query, it's waited on only if it isn't done after QueryCount frames
+	for (uint32_t i = 0; i < QueryCount; i++)
+	{
+		uint32_t slot = (m_Current + i) % QueryCount;
+		if (!m_Pending[slot])
+		{
+			continue;
+		}
+
+		if (i != 0)
+		{
+			int32_t available = 0;
+			GLCall(glGetQueryObjectiv(m_IDs[slot], GL_QUERY_RESULT_AVAILABLE, &available));
+			if (available == GL_FALSE)
+			{
+				break;
+			}
+		}
+
+		uint64_t elapsed = 0;
+		GLCall(glGetQueryObjectui64v(m_IDs[slot], GL_QUERY_RESULT, &elapsed));
+		m_LastTime = (float)((double)elapsed / 1e6);
+		m_Pending[slot] = false;
+	}
+
+	GLCall(glBeginQuery(GL_TIME_ELAPSED, m_IDs[m_Current]));
+}
+
+void GpuTimer::End()
+{
+	GLCall(glEndQuery(GL_TIME_ELAPSED));
+	m_Pending[m_Current] = true;
+	m_Current = (m_Current + 1) % QueryCount;
+}
+
+PixelReadback::PixelReadback(uint32_t depth)
+	: m_Slots(std::max(depth, 1u))
+{
+	for (Slot& slot : m_Slots)
+	{
+		GLCall(glGenBuffers(1, &slot.Buffer));
+	}
+}
+
+PixelReadback::~PixelReadback()
+{
+	for (Slot& slot : m_Slots)
 	{
-		LOG_WARN("Uniform {} does not exist or is not in use", name);
+		if (slot.Fence != nullptr)
+		{
+			GLCall(glDeleteSync(slot.Fence));
+		}
 
-		return -1;
+		GLCall(glDeleteBuffers(1, &slot.Buffer));
 	}
+}
 
-	m_UniformLocations[name] = location;
-	return location;
+void PixelReadback::Request(const Framebuffer& fb, uint32_t attachmentIdx, const glm::ivec2& offset, const glm::ivec2& size)
+{
+	Slot& slot = m_Slots[m_Next];
+	if (slot.Fence != nullptr)
+	{
+		GLCall(glDeleteSync(slot.Fence));
+		slot.Fence = nullptr;
+		m_InFlight--;
+	}
+
+	slot.Size = (uint64_t)size.x * size.y * sizeof(glm::u8vec4);
+	GLCall(glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.Buffer));
+	if (slot.Capacity < slot.Size)
+	{
+		GLCall(glBufferData(GL_PIXEL_PACK_BUFFER, slot.Size, nullptr, GL_STREAM_READ));
+		slot.Capacity = slot.Size;
+	}
+
+	// With a pack buffer bound glReadPixels only queues the copy
+	fb.Bind();
+	GLCall(glReadBuffer(GL_COLOR_ATTACHMENT0 + attachmentIdx));
+	GLCall(glReadPixels(offset.x, offset.y, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+	GLCall(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+	GLCall(slot.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+
+	m_Next = (m_Next + 1) % (uint32_t)m_Slots.size();
+	m_InFlight++;
 }
 
-SharedBuffer::SharedBuffer(const void* data, uint64_t size)
-{
-	GLCall(glGenBuffers(1, &m_ID));
-	GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_ID));
-	GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, GL_DYNAMIC_DRAW));
+PixelReadback::Slot* PixelReadback::Arrived()
+{
+	if (m_InFlight == 0)
+	{
+		return nullptr;
+	}
+
+	uint32_t depth = (uint32_t)m_Slots.size();
+	Slot& slot = m_Slots[(m_Next + depth - m_InFlight) % depth];
+
+	// Flushing makes sure the fence gets to the GPU at all, the zero timeout keeps it from waiting
+	GLenum status = GL_TIMEOUT_EXPIRED;
+	GLCall(status = glClientWaitSync(slot.Fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0));
+	if (status == GL_TIMEOUT_EXPIRED)
+	{
+		return nullptr;
+	}
+
+	GLCall(glDeleteSync(slot.Fence));
+	slot.Fence = nullptr;
+	m_InFlight--;
+
+	return status != GL_WAIT_FAILED ? &slot : nullptr;
 }
 
-SharedBuffer::~SharedBuffer()
+bool PixelReadback::Poll(std::vector<uint8_t>& pixels)
 {
-	if (m_ID != 0)
+	Slot* slot = Arrived();
+	if (slot == nullptr)
 	{
-		Unbind();
-		GLCall(glDeleteBuffers(1, &m_ID));
+		return false;
 	}
-}
 
-void SharedBuffer::Bind() const
-{
-	GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_ID));
-}
+	pixels.resize(slot->Size);
+	GLCall(glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->Buffer));
+	GLCall(glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, slot->Size, pixels.data()));
+	GLCall(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
 
-void SharedBuffer::Unbind() const
-{
-	GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
+	return true;
 }
 
-void SharedBuffer::BindBufferSlot(uint32_t bufferIndex)
+bool PixelReadback::Poll(glm::u8vec4& pixel)
 {
-	GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bufferIndex, m_ID));
-}
+	Slot* slot = Arrived();
+	if (slot == nullptr)
+	{
+		return false;
+	}
 
-void SharedBuffer::ResetData(const void* data, uint64_t size) const
-{
-	Bind();
-	GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, GL_DYNAMIC_DRAW));
-}
+	GLCall(glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->Buffer));
+	GLCall(glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, sizeof(glm::u8vec4), &pixel[0]));
+	GLCall(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
 
-void SharedBuffer::SetData(const void* data, uint32_t size, uint32_t offset) const
-{
-	Bind();
-	GLCall(glBufferSubData(GL_SHADER_STORAGE_BUFFER, (GLintptr)offset, size, data));
+	return true;
 }
 
 struct RenderbufferSettings
@@ -554,12 +1377,21 @@ static RenderbufferSettings RBO_Settings(const RenderbufferSpec& spec)
 	return sets;
 }
 
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
 static struct TexFormatInfo
 {
 	int32_t InternalFormat;
 	int32_t Format;
 	int32_t Type;
 	int32_t BPP;
+	float BytesPerTexel;
 };
 
 static TexFormatInfo FormatInfo(TextureFormat format)
@@ -573,48 +1405,98 @@ static TexFormatInfo FormatInfo(TextureFormat format)
 		formatInfo.Format = GL_RGBA;
 		formatInfo.Type = GL_UNSIGNED_BYTE;
 		formatInfo.BPP = 4;
+		formatInfo.BytesPerTexel = 4.0f;
 		break;
 	case TextureFormat::RGB8:
 		formatInfo.InternalFormat = GL_RGB8;
 		formatInfo.Format = GL_RGB;
 		formatInfo.Type = GL_UNSIGNED_BYTE;
 		formatInfo.BPP = 3;
+		formatInfo.BytesPerTexel = 3.0f;
 		break;
 	case TextureFormat::RGBA16F:
 		formatInfo.InternalFormat = GL_RGBA16F;
 		formatInfo.Format = GL_RGBA;
 		formatInfo.Type = GL_FLOAT;
 		formatInfo.BPP = 4;
+		formatInfo.BytesPerTexel = 8.0f;
 		break;
 	case TextureFormat::RGB16F:
 		formatInfo.InternalFormat = GL_RGB16F;
 		formatInfo.Format = GL_RGB;
 		formatInfo.Type = GL_FLOAT;
 		formatInfo.BPP = 3;
+		formatInfo.BytesPerTexel = 6.0f;
 		break;
 	case TextureFormat::RG16F:
 		formatInfo.InternalFormat = GL_RG16F;
 		formatInfo.Format = GL_RG;
 		formatInfo.Type = GL_FLOAT;
 		formatInfo.BPP = 2;
+		formatInfo.BytesPerTexel = 4.0f;
 		break;
 	case TextureFormat::RGB32F:
 		formatInfo.InternalFormat = GL_RGB32F;
 		formatInfo.Format = GL_RGB;
 		formatInfo.Type = GL_FLOAT;
 		formatInfo.BPP = 3;
+		formatInfo.BytesPerTexel = 12.0f;
 		break;
 	case TextureFormat::R11_G11_B10:
 		formatInfo.InternalFormat = GL_R11F_G11F_B10F;
 		formatInfo.Format = GL_RGB;
 		formatInfo.Type = GL_FLOAT;
 		formatInfo.BPP = 3;
+		formatInfo.BytesPerTexel = 4.0f;
 		break;
 	case TextureFormat::DEPTH_32F:
 		formatInfo.InternalFormat = GL_DEPTH_COMPONENT32F;
 		formatInfo.Format = GL_DEPTH_COMPONENT;
 		formatInfo.Type = GL_FLOAT;
 		formatInfo.BPP = 1;
+		formatInfo.BytesPerTexel = 4.0f;
+		break;
+	case TextureFormat::BC1:
+		formatInfo.InternalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		formatInfo.Format = GL_RGB;
+		formatInfo.Type = GL_UNSIGNED_BYTE;
+		formatInfo.BPP = 3;
+		formatInfo.BytesPerTexel = 0.5f;
+		break;
+	case TextureFormat::BC3:
+		formatInfo.InternalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		formatInfo.Format = GL_RGBA;
+		formatInfo.Type = GL_UNSIGNED_BYTE;
+		formatInfo.BPP = 4;
+		formatInfo.BytesPerTexel = 1.0f;
+		break;
+	case TextureFormat::BC4:
+		formatInfo.InternalFormat = GL_COMPRESSED_RED_RGTC1;
+		formatInfo.Format = GL_RED;
+		formatInfo.Type = GL_UNSIGNED_BYTE;
+		formatInfo.BPP = 1;
+		formatInfo.BytesPerTexel = 0.5f;
+		break;
+	case TextureFormat::BC5:
+		formatInfo.InternalFormat = GL_COMPRESSED_RG_RGTC2;
+		formatInfo.Format = GL_RG;
+		formatInfo.Type = GL_UNSIGNED_BYTE;
+		formatInfo.BPP = 2;
+		formatInfo.BytesPerTexel = 1.0f;
+		break;
+	case TextureFormat::BC6H:
+		formatInfo.InternalFormat = GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT;
+		formatInfo.Format = GL_RGB;
+		formatInfo.Type = GL_FLOAT;
+		formatInfo.BPP = 3;
+		formatInfo.BytesPerTexel = 1.0f;
+		break;
+	case TextureFormat::BC7:
+		formatInfo.InternalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;
+		formatInfo.Format = GL_RGBA;
+		formatInfo.Type = GL_UNSIGNED_BYTE;
+		formatInfo.BPP = 4;
+		formatInfo.BytesPerTexel = 1.0f;
 		break;
 	default:
 		assert(true && "Invalid texture format passed");
@@ -661,14 +1543,15 @@ Framebuffer::Framebuffer(uint32_t samples)
 	assert(samples > 0 && "At least 1 sample required.");
 
 	GLCall(glGenFramebuffers(1, &m_ID));
-	GLCall(glBindFramebuffer(GL_FRAMEBUFFER, m_ID));
+	GLState::BindFramebuffer(GL_FRAMEBUFFER, m_ID);
 }
 
 Framebuffer::~Framebuffer()
 {
-	GLCall(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+	GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
 	if (m_ID != 0)
 	{
+		GLState::ForgetFramebuffer(m_ID);
 		GLCall(glDeleteFramebuffers(1, &m_ID));
 	}
 
@@ -680,27 +1563,28 @@ Framebuffer::~Framebuffer()
 
 	for (const auto& [id, spec] : m_ColorAttachments)
 	{
-		GLCall(glBindTexture(TexType(spec.Type), 0));
+		GLState::BindTexture(TexType(spec.Type), 0);
+		GLState::ForgetTexture(id);
 		GLCall(glDeleteTextures(1, &id));
 	}
 }
 
 void Framebuffer::Bind() const
 {
-	GLCall(glBindFramebuffer(GL_FRAMEBUFFER, m_ID));
+	GLState::BindFramebuffer(GL_FRAMEBUFFER, m_ID);
 }
 
 void Framebuffer::Unbind() const
 {
-	GLCall(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+	GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void Framebuffer::BlitColorAttachment(uint32_t sourceAttachment, uint32_t targetAttachment, const Framebuffer& target) const
 {
 	assert(m_ID != 0 && target.m_ID != 0 && "One of the framebuffers is empty.");
 
-	GLCall(glBindFramebuffer(GL_READ_FRAMEBUFFER, m_ID));
-	GLCall(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target.m_ID));
+	GLState::BindFramebuffer(GL_READ_FRAMEBUFFER, m_ID);
+	GLState::BindFramebuffer(GL_DRAW_FRAMEBUFFER, target.m_ID);
 	GLCall(glReadBuffer(GL_COLOR_ATTACHMENT0 + sourceAttachment));
 	GLCall(glDrawBuffer(GL_COLOR_ATTACHMENT0 + targetAttachment));
 	GLCall(glBlitFramebuffer(
@@ -715,8 +1599,8 @@ void Framebuffer::BlitRenderbuffer(std::shared_ptr<Framebuffer> target) const
 {
 	assert(m_RenderbufferID != 0 && target->m_RenderbufferID != 0 && "One of the framebuffers has no renderbuffer");
 	
-	GLCall(glBindFramebuffer(GL_READ_FRAMEBUFFER, m_ID));
-	GLCall(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target->m_ID));
+	GLState::BindFramebuffer(GL_READ_FRAMEBUFFER, m_ID);
+	GLState::BindFramebuffer(GL_DRAW_FRAMEBUFFER, target->m_ID);
 	GLCall(glBlitFramebuffer(
 		0, 0,
 		m_RBO_Spec.Size.x, m_RBO_Spec.Size.y,
@@ -756,7 +1640,7 @@ void Framebuffer::ResizeEverything(const glm::uvec2& size)
 	{
 		for (auto& [id, spec] : m_ColorAttachments)
 		{
-			GLCall(glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, id));
+			GLState::BindTexture(GL_TEXTURE_2D_MULTISAMPLE, id);
 			GLCall(glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, m_Samples, FormatInfo(spec.Format).InternalFormat, size.x, size.y, GL_TRUE));
 			spec.Size = size;
 		}
@@ -769,7 +1653,7 @@ void Framebuffer::ResizeEverything(const glm::uvec2& size)
 		{
 			TexFormatInfo texFmt = FormatInfo(spec.Format);
 			GLenum texType = TexType(spec.Type);
-			GLCall(glBindTexture(texType, id));
+			GLState::BindTexture(texType, id);
 
 			if (spec.Type == ColorAttachmentType::TEX_CUBEMAP)
 			{
@@ -794,12 +1678,14 @@ void Framebuffer::ResizeEverything(const glm::uvec2& size)
 
 void Framebuffer::FillDrawBuffers()
 {
-	std::vector<GLenum> buffers(m_ColorAttachments.size());
+	// Every frame for some framebuffers, so it stays on the stack. GL guarantees at least 8 draw buffers
+	std::array<GLenum, 8> buffers{};
+	assert(m_ColorAttachments.size() <= buffers.size() && "More color attachments than draw buffers");
 	for (size_t i = 0; i < m_ColorAttachments.size(); i++)
 	{
-		buffers[i] = GL_COLOR_ATTACHMENT0 + i;
+		buffers[i] = GL_COLOR_ATTACHMENT0 + (GLenum)i;
 	}
-	GLCall(glDrawBuffers(buffers.size(), buffers.data()));
+	GLCall(glDrawBuffers((int32_t)m_ColorAttachments.size(), buffers.data()));
 }
 
 void Framebuffer::AddRenderbuffer(RenderbufferSpec spec)
@@ -837,7 +1723,7 @@ void Framebuffer::AddColorAttachment(ColorAttachmentSpec spec)
 	{
 		assert(spec.Type == ColorAttachmentType::TEX_2D_MULTISAMPLE && "Only multisampled texture supported for multisampled framebuffer.");
 
-		GLCall(glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, id));
+		GLState::BindTexture(GL_TEXTURE_2D_MULTISAMPLE, id);
 		GLCall(glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, m_Samples, texFmt.InternalFormat, spec.Size.x, spec.Size.y, GL_TRUE));
 	}
 	else
@@ -845,7 +1731,7 @@ void Framebuffer::AddColorAttachment(ColorAttachmentSpec spec)
 		assert(spec.Type != ColorAttachmentType::TEX_2D_MULTISAMPLE && "Only multisampled texture supported for multisampled framebuffer.");
 		int32_t type = TexType(spec.Type);
 
-		GLCall(glBindTexture(type, id));
+		GLState::BindTexture(type, id);
 		GLCall(glTexParameteri(type, GL_TEXTURE_MIN_FILTER, spec.MinFilter));
 		GLCall(glTexParameteri(type, GL_TEXTURE_MAG_FILTER, spec.MagFilter));
 		GLCall(glTexParameteri(type, GL_TEXTURE_WRAP_S, spec.Wrap));
@@ -904,8 +1790,7 @@ void Framebuffer::BindColorAttachment(uint32_t attachmentIdx, uint32_t slot) con
 	assert(attachmentIdx < m_ColorAttachments.size() && "Trying to bind non-existent color attachment.");
 
 	const auto& [id, spec] = m_ColorAttachments[attachmentIdx];
-	GLCall(glActiveTexture(GL_TEXTURE0 + slot));
-	GLCall(glBindTexture(TexType(spec.Type), id));
+	GLState::BindTexture(slot, TexType(spec.Type), id);
 }
 
 void Framebuffer::DrawToColorAttachment(uint32_t attachmentIdx, uint32_t targetAttachment, int32_t mip) const
@@ -917,6 +1802,12 @@ void Framebuffer::DrawToColorAttachment(uint32_t attachmentIdx, uint32_t targetA
 	GLCall(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + targetAttachment, TexType(spec.Type), id, mip));
 }
 
+void Framebuffer::DrawToTexture(uint32_t textureID, uint32_t targetAttachment, int32_t mip) const
+{
+	Bind();
+	GLCall(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + targetAttachment, GL_TEXTURE_2D, textureID, mip));
+}
+
 void Framebuffer::DrawToDepthMap(uint32_t attachmentIdx, int32_t mip) const
 {
 	assert(attachmentIdx < m_ColorAttachments.size() && "Trying to draw to non-existent color attachment.");
@@ -960,98 +1851,175 @@ void Framebuffer::RemoveColorAttachment(uint32_t attachmentIdx)
 	assert(attachmentIdx < m_ColorAttachments.size() && "Trying to remove non-existent color attachment.");
 
 	GLenum texType = TexType(m_ColorAttachments[attachmentIdx].spec.Type);
-	GLCall(glBindTexture(texType, 0));
+	GLState::BindTexture(texType, 0);
+	GLState::ForgetTexture(m_ColorAttachments[attachmentIdx].ID);
 	GLCall(glDeleteTextures(1, &m_ColorAttachments[attachmentIdx].ID));
 	
 	m_ColorAttachments.erase(m_ColorAttachments.begin() + attachmentIdx);
 }
 
-glm::u8vec4 Framebuffer::GetPixelAt(const glm::vec2& coords, int32_t attachmentIdx) const
+bool Framebuffer::IsComplete() const
 {
-	glm::u8vec4 pixel{};
-
-	Bind();
-	GLCall(glReadBuffer(GL_COLOR_ATTACHMENT0 + attachmentIdx));
-	GLCall(glReadPixels((GLint)coords.x, (GLint)coords.y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, &pixel[0]));
-
-	return pixel;
+	GLCall(return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
 }
 
-bool Framebuffer::IsComplete() const
+static uint64_t MipChainTexels(int32_t width, int32_t height)
 {
-	GLCall(return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	uint64_t texels = 0;
+	while (true)
+	{
+		texels += (uint64_t)width * height;
+		if (width <= 1 && height <= 1)
+		{
+			break;
+		}
+
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+
+	return texels;
 }
 
-Texture::Texture(const std::string& path, TextureFormat format)
-	: m_ID(0), m_Width(0), m_Height(0), m_BPP(0), m_Path(path)
+// Levels below the base one are generated on the CPU, glGenerateMipmap stalls and filters colour in gamma space
+static std::vector<TextureLevel> GenerateMips(const std::vector<uint8_t>& base, int32_t width, int32_t height, TextureFormat format, MipContent content)
 {
-	auto [internalFormat, pixelFormat, type, BPP] = FormatInfo(format);
-	void* buffer = nullptr;
-	stbi_set_flip_vertically_on_load(1);
+	auto [internalFormat, pixelFormat, type, BPP, bytesPerTexel] = FormatInfo(format);
+
+	std::vector<TextureLevel> levels;
 	if (type == GL_FLOAT)
 	{
-		buffer = stbi_loadf(path.c_str(), &m_Width, &m_Height, &m_BPP, BPP);
+		for (MipLevel<float>& mip : MipGenerator::Generate((const float*)base.data(), width, height, BPP))
+		{
+			const uint8_t* bytes = (const uint8_t*)mip.Data.data();
+			levels.push_back({ mip.Width, mip.Height, std::vector<uint8_t>(bytes, bytes + mip.Data.size() * sizeof(float)) });
+		}
 	}
 	else
 	{
-		buffer = stbi_load(path.c_str(), &m_Width, &m_Height, &m_BPP, BPP);
+		for (MipLevel<uint8_t>& mip : MipGenerator::Generate(base.data(), width, height, BPP, content))
+		{
+			levels.push_back({ mip.Width, mip.Height, std::move(mip.Data) });
+		}
 	}
 
+	return levels;
+}
+
+Texture::Texture(const std::string& path, TextureFormat format, MipContent content)
+	: m_ID(0), m_Width(0), m_Height(0), m_BPP(0), m_Format(format), m_Content(content), m_Path(path)
+{
+	std::filesystem::path texturePath = path;
+	m_Name = texturePath.filename().string();
+
 	GLCall(glGenTextures(1, &m_ID));
-	GLCall(glBindTexture(GL_TEXTURE_2D, m_ID));
+	GLState::BindTexture(GL_TEXTURE_2D, m_ID);
 
 	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR));
 	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
 	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT));
 	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT));
 
-	GLCall(glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, m_Width, m_Height, 0, pixelFormat, type, buffer));
-	GLCall(glGenerateMipmap(GL_TEXTURE_2D));
-	GLCall(glBindTexture(GL_TEXTURE_2D, 0));
+	auto [internalFormat, pixelFormat, type, BPP, bytesPerTexel] = FormatInfo(format);
+	if (TextureCompressor::IsCompressed(format))
+	{
+		std::optional<CompressedImage> image = TextureCompressor::LoadOrCompress(path, format, content);
+		if (image.has_value())
+		{
+			m_Width = image->Width;
+			m_Height = image->Height;
+			m_BPP = BPP;
+
+			for (CompressedMip& mip : image->Mips)
+			{
+				m_Levels.push_back({ mip.Width, mip.Height, std::move(mip.Data) });
+			}
+
+			// Compared against what the source would take when uploaded as RGBA8 (or RGB16F for HDR)
+			float sourceTexelSize = format == TextureFormat::BC6H ? 6.0f : 4.0f;
+			m_UncompressedSize = (uint64_t)(MipChainTexels(m_Width, m_Height) * sourceTexelSize);
+		}
 
-	if (buffer)
+		UploadLevels();
+	}
+	else
 	{
-		stbi_image_free(buffer);
+		void* buffer = nullptr;
+		stbi_set_flip_vertically_on_load(1);
+		if (type == GL_FLOAT)
+		{
+			buffer = stbi_loadf(path.c_str(), &m_Width, &m_Height, &m_BPP, BPP);
+		}
+		else
+		{
+			buffer = stbi_load(path.c_str(), &m_Width, &m_Height, &m_BPP, BPP);
+		}
+
+		if (buffer)
+		{
+			UploadBaseAndQueueMips(buffer);
+			stbi_image_free(buffer);
+		}
+
+		m_UncompressedSize = (uint64_t)(MipChainTexels(m_Width, m_Height) * bytesPerTexel);
 	}
 
-	std::filesystem::path texturePath = path;
-	m_Name = texturePath.filename().string();
+	GLState::BindTexture(GL_TEXTURE_2D, 0);
 }
 
-Texture::Texture(const void* data, int32_t width, int32_t height, const std::string& name, TextureFormat format)
-	: m_ID(0), m_Width(width), m_Height(height), m_BPP(0), m_Path(""), m_Name(name)
+Texture::Texture(const void* data, int32_t width, int32_t height, const std::string& name, TextureFormat format, MipContent content)
+	: m_ID(0), m_Width(width), m_Height(height), m_BPP(0), m_Format(format), m_Content(content), m_Path(""), m_Name(name)
 {
 	GLCall(glGenTextures(1, &m_ID));
-	GLCall(glBindTexture(GL_TEXTURE_2D, m_ID));
+	GLState::BindTexture(GL_TEXTURE_2D, m_ID);
 
 	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR));
 	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
 	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT));
 	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT));
 
-	auto [internalFormat, pixelFormat, type, BPP] = FormatInfo(format);
-	GLCall(glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, m_Width, m_Height, 0, pixelFormat, type, data));
-	GLCall(glGenerateMipmap(GL_TEXTURE_2D));
-	GLCall(glBindTexture(GL_TEXTURE_2D, 0));
+	auto [internalFormat, pixelFormat, type, BPP, bytesPerTexel] = FormatInfo(format);
+	if (data != nullptr)
+	{
+		UploadBaseAndQueueMips(data);
+	}
+	else
+	{
+		GLCall(glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, m_Width, m_Height, 0, pixelFormat, type, nullptr));
+		GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0));
+		m_VRAMSize = (uint64_t)((uint64_t)m_Width * m_Height * bytesPerTexel);
+	}
+	GLState::BindTexture(GL_TEXTURE_2D, 0);
+
+	m_UncompressedSize = (uint64_t)(MipChainTexels(m_Width, m_Height) * bytesPerTexel);
 }
 
 Texture::Texture(uint32_t id, const std::string& name, TextureFormat format)
-	: m_ID(id), m_Path(""), m_Name(name)
+	: m_ID(id), m_Format(format), m_Path(""), m_Name(name)
 {
 	ASSERT(id > 0 && "Invalid ID");
 
-	GLCall(glBindTexture(GL_TEXTURE_2D, m_ID));
+	GLState::BindTexture(GL_TEXTURE_2D, m_ID);
 	GLCall(glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &m_Width));
 	GLCall(glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &m_Height));
-	GLCall(glBindTexture(GL_TEXTURE_2D, 0));
+	GLState::BindTexture(GL_TEXTURE_2D, 0);
 
 	m_BPP = FormatInfo(format).BPP;
+	m_VRAMSize = (uint64_t)((uint64_t)m_Width * m_Height * FormatInfo(format).BytesPerTexel);
+	m_UncompressedSize = m_VRAMSize;
 }
 
 Texture::~Texture()
 {
+	// The job writes into this texture
+	if (m_MipJob)
+	{
+		JobSystem::Wait(*m_MipJob);
+	}
+
 	if (m_ID != 0)
 	{
+		GLState::ForgetTexture(m_ID);
 		GLCall(glDeleteTextures(1, &m_ID));
 	}
 }
@@ -1063,7 +2031,6 @@ void Texture::SetFilter(int32_t filter)
 	Bind();
 	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmapFilter));
 	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter));
-	GLCall(glGenerateMipmap(GL_TEXTURE_2D));
 
 	m_Filter = filter;
 }
@@ -1073,18 +2040,291 @@ void Texture::SetWrap(int32_t wrap)
 	Bind();
 	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap));
 	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap));
-	GLCall(glGenerateMipmap(GL_TEXTURE_2D));
 
 	m_Wrap = wrap;
 }
 
 void Texture::Bind(uint32_t slot) const
 {
-	GLCall(glActiveTexture(GL_TEXTURE0 + slot));
-	GLCall(glBindTexture(GL_TEXTURE_2D, m_ID));
+	GLState::BindTexture(slot, GL_TEXTURE_2D, m_ID);
 }
 
 void Texture::Unbind() const
 {
-	GLCall(glBindTexture(GL_TEXTURE_2D, 0));
+	GLState::BindTexture(GL_TEXTURE_2D, 0);
+}
+
+void Texture::DropMips(uint32_t count)
+{
+	if (m_Levels.empty())
+	{
+		return;
+	}
+
+	count = std::min(count, (uint32_t)m_Levels.size() - 1);
+	if (count == m_DroppedMips)
+	{
+		return;
+	}
+
+	// Levels stay at their indices and the base level moves, so only the levels changing residency are touched
+	GLState::BindTexture(GL_TEXTURE_2D, m_ID);
+	for (uint32_t i = m_DroppedMips; i < count; i++)
+	{
+		DownloadLevel(i);
+		ReleaseLevel(i);
+	}
+
+	for (uint32_t i = count; i < m_DroppedMips; i++)
+	{
+		UploadLevel(i);
+	}
+
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (int32_t)count));
+	GLState::BindTexture(GL_TEXTURE_2D, 0);
+
+	m_DroppedMips = count;
+	m_VRAMSize = ResidentSize(count);
+}
+
+// The base level is uploaded right away so the texture is usable, the rest of the chain is built in a job rather than on the GL thread
+void Texture::UploadBaseAndQueueMips(const void* data)
+{
+	auto [internalFormat, pixelFormat, type, BPP, bytesPerTexel] = FormatInfo(m_Format);
+	size_t channelSize = type == GL_FLOAT ? sizeof(float) : sizeof(uint8_t);
+
+	const uint8_t* bytes = (const uint8_t*)data;
+	std::vector<uint8_t> base(bytes, bytes + (size_t)m_Width * m_Height * BPP * channelSize);
+	m_Levels.push_back({ m_Width, m_Height, base });
+	UploadLevels();
+
+	if (m_Width <= 1 && m_Height <= 1)
+	{
+		return;
+	}
+
+	m_MipJob = std::make_unique<JobCounter>();
+	JobSystem::Run([this, base = std::move(base)]()
+		{
+			m_PendingLevels = GenerateMips(base, m_Width, m_Height, m_Format, m_Content);
+		}, m_MipJob.get());
+}
+
+bool Texture::FinishMips()
+{
+	if (!m_MipJob)
+	{
+		return true;
+	}
+
+	if (!m_MipJob->Done())
+	{
+		return false;
+	}
+
+	m_MipJob.reset();
+
+	// Nothing is dropped until the chain is complete, so the new levels go on top of a fully resident base
+	uint32_t first = (uint32_t)m_Levels.size();
+	for (TextureLevel& level : m_PendingLevels)
+	{
+		m_Levels.push_back(std::move(level));
+	}
+	m_PendingLevels = {};
+
+	GLState::BindTexture(GL_TEXTURE_2D, m_ID);
+	for (uint32_t i = first; i < (uint32_t)m_Levels.size(); i++)
+	{
+		UploadLevel(i);
+	}
+
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (int32_t)m_Levels.size() - 1));
+	GLState::BindTexture(GL_TEXTURE_2D, 0);
+
+	m_VRAMSize = ResidentSize(m_DroppedMips);
+	return true;
+}
+
+void Texture::WaitForMips()
+{
+	if (m_MipJob)
+	{
+		JobSystem::Wait(*m_MipJob);
+	}
+
+	FinishMips();
+}
+
+void Texture::UploadLevels()
+{
+	for (uint32_t i = 0; i < (uint32_t)m_Levels.size(); i++)
+	{
+		UploadLevel(i);
+	}
+
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, m_Levels.empty() ? 0 : (int32_t)m_Levels.size() - 1));
+	m_DroppedMips = 0;
+	m_VRAMSize = ResidentSize(0);
+}
+
+void Texture::UploadLevel(uint32_t level)
+{
+	auto [internalFormat, pixelFormat, type, BPP, bytesPerTexel] = FormatInfo(m_Format);
+	TextureLevel& source = m_Levels[level];
+
+	GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+	if (TextureCompressor::IsCompressed(m_Format))
+	{
+		GLCall(glCompressedTexImage2D(GL_TEXTURE_2D, level, internalFormat, source.Width, source.Height, 0, (int32_t)source.Data.size(), source.Data.data()));
+	}
+	else
+	{
+		GLCall(glTexImage2D(GL_TEXTURE_2D, level, internalFormat, source.Width, source.Height, 0, pixelFormat, type, source.Data.data()));
+	}
+	GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+
+	source.Data = {};
+}
+
+// Synchronous, but evictions only happen while over budget and each level is read back once
+void Texture::DownloadLevel(uint32_t level)
+{
+	auto [internalFormat, pixelFormat, type, BPP, bytesPerTexel] = FormatInfo(m_Format);
+	TextureLevel& target = m_Levels[level];
+
+	GLCall(glPixelStorei(GL_PACK_ALIGNMENT, 1));
+	if (TextureCompressor::IsCompressed(m_Format))
+	{
+		target.Data.resize(LevelSize(level));
+		GLCall(glGetCompressedTexImage(GL_TEXTURE_2D, level, target.Data.data()));
+	}
+	else
+	{
+		size_t channelSize = type == GL_FLOAT ? sizeof(float) : sizeof(uint8_t);
+		target.Data.resize((size_t)target.Width * target.Height * BPP * channelSize);
+		GLCall(glGetTexImage(GL_TEXTURE_2D, level, pixelFormat, type, target.Data.data()));
+	}
+	GLCall(glPixelStorei(GL_PACK_ALIGNMENT, 4));
+}
+
+void Texture::ReleaseLevel(uint32_t level)
+{
+	auto [internalFormat, pixelFormat, type, BPP, bytesPerTexel] = FormatInfo(m_Format);
+	bool compressed = TextureCompressor::IsCompressed(m_Format);
+
+	// Levels below the base one don't take part in completeness, an empty image frees the storage
+	GLCall(glTexImage2D(GL_TEXTURE_2D, level, compressed ? GL_RGBA8 : internalFormat, 0, 0, 0, compressed ? GL_RGBA : pixelFormat, compressed ? GL_UNSIGNED_BYTE : type, nullptr));
+}
+
+uint64_t Texture::ResidentSize(uint32_t droppedMips) const
+{
+	uint64_t size = 0;
+	for (uint32_t i = droppedMips; i < (uint32_t)m_Levels.size(); i++)
+	{
+		size += LevelSize(i);
+	}
+
+	return size;
+}
+
+uint64_t Texture::EvictedSize() const
+{
+	uint64_t size = 0;
+	for (const TextureLevel& level : m_Levels)
+	{
+		size += level.Data.size();
+	}
+
+	return size;
+}
+
+uint64_t Texture::LevelSize(uint32_t level) const
+{
+	const TextureLevel& mip = m_Levels[level];
+	if (TextureCompressor::IsCompressed(m_Format))
+	{
+		return (uint64_t)((mip.Width + 3) / 4) * ((mip.Height + 3) / 4) * TextureCompressor::BlockSize(m_Format);
+	}
+
+	return (uint64_t)((uint64_t)mip.Width * mip.Height * FormatInfo(m_Format).BytesPerTexel);
+}
+
+TexturePool::~TexturePool()
+{
+	for (const PooledTexture& texture : m_Textures)
+	{
+		GLState::ForgetTexture(texture.ID);
+		GLCall(glDeleteTextures(1, &texture.ID));
+	}
+}
+
+uint32_t TexturePool::Acquire(const glm::ivec2& size, TextureFormat format)
+{
+	for (PooledTexture& texture : m_Textures)
+	{
+		if (!texture.InUse && texture.Size == size && texture.Format == format)
+		{
+			texture.InUse = true;
+			texture.LastUsedFrame = m_Frame;
+
+			return texture.ID;
+		}
+	}
+
+	PooledTexture& texture = m_Textures.emplace_back();
+	texture.Size = size;
+	texture.Format = format;
+	texture.InUse = true;
+	texture.LastUsedFrame = m_Frame;
+
+	TexFormatInfo texFmt = FormatInfo(format);
+	GLCall(glGenTextures(1, &texture.ID));
+	GLState::BindTexture(GL_TEXTURE_2D, texture.ID);
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+	GLCall(glTexStorage2D(GL_TEXTURE_2D, 1, texFmt.InternalFormat, size.x, size.y));
+	m_VRAMSize += TextureSize(size, format);
+
+	return texture.ID;
+}
+
+void TexturePool::Release(uint32_t textureID)
+{
+	for (PooledTexture& texture : m_Textures)
+	{
+		if (texture.ID == textureID)
+		{
+			texture.InUse = false;
+
+			return;
+		}
+	}
+
+	assert(false && "Released texture doesn't belong to the pool");
+}
+
+void TexturePool::NextFrame(uint32_t maxIdleFrames)
+{
+	m_Frame++;
+	std::erase_if(m_Textures,
+		[&](const PooledTexture& texture)
+		{
+			if (texture.InUse || m_Frame - texture.LastUsedFrame <= maxIdleFrames)
+			{
+				return false;
+			}
+
+			GLState::ForgetTexture(texture.ID);
+			GLCall(glDeleteTextures(1, &texture.ID));
+			m_VRAMSize -= TextureSize(texture.Size, texture.Format);
+
+			return true;
+		});
+}
+
+uint64_t TexturePool::TextureSize(const glm::ivec2& size, TextureFormat format)
+{
+	return (uint64_t)((double)size.x * size.y * FormatInfo(format).BytesPerTexel);
 }
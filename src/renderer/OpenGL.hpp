@@ -5,9 +5,12 @@
 
 #include <unordered_map>
 #include <string>
+#include <string_view>
 #include <optional>
 #include <memory>
 #include <vector>
+#include <array>
+#include <functional>
 
 #define __FILENAME__ (strrchr(__FILE__, '\\') ? strrchr(__FILE__, '\\') + 1 : __FILE__)
 
@@ -32,6 +35,82 @@ void GLClearErrors();
 
 bool GLCheckForErrors(const char* func, const char* filename, int32_t line);
 
+// Shadow copy of the bound objects and pipeline state, calls that wouldn't change anything never reach the driver.
+// Every change of the tracked state has to go through here, code that touches it behind our back calls Invalidate after
+class GLState
+{
+public:
+	static void UseProgram(uint32_t program);
+	static void BindVertexArray(uint32_t vao);
+	static void BindFramebuffer(GLenum target, uint32_t fbo);
+
+	// Without a unit the texture goes to the active one, same as glBindTexture
+	static void ActiveTexture(uint32_t unit);
+	static void BindTexture(GLenum target, uint32_t texture);
+	static void BindTexture(uint32_t unit, GLenum target, uint32_t texture);
+
+	static void Enable(GLenum capability);
+	static void Disable(GLenum capability);
+	static void BlendFunc(GLenum source, GLenum destination);
+	static void BlendEquation(GLenum mode);
+	static void DepthFunc(GLenum func);
+	static void DepthMask(bool enabled);
+	static void CullFace(GLenum face);
+	static void StencilFunc(GLenum func, int32_t ref, uint32_t mask);
+	static void StencilOp(GLenum stencilFail, GLenum depthFail, GLenum pass);
+	static void StencilOpSeparate(GLenum face, GLenum stencilFail, GLenum depthFail, GLenum pass);
+	static void StencilMask(uint32_t mask);
+	static void PolygonMode(GLenum mode);
+
+	// Deleting a bound object resets its binding to 0, and a recycled name must not look bound already
+	static void ForgetProgram(uint32_t program);
+	static void ForgetVertexArray(uint32_t vao);
+	static void ForgetFramebuffer(uint32_t fbo);
+	static void ForgetTexture(uint32_t texture);
+
+	// Next change of every state goes to the driver again
+	static void Invalidate();
+
+	// Asks the driver only when the state isn't known
+	static uint32_t DrawFramebuffer();
+	static bool DepthMaskEnabled();
+
+	inline static uint32_t IssuedCalls() { return s_IssuedCalls; }
+	inline static uint32_t AvoidedCalls() { return s_AvoidedCalls; }
+	static void ResetCounters();
+
+private:
+	static constexpr uint32_t Unknown = UINT32_MAX;
+	static constexpr uint32_t TextureTargetCount = 6;
+
+	static bool Changed(uint32_t& cached, uint32_t value);
+	static int32_t TextureTargetIndex(GLenum target);
+	static void ForgetTextureBindings();
+
+	static uint32_t s_Program;
+	static uint32_t s_VertexArray;
+	static uint32_t s_ReadFramebuffer;
+	static uint32_t s_DrawFramebuffer;
+	static uint32_t s_ActiveUnit;
+	static std::vector<std::array<uint32_t, TextureTargetCount>> s_Textures;
+	static std::unordered_map<GLenum, uint32_t> s_Capabilities;
+	static uint32_t s_BlendSource;
+	static uint32_t s_BlendDestination;
+	static uint32_t s_BlendEquation;
+	static uint32_t s_DepthFunc;
+	static uint32_t s_DepthMask;
+	static uint32_t s_CullFace;
+	static uint32_t s_StencilFunc;
+	static uint32_t s_StencilRef;
+	static uint32_t s_StencilFuncMask;
+	static uint32_t s_StencilOps[2][3];
+	static uint32_t s_StencilMask;
+	static uint32_t s_PolygonMode;
+
+	static uint32_t s_IssuedCalls;
+	static uint32_t s_AvoidedCalls;
+};
+
 class VertexBuffer
 {
 public:
@@ -172,18 +251,39 @@ struct ShaderSpec
 	ShaderDescriptor Vertex;
 	ShaderDescriptor Fragment;
 	std::optional<ShaderDescriptor> Geometry;
+
+	// Builds a compute-only program, the other stages are ignored
+	std::optional<ShaderDescriptor> Compute;
+};
+
+// Index into the uniforms a shader resolved up front, stays valid when the program is relinked
+struct UniformHandle
+{
+	uint32_t Index = UINT32_MAX;
 };
 
+// Compilation is only issued on construction, the program is checked and reflected on first use or once IsReady reports it done
 class Shader
 {
 public:
 	Shader(const ShaderSpec& spec);
 	~Shader();
 
-	void Bind() const;
+	void Bind();
 	void Unbind() const;
 
+	// Compiles the sources again in the background. The current program stays in use until the new one linked and is kept if it doesn't
 	void Reload();
+	bool UsesSource(const std::string& path) const;
+
+	// Whether there's a linked program to draw with. Never waits on drivers with KHR_parallel_shader_compile,
+	// elsewhere it finishes a pending program right away
+	bool IsReady();
+
+	// Runs every time the program gets linked, right away if it already is. Meant for sampler slots and other uniforms that stay put
+	void OnLinked(std::function<void(Shader&)> setup);
+
+	static void SetParallelCompile(bool supported);
 
 	void SetUniform1i(const std::string& name, int32_t val);
 	void SetUniform1f(const std::string& name, float val);
@@ -193,15 +293,63 @@ public:
 	void SetUniformMat4(const std::string& name, const glm::mat4& vec);
 	void SetUniformBool(const std::string& name, bool flag);
 
+	// Looks the uniform up once, setting it through the handle skips the lookup by name.
+	// Asking again for a resolved name only compares it against the others, nothing is allocated
+	UniformHandle Uniform(std::string_view name);
+
+	void SetUniform1i(UniformHandle handle, int32_t val);
+	void SetUniform1f(UniformHandle handle, float val);
+	void SetUniform2f(UniformHandle handle, const glm::vec2& vec);
+	void SetUniform3f(UniformHandle handle, const glm::vec3& vec);
+	void SetUniform4f(UniformHandle handle, const glm::vec4& vec);
+	void SetUniformMat4(UniformHandle handle, const glm::mat4& mat);
+	void SetUniformBool(UniformHandle handle, bool flag);
+
+	// Whole array from its first element
+	void SetUniform1iv(UniformHandle handle, const int32_t* values, uint32_t count);
+	void SetUniform1fv(UniformHandle handle, const float* values, uint32_t count);
+	void SetUniform3fv(UniformHandle handle, const glm::vec3* values, uint32_t count);
+	void SetUniform4fv(UniformHandle handle, const glm::vec4* values, uint32_t count);
+
 private:
 	std::optional<std::string> ParseShaderSource(const std::string& path);
-	uint32_t CreateShader(const std::string& vsrc, const std::string& fsrc, std::optional<std::string> gsrc);
+	std::optional<std::string> LoadStage(const ShaderDescriptor& stage, const char* stageName);
+
+	// Issued program whose compile and link statuses weren't asked for yet
+	struct PendingProgram
+	{
+		uint32_t ID = 0;
+		std::vector<uint32_t> Stages;
+		std::string CachePath;
+		float SourceTime = 0.0f;
+		float IssueTime = 0.0f;
+	};
+
+	// Sources with their replacements applied. Returns the program when the binary cache had it, 0 when the build is pending or failed
+	uint32_t Build();
+	PendingProgram CreateShader(const std::string& vsrc, const std::string& fsrc, std::optional<std::string> gsrc);
+	PendingProgram CreateComputeShader(const std::string& csrc);
+	void LinkProgram(const PendingProgram& pending);
 	uint32_t CompileShader(uint32_t type, const std::string& source);
+
+	// Waits for the pending link, reports errors and stores the binary. Only a working program replaces the current one
+	void Finish();
+	void Swap(uint32_t program);
+	void Discard();
+	void Discard(const PendingProgram& pending);
 	int32_t UniformLocation(const std::string& name);
+	int32_t HandleLocation(UniformHandle handle) const;
+	void ReflectUniforms();
 
 	ShaderSpec m_Spec;
 	std::unordered_map<std::string, int32_t> m_UniformLocations;
+	std::vector<std::string> m_HandleNames;
+	std::vector<int32_t> m_HandleLocations;
+	std::function<void(Shader&)> m_OnLinked;
+	std::optional<PendingProgram> m_Pending;
 	uint32_t m_ID = 0;
+
+	static bool s_ParallelCompile;
 };
 
 class SharedBuffer
@@ -220,6 +368,64 @@ private:
 	uint32_t m_ID = 0;
 };
 
+// GL_TIME_ELAPSED queries in a small ring, results are read a few frames late so the CPU doesn't wait on the GPU
+class GpuTimer
+{
+public:
+	GpuTimer();
+	~GpuTimer();
+
+	void Begin();
+	void End();
+
+	// Milliseconds between the most recent finished Begin and End pair
+	inline float LastTime() const { return m_LastTime; }
+
+private:
+	static constexpr uint32_t QueryCount = 4;
+
+	uint32_t m_IDs[QueryCount]{};
+	bool m_Pending[QueryCount]{};
+	uint32_t m_Current = 0;
+	float m_LastTime = 0.0f;
+};
+
+class Framebuffer;
+
+// Ring of pack buffers, every request copies RGBA8 pixels into the next one behind a fence and they're read once the GPU got to them
+class PixelReadback
+{
+public:
+	explicit PixelReadback(uint32_t depth = 1);
+	~PixelReadback();
+
+	PixelReadback(const PixelReadback&) = delete;
+	PixelReadback& operator=(const PixelReadback&) = delete;
+
+	// With every buffer in flight the oldest read is replaced
+	void Request(const Framebuffer& fb, uint32_t attachmentIdx, const glm::ivec2& offset, const glm::ivec2& size = { 1, 1 });
+	// Never waits, true once the oldest read arrived. The pixels are resized to fit the requested rectangle
+	bool Poll(std::vector<uint8_t>& pixels);
+	bool Poll(glm::u8vec4& pixel);
+	inline bool Pending() const { return m_InFlight > 0; }
+
+private:
+	struct Slot
+	{
+		uint32_t Buffer = 0;
+		uint64_t Capacity = 0;
+		uint64_t Size = 0;
+		GLsync Fence = nullptr;
+	};
+
+	// The oldest read if it finished, it's no longer in flight afterwards
+	Slot* Arrived();
+
+	std::vector<Slot> m_Slots;
+	uint32_t m_Next = 0;
+	uint32_t m_InFlight = 0;
+};
+
 enum class RenderbufferType
 {
 	DEPTH,
@@ -242,7 +448,22 @@ enum class TextureFormat
 	RG16F,
 	RGB32F,
 	R11_G11_B10,
-	DEPTH_32F
+	DEPTH_32F,
+
+	BC1,
+	BC3,
+	BC4,
+	BC5,
+	BC6H,
+	BC7
+};
+
+// What 8-bit texels hold, it decides the space mips are filtered in. The pixel format can't tell, data maps are stored the same way colour is
+enum class MipContent
+{
+	COLOR_SRGB,	// Filtered in linear light, stored back as sRGB
+	LINEAR,
+	NORMAL_MAP	// XYZ remapped to [0, 1], renormalized after filtering
 };
 
 enum class ColorAttachmentType
@@ -295,6 +516,7 @@ public:
 	void BindColorAttachment(uint32_t attachmentIdx, uint32_t slot = 0) const;
 
 	void DrawToColorAttachment(uint32_t attachmentIdx, uint32_t targetAttachment, int32_t mip = 0) const;
+	void DrawToTexture(uint32_t textureID, uint32_t targetAttachment, int32_t mip = 0) const;
 	void DrawToDepthMap(uint32_t attachmentIdx, int32_t mip = 0) const;
 	void DrawToCubeColorAttachment(uint32_t attachmentIdx, uint32_t targetAttachment, int32_t faceIdx, int32_t mip = 0) const;
 	void ClearColorAttachment(uint32_t attachmentIdx, uint32_t mip = 0) const;
@@ -306,7 +528,6 @@ public:
 	inline const std::vector<ColorAttachment>& ColorAttachments() const { return m_ColorAttachments; }
 	inline glm::ivec2 ColorAttachmentSize(uint32_t attachmentIdx) const { return m_ColorAttachments[attachmentIdx].spec.Size; }
 	inline uint32_t GetColorAttachmentID(uint32_t attachmentIdx) const { return m_ColorAttachments[attachmentIdx].ID; }
-	glm::u8vec4 GetPixelAt(const glm::vec2& coords, int32_t attachmentIdx) const;
 	bool IsComplete() const;
 
 private:
@@ -319,11 +540,21 @@ private:
 	uint32_t m_Samples = 0;
 };
 
+// Data is only held while the level isn't resident, uploaded levels live in VRAM alone
+struct TextureLevel
+{
+	int32_t Width = 0;
+	int32_t Height = 0;
+	std::vector<uint8_t> Data;
+};
+
+class JobCounter;
+
 class Texture
 {
 public:
-	Texture(const std::string& path, TextureFormat format = TextureFormat::RGBA8);
-	Texture(const void* data, int32_t width, int32_t height, const std::string& name, TextureFormat format = TextureFormat::RGBA8);
+	Texture(const std::string& path, TextureFormat format = TextureFormat::RGBA8, MipContent content = MipContent::COLOR_SRGB);
+	Texture(const void* data, int32_t width, int32_t height, const std::string& name, TextureFormat format = TextureFormat::RGBA8, MipContent content = MipContent::COLOR_SRGB);
 	Texture(uint32_t id, const std::string& name, TextureFormat format);
 	~Texture();
 
@@ -333,24 +564,94 @@ public:
 	void Bind(uint32_t slot = 0) const;
 	void Unbind() const;
 
+	// Evicts the given count of top levels, they're read back into system memory first and uploaded again once fewer are dropped
+	void DropMips(uint32_t count);
+	inline uint32_t DroppedMips() const { return m_DroppedMips; }
+	inline uint32_t MipCount() const { return (uint32_t)m_Levels.size(); }
+	uint64_t ResidentSize(uint32_t droppedMips) const;
+	// Bytes of the dropped levels kept around to restore them
+	uint64_t EvictedSize() const;
+
+	// Levels below the base one are generated in a job, they're uploaded by the first call after it's done. Returns whether the chain is complete
+	bool FinishMips();
+	// Blocks until the mip job is done and uploads its levels
+	void WaitForMips();
+
 	inline int32_t GetWidth() const { return m_Width; }
 	inline int32_t GetHeight() const { return m_Height; }
 	inline uint32_t GetID() const { return m_ID; }
 	inline const std::string& GetPath() const { return m_Path; }
 	inline const std::string& Name() const { return m_Name; }
+	inline TextureFormat Format() const { return m_Format; }
+	inline MipContent Content() const { return m_Content; }
+
+	// Bytes taken by all mip levels, the uncompressed one being what it'd take without block compression
+	inline uint64_t VRAMSize() const { return m_VRAMSize; }
+	inline uint64_t UncompressedSize() const { return m_UncompressedSize; }
 
 	inline int32_t Filter() const { return m_Filter; }
 	inline int32_t Wrap()   const { return m_Wrap; }
 
 private:
+	void UploadBaseAndQueueMips(const void* data);
+	void UploadLevels();
+	void UploadLevel(uint32_t level);
+	void DownloadLevel(uint32_t level);
+	void ReleaseLevel(uint32_t level);
+	uint64_t LevelSize(uint32_t level) const;
+
 	uint32_t m_ID	  = 0;
 	int32_t	 m_Width  = 0;
 	int32_t	 m_Height = 0;
 	int32_t	 m_BPP	  = 0;
 
+	TextureFormat m_Format = TextureFormat::RGBA8;
+	MipContent m_Content = MipContent::COLOR_SRGB;
+	uint64_t m_VRAMSize = 0;
+	uint64_t m_UncompressedSize = 0;
+
+	std::vector<TextureLevel> m_Levels;
+	uint32_t m_DroppedMips = 0;
+
+	// Written by the mip job, only read once its counter is done
+	std::unique_ptr<JobCounter> m_MipJob;
+	std::vector<TextureLevel> m_PendingLevels;
+
 	int32_t m_Filter = GL_LINEAR;
 	int32_t m_Wrap   = GL_REPEAT;
 	
 	std::string	m_Path;
 	std::string m_Name;
+};
+
+// 2D textures without mips, clamped and linearly filtered. A released texture goes to the next request of the same size and format
+class TexturePool
+{
+public:
+	TexturePool() = default;
+	~TexturePool();
+
+	uint32_t Acquire(const glm::ivec2& size, TextureFormat format);
+	void Release(uint32_t textureID);
+
+	// Deletes textures that weren't acquired in the last maxIdleFrames frames
+	void NextFrame(uint32_t maxIdleFrames = 8);
+
+	static uint64_t TextureSize(const glm::ivec2& size, TextureFormat format);
+	inline uint64_t VRAMSize() const { return m_VRAMSize; }
+	inline uint32_t TextureCount() const { return (uint32_t)m_Textures.size(); }
+
+private:
+	struct PooledTexture
+	{
+		uint32_t ID = 0;
+		glm::ivec2 Size{ 0 };
+		TextureFormat Format = TextureFormat::RGBA8;
+		bool InUse = false;
+		uint64_t LastUsedFrame = 0;
+	};
+
+	std::vector<PooledTexture> m_Textures;
+	uint64_t m_Frame = 0;
+	uint64_t m_VRAMSize = 0;
 };
\ No newline at end of file
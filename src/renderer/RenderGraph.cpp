@@ -0,0 +1,347 @@
+#include "RenderGraph.hpp"
+
+#include <queue>
+#include <cassert>
+#include <algorithm>
+
+RenderGraphBuilder::RenderGraphBuilder(RenderGraph& graph, uint32_t pass)
+	: m_Graph(graph), m_Pass(pass)
+{
+}
+
+RenderGraphResource RenderGraphBuilder::Create(const std::string& name, const RenderGraphTextureDesc& desc)
+{
+	RenderGraph::ResourceData& resource = m_Graph.m_Resources.emplace_back();
+	resource.Name = name;
+	resource.Desc = desc;
+
+	RenderGraphResource handle = m_Graph.AddVersion((uint32_t)m_Graph.m_Resources.size() - 1, m_Pass);
+	m_Graph.m_Passes[m_Pass].Outputs.push_back(handle);
+
+	return handle;
+}
+
+RenderGraphResource RenderGraphBuilder::Read(RenderGraphResource resource)
+{
+	assert(resource < m_Graph.m_Versions.size() && "Reading a resource that doesn't exist");
+	m_Graph.m_Passes[m_Pass].Inputs.push_back(resource);
+
+	return resource;
+}
+
+RenderGraphResource RenderGraphBuilder::Write(RenderGraphResource resource)
+{
+	assert(resource < m_Graph.m_Versions.size() && "Writing a resource that doesn't exist");
+
+	uint32_t index = m_Graph.m_Versions[resource].Resource;
+	assert(m_Graph.m_Resources[index].Latest == resource && "Only the latest version of a resource can be written");
+
+	m_Graph.m_Passes[m_Pass].Inputs.push_back(resource);
+	RenderGraphResource handle = m_Graph.AddVersion(index, m_Pass);
+	m_Graph.m_Versions[handle].Previous = resource;
+	m_Graph.m_Passes[m_Pass].Outputs.push_back(handle);
+
+	return handle;
+}
+
+void RenderGraphBuilder::SideEffect()
+{
+	m_Graph.m_Passes[m_Pass].SideEffect = true;
+}
+
+uint32_t RenderGraph::AddPass(const std::string& name, const SetupFunc& setup, const ExecuteFunc& execute)
+{
+	uint32_t index = (uint32_t)m_Passes.size();
+	PassData& pass = m_Passes.emplace_back();
+	pass.Name = name;
+	pass.Execute = execute;
+
+	RenderGraphBuilder builder(*this, index);
+	setup(builder);
+	m_Compiled = false;
+
+	return index;
+}
+
+RenderGraphResource RenderGraph::Import(const std::string& name, uint32_t textureID, const RenderGraphTextureDesc& desc)
+{
+	ResourceData& resource = m_Resources.emplace_back();
+	resource.Name = name;
+	resource.Desc = desc;
+	resource.Imported = true;
+	resource.TextureID = textureID;
+
+	return AddVersion((uint32_t)m_Resources.size() - 1, NoPass);
+}
+
+void RenderGraph::Export(RenderGraphResource resource)
+{
+	m_Versions[resource].Exported = true;
+	m_Resources[m_Versions[resource].Resource].Exported = true;
+	m_Compiled = false;
+}
+
+RenderGraphResource RenderGraph::AddVersion(uint32_t resource, uint32_t producer)
+{
+	m_Versions.push_back({ resource, producer });
+	m_Resources[resource].Latest = (RenderGraphResource)m_Versions.size() - 1;
+
+	return m_Resources[resource].Latest;
+}
+
+void RenderGraph::Compile()
+{
+	// Culling, walking back from exported resources and passes that are visible outside the graph
+	std::vector<uint32_t> pending;
+	auto keep = [&](uint32_t pass)
+		{
+			if (pass != NoPass && m_Passes[pass].Culled)
+			{
+				m_Passes[pass].Culled = false;
+				pending.push_back(pass);
+			}
+		};
+
+	for (PassData& pass : m_Passes)
+	{
+		pass.Culled = true;
+	}
+
+	for (const Version& version : m_Versions)
+	{
+		if (version.Exported)
+		{
+			keep(version.Producer);
+		}
+	}
+
+	for (uint32_t i = 0; i < m_Passes.size(); i++)
+	{
+		bool writesImported = std::any_of(m_Passes[i].Outputs.begin(), m_Passes[i].Outputs.end(),
+			[&](RenderGraphResource output) { return m_Resources[m_Versions[output].Resource].Imported; });
+
+		if (m_Passes[i].SideEffect || writesImported)
+		{
+			keep(i);
+		}
+	}
+
+	while (!pending.empty())
+	{
+		uint32_t pass = pending.back();
+		pending.pop_back();
+		for (RenderGraphResource input : m_Passes[pass].Inputs)
+		{
+			keep(m_Versions[input].Producer);
+		}
+	}
+
+	// Ordering, a pass runs after the producers of what it reads and before anything overwrites what it read
+	std::vector<std::vector<uint32_t>> readers(m_Versions.size());
+	for (uint32_t i = 0; i < m_Passes.size(); i++)
+	{
+		for (RenderGraphResource input : m_Passes[i].Inputs)
+		{
+			if (!m_Passes[i].Culled)
+			{
+				readers[input].push_back(i);
+			}
+		}
+	}
+
+	std::vector<std::vector<uint32_t>> edges(m_Passes.size());
+	std::vector<uint32_t> dependencies(m_Passes.size(), 0);
+	auto addEdge = [&](uint32_t from, uint32_t to)
+		{
+			if (from != NoPass && from != to && !m_Passes[from].Culled)
+			{
+				edges[from].push_back(to);
+				dependencies[to]++;
+			}
+		};
+
+	for (uint32_t i = 0; i < m_Passes.size(); i++)
+	{
+		if (m_Passes[i].Culled)
+		{
+			continue;
+		}
+
+		for (RenderGraphResource input : m_Passes[i].Inputs)
+		{
+			addEdge(m_Versions[input].Producer, i);
+		}
+
+		for (RenderGraphResource output : m_Passes[i].Outputs)
+		{
+			if (m_Versions[output].Previous != UINT32_MAX)
+			{
+				for (uint32_t reader : readers[m_Versions[output].Previous])
+				{
+					addEdge(reader, i);
+				}
+			}
+		}
+	}
+
+	// Declaration order breaks ties, so the same graph always runs the same way
+	std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> ready;
+	for (uint32_t i = 0; i < m_Passes.size(); i++)
+	{
+		if (!m_Passes[i].Culled && dependencies[i] == 0)
+		{
+			ready.push(i);
+		}
+	}
+
+	m_Order.clear();
+	while (!ready.empty())
+	{
+		uint32_t pass = ready.top();
+		ready.pop();
+		m_Order.push_back(pass);
+
+		for (uint32_t next : edges[pass])
+		{
+			if (--dependencies[next] == 0)
+			{
+				ready.push(next);
+			}
+		}
+	}
+	assert(std::count_if(m_Passes.begin(), m_Passes.end(), [](const PassData& pass) { return !pass.Culled; }) == (int64_t)m_Order.size() && "Render graph has a cycle");
+
+	// Lifetimes in execution order, then the first free physical texture with a matching description
+	constexpr uint32_t UNUSED = UINT32_MAX;
+	std::vector<uint32_t> first(m_Resources.size(), UNUSED);
+	std::vector<uint32_t> last(m_Resources.size(), 0);
+	for (uint32_t position = 0; position < m_Order.size(); position++)
+	{
+		const PassData& pass = m_Passes[m_Order[position]];
+		for (const std::vector<RenderGraphResource>* handles : { &pass.Inputs, &pass.Outputs })
+		{
+			for (RenderGraphResource handle : *handles)
+			{
+				uint32_t resource = m_Versions[handle].Resource;
+				first[resource] = std::min(first[resource], position);
+				last[resource] = std::max(last[resource], position);
+			}
+		}
+	}
+
+	m_Physical.clear();
+	for (uint32_t position = 0; position < m_Order.size(); position++)
+	{
+		for (uint32_t i = 0; i < m_Resources.size(); i++)
+		{
+			ResourceData& resource = m_Resources[i];
+			if (resource.Imported || first[i] != position)
+			{
+				continue;
+			}
+
+			auto physical = std::find_if(m_Physical.begin(), m_Physical.end(),
+				[&](const PhysicalData& physical) { return !physical.Exported && physical.Last < position && physical.Desc == resource.Desc; });
+
+			if (physical == m_Physical.end())
+			{
+				m_Physical.push_back({ resource.Desc, position });
+				physical = m_Physical.end() - 1;
+			}
+
+			physical->Last = resource.Exported ? (uint32_t)m_Order.size() : last[i];
+			physical->Exported = resource.Exported;
+			resource.Physical = (int32_t)(physical - m_Physical.begin());
+		}
+	}
+
+	for (uint32_t i = 0; i < m_Resources.size(); i++)
+	{
+		if (first[i] == UNUSED)
+		{
+			m_Resources[i].Physical = -1;
+		}
+	}
+
+	m_Compiled = true;
+}
+
+void RenderGraph::Execute(TexturePool& pool)
+{
+	if (!m_Compiled)
+	{
+		Compile();
+	}
+
+	for (uint32_t position = 0; position < m_Order.size(); position++)
+	{
+		for (PhysicalData& physical : m_Physical)
+		{
+			if (physical.First == position)
+			{
+				physical.TextureID = pool.Acquire(physical.Desc.Size, physical.Desc.Format);
+			}
+		}
+
+		m_Passes[m_Order[position]].Execute(*this);
+
+		for (PhysicalData& physical : m_Physical)
+		{
+			if (physical.Last == position && !physical.Exported)
+			{
+				pool.Release(physical.TextureID);
+			}
+		}
+	}
+}
+
+uint32_t RenderGraph::Texture(RenderGraphResource resource) const
+{
+	const ResourceData& data = m_Resources[m_Versions[resource].Resource];
+	if (data.Imported)
+	{
+		return data.TextureID;
+	}
+
+	return data.Physical >= 0 ? m_Physical[data.Physical].TextureID : 0;
+}
+
+const RenderGraphTextureDesc& RenderGraph::Desc(RenderGraphResource resource) const
+{
+	return m_Resources[m_Versions[resource].Resource].Desc;
+}
+
+bool RenderGraph::IsCulled(uint32_t pass) const
+{
+	return m_Passes[pass].Culled;
+}
+
+int32_t RenderGraph::PhysicalTexture(RenderGraphResource resource) const
+{
+	return m_Resources[m_Versions[resource].Resource].Physical;
+}
+
+uint64_t RenderGraph::TransientMemory() const
+{
+	uint64_t size = 0;
+	for (const PhysicalData& physical : m_Physical)
+	{
+		size += TexturePool::TextureSize(physical.Desc.Size, physical.Desc.Format);
+	}
+
+	return size;
+}
+
+uint64_t RenderGraph::UnaliasedMemory() const
+{
+	uint64_t size = 0;
+	for (const ResourceData& resource : m_Resources)
+	{
+		if (resource.Physical >= 0)
+		{
+			size += TexturePool::TextureSize(resource.Desc.Size, resource.Desc.Format);
+		}
+	}
+
+	return size;
+}
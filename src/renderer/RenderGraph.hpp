@@ -0,0 +1,128 @@
+#pragma once
+
+#include "OpenGL.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+
+// Handle to one version of a resource, every write produces a new one
+using RenderGraphResource = uint32_t;
+
+struct RenderGraphTextureDesc
+{
+	glm::ivec2 Size{ 0 };
+	TextureFormat Format = TextureFormat::RGBA8;
+
+	bool operator==(const RenderGraphTextureDesc&) const = default;
+};
+
+class RenderGraph;
+
+class RenderGraphBuilder
+{
+public:
+	// Transient texture, taken from the pool right before its first pass and given back after its last one
+	RenderGraphResource Create(const std::string& name, const RenderGraphTextureDesc& desc);
+	RenderGraphResource Read(RenderGraphResource resource);
+
+	// Keeps the previous contents, so the pass also depends on whoever wrote them
+	RenderGraphResource Write(RenderGraphResource resource);
+
+	// Pass is never culled, for passes whose results leave the graph some other way
+	void SideEffect();
+
+private:
+	friend class RenderGraph;
+	RenderGraphBuilder(RenderGraph& graph, uint32_t pass);
+
+	RenderGraph& m_Graph;
+	uint32_t m_Pass = 0;
+};
+
+// Passes declare what they read and write during setup. Compile culls the passes nothing depends on, orders the rest
+// and gives transient textures with disjoint lifetimes the same physical texture when their descriptions match
+class RenderGraph
+{
+public:
+	using SetupFunc = std::function<void(RenderGraphBuilder&)>;
+	using ExecuteFunc = std::function<void(const RenderGraph&)>;
+
+	uint32_t AddPass(const std::string& name, const SetupFunc& setup, const ExecuteFunc& execute);
+	RenderGraphResource Import(const std::string& name, uint32_t textureID, const RenderGraphTextureDesc& desc);
+
+	// Contents are used after the graph ran, its texture stays acquired until the caller gives it back to the pool
+	void Export(RenderGraphResource resource);
+
+	void Compile();
+	void Execute(TexturePool& pool);
+
+	// Valid inside the pass execution, and afterwards for exported and imported resources
+	uint32_t Texture(RenderGraphResource resource) const;
+	const RenderGraphTextureDesc& Desc(RenderGraphResource resource) const;
+
+	bool IsCulled(uint32_t pass) const;
+	inline const std::vector<uint32_t>& ExecutionOrder() const { return m_Order; }
+	inline const std::string& PassName(uint32_t pass) const { return m_Passes[pass].Name; }
+
+	// Physical texture index of a transient resource, -1 when imported or never used by a pass that survived culling
+	int32_t PhysicalTexture(RenderGraphResource resource) const;
+	inline uint32_t PhysicalTextureCount() const { return (uint32_t)m_Physical.size(); }
+
+	// Bytes taken by the physical textures, and what the transient resources would take without aliasing
+	uint64_t TransientMemory() const;
+	uint64_t UnaliasedMemory() const;
+
+private:
+	friend class RenderGraphBuilder;
+
+	static constexpr uint32_t NoPass = UINT32_MAX;
+
+	struct ResourceData
+	{
+		std::string Name;
+		RenderGraphTextureDesc Desc;
+		bool Imported = false;
+		bool Exported = false;
+		uint32_t TextureID = 0;
+		int32_t Physical = -1;
+		RenderGraphResource Latest = 0;
+	};
+
+	struct Version
+	{
+		uint32_t Resource = 0;
+		uint32_t Producer = NoPass;
+		RenderGraphResource Previous = UINT32_MAX;
+		bool Exported = false;
+	};
+
+	struct PassData
+	{
+		std::string Name;
+		ExecuteFunc Execute;
+		std::vector<RenderGraphResource> Inputs;
+		std::vector<RenderGraphResource> Outputs;
+		bool SideEffect = false;
+		bool Culled = true;
+	};
+
+	struct PhysicalData
+	{
+		RenderGraphTextureDesc Desc;
+		uint32_t First = 0;
+		uint32_t Last = 0;
+		bool Exported = false;
+		uint32_t TextureID = 0;
+	};
+
+	RenderGraphResource AddVersion(uint32_t resource, uint32_t producer);
+
+	std::vector<ResourceData> m_Resources;
+	std::vector<Version> m_Versions;
+	std::vector<PassData> m_Passes;
+	std::vector<PhysicalData> m_Physical;
+	std::vector<uint32_t> m_Order;
+	bool m_Compiled = false;
+};
@@ -5,9 +5,14 @@
 #include "Camera.hpp"
 #include "PrimitivesGen.hpp"
 #include "AssetManager.hpp"
+#include "TextureResidency.hpp"
+#include "VirtualTexture.hpp"
+#include "IBLCache.hpp"
 #include "../RandomUtils.hpp"
 #include "../Application.hpp"
+#include "../FileWatcher.hpp"
 
+#include <algorithm>
 #include <random>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -50,6 +55,34 @@ struct LineVertex
 	glm::vec4 Color;
 };
 
+// Features Default.frag and GBuf.frag skip when a material doesn't use them, each combination compiles into its own program
+enum MaterialFeature : uint32_t
+{
+	MATERIAL_PARALLAX	  = 1 << 0,
+	MATERIAL_NORMAL_MAP	  = 1 << 1,
+	MATERIAL_PBR_TEXTURES = 1 << 2,
+
+	MATERIAL_ALL_FEATURES = (1 << 3) - 1
+};
+
+static constexpr uint32_t MaterialVariants = MATERIAL_ALL_FEATURES + 1;
+
+// Image based lighting values of the last created environment, uploaded again only when they change
+struct EnvironmentUniforms
+{
+	UniformHandle UseIrradianceSH;
+	UniformHandle IrradianceSH;
+	uint32_t Version = 0; // Of the environment last uploaded, 0 until the first upload and after relinks
+};
+
+// Set on every flush, so they're resolved once when the variant is created
+struct VariantUniforms
+{
+	UniformHandle CascadeDistances;
+	VirtualTextureUniforms VirtualTextures;
+	EnvironmentUniforms Environment;
+};
+
 struct MeshInstance
 {
 	glm::mat4 Transform;
@@ -60,7 +93,9 @@ struct MeshInstance
 struct MeshBufferData
 {
 	int32_t CurrentInstancesCount = 0;
-	std::vector<MeshInstance> Instances;
+
+	// Bucketed by the features of their material, uploaded back to back in the order of the buckets
+	std::array<std::vector<MeshInstance>, MaterialVariants> Instances;
 };
 
 struct DirLightBufferData
@@ -114,7 +149,7 @@ struct MaterialsBufferData
 	int32_t AmbientOccTextureSlot;
 	float AmbientOccFactor;
 
-	float Padding;
+	int32_t VirtualTextureID;
 };
 
 struct CameraBufferData
@@ -138,7 +173,8 @@ static bool MaterialToBufferCmp(const Material& lhs, const MaterialsBufferData&
 		&& lhs.IsDepthMap == rhs.IsDepthMap
 		&& lhs.RoughnessFactor == rhs.RoughnessFactor
 		&& lhs.MetallicFactor == rhs.MetallicFactor
-		&& lhs.AmbientOccFactor == rhs.AmbientOccFactor;
+		&& lhs.AmbientOccFactor == rhs.AmbientOccFactor
+		&& lhs.VirtualTextureID == rhs.VirtualTextureID;
 }
 
 static MaterialsBufferData MaterialToBuffer(const Material& material)
@@ -153,10 +189,56 @@ static MaterialsBufferData MaterialToBuffer(const Material& material)
 	mbd.RoughnessFactor = material.RoughnessFactor;
 	mbd.MetallicFactor = material.MetallicFactor;
 	mbd.AmbientOccFactor = material.AmbientOccFactor;
+	mbd.VirtualTextureID = material.VirtualTextureID;
 
 	return mbd;
 }
 
+// Default textures are 1x1 and read the same everywhere, their features are left out
+static uint32_t MaterialFeatures(const Material& material)
+{
+	uint32_t features = 0;
+	if (material.HeightFactor != 0.0f)
+	{
+		features |= MATERIAL_PARALLAX;
+	}
+
+	if (material.NormalTextureID != AssetManager::TEXTURE_NORMAL)
+	{
+		features |= MATERIAL_NORMAL_MAP;
+	}
+
+	if (material.RoughnessTextureID != AssetManager::TEXTURE_WHITE
+		|| material.MetallicTextureID != AssetManager::TEXTURE_WHITE
+		|| material.AmbientOccTextureID != AssetManager::TEXTURE_WHITE)
+	{
+		features |= MATERIAL_PBR_TEXTURES;
+	}
+
+	return features;
+}
+
+static std::string MaterialDefines(uint32_t features)
+{
+	std::string defines;
+	if (features & MATERIAL_PARALLAX)
+	{
+		defines += "#define PARALLAX\n";
+	}
+
+	if (features & MATERIAL_NORMAL_MAP)
+	{
+		defines += "#define NORMAL_MAP\n";
+	}
+
+	if (features & MATERIAL_PBR_TEXTURES)
+	{
+		defines += "#define PBR_TEXTURES\n";
+	}
+
+	return defines;
+}
+
 struct GpuSpecs
 {
 	uint32_t MaxTextureUnits = 64;
@@ -180,8 +262,25 @@ struct RendererData
 	int32_t PrefilterSlot = -1;
 	int32_t BRDF_Slot = -1;
 
+	// Diffuse IBL term, either the convolved cubemap or its SH9 projection
+	static constexpr int32_t IrradianceSize = 32;
+	static constexpr float IrradianceSHSourceSize = 64.0f;
+	SH9 IrradianceSH{};
+	bool UseIrradianceSH = false;
+	// Bumped whenever the environment or the SH toggle changes
+	uint32_t EnvironmentVersion = 1;
+
+	// Roughness 1 lands on the last mip, which the shaders' MAX_REFL_LOD expects to be the 8th
+	static constexpr uint32_t PrefilterSize = 128;
+	static constexpr int32_t PrefilterSamples = 64;
+
 	int32_t OffsetsSlot = -1;
 
+	int32_t VirtualPageTableSlot = -1;
+	int32_t VirtualPhysicalSlot = -1;
+	bool UsesVirtualTextures = false;
+	bool DrawFeedback = true;
+
 	int32_t MaxMaterials = 32;
 
 	int32_t MaxDirLights = 4;
@@ -194,6 +293,10 @@ struct RendererData
 	uint32_t InstancesCount = 0;
 	std::unordered_map<int32_t, MeshBufferData> MeshesData;
 
+	// Material slots looked up by merged submission stay valid until the batch changes
+	uint32_t Batch = 0;
+	std::vector<std::pair<uint64_t, const MeshCommand*>> SortedCommands;
+
 	std::shared_ptr<VertexArray>  ScreenQuadVertexArray;
 	std::shared_ptr<VertexBuffer> ScreenQuadVertexBuffer;
 	std::shared_ptr<Shader>		  ScreenQuadShader;
@@ -206,9 +309,44 @@ struct RendererData
 	std::shared_ptr<Shader>		  SkyboxShader;
 	std::shared_ptr<Texture>	  BRDF_Map;
 
+	std::shared_ptr<TexturePool> TransientTextures;
+
 	std::shared_ptr<Framebuffer> BloomFBO;
 	std::shared_ptr<Shader> BloomDownsamplerShader;
 	std::shared_ptr<Shader> BloomUpsamplerShader;
+	UniformHandle BloomDownsamplerResolution;
+	UniformHandle BloomDownsamplerFirstMip;
+	UniformHandle BloomDownsamplerThreshold;
+	UniformHandle ScreenQuadBloomStrength;
+
+	// Chain starts at half the HDR target and is rebuilt when that changes. The compute path binds every level as an image,
+	// and 8 is the least GL_MAX_COMPUTE_IMAGE_UNIFORMS an implementation can have
+	static constexpr uint32_t BloomMaxMips = 8;
+	static constexpr int32_t BloomMinMipSize = 8;
+	glm::ivec2 BloomSourceSize{ 0 };
+	std::vector<glm::ivec2> BloomMipSizes;
+	uint64_t BloomMemory = 0;
+
+	// Bloom result of the last frame, held until the next bloom pass runs
+	uint32_t BloomTexture = 0;
+
+	// Whole downsample chain in one dispatch, the upsample in one dispatch per level above the fused size
+	static constexpr int32_t BloomFusedUpsampleSize = 32;
+	static constexpr float BloomFilterRadius = 0.005f;
+	std::shared_ptr<Shader> BloomDownsampleComputeShader;
+	std::shared_ptr<Shader> BloomUpsampleComputeShader;
+	UniformHandle BloomComputeResolution;
+	UniformHandle BloomComputeMipCount;
+	UniformHandle BloomComputeThreshold;
+	UniformHandle BloomUpsampleFused;
+	UniformHandle BloomUpsampleSourceMip;
+	UniformHandle BloomUpsampleTargetMip;
+	std::shared_ptr<SharedBuffer> BloomCounterBuffer;
+	bool ComputeBloom = false;
+	float BloomThreshold = 1.0f;
+
+	std::shared_ptr<GpuTimer> BloomFragmentTimer;
+	std::shared_ptr<GpuTimer> BloomComputeTimer;
 
 	std::shared_ptr<VertexArray>  LineVertexArray;
 	std::shared_ptr<VertexBuffer> LineVertexBuffer;
@@ -217,7 +355,10 @@ struct RendererData
 	LineVertex* LineBufferBase  = nullptr;
 	LineVertex* LineBufferPtr   = nullptr;
 
+	// DefaultShader has every material feature and draws the variants that are still compiling
 	std::shared_ptr<Shader>	DefaultShader;
+	std::array<std::shared_ptr<Shader>, MaterialVariants> DefaultVariants;
+	std::array<VariantUniforms, MaterialVariants> DefaultVariantUniforms;
 	std::shared_ptr<Shader> FlatShader;
 	std::shared_ptr<Shader> CurrentShader;
 
@@ -246,10 +387,21 @@ struct RendererData
 
 	std::unique_ptr<Framebuffer> G_FBO;
 	std::shared_ptr<Shader> G_PassShader;
+	std::array<std::shared_ptr<Shader>, MaterialVariants> G_PassVariants;
+	std::array<VariantUniforms, MaterialVariants> G_PassVariantUniforms;
 	std::shared_ptr<Shader> G_LightShader;
 	std::shared_ptr<Shader> G_PointLightShader;
 	std::shared_ptr<Shader> G_PassThrough;
 
+	// Set on every flush, so they're resolved once when the shaders are created
+	UniformHandle G_LightCascadeDistances;
+	UniformHandle G_PointLightTransform;
+	UniformHandle G_PointLightID;
+	UniformHandle G_PassThroughTransform;
+	EnvironmentUniforms G_LightEnvironment;
+
+	std::unique_ptr<FileWatcher> ShaderWatcher;
+
 	RenderMode RenderMode = RenderMode::FORWARD;
 };
 
@@ -273,7 +425,9 @@ static void PrintDriversInfo()
 	s_Data.PrefilterSlot = data - 3;
 	s_Data.BRDF_Slot = data - 2;
 	s_Data.OffsetsSlot = data - 1;
-	s_Data.TextureBindings.resize((size_t)data - 8);
+	s_Data.VirtualPageTableSlot = data - 9;
+	s_Data.VirtualPhysicalSlot = data - 8;
+	s_Data.TextureBindings.resize((size_t)data - 9);
 
 	GLCall(glGetIntegerv(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &data));
 	LOG_INFO("Max SSBO size:\t{} bytes", data);
@@ -292,6 +446,178 @@ static void PrintDriversInfo()
 
 	GLCall(glGetIntegerv(GL_MAX_VERTEX_UNIFORM_VECTORS, &data));
 	LOG_INFO("Max uniform array size:\t{}", data);
+
+	bool parallelCompile = false;
+	GLCall(glGetIntegerv(GL_NUM_EXTENSIONS, &data));
+	for (int32_t i = 0; i < data; i++)
+	{
+		GLCall(const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i));
+		parallelCompile |= strcmp(extension, "GL_KHR_parallel_shader_compile") == 0 || strcmp(extension, "GL_ARB_parallel_shader_compile") == 0;
+	}
+	LOG_INFO("Parallel shader compile:\t{}", parallelCompile);
+	Shader::SetParallelCompile(parallelCompile);
+}
+
+// Image based lighting inputs shared by the forward and deferred lighting shaders, the samplers stay put
+static void SetEnvironmentSamplers(Shader& shader)
+{
+	shader.SetUniform1i("u_IrradianceMap", s_Data.IrradianceSlot);
+	shader.SetUniform1i("u_PrefilterMap", s_Data.PrefilterSlot);
+	shader.SetUniform1i("u_BRDF_LUT", s_Data.BRDF_Slot);
+}
+
+static EnvironmentUniforms ResolveEnvironmentUniforms(Shader& shader)
+{
+	return { shader.Uniform("u_UseIrradianceSH"), shader.Uniform("u_IrradianceSH") };
+}
+
+static void UploadEnvironment(Shader& shader, EnvironmentUniforms& uniforms)
+{
+	if (uniforms.Version == s_Data.EnvironmentVersion)
+	{
+		return;
+	}
+
+	shader.Bind();
+	shader.SetUniformBool(uniforms.UseIrradianceSH, s_Data.UseIrradianceSH);
+	shader.SetUniform3fv(uniforms.IrradianceSH, s_Data.IrradianceSH.data(), (uint32_t)s_Data.IrradianceSH.size());
+	uniforms.Version = s_Data.EnvironmentVersion;
+}
+
+static std::shared_ptr<Shader> CreateDefaultShader(uint32_t features)
+{
+	ShaderSpec spec{};
+	spec.Vertex	  = { "resources/shaders/Default.vert", {} };
+	spec.Fragment = { 
+		"resources/shaders/Default.frag",
+		{
+			{ "${MATERIAL_FEATURES}",	MaterialDefines(features)					 },
+			{ "${MATERIALS_COUNT}",		std::to_string(s_Data.MaxMaterials)			 },
+			{ "${TEXTURE_UNITS}",		std::to_string(s_Data.Specs.MaxTextureUnits) },
+			{ "${MAX_DIR_LIGHTS}",		std::to_string(s_Data.MaxDirLights)			 },
+			{ "${MAX_POINT_LIGHTS}",	std::to_string(s_Data.MaxPointLights)		 },
+			{ "${MAX_SPOTLIGHTS}",		std::to_string(s_Data.MaxSpotlights)		 },
+			{ "${CASCADES_COUNT}",		std::to_string(s_Data.CascadesCount)		 },
+			{ "${MAX_VIRTUAL_TEXTURES}",	std::to_string(VirtualTexturing::MAX_VIRTUAL_TEXTURES) }
+		}
+	};
+	std::shared_ptr<Shader> shader = std::make_shared<Shader>(spec);
+	shader->OnLinked([features](Shader& shader)
+		{
+			shader.Bind();
+			for (int32_t i = 0; i < s_Data.TextureBindings.size(); i++)
+			{
+				shader.SetUniform1i("u_Textures[" + std::to_string(i) + "]", i);
+			}
+			shader.SetUniform1i("u_DirLightCSM", s_Data.CSM_Slot);
+			shader.SetUniform1i("u_PointLightShadowmaps", s_Data.PointShadowSlot);
+			shader.SetUniform1i("u_SpotlightShadowmaps", s_Data.SpotlightShadowSlot);
+			shader.SetUniform1i("u_OffsetsTexSize", 16);
+			shader.SetUniform1i("u_OffsetsFilterSize", 8);
+			shader.SetUniform1f("u_OffsetsRadius", s_Data.OffsetsRadius);
+			shader.SetUniform1i("u_OffsetsTexture", s_Data.OffsetsSlot);
+			shader.SetUniform1i("u_VirtualPageTable", s_Data.VirtualPageTableSlot);
+			shader.SetUniform1i("u_VirtualPhysical", s_Data.VirtualPhysicalSlot);
+			SetEnvironmentSamplers(shader);
+
+			// A relinked program lost its values, the next skybox draw uploads them
+			s_Data.DefaultVariantUniforms[features].Environment.Version = 0;
+		});
+	s_Data.DefaultVariantUniforms[features] = {
+		shader->Uniform("u_CascadeDistances"),
+		VirtualTexturing::ResolveUniforms(*shader),
+		ResolveEnvironmentUniforms(*shader)
+	};
+
+	return shader;
+}
+
+static std::shared_ptr<Shader> CreateG_PassShader(uint32_t features)
+{
+	ShaderSpec spec{};
+	spec.Vertex = {
+		"resources/shaders/deferred/GBuf.vert", {}
+	};
+	spec.Fragment = {
+		"resources/shaders/deferred/GBuf.frag",
+		{
+			{ "${MATERIAL_FEATURES}",	 MaterialDefines(features)								},
+			{ "${MATERIALS_COUNT}",		 std::to_string(s_Data.MaxMaterials)					},
+			{ "${TEXTURE_UNITS}",		 std::to_string(s_Data.Specs.MaxTextureUnits)			},
+			{ "${MAX_VIRTUAL_TEXTURES}", std::to_string(VirtualTexturing::MAX_VIRTUAL_TEXTURES) }
+		}
+	};
+	std::shared_ptr<Shader> shader = std::make_shared<Shader>(spec);
+	shader->OnLinked([](Shader& shader)
+		{
+			shader.Bind();
+			for (int32_t i = 0; i < s_Data.TextureBindings.size(); i++)
+			{
+				shader.SetUniform1i("u_Textures[" + std::to_string(i) + "]", i);
+			}
+			shader.SetUniform1i("u_VirtualPageTable", s_Data.VirtualPageTableSlot);
+			shader.SetUniform1i("u_VirtualPhysical", s_Data.VirtualPhysicalSlot);
+		});
+	s_Data.G_PassVariantUniforms[features] = { {}, VirtualTexturing::ResolveUniforms(*shader) };
+
+	return shader;
+}
+
+// Compiles the variant the first time a material asks for it
+static void RequestVariant(std::array<std::shared_ptr<Shader>, MaterialVariants>& variants, uint32_t features, std::shared_ptr<Shader>(*create)(uint32_t))
+{
+	if (variants[features] == nullptr)
+	{
+		variants[features] = create(features);
+	}
+}
+
+// The program with every feature draws the variant's instances until its own one is linked
+static const std::shared_ptr<Shader>& ReadyVariant(const std::array<std::shared_ptr<Shader>, MaterialVariants>& variants, uint32_t features)
+{
+	const std::shared_ptr<Shader>& variant = variants[features];
+	if (variant != nullptr && variant->IsReady())
+	{
+		return variant;
+	}
+
+	return variants[MATERIAL_ALL_FEATURES];
+}
+
+static void RequestMaterialVariant(uint32_t features)
+{
+	if (s_Data.RenderMode == RenderMode::FORWARD)
+	{
+		RequestVariant(s_Data.DefaultVariants, features, CreateDefaultShader);
+	}
+	else if (s_Data.RenderMode == RenderMode::DEFERRED && s_Data.G_PassShader != nullptr)
+	{
+		RequestVariant(s_Data.G_PassVariants, features, CreateG_PassShader);
+	}
+}
+
+static void UploadInstances(const Mesh& mesh, const MeshBufferData& data)
+{
+	uint32_t offset = 0;
+	for (const std::vector<MeshInstance>& instances : data.Instances)
+	{
+		if (!instances.empty())
+		{
+			mesh.InstanceBuffer->SetData(instances.data(), (uint32_t)(instances.size() * sizeof(MeshInstance)), offset);
+			offset += (uint32_t)(instances.size() * sizeof(MeshInstance));
+		}
+	}
+}
+
+static void AddInstance(MeshBufferData& meshData, const glm::mat4& transform, int32_t entityID, int32_t materialIdx, uint32_t features)
+{
+	MeshInstance& instance = meshData.Instances[features].emplace_back();
+	instance.Transform = transform;
+	instance.EntityID = (float)entityID + 1.0f;
+	instance.MaterialSlot = (float)materialIdx;
+	meshData.CurrentInstancesCount++;
+	s_Data.InstancesCount++;
+	s_Data.Stats.ObjectsRendered++;
 }
 
 static Mesh GenerateMeshData(VertexData vertexData)
@@ -329,25 +655,25 @@ void Renderer::Init()
 	FUNC_PROFILE();
 
 #ifdef CONF_DEBUG
-	GLCall(glEnable(GL_DEBUG_OUTPUT));
-	GLCall(glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS));
+	GLState::Enable(GL_DEBUG_OUTPUT);
+	GLState::Enable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
 	GLCall(glDebugMessageCallback(OpenGLMessageCallback, nullptr));
 	GLCall(glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, NULL, GL_FALSE));
 #endif
 
-	GLCall(glEnable(GL_DEPTH_TEST));
-	GLCall(glDepthFunc(GL_LESS));
-	GLCall(glEnable(GL_BLEND));
-	GLCall(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
-	GLCall(glEnable(GL_CULL_FACE));
-	GLCall(glCullFace(GL_BACK));
-	GLCall(glEnable(GL_LINE_SMOOTH));
-	GLCall(glEnable(GL_MULTISAMPLE));
-	GLCall(glEnable(GL_STENCIL_TEST));
-	GLCall(glStencilFunc(GL_NOTEQUAL, 1, 0xFF));
-	GLCall(glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE));
-	GLCall(glStencilMask(0x00));
-	GLCall(glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS));
+	GLState::Enable(GL_DEPTH_TEST);
+	GLState::DepthFunc(GL_LESS);
+	GLState::Enable(GL_BLEND);
+	GLState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::Enable(GL_CULL_FACE);
+	GLState::CullFace(GL_BACK);
+	GLState::Enable(GL_LINE_SMOOTH);
+	GLState::Enable(GL_MULTISAMPLE);
+	GLState::Enable(GL_STENCIL_TEST);
+	GLState::StencilFunc(GL_NOTEQUAL, 1, 0xFF);
+	GLState::StencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+	GLState::StencilMask(0x00);
+	GLState::Enable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
 	PrintDriversInfo();
 
@@ -357,8 +683,7 @@ void Renderer::Init()
 		Mesh quadMesh = GenerateMeshData(QuadMeshData());
 		quadMesh.Name = "Quad";
 
-		int32_t meshID = AssetManager::AddMesh(quadMesh, AssetManager::MESH_PLANE);
-		s_Data.MeshesData[meshID].Instances.reserve(s_Data.MaxInstancesOfType);
+		AssetManager::AddMesh(quadMesh, AssetManager::MESH_PLANE);
 	}
 
 	{
@@ -367,8 +692,7 @@ void Renderer::Init()
 		Mesh cubeMesh = GenerateMeshData(CubeMeshData());
 		cubeMesh.Name = "Cube";
 
-		int32_t meshID = AssetManager::AddMesh(cubeMesh, AssetManager::MESH_CUBE);
-		s_Data.MeshesData[meshID].Instances.reserve(s_Data.MaxInstancesOfType);
+		AssetManager::AddMesh(cubeMesh, AssetManager::MESH_CUBE);
 	}
 
 	{
@@ -377,43 +701,26 @@ void Renderer::Init()
 		Mesh sphereMesh = GenerateMeshData(SphereMeshData());
 		sphereMesh.Name = "Sphere";
 
-		int32_t meshID = AssetManager::AddMesh(sphereMesh, AssetManager::MESH_SPHERE);
-		s_Data.MeshesData[meshID].Instances.reserve(s_Data.MaxInstancesOfType);
+		AssetManager::AddMesh(sphereMesh, AssetManager::MESH_SPHERE);
 	}
 
 	{
 		SCOPE_PROFILE("Shaders init + default textures");
 
-		ShaderSpec spec{};
-		spec.Vertex	  = { "resources/shaders/Default.vert", {} };
-		spec.Fragment = { 
-			"resources/shaders/Default.frag",
-			{
-				{ "${MATERIALS_COUNT}",		std::to_string(s_Data.MaxMaterials)			 },
-				{ "${TEXTURE_UNITS}",		std::to_string(s_Data.Specs.MaxTextureUnits) },
-				{ "${MAX_DIR_LIGHTS}",		std::to_string(s_Data.MaxDirLights)			 },
-				{ "${MAX_POINT_LIGHTS}",	std::to_string(s_Data.MaxPointLights)		 },
-				{ "${MAX_SPOTLIGHTS}",		std::to_string(s_Data.MaxSpotlights)		 },
-				{ "${CASCADES_COUNT}",		std::to_string(s_Data.CascadesCount)		 }
-			}
-		};
-		s_Data.DefaultShader = std::make_shared<Shader>(spec);
-		s_Data.DefaultShader->Bind();
-		for (int32_t i = 0; i < s_Data.TextureBindings.size(); i++)
-		{
-			s_Data.DefaultShader->SetUniform1i("u_Textures[" + std::to_string(i) + "]", i);
-		}
+		s_Data.DefaultShader = CreateDefaultShader(MATERIAL_ALL_FEATURES);
+		s_Data.DefaultVariants[MATERIAL_ALL_FEATURES] = s_Data.DefaultShader;
+		s_Data.CurrentShader = s_Data.DefaultShader;
 
 		uint8_t whitePixel[] = { 255, 255, 255, 255 };
 		std::shared_ptr<Texture> defaultAlbedo = std::make_shared<Texture>(whitePixel, 1, 1, "Default white");
 		AssetManager::AddTexture(defaultAlbedo, AssetManager::TEXTURE_WHITE);
 
 		uint8_t normalPixel[] = { 127, 127, 255, 255 };
-		std::shared_ptr<Texture> defaultNormal = std::make_shared<Texture>(normalPixel, 1, 1, "Default normal");
+		std::shared_ptr<Texture> defaultNormal = std::make_shared<Texture>(normalPixel, 1, 1, "Default normal", TextureFormat::RGBA8, MipContent::NORMAL_MAP);
 		AssetManager::AddTexture(defaultNormal, AssetManager::TEXTURE_NORMAL);
 
 		uint8_t blackPixel[] = { 0, 0, 0, 255 };
-		std::shared_ptr<Texture> defaultBlack = std::make_shared<Texture>(blackPixel, 1, 1, "Default black");
+		std::shared_ptr<Texture> defaultBlack = std::make_shared<Texture>(blackPixel, 1, 1, "Default black", TextureFormat::RGBA8, MipContent::LINEAR);
 		AssetManager::AddTexture(defaultBlack, AssetManager::TEXTURE_BLACK);
 
 		Material mat{};
@@ -423,15 +730,7 @@ void Renderer::Init()
 		mat.HeightTextureID = AssetManager::TEXTURE_BLACK;
 		AssetManager::AddMaterial(mat, AssetManager::MATERIAL_DEFAULT);
 
-		s_Data.DefaultShader->SetUniform1i("u_DirLightCSM", s_Data.CSM_Slot);
-		s_Data.DefaultShader->SetUniform1i("u_PointLightShadowmaps", s_Data.PointShadowSlot);
-		s_Data.DefaultShader->SetUniform1i("u_SpotlightShadowmaps", s_Data.SpotlightShadowSlot);
-		s_Data.DefaultShader->SetUniform1i("u_OffsetsTexSize", 16);
-		s_Data.DefaultShader->SetUniform1i("u_OffsetsFilterSize", 8);
-		s_Data.DefaultShader->SetUniform1f("u_OffsetsRadius", s_Data.OffsetsRadius);
-		s_Data.DefaultShader->SetUniform1i("u_OffsetsTexture", s_Data.OffsetsSlot);
-		s_Data.CurrentShader = s_Data.DefaultShader;
-
+		ShaderSpec spec{};
 		spec.Vertex = { "resources/shaders/FlatColor.vert", {} };
 		spec.Fragment = {
 			"resources/shaders/FlatColor.frag",
@@ -441,11 +740,14 @@ void Renderer::Init()
 			}
 		};
 		s_Data.FlatShader = std::make_shared<Shader>(spec);
-		s_Data.FlatShader->Bind();
-		for (int32_t i = 0; i < s_Data.TextureBindings.size(); i++)
-		{
-			s_Data.FlatShader->SetUniform1i("u_Textures[" + std::to_string(i) + "]", i);
-		}
+		s_Data.FlatShader->OnLinked([](Shader& shader)
+			{
+				shader.Bind();
+				for (int32_t i = 0; i < s_Data.TextureBindings.size(); i++)
+				{
+					shader.SetUniform1i("u_Textures[" + std::to_string(i) + "]", i);
+				}
+			});
 	}
 
 	{
@@ -543,9 +845,13 @@ void Renderer::Init()
 		spec.Vertex   = { "resources/shaders/ScreenQuad.vert", {} };
 		spec.Fragment = { "resources/shaders/ScreenQuad.frag", {} };
 		s_Data.ScreenQuadShader = std::make_shared<Shader>(spec);
-		s_Data.ScreenQuadShader->Bind();
-		s_Data.ScreenQuadShader->SetUniform1i("u_ScreenTexture", 0);
-		s_Data.ScreenQuadShader->SetUniform1i("u_BloomTexture", 1);
+		s_Data.ScreenQuadShader->OnLinked([](Shader& shader)
+			{
+				shader.Bind();
+				shader.SetUniform1i("u_ScreenTexture", 0);
+				shader.SetUniform1i("u_BloomTexture", 1);
+			});
+		s_Data.ScreenQuadBloomStrength = s_Data.ScreenQuadShader->Uniform("u_BloomStrength");
 	}
 
 	{
@@ -564,26 +870,38 @@ void Renderer::Init()
 		spec.Vertex   = { "resources/shaders/env_map/EnvMapper.vert", {} };
 		spec.Fragment = { "resources/shaders/env_map/EnvMapper.frag", {} };
 		s_Data.EnvMapShader = std::make_shared<Shader>(spec);
-		s_Data.EnvMapShader->Bind();
-		s_Data.EnvMapShader->SetUniform1i("u_EquirectangularEnvMap", 0);
+		s_Data.EnvMapShader->OnLinked([](Shader& shader)
+			{
+				shader.Bind();
+				shader.SetUniform1i("u_EquirectangularEnvMap", 0);
+			});
 
 		spec.Vertex   = { "resources/shaders/env_map/EnvMapper.vert", {} };
 		spec.Fragment = { "resources/shaders/env_map/Irradiance.frag", {} };
 		s_Data.IrradianceShader = std::make_shared<Shader>(spec);
-		s_Data.IrradianceShader->Bind();
-		s_Data.IrradianceShader->SetUniform1i("u_EnvMap", 0);
+		s_Data.IrradianceShader->OnLinked([](Shader& shader)
+			{
+				shader.Bind();
+				shader.SetUniform1i("u_EnvMap", 0);
+			});
 
 		spec.Vertex   = { "resources/shaders/env_map/EnvMapper.vert", {} };
 		spec.Fragment = { "resources/shaders/env_map/EnvPrefilter.frag", {} };
 		s_Data.PrefilterShader = std::make_shared<Shader>(spec);
-		s_Data.PrefilterShader->Bind();
-		s_Data.PrefilterShader->SetUniform1i("u_EnvironmentMap", 0);
+		s_Data.PrefilterShader->OnLinked([](Shader& shader)
+			{
+				shader.Bind();
+				shader.SetUniform1i("u_EnvironmentMap", 0);
+			});
 
 		spec.Vertex   = { "resources/shaders/env_map/Skybox.vert", {} };
 		spec.Fragment = { "resources/shaders/env_map/Skybox.frag", {} };
 		s_Data.SkyboxShader = std::make_shared<Shader>(spec);
-		s_Data.SkyboxShader->Bind();
-		s_Data.SkyboxShader->SetUniform1i("u_Cubemap", 0);
+		s_Data.SkyboxShader->OnLinked([](Shader& shader)
+			{
+				shader.Bind();
+				shader.SetUniform1i("u_Cubemap", 0);
+			});
 	}
 
 	{
@@ -627,77 +945,63 @@ void Renderer::Init()
 	{
 		SCOPE_PROFILE("Bloom setup");
 
-		constexpr uint32_t MIPS = 8;
-		glm::ivec2 mipSize(1024);
+		// No attachments of its own, the bloom passes draw into textures of the render graph
+		s_Data.TransientTextures = std::make_shared<TexturePool>();
 		s_Data.BloomFBO = std::make_shared<Framebuffer>(1);
-		for (uint32_t i = 0; i < MIPS; i++)
-		{
-			mipSize /= 2;
-			s_Data.BloomFBO->AddColorAttachment({
-				.Type = ColorAttachmentType::TEX_2D,
-				.Format = TextureFormat::R11_G11_B10,
-				.Wrap = GL_CLAMP_TO_EDGE,
-				.MinFilter = GL_LINEAR,
-				.MagFilter = GL_LINEAR,
-				.Size = mipSize,
-				.GenMipmaps = false
-			});
-		}
-		s_Data.BloomFBO->DrawToColorAttachment(0, 0);
-		assert(s_Data.BloomFBO->IsComplete() && "Incomplete framebuffer!");
-		s_Data.BloomFBO->Unbind();
 
 		ShaderSpec spec{};
 		spec.Vertex   = { "resources/shaders/ScreenQuad.vert", {} };
 		spec.Fragment = { "resources/shaders/BloomDownsampler.frag", {} };
 		s_Data.BloomDownsamplerShader = std::make_shared<Shader>(spec);
-		s_Data.BloomDownsamplerShader->Bind();
-		s_Data.BloomDownsamplerShader->SetUniform1i("u_SourceTexture", 0);
+		s_Data.BloomDownsamplerShader->OnLinked([](Shader& shader)
+			{
+				shader.Bind();
+				shader.SetUniform1i("u_SourceTexture", 0);
+				shader.SetUniform1f("u_Threshold", s_Data.BloomThreshold);
+			});
+		s_Data.BloomDownsamplerResolution = s_Data.BloomDownsamplerShader->Uniform("u_SourceResolution");
+		s_Data.BloomDownsamplerFirstMip = s_Data.BloomDownsamplerShader->Uniform("u_FirstMip");
+		s_Data.BloomDownsamplerThreshold = s_Data.BloomDownsamplerShader->Uniform("u_Threshold");
 
 		spec.Vertex   = { "resources/shaders/ScreenQuad.vert", {} };
 		spec.Fragment = { "resources/shaders/BloomUpsampler.frag", {} };
 		s_Data.BloomUpsamplerShader = std::make_shared<Shader>(spec);
-		s_Data.BloomUpsamplerShader->Bind();
-		s_Data.BloomUpsamplerShader->SetUniform1i("u_SourceTexture", 0);
+		s_Data.BloomUpsamplerShader->OnLinked([](Shader& shader)
+			{
+				shader.Bind();
+				shader.SetUniform1i("u_SourceTexture", 0);
+				shader.SetUniform1f("u_FilterRadius", s_Data.BloomFilterRadius);
+			});
+
+		// Workgroups that finished their tile, the last one resets it
+		uint32_t finishedGroups = 0;
+		s_Data.BloomCounterBuffer = std::make_shared<SharedBuffer>(&finishedGroups, sizeof(uint32_t));
+
+		s_Data.BloomFragmentTimer = std::make_shared<GpuTimer>();
+		s_Data.BloomComputeTimer = std::make_shared<GpuTimer>();
+
+		if (s_Data.ComputeBloom)
+		{
+			InitComputeBloomShaders();
+		}
 	}
 
 	{
 		SCOPE_PROFILE("Creating BRDF map");
-		
-		GLuint fbo{};
-		GLuint rbo{};
-		GLCall(glGenFramebuffers(1, &fbo));
-		GLCall(glBindFramebuffer(GL_FRAMEBUFFER, fbo));
-		GLCall(glGenRenderbuffers(1, &rbo));
-		GLCall(glBindRenderbuffer(GL_RENDERBUFFER, rbo));
-		GLCall(glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512));
-		GLCall(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rbo));
+
+		constexpr int32_t BRDF_SIZE = 512;
+		std::vector<float> brdf = IBLCache::LoadOrIntegrateBRDF(BRDF_SIZE);
 
 		GLuint brdfTex{};
 		GLCall(glGenTextures(1, &brdfTex));
-		GLCall(glBindTexture(GL_TEXTURE_2D, brdfTex));
-		GLCall(glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, 512, 512, 0, GL_RG, GL_FLOAT, 0));
+		GLState::BindTexture(GL_TEXTURE_2D, brdfTex);
+		GLCall(glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, BRDF_SIZE, BRDF_SIZE, 0, GL_RG, GL_FLOAT, brdf.data()));
 		GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
 		GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
 		GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
 		GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
-
-		GLCall(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, brdfTex, 0));
-		GLCall(glViewport(0, 0, 512, 512)); 
-
-		ShaderSpec spec{};
-		spec.Vertex   = { "resources/shaders/ScreenQuad.vert", {} };
-		spec.Fragment = { "resources/shaders/env_map/BRDF.frag", {} };
-		std::shared_ptr<Shader> brdfShader = std::make_shared<Shader>(spec);
-		brdfShader->Bind();
-		Clear();
-		DrawArrays(brdfShader, s_Data.ScreenQuadVertexArray, 6);
+		GLState::BindTexture(GL_TEXTURE_2D, 0);
 		s_Data.BRDF_Map = std::make_shared<Texture>((uint32_t)brdfTex, "BRDF Map", TextureFormat::RG16F);
-
-		GLCall(glBindRenderbuffer(GL_RENDERBUFFER, 0));
-		GLCall(glBindFramebuffer(GL_FRAMEBUFFER, 0));
-		GLCall(glDeleteRenderbuffers(1, &rbo));
-		GLCall(glDeleteFramebuffers(1, &fbo));
 	}
 
 	{
@@ -737,16 +1041,16 @@ void Renderer::Init()
 
 		constexpr int32_t filterSamples = filterSize * filterSize;
 		GLCall(glGenTextures(1, &s_Data.OffsetsTexID));
-		GLCall(glBindTexture(GL_TEXTURE_3D, s_Data.OffsetsTexID));
+		GLState::BindTexture(GL_TEXTURE_3D, s_Data.OffsetsTexID);
 		GLCall(glTexStorage3D(GL_TEXTURE_3D, 1, GL_RGBA32F, filterSamples / 2, windowSize, windowSize));
 		GLCall(glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, filterSamples / 2, windowSize, windowSize, GL_RGBA, GL_FLOAT, textureData.data()));
 		GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
 		GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
-		GLCall(glBindTexture(GL_TEXTURE_3D, 0));
+		GLState::BindTexture(GL_TEXTURE_3D, 0);
 	}
 
 	{
-		SCOPE_PROFILE("Deferred G buffer + shaders init");
+		SCOPE_PROFILE("Deferred G buffer init");
 		
 		{
 			const WindowSpec& wSpec = Application::Instance()->Spec();
@@ -780,81 +1084,15 @@ void Renderer::Init()
 
 			assert(s_Data.G_FBO->IsComplete() && "Incomplete framebuffer!");
 		}
+	}
 
-		{
-			ShaderSpec spec{};
-			spec.Vertex = {
-				"resources/shaders/deferred/GBuf.vert", {}
-			};
-			spec.Fragment = {
-				"resources/shaders/deferred/GBuf.frag",
-				{
-					{ "${MATERIALS_COUNT}",		std::to_string(s_Data.MaxMaterials)			 },
-					{ "${TEXTURE_UNITS}",		std::to_string(s_Data.Specs.MaxTextureUnits) }
-				}
-			};
-			s_Data.G_PassShader = std::make_shared<Shader>(spec);
-			s_Data.G_PassShader->Bind();
-			for (int32_t i = 0; i < s_Data.TextureBindings.size(); i++)
-			{
-				s_Data.G_PassShader->SetUniform1i("u_Textures[" + std::to_string(i) + "]", i);
-			}
-		}
-		
-		{
-			ShaderSpec spec{};
-			spec.Vertex		= { "resources/shaders/deferred/LightPass.vert", {} };
-			spec.Fragment	= { "resources/shaders/deferred/LightPass.frag",
-				{
-					{ "${MAX_DIR_LIGHTS}",	 std::to_string(s_Data.MaxDirLights)	},
-					{ "${MAX_SPOTLIGHTS}",	 std::to_string(s_Data.MaxSpotlights)	},
-					{ "${CASCADES_COUNT}",	 std::to_string(s_Data.CascadesCount)	}
-				}
-			};
-			s_Data.G_LightShader = std::make_shared<Shader>(spec);
-			s_Data.G_LightShader->Bind();
-			s_Data.G_LightShader->SetUniform1i("gPosition", 0);
-			s_Data.G_LightShader->SetUniform1i("gNormal", 1);
-			s_Data.G_LightShader->SetUniform1i("gColor", 2);
-			s_Data.G_LightShader->SetUniform1i("gMaterial", 3);
-			s_Data.G_LightShader->SetUniform1i("gLights", 4);
-			s_Data.G_LightShader->SetUniform1i("u_DirLightCSM", s_Data.CSM_Slot);
-			s_Data.G_LightShader->SetUniform1i("u_SpotlightShadowmaps", s_Data.SpotlightShadowSlot);
-			s_Data.G_LightShader->SetUniform1i("u_OffsetsTexSize", 16);
-			s_Data.G_LightShader->SetUniform1i("u_OffsetsFilterSize", 8);
-			s_Data.G_LightShader->SetUniform1f("u_OffsetsRadius", s_Data.OffsetsRadius);
-			s_Data.G_LightShader->SetUniform1i("u_OffsetsTexture", s_Data.OffsetsSlot);
-		}
-		
-		{
-			ShaderSpec spec{};
-			spec.Vertex		= { "resources/shaders/deferred/PrepLightPass.vert", {} };
-			spec.Fragment	= { "resources/shaders/deferred/PointLightPass.frag",
-				{
-					{ "${MAX_POINT_LIGHTS}", std::to_string(s_Data.MaxPointLights)	}
-				}
-			};
-			s_Data.G_PointLightShader = std::make_shared<Shader>(spec);
-			s_Data.G_PointLightShader->Bind();
-			s_Data.G_PointLightShader->SetUniform1i("gPosition", 0);
-			s_Data.G_PointLightShader->SetUniform1i("gNormal", 1);
-			s_Data.G_PointLightShader->SetUniform1i("gColor", 2);
-			s_Data.G_PointLightShader->SetUniform1i("gMaterial", 3);
-			s_Data.G_PointLightShader->SetUniform1i("u_PointLightShadowmaps", s_Data.PointShadowSlot);
-			s_Data.G_PointLightShader->SetUniform1i("u_OffsetsTexSize", 16);
-			s_Data.G_PointLightShader->SetUniform1i("u_OffsetsFilterSize", 8);
-			s_Data.G_PointLightShader->SetUniform1f("u_OffsetsRadius", s_Data.OffsetsRadius);
-			s_Data.G_PointLightShader->SetUniform1i("u_OffsetsTexture", s_Data.OffsetsSlot);
-		}
-
-		{
-			ShaderSpec spec{};
-			spec.Vertex		= { "resources/shaders/deferred/PrepLightPass.vert", {} };
-			spec.Fragment	= { "resources/shaders/Empty.frag", {} };
-			s_Data.G_PassThrough = std::make_shared<Shader>(spec);
-		}
+	{
+		SCOPE_PROFILE("Virtual texturing init");
+		VirtualTexturing::Init(s_Data.MaxMaterials);
 	}
 
+	s_Data.ShaderWatcher = std::make_unique<FileWatcher>("resources/shaders");
+
 	memset(&s_Data.Stats, 0, sizeof(RendererStats));
 }
 
@@ -862,6 +1100,8 @@ void Renderer::Shutdown()
 {
 	s_TargetFBO = nullptr;
 
+	VirtualTexturing::Shutdown();
+
 	delete[] s_Data.LineBufferBase;
 
 	s_Data.ScreenQuadVertexArray = nullptr;
@@ -881,10 +1121,19 @@ void Renderer::Shutdown()
 	s_Data.BRDF_Map = nullptr;
 
 	s_Data.BloomFBO = nullptr;
+	s_Data.BloomTexture = 0;
+	s_Data.TransientTextures = nullptr;
 	s_Data.BloomDownsamplerShader = nullptr;
 	s_Data.BloomUpsamplerShader = nullptr;
+	s_Data.BloomDownsampleComputeShader = nullptr;
+	s_Data.BloomUpsampleComputeShader = nullptr;
+	s_Data.BloomCounterBuffer = nullptr;
+	s_Data.BloomFragmentTimer = nullptr;
+	s_Data.BloomComputeTimer = nullptr;
 
 	s_Data.DefaultShader = nullptr;
+	s_Data.DefaultVariants = {};
+	s_Data.DefaultVariantUniforms = {};
 	s_Data.FlatShader = nullptr;
 	s_Data.CurrentShader = nullptr;
 
@@ -901,21 +1150,89 @@ void Renderer::Shutdown()
 
 	s_Data.G_FBO = nullptr;
 	s_Data.G_PassShader = nullptr;
+	s_Data.G_PassVariants = {};
+	s_Data.G_PassVariantUniforms = {};
 	s_Data.G_LightShader = nullptr;
 	s_Data.G_PointLightShader = nullptr;
 	s_Data.G_PassThrough = nullptr;
 
+	s_Data.ShaderWatcher = nullptr;
+
 	if (s_Data.OffsetsTexID != 0)
 	{
-		GLCall(glBindTexture(GL_TEXTURE_3D, 0));
+		GLState::BindTexture(GL_TEXTURE_3D, 0);
+		GLState::ForgetTexture(s_Data.OffsetsTexID);
 		GLCall(glDeleteTextures(1, &s_Data.OffsetsTexID));
 		s_Data.OffsetsTexID = 0;
 	}
 }
 
+// Programs of modes and material variants that weren't used yet are still null
+static std::vector<Shader*> AllShaders()
+{
+	std::vector<Shader*> shaders;
+	for (uint32_t features = 0; features < MaterialVariants; features++)
+	{
+		for (Shader* shader : { s_Data.DefaultVariants[features].get(), s_Data.G_PassVariants[features].get() })
+		{
+			if (shader != nullptr)
+			{
+				shaders.push_back(shader);
+			}
+		}
+	}
+
+	for (Shader* shader : {
+		s_Data.FlatShader.get(), s_Data.ScreenQuadShader.get(), s_Data.LineShader.get(),
+		s_Data.DirectionalShadowShader.get(), s_Data.PointShadowShader.get(), s_Data.SpotlightShadowShader.get(),
+		s_Data.EnvMapShader.get(), s_Data.IrradianceShader.get(), s_Data.PrefilterShader.get(), s_Data.SkyboxShader.get(),
+		s_Data.BloomDownsamplerShader.get(), s_Data.BloomUpsamplerShader.get(),
+		s_Data.BloomDownsampleComputeShader.get(), s_Data.BloomUpsampleComputeShader.get(),
+		s_Data.G_LightShader.get(), s_Data.G_PointLightShader.get(), s_Data.G_PassThrough.get(),
+		VirtualTexturing::FeedbackShader().get() })
+	{
+		if (shader != nullptr)
+		{
+			shaders.push_back(shader);
+		}
+	}
+
+	return shaders;
+}
+
 void Renderer::ReloadShaders()
 {
-	
+	for (Shader* shader : AllShaders())
+	{
+		shader->Reload();
+	}
+}
+
+void Renderer::ReloadChangedShaders()
+{
+	if (s_Data.ShaderWatcher == nullptr)
+	{
+		return;
+	}
+
+	std::vector<std::filesystem::path> changes = s_Data.ShaderWatcher->Changes();
+	if (changes.empty())
+	{
+		return;
+	}
+
+	std::vector<Shader*> shaders = AllShaders();
+	for (const std::filesystem::path& path : changes)
+	{
+		for (Shader* shader : shaders)
+		{
+			if (shader->UsesSource(path.string()))
+			{
+				LOG_INFO("Reloading shaders using {}", path.string());
+				shader->Reload();
+			}
+		}
+	}
 }
 
 void Renderer::OnWindowResize(const Viewport& newViewport)
@@ -929,6 +1246,7 @@ void Renderer::OnWindowResize(const Viewport& newViewport)
 void Renderer::SceneBegin(Camera& camera)
 {
 	s_ActiveCamera = &camera;
+	s_Data.TransientTextures->NextFrame();
 	glm::mat4 projection = camera.GetProjection();
 	glm::mat4 view = camera.GetViewMatrix();
 
@@ -962,15 +1280,22 @@ void Renderer::Flush()
 		s_ActiveCamera->m_FarClip / 2.0f,
 		s_ActiveCamera->m_FarClip
 	};
-	s_Data.DefaultShader->Bind();
-	for (size_t i = 0; i < cascades.size(); i++)
+	for (uint32_t features = 0; features < MaterialVariants; features++)
 	{
-		s_Data.DefaultShader->SetUniform1f("u_CascadeDistances[" + std::to_string(i) + "]", cascades[i]);
+		const std::shared_ptr<Shader>& variant = s_Data.DefaultVariants[features];
+		if (variant != nullptr && variant->IsReady())
+		{
+			variant->Bind();
+			variant->SetUniform1fv(s_Data.DefaultVariantUniforms[features].CascadeDistances, cascades.data(), (uint32_t)cascades.size());
+		}
 	}
-	s_Data.G_LightShader->Bind();
-	for (size_t i = 0; i < cascades.size(); i++)
+
+	// Forward rendering fills in until the deferred programs finished compiling
+	bool deferred = s_Data.RenderMode == RenderMode::DEFERRED && RenderModeReady(RenderMode::DEFERRED);
+	if (deferred)
 	{
-		s_Data.G_LightShader->SetUniform1f("u_CascadeDistances[" + std::to_string(i) + "]", cascades[i]);
+		s_Data.G_LightShader->Bind();
+		s_Data.G_LightShader->SetUniform1fv(s_Data.G_LightCascadeDistances, cascades.data(), (uint32_t)cascades.size());
 	}
 
 	s_Data.MaterialsBuffer->SetData(s_Data.MaterialsData.data(), s_Data.MaterialsData.size() * sizeof(MaterialsBufferData));
@@ -995,12 +1320,27 @@ void Renderer::Flush()
 
 	for (int32_t i = 0; i < s_Data.BoundTexturesCount; i++)
 	{
-		GLCall(glActiveTexture(GL_TEXTURE0 + i));
-		GLCall(glBindTexture(GL_TEXTURE_2D, s_Data.TextureBindings[i]));
+		GLState::BindTexture(i, GL_TEXTURE_2D, s_Data.TextureBindings[i]);
 	}
 
-	GLCall(glActiveTexture(GL_TEXTURE0 + s_Data.OffsetsSlot));
-	GLCall(glBindTexture(GL_TEXTURE_3D, s_Data.OffsetsTexID));
+	GLState::BindTexture(s_Data.OffsetsSlot, GL_TEXTURE_3D, s_Data.OffsetsTexID);
+
+	if (s_Data.UsesVirtualTextures)
+	{
+		VirtualTexturing::BindTextures(s_Data.VirtualPageTableSlot, s_Data.VirtualPhysicalSlot);
+		for (uint32_t features = 0; features < MaterialVariants; features++)
+		{
+			if (s_Data.DefaultVariants[features] != nullptr && s_Data.DefaultVariants[features]->IsReady())
+			{
+				VirtualTexturing::ApplyUniforms(s_Data.DefaultVariants[features], s_Data.DefaultVariantUniforms[features].VirtualTextures);
+			}
+
+			if (deferred && s_Data.G_PassVariants[features] != nullptr && s_Data.G_PassVariants[features]->IsReady())
+			{
+				VirtualTexturing::ApplyUniforms(s_Data.G_PassVariants[features], s_Data.G_PassVariantUniforms[features].VirtualTextures);
+			}
+		}
+	}
 
 	switch (s_Data.RenderMode)
 	{
@@ -1013,12 +1353,23 @@ void Renderer::Flush()
 		ForwardRender();
 		break;
 	case RenderMode::DEFERRED:
-		DeferredRender();
+		if (deferred)
+		{
+			DeferredRender();
+			break;
+		}
+		s_Data.CurrentShader = s_Data.DefaultShader;
+		ForwardRender();
 		break;
 	default:
 		assert(false && "Invalid rendering pipeline passed");
 		break;
 	}
+
+	if (s_Data.UsesVirtualTextures && s_Data.DrawFeedback)
+	{
+		FeedbackRender();
+	}
 }
 
 void Renderer::BeginShadowMapPass()
@@ -1050,8 +1401,7 @@ void Renderer::EndShadowMapPass()
 			continue;
 		}
 		
-		Mesh& mesh = AssetManager::GetMesh(meshID);
-		mesh.InstanceBuffer->SetData(meshData.Instances.data(), meshData.CurrentInstancesCount * sizeof(MeshInstance));
+		UploadInstances(AssetManager::GetMesh(meshID), meshData);
 	}
 
 	s_Data.ShadowMapsFBO->Bind();
@@ -1125,11 +1475,21 @@ void Renderer::EndShadowMapPass()
 void Renderer::ResetStats()
 {
 	memset(&s_Data.Stats, 0, sizeof(RendererStats));
+	GLState::ResetCounters();
 }
 
 RendererStats Renderer::Stats()
 {
-	return s_Data.Stats;
+	// Both bloom paths keep their last timing, so they can be compared after switching
+	RendererStats stats = s_Data.Stats;
+	stats.BloomFragmentTime = s_Data.BloomFragmentTimer->LastTime();
+	stats.BloomComputeTime = s_Data.BloomComputeTimer->LastTime();
+	stats.BloomMips = (uint32_t)s_Data.BloomMipSizes.size();
+	stats.BloomMemory = s_Data.BloomMemory;
+	stats.StateChanges = GLState::IssuedCalls();
+	stats.StateChangesAvoided = GLState::AvoidedCalls();
+
+	return stats;
 }
 
 void Renderer::ClearColor(const glm::vec4& color)
@@ -1173,20 +1533,89 @@ void Renderer::DrawCube(const glm::mat4& transform, const glm::vec4& color)
 
 void Renderer::SubmitMesh(const glm::mat4& transform, const MeshComponent& mesh, const Material& material, int32_t entityID)
 {
-	if (s_Data.MeshesData[mesh.MeshID].CurrentInstancesCount >= s_Data.MaxInstancesOfType
+	MeshBufferData& meshData = s_Data.MeshesData[mesh.MeshID];
+	if (meshData.CurrentInstancesCount >= s_Data.MaxInstancesOfType
 		|| s_Data.InstancesCount >= s_Data.MaxInstances)
 	{
 		NextBatch();
 	}
 
-	std::shared_ptr<Texture> textures[] = {
-		AssetManager::GetTexture(material.AlbedoTextureID),
-		AssetManager::GetTexture(material.NormalTextureID),
-		AssetManager::GetTexture(material.HeightTextureID),
-		AssetManager::GetTexture(material.RoughnessTextureID),
+	int32_t materialIdx = AddMaterial(material);
+	uint32_t features = MaterialFeatures(material);
+	RequestMaterialVariant(features);
+	AddInstance(meshData, transform, entityID, materialIdx, features);
+}
+
+void Renderer::SubmitMeshes(const std::vector<std::vector<MeshCommand>>& buckets, const std::unordered_map<int32_t, Material>& materials)
+{
+	s_Data.SortedCommands.clear();
+	for (const std::vector<MeshCommand>& bucket : buckets)
+	{
+		for (const MeshCommand& command : bucket)
+		{
+			uint64_t key = ((uint64_t)(uint32_t)command.MaterialID << 32) | (uint32_t)command.MeshID;
+			s_Data.SortedCommands.emplace_back(key, &command);
+		}
+	}
+
+	std::sort(s_Data.SortedCommands.begin(), s_Data.SortedCommands.end(),
+		[](const auto& a, const auto& b)
+		{
+			return a.first < b.first;
+		});
+
+	int32_t meshID = -1;
+	MeshBufferData* meshData = nullptr;
+	int32_t materialID = -1;
+	int32_t materialIdx = -1;
+	uint32_t materialBatch = 0;
+	uint32_t features = 0;
+	for (const auto& [key, command] : s_Data.SortedCommands)
+	{
+		if (command->MeshID != meshID || meshData == nullptr)
+		{
+			meshID = command->MeshID;
+			meshData = &s_Data.MeshesData[meshID];
+		}
+
+		if (meshData->CurrentInstancesCount >= s_Data.MaxInstancesOfType
+			|| s_Data.InstancesCount >= s_Data.MaxInstances)
+		{
+			NextBatch();
+		}
+
+		if (command->MaterialID != materialID || materialBatch != s_Data.Batch)
+		{
+			const Material& material = materials.at(command->MaterialID);
+			materialIdx = AddMaterial(material);
+			features = MaterialFeatures(material);
+			RequestMaterialVariant(features);
+			materialID = command->MaterialID;
+			materialBatch = s_Data.Batch;
+		}
+
+		AddInstance(*meshData, command->Transform, command->EntityID, materialIdx, features);
+	}
+}
+
+int32_t Renderer::AddMaterial(const Material& material)
+{
+	std::shared_ptr<Texture> textures[] = {
+		AssetManager::GetTexture(material.AlbedoTextureID),
+		AssetManager::GetTexture(material.NormalTextureID),
+		AssetManager::GetTexture(material.HeightTextureID),
+		AssetManager::GetTexture(material.RoughnessTextureID),
 		AssetManager::GetTexture(material.MetallicTextureID),
 		AssetManager::GetTexture(material.AmbientOccTextureID)
 	};
+	TextureResidency::MarkUsed(material.AlbedoTextureID, *textures[0]);
+	TextureResidency::MarkUsed(material.NormalTextureID, *textures[1]);
+	TextureResidency::MarkUsed(material.HeightTextureID, *textures[2]);
+	TextureResidency::MarkUsed(material.RoughnessTextureID, *textures[3]);
+	TextureResidency::MarkUsed(material.MetallicTextureID, *textures[4]);
+	TextureResidency::MarkUsed(material.AmbientOccTextureID, *textures[5]);
+	s_Data.UsesVirtualTextures |= material.VirtualTextureID >= 0;
+
 	int32_t textureIdxs[] = { -1, -1, -1, -1, -1, -1 };
 	size_t newTextures = 0;
 
@@ -1276,14 +1705,7 @@ void Renderer::SubmitMesh(const glm::mat4& transform, const MeshComponent& mesh,
 		s_Data.MaterialsData.back().AmbientOccTextureSlot = textureIdxs[5];
 	}
 
-	std::vector<MeshInstance>& instances = s_Data.MeshesData[mesh.MeshID].Instances;
-	MeshInstance& instance = instances.emplace_back();
-	instance.Transform = transform;
-	instance.EntityID = (float)entityID + 1.0f;
-	instance.MaterialSlot = (float)materialIdx;
-	s_Data.MeshesData[mesh.MeshID].CurrentInstancesCount++;
-	s_Data.InstancesCount++;
-	s_Data.Stats.ObjectsRendered++;
+	return materialIdx;
 }
 
 void Renderer::DrawIndexed(const std::shared_ptr<Shader>& shader, const std::shared_ptr<VertexArray>& vao, uint32_t primitiveType)
@@ -1296,12 +1718,12 @@ void Renderer::DrawIndexed(const std::shared_ptr<Shader>& shader, const std::sha
 	s_Data.Stats.DrawCalls++;
 }
 
-void Renderer::DrawIndexedInstanced(const std::shared_ptr<Shader>& shader, const std::shared_ptr<VertexArray>& vao, uint32_t instances, uint32_t primitiveType)
+void Renderer::DrawIndexedInstanced(const std::shared_ptr<Shader>& shader, const std::shared_ptr<VertexArray>& vao, uint32_t instances, uint32_t primitiveType, uint32_t baseInstance)
 {
 	vao->Bind();
 	shader->Bind();
 
-	GLCall(glDrawElementsInstanced(primitiveType, vao->GetIndexBuffer()->GetCount(), GL_UNSIGNED_INT, nullptr, instances));
+	GLCall(glDrawElementsInstancedBaseInstance(primitiveType, vao->GetIndexBuffer()->GetCount(), GL_UNSIGNED_INT, nullptr, instances, baseInstance));
 
 	s_Data.Stats.DrawCalls++;
 }
@@ -1328,14 +1750,154 @@ void Renderer::DrawArraysInstanced(const std::shared_ptr<Shader>& shader, const
 
 void Renderer::DrawScreenQuad()
 {
-	GLCall(glDisable(GL_DEPTH_TEST));
+	GLState::Disable(GL_DEPTH_TEST);
 	DrawArrays(s_Data.ScreenQuadShader, s_Data.ScreenQuadVertexArray, 6);
-	GLCall(glEnable(GL_DEPTH_TEST));
+	GLState::Enable(GL_DEPTH_TEST);
 }
 
 void Renderer::SetRenderMode(RenderMode mode)
 {
 	s_Data.RenderMode = mode;
+
+	// Startup doesn't wait on programs of a mode nobody asked for yet
+	if (mode == RenderMode::DEFERRED && s_Data.G_PassShader == nullptr)
+	{
+		InitDeferredShaders();
+	}
+}
+
+bool Renderer::RenderModeReady(RenderMode mode)
+{
+	// Every program is asked, so all of the finished ones get set up and not just the first
+	bool ready = true;
+	if (mode == RenderMode::FORWARD)
+	{
+		for (const std::shared_ptr<Shader>& variant : s_Data.DefaultVariants)
+		{
+			ready = (variant == nullptr || variant->IsReady()) && ready;
+		}
+
+		return ready;
+	}
+
+	if (mode != RenderMode::DEFERRED)
+	{
+		return true;
+	}
+
+	for (Shader* shader : { s_Data.G_PassShader.get(), s_Data.G_LightShader.get(), s_Data.G_PointLightShader.get(), s_Data.G_PassThrough.get() })
+	{
+		ready = shader != nullptr && shader->IsReady() && ready;
+	}
+
+	for (const std::shared_ptr<Shader>& variant : s_Data.G_PassVariants)
+	{
+		ready = (variant == nullptr || variant->IsReady()) && ready;
+	}
+
+	return ready;
+}
+
+void Renderer::InitDeferredShaders()
+{
+	SCOPE_PROFILE("Deferred shaders init");
+
+	s_Data.G_PassShader = CreateG_PassShader(MATERIAL_ALL_FEATURES);
+	s_Data.G_PassVariants[MATERIAL_ALL_FEATURES] = s_Data.G_PassShader;
+	
+	{
+		ShaderSpec spec{};
+		spec.Vertex		= { "resources/shaders/deferred/LightPass.vert", {} };
+		spec.Fragment	= { "resources/shaders/deferred/LightPass.frag",
+			{
+				{ "${MAX_DIR_LIGHTS}",	 std::to_string(s_Data.MaxDirLights)	},
+				{ "${MAX_SPOTLIGHTS}",	 std::to_string(s_Data.MaxSpotlights)	},
+				{ "${CASCADES_COUNT}",	 std::to_string(s_Data.CascadesCount)	}
+			}
+		};
+		s_Data.G_LightShader = std::make_shared<Shader>(spec);
+		s_Data.G_LightShader->OnLinked([](Shader& shader)
+			{
+				shader.Bind();
+				shader.SetUniform1i("gPosition", 0);
+				shader.SetUniform1i("gNormal", 1);
+				shader.SetUniform1i("gColor", 2);
+				shader.SetUniform1i("gMaterial", 3);
+				shader.SetUniform1i("gLights", 4);
+				shader.SetUniform1i("u_DirLightCSM", s_Data.CSM_Slot);
+				shader.SetUniform1i("u_SpotlightShadowmaps", s_Data.SpotlightShadowSlot);
+				shader.SetUniform1i("u_OffsetsTexSize", 16);
+				shader.SetUniform1i("u_OffsetsFilterSize", 8);
+				shader.SetUniform1f("u_OffsetsRadius", s_Data.OffsetsRadius);
+				shader.SetUniform1i("u_OffsetsTexture", s_Data.OffsetsSlot);
+				SetEnvironmentSamplers(shader);
+				s_Data.G_LightEnvironment.Version = 0;
+			});
+		s_Data.G_LightCascadeDistances = s_Data.G_LightShader->Uniform("u_CascadeDistances");
+		s_Data.G_LightEnvironment = ResolveEnvironmentUniforms(*s_Data.G_LightShader);
+	}
+	
+	{
+		ShaderSpec spec{};
+		spec.Vertex		= { "resources/shaders/deferred/PrepLightPass.vert", {} };
+		spec.Fragment	= { "resources/shaders/deferred/PointLightPass.frag",
+			{
+				{ "${MAX_POINT_LIGHTS}", std::to_string(s_Data.MaxPointLights)	}
+			}
+		};
+		s_Data.G_PointLightShader = std::make_shared<Shader>(spec);
+		s_Data.G_PointLightShader->OnLinked([](Shader& shader)
+			{
+				shader.Bind();
+				shader.SetUniform1i("gPosition", 0);
+				shader.SetUniform1i("gNormal", 1);
+				shader.SetUniform1i("gColor", 2);
+				shader.SetUniform1i("gMaterial", 3);
+				shader.SetUniform1i("u_PointLightShadowmaps", s_Data.PointShadowSlot);
+				shader.SetUniform1i("u_OffsetsTexSize", 16);
+				shader.SetUniform1i("u_OffsetsFilterSize", 8);
+				shader.SetUniform1f("u_OffsetsRadius", s_Data.OffsetsRadius);
+				shader.SetUniform1i("u_OffsetsTexture", s_Data.OffsetsSlot);
+			});
+		s_Data.G_PointLightTransform = s_Data.G_PointLightShader->Uniform("u_Transform");
+		s_Data.G_PointLightID = s_Data.G_PointLightShader->Uniform("u_LightID");
+	}
+
+	{
+		ShaderSpec spec{};
+		spec.Vertex		= { "resources/shaders/deferred/PrepLightPass.vert", {} };
+		spec.Fragment	= { "resources/shaders/Empty.frag", {} };
+		s_Data.G_PassThrough = std::make_shared<Shader>(spec);
+		s_Data.G_PassThroughTransform = s_Data.G_PassThrough->Uniform("u_Transform");
+	}
+}
+
+void Renderer::InitComputeBloomShaders()
+{
+	ShaderSpec spec{};
+	spec.Compute = { "resources/shaders/BloomDownsample.comp", {} };
+	s_Data.BloomDownsampleComputeShader = std::make_shared<Shader>(spec);
+	s_Data.BloomDownsampleComputeShader->OnLinked([](Shader& shader)
+		{
+			shader.Bind();
+			shader.SetUniform1i("u_SourceTexture", 0);
+			shader.SetUniform1f("u_Threshold", s_Data.BloomThreshold);
+		});
+	s_Data.BloomComputeResolution = s_Data.BloomDownsampleComputeShader->Uniform("u_SourceResolution");
+	s_Data.BloomComputeMipCount = s_Data.BloomDownsampleComputeShader->Uniform("u_MipCount");
+	s_Data.BloomComputeThreshold = s_Data.BloomDownsampleComputeShader->Uniform("u_Threshold");
+
+	spec.Compute = { "resources/shaders/BloomUpsample.comp", {} };
+	s_Data.BloomUpsampleComputeShader = std::make_shared<Shader>(spec);
+	s_Data.BloomUpsampleComputeShader->OnLinked([](Shader& shader)
+		{
+			shader.Bind();
+			shader.SetUniform1i("u_SourceTexture", 0);
+			shader.SetUniform1f("u_FilterRadius", s_Data.BloomFilterRadius);
+		});
+	s_Data.BloomUpsampleFused = s_Data.BloomUpsampleComputeShader->Uniform("u_Fused");
+	s_Data.BloomUpsampleSourceMip = s_Data.BloomUpsampleComputeShader->Uniform("u_SourceMip");
+	s_Data.BloomUpsampleTargetMip = s_Data.BloomUpsampleComputeShader->Uniform("u_TargetMip");
 }
 
 void Renderer::SetTargetFBO(std::shared_ptr<Framebuffer>& fbo)
@@ -1345,83 +1907,124 @@ void Renderer::SetTargetFBO(std::shared_ptr<Framebuffer>& fbo)
 
 void Renderer::Bloom(std::shared_ptr<Framebuffer> hdrFBO)
 {
-	const std::vector<ColorAttachment>& mips = s_Data.BloomFBO->ColorAttachments();
-	s_Data.BloomFBO->Bind();
+	if (hdrFBO->ColorAttachmentSize(0) != s_Data.BloomSourceSize)
+	{
+		ResizeBloomChain(hdrFBO->ColorAttachmentSize(0));
+	}
 
-	// Bloom downsampling
-	glm::ivec2 viewportSize = hdrFBO->ColorAttachmentSize(0);
-	s_Data.BloomDownsamplerShader->Bind();
-	s_Data.BloomDownsamplerShader->SetUniform2f("u_SourceResolution", viewportSize);
-	s_Data.BloomDownsamplerShader->SetUniformBool("u_FirstMip", true);
-	hdrFBO->BindColorAttachment(0);
-	GLCall(glDrawBuffer(GL_COLOR_ATTACHMENT0));
-	GLCall(glDisable(GL_DEPTH_TEST));
+	if (s_Data.BloomTexture != 0)
+	{
+		s_Data.TransientTextures->Release(s_Data.BloomTexture);
+		s_Data.BloomTexture = 0;
+	}
 
-	for (size_t i = 0; i < mips.size(); i++)
+	// Nothing to blur, the screen quad samples black from the empty slot and adds nothing
+	if (s_Data.BloomMipSizes.empty())
 	{
-		const ColorAttachment& mip = mips[i];
-		GLCall(glViewport(0, 0, mip.spec.Size.x, mip.spec.Size.y));
-		s_Data.BloomFBO->DrawToColorAttachment(i, 0);
+		s_Data.BloomMemory = 0;
+		GLState::BindTexture(1, GL_TEXTURE_2D, 0);
+		return;
+	}
 
-		DrawArrays(s_Data.BloomDownsamplerShader, s_Data.ScreenQuadVertexArray, 6);
+	RenderGraph graph;
+	const ColorAttachment& hdr = hdrFBO->ColorAttachments()[0];
+	RenderGraphResource source = graph.Import("HDR", hdr.ID, { hdr.spec.Size, hdr.spec.Format });
 
-		s_Data.BloomDownsamplerShader->SetUniform2f("u_SourceResolution", mip.spec.Size);
-		s_Data.BloomDownsamplerShader->SetUniformBool("u_FirstMip", false);
-		s_Data.BloomFBO->BindColorAttachment(i);
+	// Handles stay valid until the graph has run, every pass reads them through a reference
+	std::vector<RenderGraphResource> mips(s_Data.BloomMipSizes.size());
+
+	// The fragment chain fills in until the compute programs finished compiling
+	bool compute = s_Data.ComputeBloom && s_Data.BloomDownsampleComputeShader->IsReady() && s_Data.BloomUpsampleComputeShader->IsReady();
+	if (compute)
+	{
+		ComputeBloom(graph, source, mips);
 	}
+	else
+	{
+		FragmentBloom(graph, source, mips);
+	}
+	graph.Export(mips[0]);
+	graph.Compile();
 
-	// Bloom upsampling
-	s_Data.BloomUpsamplerShader->Bind();
-	s_Data.BloomUpsamplerShader->SetUniform1f("u_FilterRadius", 0.005f);
-	GLCall(glBlendFunc(GL_ONE, GL_ONE));
-	GLCall(glBlendEquation(GL_FUNC_ADD));
+	std::shared_ptr<GpuTimer>& timer = compute ? s_Data.BloomComputeTimer : s_Data.BloomFragmentTimer;
+	timer->Begin();
+	graph.Execute(*s_Data.TransientTextures);
+	timer->End();
 
-	for (size_t i = mips.size() - 1; i > 0; i--)
-	{
-		const ColorAttachment& mip = mips[i];
-		const ColorAttachment& nextMip = mips[i - 1];
+	GLState::BlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::Enable(GL_DEPTH_TEST);
+	GLCall(glViewport(0, 0, hdr.spec.Size.x, hdr.spec.Size.y));
 
-		s_Data.BloomFBO->BindColorAttachment(i);
-		GLCall(glViewport(0, 0, nextMip.spec.Size.x, nextMip.spec.Size.y));
-		s_Data.BloomFBO->DrawToColorAttachment(i - 1, 0);
+	s_Data.BloomMemory = graph.TransientMemory();
+	s_Data.BloomTexture = graph.Texture(mips[0]);
+	GLState::BindTexture(1, GL_TEXTURE_2D, s_Data.BloomTexture);
+}
 
-		DrawArrays(s_Data.BloomUpsamplerShader, s_Data.ScreenQuadVertexArray, 6);
+void Renderer::SetComputeBloom(bool enabled)
+{
+	s_Data.ComputeBloom = enabled;
+	if (enabled && s_Data.BloomDownsampleComputeShader == nullptr)
+	{
+		InitComputeBloomShaders();
 	}
-	GLCall(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
-	GLCall(glEnable(GL_DEPTH_TEST));
-	GLCall(glViewport(0, 0, viewportSize.x, viewportSize.y));
-	s_Data.BloomFBO->BindColorAttachment(0, 1);
+}
+
+bool Renderer::ComputeBloomEnabled()
+{
+	return s_Data.ComputeBloom;
 }
 
 void Renderer::SetBloomStrength(float strength)
 {
 	s_Data.ScreenQuadShader->Bind();
-	s_Data.ScreenQuadShader->SetUniform1f("u_BloomStrength", strength);
+	s_Data.ScreenQuadShader->SetUniform1f(s_Data.ScreenQuadBloomStrength, strength);
 }
 
 void Renderer::SetBloomThreshold(float threshold)
 {
+	s_Data.BloomThreshold = threshold;
+
 	s_Data.BloomDownsamplerShader->Bind();
-	s_Data.BloomDownsamplerShader->SetUniform1f("u_Threshold", threshold);
+	s_Data.BloomDownsamplerShader->SetUniform1f(s_Data.BloomDownsamplerThreshold, threshold);
+
+	if (s_Data.BloomDownsampleComputeShader != nullptr && s_Data.BloomDownsampleComputeShader->IsReady())
+	{
+		s_Data.BloomDownsampleComputeShader->Bind();
+		s_Data.BloomDownsampleComputeShader->SetUniform1f(s_Data.BloomComputeThreshold, threshold);
+	}
 }
 
 void Renderer::SetOffsetsRadius(float radius)
 {
+	// The editor sets it every frame, programs linked later pick it up in their OnLinked
+	if (s_Data.OffsetsRadius == radius)
+	{
+		return;
+	}
 	s_Data.OffsetsRadius = radius;
 	
-	s_Data.DefaultShader->Bind();
-	s_Data.DefaultShader->SetUniform1f("u_OffsetsRadius", radius);
-	
-	s_Data.G_LightShader->Bind();
-	s_Data.G_LightShader->SetUniform1f("u_OffsetsRadius", radius);
+	for (const std::shared_ptr<Shader>& variant : s_Data.DefaultVariants)
+	{
+		if (variant != nullptr && variant->IsReady())
+		{
+			variant->Bind();
+			variant->SetUniform1f("u_OffsetsRadius", radius);
+		}
+	}
 	
-	s_Data.G_PointLightShader->Bind();
-	s_Data.G_PointLightShader->SetUniform1f("u_OffsetsRadius", radius);
+	if (RenderModeReady(RenderMode::DEFERRED))
+	{
+		s_Data.G_LightShader->Bind();
+		s_Data.G_LightShader->SetUniform1f("u_OffsetsRadius", radius);
+
+		s_Data.G_PointLightShader->Bind();
+		s_Data.G_PointLightShader->SetUniform1f("u_OffsetsRadius", radius);
+	}
 }
 
-std::shared_ptr<Framebuffer> Renderer::CreateEnvCubemap(std::shared_ptr<Texture> hdrEnvMap, const glm::uvec2& faceSize)
+std::shared_ptr<Framebuffer> Renderer::CreateEnvCubemap(const std::string& hdrPath, const glm::uvec2& faceSize)
 {
-	// Mapping env map to a cubemap
+	Clock clock;
 	std::shared_ptr<Framebuffer> cfb = std::make_shared<Framebuffer>(1);
 	cfb->AddRenderbuffer({
 		.Type = RenderbufferType::DEPTH,
@@ -1436,6 +2039,43 @@ std::shared_ptr<Framebuffer> Renderer::CreateEnvCubemap(std::shared_ptr<Texture>
 		.Size = faceSize,
 		.GenMipmaps = true
 	});
+	cfb->AddColorAttachment({
+		.Type = ColorAttachmentType::TEX_CUBEMAP,
+		.Format = TextureFormat::RGB16F,
+		.Wrap = GL_CLAMP_TO_EDGE,
+		.MinFilter = GL_LINEAR,
+		.MagFilter = GL_LINEAR,
+		.Size = { s_Data.IrradianceSize, s_Data.IrradianceSize },
+		.GenMipmaps = false
+	});
+	cfb->AddColorAttachment({
+		.Type = ColorAttachmentType::TEX_CUBEMAP,
+		.Format = TextureFormat::RGB16F,
+		.Wrap = GL_CLAMP_TO_EDGE,
+		.MinFilter = GL_LINEAR_MIPMAP_LINEAR,
+		.MagFilter = GL_LINEAR,
+		.Size = { s_Data.PrefilterSize, s_Data.PrefilterSize },
+		.GenMipmaps = true
+	});
+
+	std::optional<std::filesystem::path> cachePath = IBLCache::EntryPath(hdrPath, faceSize);
+	if (cachePath.has_value())
+	{
+		if (std::optional<IBLData> cached = IBLCache::Read(cachePath.value()); cached.has_value())
+		{
+			IBLCache::Upload(cfb->GetColorAttachmentID(0), cached->Environment);
+			IBLCache::Upload(cfb->GetColorAttachmentID(1), cached->Irradiance);
+			IBLCache::Upload(cfb->GetColorAttachmentID(2), cached->Prefilter);
+			s_Data.IrradianceSH = cached->IrradianceSH;
+			s_Data.EnvironmentVersion++;
+
+			LOG_INFO("Loaded environment {} from cache in {}ms", hdrPath, clock.GetElapsedTime());
+			return cfb;
+		}
+	}
+
+	std::shared_ptr<Texture> hdrEnvMap = std::make_shared<Texture>(hdrPath, TextureFormat::BC6H);
+	hdrEnvMap->SetWrap(GL_CLAMP_TO_EDGE);
 
 	glm::mat4 captureProj = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 100.0f);
 	glm::mat4 captureViews[] = {
@@ -1449,6 +2089,17 @@ std::shared_ptr<Framebuffer> Renderer::CreateEnvCubemap(std::shared_ptr<Texture>
 	s_Data.CameraBuffer->Bind();
 	s_Data.CameraBuffer->SetData(glm::value_ptr(captureProj), sizeof(glm::mat4));
 
+	// Stages are timed on the CPU, finishing the GPU work queued by each of them
+	Clock stageClock;
+	auto stageTime = [&stageClock]()
+		{
+			GLCall(glFinish());
+			float time = stageClock.GetElapsedTime();
+			stageClock.Restart();
+			return time;
+		};
+
+	// Mapping env map to a cubemap
 	cfb->Bind();
 	cfb->BindRenderbuffer();
 	GLCall(glDrawBuffer(GL_COLOR_ATTACHMENT0));
@@ -1464,17 +2115,11 @@ std::shared_ptr<Framebuffer> Renderer::CreateEnvCubemap(std::shared_ptr<Texture>
 	}
 	cfb->BindColorAttachment(0);
 	GLCall(glGenerateMipmap(GL_TEXTURE_CUBE_MAP));
+	float mappingTime = stageTime();
 
 	// Irradiance map
-	cfb->AddColorAttachment({
-		.Type = ColorAttachmentType::TEX_CUBEMAP,
-		.Format = TextureFormat::RGB16F,
-		.Wrap = GL_CLAMP_TO_EDGE,
-		.MinFilter = GL_LINEAR,
-		.MagFilter = GL_LINEAR,
-		.Size = faceSize,
-		.GenMipmaps = false
-	});
+	cfb->ResizeRenderbuffer({ s_Data.IrradianceSize, s_Data.IrradianceSize });
+	cfb->BindRenderbuffer();
 	cfb->BindColorAttachment(0);
 	s_Data.IrradianceShader->Bind();
 	for (uint32_t i = 0; i < 6; i++)
@@ -1484,57 +2129,102 @@ std::shared_ptr<Framebuffer> Renderer::CreateEnvCubemap(std::shared_ptr<Texture>
 		Clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		DrawArrays(s_Data.IrradianceShader, s_Data.EnvMapVertexArray, 36);
 	}
+	float irradianceTime = stageTime();
 
-	cfb->AddColorAttachment({
-		.Type = ColorAttachmentType::TEX_CUBEMAP,
-		.Format = TextureFormat::RGB16F,
-		.Wrap = GL_CLAMP_TO_EDGE,
-		.MinFilter = GL_LINEAR_MIPMAP_LINEAR,
-		.MagFilter = GL_LINEAR,
-		.Size = { 128, 128 },
-		.GenMipmaps = true
-	});
-	GLCall(glViewport(0, 0, 128, 128));
-
-	// Reflection maps
+	// Reflection maps, one roughness step per mip
 	cfb->BindColorAttachment(0);
 	s_Data.PrefilterShader->Bind();
-	cfb->ResizeRenderbuffer({ 128, 128 });
-	s_Data.PrefilterShader->SetUniform1f("u_Roughness", 0.0f);
-	for (uint32_t i = 0; i < 6; i++)
+	s_Data.PrefilterShader->SetUniform1f("u_Resolution", (float)faceSize.x);
+	uint32_t prefilterMips = (uint32_t)std::log2(s_Data.PrefilterSize) + 1;
+	for (uint32_t mip = 0; mip < prefilterMips; mip++)
 	{
-		s_Data.CameraBuffer->SetData(glm::value_ptr(captureViews[i]), sizeof(glm::mat4), sizeof(glm::mat4));
-		cfb->DrawToCubeColorAttachment(2, 0, i);
-		Clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		DrawArrays(s_Data.PrefilterShader, s_Data.EnvMapVertexArray, 36);
+		uint32_t mipSize = s_Data.PrefilterSize >> mip;
+		cfb->ResizeRenderbuffer({ mipSize, mipSize });
+		cfb->BindRenderbuffer();
+
+		// Mirror-like mip 0 is a plain copy of the environment
+		float roughness = (float)mip / (float)(prefilterMips - 1);
+		s_Data.PrefilterShader->SetUniform1f("u_Roughness", roughness);
+		s_Data.PrefilterShader->SetUniform1i("u_SampleCount", mip == 0 ? 1 : s_Data.PrefilterSamples);
+		for (uint32_t i = 0; i < 6; i++)
+		{
+			s_Data.CameraBuffer->SetData(glm::value_ptr(captureViews[i]), sizeof(glm::mat4), sizeof(glm::mat4));
+			cfb->DrawToCubeColorAttachment(2, 0, i, mip);
+			Clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			DrawArrays(s_Data.PrefilterShader, s_Data.EnvMapVertexArray, 36);
+		}
 	}
-	GLCall(glGenerateMipmap(GL_TEXTURE_CUBE_MAP));
 	
 	cfb->ResizeRenderbuffer(faceSize);
 	cfb->BindRenderbuffer();
 	cfb->Unbind();
+	float prefilterTime = stageTime();
+
+	// SH9 only keeps the lowest frequencies, a small mip projects just as well as the full face
+	uint32_t shMip = (uint32_t)std::max(std::log2((float)faceSize.x / s_Data.IrradianceSHSourceSize), 0.0f);
+	int32_t shFaceSize = std::max((int32_t)faceSize.x >> shMip, 1);
+	s_Data.IrradianceSH = SphericalHarmonics::ProjectIrradiance(IBLCache::DownloadFloat(cfb->GetColorAttachmentID(0), shMip).data(), shFaceSize);
+	s_Data.EnvironmentVersion++;
+
+	if (cachePath.has_value())
+	{
+		IBLData data{};
+		data.Environment = IBLCache::Download(cfb->GetColorAttachmentID(0));
+		data.Irradiance = IBLCache::Download(cfb->GetColorAttachmentID(1));
+		data.Prefilter = IBLCache::Download(cfb->GetColorAttachmentID(2));
+		data.IrradianceSH = s_Data.IrradianceSH;
+		IBLCache::Write(cachePath.value(), data);
+	}
+	float cachingTime = stageTime();
+
+	LOG_INFO("Baked environment {} ({}x{} faces) in {}ms: cubemap {}ms, irradiance {}ms, prefilter {}ms, SH and caching {}ms",
+		hdrPath, faceSize.x, faceSize.y, clock.GetElapsedTime(), mappingTime, irradianceTime, prefilterTime, cachingTime);
 	return cfb;
 }
 
 void Renderer::DrawSkybox(std::shared_ptr<Framebuffer> cfb)
 {
 	cfb->BindColorAttachment(0);
-	GLCall(glDepthFunc(GL_LEQUAL));
+	GLState::DepthFunc(GL_LEQUAL);
 	DrawArrays(s_Data.SkyboxShader, s_Data.EnvMapVertexArray, 36);
-	GLCall(glDepthFunc(GL_LESS));
+	GLState::DepthFunc(GL_LESS);
 
 	cfb->BindColorAttachment(1, s_Data.IrradianceSlot);
 	cfb->BindColorAttachment(2, s_Data.PrefilterSlot);
 	s_Data.BRDF_Map->Bind(s_Data.BRDF_Slot);
-	s_Data.DefaultShader->Bind();
-	s_Data.DefaultShader->SetUniform1i("u_IrradianceMap", s_Data.IrradianceSlot);
-	s_Data.DefaultShader->SetUniform1i("u_PrefilterMap", s_Data.PrefilterSlot);
-	s_Data.DefaultShader->SetUniform1i("u_BRDF_LUT", s_Data.BRDF_Slot);
+	for (uint32_t features = 0; features < MaterialVariants; features++)
+	{
+		const std::shared_ptr<Shader>& variant = s_Data.DefaultVariants[features];
+		if (variant != nullptr && variant->IsReady())
+		{
+			UploadEnvironment(*variant, s_Data.DefaultVariantUniforms[features].Environment);
+		}
+	}
 
-	s_Data.G_LightShader->Bind();
-	s_Data.G_LightShader->SetUniform1i("u_IrradianceMap", s_Data.IrradianceSlot);
-	s_Data.G_LightShader->SetUniform1i("u_PrefilterMap", s_Data.PrefilterSlot);
-	s_Data.G_LightShader->SetUniform1i("u_BRDF_LUT", s_Data.BRDF_Slot);
+	// Still compiling deferred programs pick the environment up once they're linked
+	if (RenderModeReady(RenderMode::DEFERRED))
+	{
+		UploadEnvironment(*s_Data.G_LightShader, s_Data.G_LightEnvironment);
+	}
+}
+
+void Renderer::SetIrradianceSH(bool enabled)
+{
+	if (s_Data.UseIrradianceSH != enabled)
+	{
+		s_Data.UseIrradianceSH = enabled;
+		s_Data.EnvironmentVersion++;
+	}
+}
+
+bool Renderer::IrradianceSH()
+{
+	return s_Data.UseIrradianceSH;
+}
+
+void Renderer::SetVirtualTextureFeedback(bool enabled)
+{
+	s_Data.DrawFeedback = enabled;
 }
 
 void Renderer::AddDirectionalLight(const TransformComponent& transform, const DirectionalLightComponent& light)
@@ -1666,47 +2356,47 @@ void Renderer::AddSpotLight(const TransformComponent& transform, const SpotLight
 
 void Renderer::EnableStencil()
 {
-	GLCall(glEnable(GL_STENCIL_TEST));
+	GLState::Enable(GL_STENCIL_TEST);
 }
 
 void Renderer::DisableStencil()
 {
-	GLCall(glDisable(GL_STENCIL_TEST));
+	GLState::Disable(GL_STENCIL_TEST);
 }
 
 void Renderer::SetStencilFunc(uint32_t func, int32_t ref, uint32_t mask)
 {
-	GLCall(glStencilFunc(func, ref, mask));
+	GLState::StencilFunc(func, ref, mask);
 }
 
 void Renderer::SetStencilMask(uint32_t mask)
 {
-	GLCall(glStencilMask(mask));
+	GLState::StencilMask(mask);
 }
 
 void Renderer::EnableDepthTest()
 {
-	GLCall(glEnable(GL_DEPTH_TEST));
+	GLState::Enable(GL_DEPTH_TEST);
 }
 
 void Renderer::DisableDepthTest()
 {
-	GLCall(glDisable(GL_DEPTH_TEST));
+	GLState::Disable(GL_DEPTH_TEST);
 }
 
 void Renderer::EnableFaceCulling()
 {
-	GLCall(glEnable(GL_CULL_FACE));
+	GLState::Enable(GL_CULL_FACE);
 }
 
 void Renderer::DisableFaceCulling()
 {
-	GLCall(glDisable(GL_CULL_FACE));
+	GLState::Disable(GL_CULL_FACE);
 }
 
 void Renderer::SetWireframe(bool enabled)
 {
-	GLCall(glPolygonMode(GL_FRONT_AND_BACK, enabled ? GL_LINE : GL_FILL));
+	GLState::PolygonMode(enabled ? GL_LINE : GL_FILL);
 }
 
 Viewport Renderer::CurrentViewport()
@@ -1727,12 +2417,15 @@ G_BuffersIDs Renderer::G_Buffers()
 
 void Renderer::StartBatch()
 {
+	s_Data.Batch++;
 	s_Data.InstancesCount = 0;
 	for (auto& [meshID, data] : s_Data.MeshesData)
 	{
 		data.CurrentInstancesCount = 0;
-		data.Instances.clear();
-		data.Instances.reserve(s_Data.MaxInstancesOfType);
+		for (std::vector<MeshInstance>& instances : data.Instances)
+		{
+			instances.clear();
+		}
 	}
 
 	s_Data.LineVertexCount = 0;
@@ -1744,24 +2437,197 @@ void Renderer::StartBatch()
 	s_Data.SpotlightsData.clear();
 
 	s_Data.BoundTexturesCount = 0;
+	s_Data.UsesVirtualTextures = false;
 }
 
 void Renderer::NextBatch()
 {
 	Flush();
 
+	s_Data.Batch++;
 	s_Data.InstancesCount = 0;
 	for (auto& [meshID, data] : s_Data.MeshesData)
 	{
 		data.CurrentInstancesCount = 0;
-		data.Instances.clear();
-		data.Instances.reserve(s_Data.MaxInstancesOfType);
+		for (std::vector<MeshInstance>& instances : data.Instances)
+		{
+			instances.clear();
+		}
 	}
 
 	s_Data.MaterialsData.clear();
 	s_Data.LineVertexCount = 0;
 	s_Data.LineBufferPtr = s_Data.LineBufferBase;
 	s_Data.BoundTexturesCount = 0;
+	s_Data.UsesVirtualTextures = false;
+}
+
+void Renderer::ResizeBloomChain(const glm::ivec2& sourceSize)
+{
+	if (!s_Data.BloomMipSizes.empty())
+	{
+		LOG_INFO("Bloom chain for {}x{} took {:.3f}ms fragment, {:.3f}ms compute", s_Data.BloomSourceSize.x, s_Data.BloomSourceSize.y,
+			s_Data.BloomFragmentTimer->LastTime(), s_Data.BloomComputeTimer->LastTime());
+	}
+
+	// Textures of the old sizes go back to the pool and are deleted once they've been idle for a while
+	s_Data.BloomSourceSize = sourceSize;
+	s_Data.BloomMipSizes.clear();
+	uint64_t memory = 0;
+
+	// Every mip respects the minimum size, a source too small for even the first one gets no bloom at all
+	glm::ivec2 mipSize = sourceSize / 2;
+	while (s_Data.BloomMipSizes.size() < s_Data.BloomMaxMips && glm::min(mipSize.x, mipSize.y) >= s_Data.BloomMinMipSize)
+	{
+		s_Data.BloomMipSizes.push_back(mipSize);
+		memory += TexturePool::TextureSize(mipSize, TextureFormat::R11_G11_B10);
+		mipSize /= 2;
+	}
+
+	if (s_Data.BloomMipSizes.empty())
+	{
+		LOG_INFO("Bloom chain for {}x{}: below the {}px minimum mip size, bloom is skipped", sourceSize.x, sourceSize.y, s_Data.BloomMinMipSize);
+		return;
+	}
+
+	glm::ivec2 smallest = s_Data.BloomMipSizes.back();
+	LOG_INFO("Bloom chain for {}x{}: {} mips down to {}x{}, {:.2f}MB", sourceSize.x, sourceSize.y,
+		s_Data.BloomMipSizes.size(), smallest.x, smallest.y, memory / (1024.0f * 1024.0f));
+}
+
+void Renderer::FragmentBloom(RenderGraph& graph, RenderGraphResource source, std::vector<RenderGraphResource>& mips)
+{
+	for (uint32_t i = 0; i < mips.size(); i++)
+	{
+		graph.AddPass("Bloom downsample",
+			[&, i](RenderGraphBuilder& builder)
+			{
+				builder.Read(i == 0 ? source : mips[i - 1]);
+				mips[i] = builder.Create("Bloom mip", { s_Data.BloomMipSizes[i], TextureFormat::R11_G11_B10 });
+			},
+			[&mips, source, i](const RenderGraph& graph)
+			{
+				RenderGraphResource input = i == 0 ? source : mips[i - 1];
+				glm::ivec2 size = graph.Desc(mips[i]).Size;
+
+				s_Data.BloomDownsamplerShader->Bind();
+				s_Data.BloomDownsamplerShader->SetUniform2f(s_Data.BloomDownsamplerResolution, graph.Desc(input).Size);
+				s_Data.BloomDownsamplerShader->SetUniformBool(s_Data.BloomDownsamplerFirstMip, i == 0);
+				GLState::BindTexture(0, GL_TEXTURE_2D, graph.Texture(input));
+
+				s_Data.BloomFBO->DrawToTexture(graph.Texture(mips[i]), 0);
+				GLCall(glDrawBuffer(GL_COLOR_ATTACHMENT0));
+				GLState::Disable(GL_DEPTH_TEST);
+				GLCall(glViewport(0, 0, size.x, size.y));
+
+				DrawArrays(s_Data.BloomDownsamplerShader, s_Data.ScreenQuadVertexArray, 6);
+			});
+	}
+
+	for (uint32_t i = (uint32_t)mips.size() - 1; i > 0; i--)
+	{
+		graph.AddPass("Bloom upsample",
+			[&, i](RenderGraphBuilder& builder)
+			{
+				builder.Read(mips[i]);
+				mips[i - 1] = builder.Write(mips[i - 1]);
+			},
+			[&mips, i](const RenderGraph& graph)
+			{
+				glm::ivec2 size = graph.Desc(mips[i - 1]).Size;
+
+				s_Data.BloomUpsamplerShader->Bind();
+				GLState::BindTexture(0, GL_TEXTURE_2D, graph.Texture(mips[i]));
+
+				s_Data.BloomFBO->DrawToTexture(graph.Texture(mips[i - 1]), 0);
+				GLState::BlendFunc(GL_ONE, GL_ONE);
+				GLState::BlendEquation(GL_FUNC_ADD);
+				GLCall(glViewport(0, 0, size.x, size.y));
+
+				DrawArrays(s_Data.BloomUpsamplerShader, s_Data.ScreenQuadVertexArray, 6);
+			});
+	}
+}
+
+void Renderer::ComputeBloom(RenderGraph& graph, RenderGraphResource source, std::vector<RenderGraphResource>& mips)
+{
+	auto bindImages = [&mips](const RenderGraph& graph)
+		{
+			for (uint32_t i = 0; i < mips.size(); i++)
+			{
+				GLCall(glBindImageTexture(i, graph.Texture(mips[i]), 0, GL_FALSE, 0, GL_READ_WRITE, GL_R11F_G11F_B10F));
+			}
+		};
+
+	graph.AddPass("Bloom downsample",
+		[&](RenderGraphBuilder& builder)
+		{
+			builder.Read(source);
+			for (uint32_t i = 0; i < mips.size(); i++)
+			{
+				mips[i] = builder.Create("Bloom mip", { s_Data.BloomMipSizes[i], TextureFormat::R11_G11_B10 });
+			}
+		},
+		[&mips, source, bindImages](const RenderGraph& graph)
+		{
+			bindImages(graph);
+
+			// Every workgroup reduces a 64x64 tile of the first mip
+			glm::ivec2 groups = (graph.Desc(mips[0]).Size + 63) / 64;
+			s_Data.BloomDownsampleComputeShader->Bind();
+			s_Data.BloomDownsampleComputeShader->SetUniform2f(s_Data.BloomComputeResolution, graph.Desc(source).Size);
+			s_Data.BloomDownsampleComputeShader->SetUniform1i(s_Data.BloomComputeMipCount, (int32_t)mips.size());
+			s_Data.BloomCounterBuffer->BindBufferSlot(0);
+			GLState::BindTexture(0, GL_TEXTURE_2D, graph.Texture(source));
+			GLCall(glDispatchCompute(groups.x, groups.y, 1));
+		});
+
+	graph.AddPass("Bloom upsample",
+		[&](RenderGraphBuilder& builder)
+		{
+			builder.Read(mips.back());
+			for (uint32_t i = 0; i + 1 < mips.size(); i++)
+			{
+				mips[i] = builder.Write(mips[i]);
+			}
+		},
+		[&mips, bindImages](const RenderGraph& graph)
+		{
+			bindImages(graph);
+			s_Data.BloomUpsampleComputeShader->Bind();
+
+			int32_t level = (int32_t)mips.size() - 1;
+			int32_t fusedTarget = level;
+			while (fusedTarget > 0 && glm::all(glm::lessThanEqual(graph.Desc(mips[fusedTarget - 1]).Size, glm::ivec2(s_Data.BloomFusedUpsampleSize))))
+			{
+				fusedTarget--;
+			}
+
+			if (fusedTarget < level)
+			{
+				GLCall(glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT));
+				s_Data.BloomUpsampleComputeShader->SetUniformBool(s_Data.BloomUpsampleFused, true);
+				s_Data.BloomUpsampleComputeShader->SetUniform1i(s_Data.BloomUpsampleSourceMip, level);
+				s_Data.BloomUpsampleComputeShader->SetUniform1i(s_Data.BloomUpsampleTargetMip, fusedTarget);
+				GLCall(glDispatchCompute(1, 1, 1));
+				level = fusedTarget;
+			}
+
+			s_Data.BloomUpsampleComputeShader->SetUniformBool(s_Data.BloomUpsampleFused, false);
+			for (; level > 0; level--)
+			{
+				GLCall(glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT));
+				GLState::BindTexture(0, GL_TEXTURE_2D, graph.Texture(mips[level]));
+				s_Data.BloomUpsampleComputeShader->SetUniform1i(s_Data.BloomUpsampleSourceMip, level);
+				s_Data.BloomUpsampleComputeShader->SetUniform1i(s_Data.BloomUpsampleTargetMip, level - 1);
+
+				glm::ivec2 targetGroups = (graph.Desc(mips[level - 1]).Size + 15) / 16;
+				GLCall(glDispatchCompute(targetGroups.x, targetGroups.y, 1));
+			}
+
+			// The screen quad samples the first mip
+			GLCall(glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT));
+		});
 }
 
 void Renderer::ForwardRender()
@@ -1774,9 +2640,27 @@ void Renderer::ForwardRender()
 		}
 
 		Mesh& mesh = AssetManager::GetMesh(meshID);
-		mesh.InstanceBuffer->SetData(meshData.Instances.data(), meshData.CurrentInstancesCount * sizeof(MeshInstance));
-		DrawIndexedInstanced(s_Data.CurrentShader, mesh.VAO, meshData.CurrentInstancesCount);
-		s_Data.Stats.RenderPassDrawCalls++;
+		UploadInstances(mesh, meshData);
+		if (s_Data.CurrentShader != s_Data.DefaultShader)
+		{
+			DrawIndexedInstanced(s_Data.CurrentShader, mesh.VAO, meshData.CurrentInstancesCount);
+			s_Data.Stats.RenderPassDrawCalls++;
+			continue;
+		}
+
+		uint32_t baseInstance = 0;
+		for (uint32_t features = 0; features < MaterialVariants; features++)
+		{
+			uint32_t count = (uint32_t)meshData.Instances[features].size();
+			if (count == 0)
+			{
+				continue;
+			}
+
+			DrawIndexedInstanced(ReadyVariant(s_Data.DefaultVariants, features), mesh.VAO, count, GL_TRIANGLES, baseInstance);
+			s_Data.Stats.RenderPassDrawCalls++;
+			baseInstance += count;
+		}
 	}
 
 	if (s_Data.LineVertexCount)
@@ -1784,9 +2668,9 @@ void Renderer::ForwardRender()
 		uint32_t dataSize = (uint32_t)((uint8_t*)s_Data.LineBufferPtr - (uint8_t*)s_Data.LineBufferBase);
 		s_Data.LineVertexBuffer->SetData(s_Data.LineBufferBase, dataSize);
 
-		GLCall(glDisable(GL_CULL_FACE));
+		GLState::Disable(GL_CULL_FACE);
 		DrawArrays(s_Data.LineShader, s_Data.LineVertexArray, s_Data.LineVertexCount, GL_LINES);
-		GLCall(glEnable(GL_CULL_FACE));
+		GLState::Enable(GL_CULL_FACE);
 		s_Data.Stats.RenderPassDrawCalls++;
 	}
 }
@@ -1802,9 +2686,9 @@ void Renderer::DeferredRender()
 	s_Data.G_FBO->DrawToColorAttachment(3, 3);
 	s_Data.G_FBO->FillDrawBuffers();
 	
-	GLCall(glDepthMask(GL_TRUE));
-	GLCall(glDisable(GL_BLEND));
-	GLCall(glCullFace(GL_BACK));
+	GLState::DepthMask(true);
+	GLState::Disable(GL_BLEND);
+	GLState::CullFace(GL_BACK);
 	Renderer::ClearColor(glm::vec4(0.0f));
 	Renderer::Clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	Renderer::EnableDepthTest();
@@ -1817,10 +2701,22 @@ void Renderer::DeferredRender()
 		}
 
 		Mesh& mesh = AssetManager::GetMesh(meshID);
-		mesh.InstanceBuffer->SetData(meshData.Instances.data(), meshData.CurrentInstancesCount * sizeof(MeshInstance));
-		DrawIndexedInstanced(s_Data.G_PassShader, mesh.VAO, meshData.CurrentInstancesCount);
+		UploadInstances(mesh, meshData);
+
+		uint32_t baseInstance = 0;
+		for (uint32_t features = 0; features < MaterialVariants; features++)
+		{
+			uint32_t count = (uint32_t)meshData.Instances[features].size();
+			if (count == 0)
+			{
+				continue;
+			}
+
+			DrawIndexedInstanced(ReadyVariant(s_Data.G_PassVariants, features), mesh.VAO, count, GL_TRIANGLES, baseInstance);
+			baseInstance += count;
+		}
 	}
-	GLCall(glDepthMask(GL_FALSE));
+	GLState::DepthMask(false);
 
 	// Point light pass
 	s_Data.G_FBO->BindColorAttachment(0, 0);
@@ -1846,27 +2742,27 @@ void Renderer::DeferredRender()
 		Renderer::DisableFaceCulling();
 		Renderer::Clear(GL_STENCIL_BUFFER_BIT);
 		Renderer::SetStencilFunc(GL_ALWAYS, 0, 0);
-		GLCall(glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP));
-		GLCall(glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP));
+		GLState::StencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+		GLState::StencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
 		GLCall(glDrawBuffer(GL_NONE));
 
 		s_Data.G_PassThrough->Bind();
-		s_Data.G_PassThrough->SetUniformMat4("u_Transform", tc.ToMat4());
+		s_Data.G_PassThrough->SetUniformMat4(s_Data.G_PassThroughTransform, tc.ToMat4());
 		DrawIndexed(s_Data.G_PassThrough, mesh.VAO);
 
 		// Color pass
 		Renderer::DisableDepthTest();
 		Renderer::EnableFaceCulling();
 		Renderer::SetStencilFunc(GL_NOTEQUAL, 0, 0xFF);
-		GLCall(glEnable(GL_BLEND));
-		GLCall(glBlendEquation(GL_FUNC_ADD));
-		GLCall(glBlendFunc(GL_ONE, GL_ONE));
-		GLCall(glCullFace(GL_FRONT));
+		GLState::Enable(GL_BLEND);
+		GLState::BlendEquation(GL_FUNC_ADD);
+		GLState::BlendFunc(GL_ONE, GL_ONE);
+		GLState::CullFace(GL_FRONT);
 		GLCall(glDrawBuffer(GL_COLOR_ATTACHMENT0));
 	
 		s_Data.G_PointLightShader->Bind();
-		s_Data.G_PointLightShader->SetUniformMat4("u_Transform", tc.ToMat4());
-		s_Data.G_PointLightShader->SetUniform1i("u_LightID", i);
+		s_Data.G_PointLightShader->SetUniformMat4(s_Data.G_PointLightTransform, tc.ToMat4());
+		s_Data.G_PointLightShader->SetUniform1i(s_Data.G_PointLightID, (int32_t)i);
 		DrawIndexed(s_Data.G_PointLightShader, mesh.VAO);
 	}
 
@@ -1877,12 +2773,36 @@ void Renderer::DeferredRender()
 	s_TargetFBO->Bind();
 	s_TargetFBO->BindRenderbuffer();
 	s_TargetFBO->DrawToColorAttachment(0, 0);
-	s_TargetFBO->DrawToColorAttachment(1, 1);
-	s_TargetFBO->FillDrawBuffers();
-	
-	GLCall(glCullFace(GL_BACK));
-	GLCall(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+	GLCall(glDrawBuffer(GL_COLOR_ATTACHMENT0));
+
+	GLState::CullFace(GL_BACK);
+	GLState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	DrawArrays(s_Data.G_LightShader, s_Data.ScreenQuadVertexArray, 6);
-	GLCall(glDepthMask(GL_TRUE));
+	GLState::DepthMask(true);
 	Renderer::EnableDepthTest();
 }
+
+void Renderer::FeedbackRender()
+{
+	uint32_t previousFBO = GLState::DrawFramebuffer();
+	bool depthMask = GLState::DepthMaskEnabled();
+	int32_t viewport[4]{};
+	GLCall(glGetIntegerv(GL_VIEWPORT, viewport));
+
+	// Instance buffers were already filled by the render pass
+	std::shared_ptr<Shader> shader = VirtualTexturing::BeginFeedback({ viewport[2], viewport[3] });
+	for (auto& [meshID, meshData] : s_Data.MeshesData)
+	{
+		if (meshData.CurrentInstancesCount == 0)
+		{
+			continue;
+		}
+
+		Mesh& mesh = AssetManager::GetMesh(meshID);
+		DrawIndexedInstanced(shader, mesh.VAO, meshData.CurrentInstancesCount);
+	}
+
+	GLState::BindFramebuffer(GL_FRAMEBUFFER, previousFBO);
+	GLCall(glViewport(viewport[0], viewport[1], viewport[2], viewport[3]));
+	GLState::DepthMask(depthMask);
+}
@@ -2,8 +2,11 @@
 
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "OpenGL.hpp"
+#include "RenderGraph.hpp"
 #include "../scenes/Components.hpp"
 
 class Shader;
@@ -29,6 +32,12 @@ struct RendererStats
 	float DirLightShadowPassTime = 0.0f;
 	float PointLightShadowPassTime = 0.0f;
 	float SpotlightShadowPassTime = 0.0f;
+	float BloomFragmentTime = 0.0f;
+	float BloomComputeTime = 0.0f;
+	uint32_t BloomMips = 0;
+	uint64_t BloomMemory = 0;
+	uint32_t StateChanges = 0;
+	uint32_t StateChangesAvoided = 0;
 };
 
 struct G_BuffersIDs
@@ -40,6 +49,15 @@ struct G_BuffersIDs
 	uint32_t G_Lights;
 };
 
+// A mesh instance recorded without touching the renderer, so worker threads can each fill a bucket of their own
+struct MeshCommand
+{
+	glm::mat4 Transform;
+	int32_t MeshID;
+	int32_t MaterialID;
+	int32_t EntityID;
+};
+
 enum class RenderMode
 {
 	FORWARD = 0,
@@ -55,7 +73,10 @@ public:
 	static void Init();
 	static void Shutdown();
 
+	// Programs keep rendering with the previous version until the new one links, and don't swap at all when it fails
 	static void ReloadShaders();
+	// Only the programs built from files in resources/shaders that changed since the last call
+	static void ReloadChangedShaders();
 
 	static void OnWindowResize(const Viewport& newViewport);
 
@@ -76,25 +97,42 @@ public:
 	static void DrawCube(const glm::mat4& transform, const glm::vec4& color);
 
 	static void SubmitMesh(const glm::mat4& transform, const MeshComponent& mesh, const Material& material, int32_t entityID);
+	// Merges the buckets and sorts them by material and mesh, so each run of a material sets up its textures once
+	static void SubmitMeshes(const std::vector<std::vector<MeshCommand>>& buckets, const std::unordered_map<int32_t, Material>& materials);
 
 	static void DrawIndexed(const std::shared_ptr<Shader>& shader, const std::shared_ptr<VertexArray>& vao, uint32_t primitiveType = GL_TRIANGLES);
-	static void DrawIndexedInstanced(const std::shared_ptr<Shader>& shader, const std::shared_ptr<VertexArray>& vao, uint32_t instances, uint32_t primitiveType = GL_TRIANGLES);
+	static void DrawIndexedInstanced(const std::shared_ptr<Shader>& shader, const std::shared_ptr<VertexArray>& vao, uint32_t instances, uint32_t primitiveType = GL_TRIANGLES, uint32_t baseInstance = 0);
 	static void DrawArrays(const std::shared_ptr<Shader>& shader, const std::shared_ptr<VertexArray>& vao, uint32_t vertexCount, uint32_t primitiveType = GL_TRIANGLES);
 	static void DrawArraysInstanced(const std::shared_ptr<Shader>& shader, const std::shared_ptr<VertexArray>& vao, uint32_t instances, uint32_t primitiveType = GL_TRIANGLES);
 	static void DrawScreenQuad();
 
 	static void SetRenderMode(RenderMode pipeline);
+	// Modes other than the default one compile their programs on first use and render forward meanwhile.
+	// Material variants compile once a submitted material needs them, the program with every feature draws in their place until then
+	static bool RenderModeReady(RenderMode mode);
 	static void SetTargetFBO(std::shared_ptr<Framebuffer>& fbo);
 
 	static void Bloom(std::shared_ptr<Framebuffer> hdrFBO);
 	static void SetBloomStrength(float strength);
 	static void SetBloomThreshold(float threshold);
 
+	// Compute path builds the downsample chain in a single dispatch, both paths are timed on the GPU
+	static void SetComputeBloom(bool enabled);
+	static bool ComputeBloomEnabled();
+
 	static void SetOffsetsRadius(float radius);
 
-	static std::shared_ptr<Framebuffer> CreateEnvCubemap(std::shared_ptr<Texture> hdrEnvMap, const glm::uvec2& faceSize = { 512, 512 });
+	// Loads every cubemap from the disk cache when the source and face size match an earlier bake, bakes and caches them otherwise
+	static std::shared_ptr<Framebuffer> CreateEnvCubemap(const std::string& hdrPath, const glm::uvec2& faceSize = { 512, 512 });
 	static void DrawSkybox(std::shared_ptr<Framebuffer> cfb);
 
+	// Diffuse environment lighting from the SH9 projection of the last created environment instead of its irradiance cubemap
+	static void SetIrradianceSH(bool enabled);
+	static bool IrradianceSH();
+
+	// Flushes draw the virtual texture feedback after the scene, passes that don't show the scene like the editor's ID pass turn it off
+	static void SetVirtualTextureFeedback(bool enabled);
+
 	static void AddDirectionalLight(const TransformComponent& transform, const DirectionalLightComponent& light);
 	static void AddPointLight(const glm::vec3& position, const PointLightComponent& light);
 	static void AddSpotLight(const TransformComponent& transform, const SpotLightComponent& light);
@@ -118,9 +156,19 @@ public:
 private:
 	static void StartBatch();
 	static void NextBatch();
+	static int32_t AddMaterial(const Material& material);
+
+	static void InitDeferredShaders();
+	static void InitComputeBloomShaders();
 
 	static void ForwardRender();
 	static void DeferredRender();
+	static void FeedbackRender();
+
+	static void ResizeBloomChain(const glm::ivec2& sourceSize);
+	// Add the bloom passes to the graph, the mips end up holding the latest version of every level
+	static void FragmentBloom(RenderGraph& graph, RenderGraphResource source, std::vector<RenderGraphResource>& mips);
+	static void ComputeBloom(RenderGraph& graph, RenderGraphResource source, std::vector<RenderGraphResource>& mips);
 
 	static Camera* s_ActiveCamera;
 	static Viewport s_Viewport;
@@ -0,0 +1,151 @@
+#include "ShaderCache.hpp"
+#include "OpenGL.hpp"
+#include "../Logger.hpp"
+#include "../RandomUtils.hpp"
+
+#include <fstream>
+#include <algorithm>
+
+static const std::filesystem::path CACHE_DIRECTORY = "resources/cache/shaders";
+static constexpr uint32_t CACHE_MAGIC = 0x43444853; // "SHDC"
+static constexpr uint32_t CACHE_VERSION = 1;
+
+std::filesystem::path ShaderCache::EntryPath(std::initializer_list<std::string_view> sources, std::string_view driver)
+{
+	uint64_t hash = FNV1a(driver.data(), driver.size());
+	for (std::string_view source : sources)
+	{
+		// Lengths keep the stage boundaries apart, moving text from one stage to the next changes the key
+		uint64_t length = source.size();
+		hash = FNV1a(&length, sizeof(length), hash);
+		hash = FNV1a(source.data(), source.size(), hash);
+	}
+
+	char fileName[32]{};
+	snprintf(fileName, sizeof(fileName), "%016llx.bin", (unsigned long long)hash);
+	return CACHE_DIRECTORY / fileName;
+}
+
+std::optional<ProgramBinary> ShaderCache::Read(const std::filesystem::path& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+	{
+		return std::nullopt;
+	}
+
+	uint32_t header[4]{};
+	file.read((char*)header, sizeof(header));
+	if (!file || header[0] != CACHE_MAGIC || header[1] != CACHE_VERSION || header[3] == 0)
+	{
+		return std::nullopt;
+	}
+
+	// The length on disk isn't trusted further than the file goes
+	std::error_code ec;
+	uint64_t fileSize = std::filesystem::file_size(path, ec);
+	if (ec || header[3] > fileSize - sizeof(header))
+	{
+		LOG_WARN("Corrupted shader cache entry {}, compiling again", path.string());
+		return std::nullopt;
+	}
+
+	ProgramBinary binary{ header[2] };
+	binary.Data.resize(header[3]);
+	file.read((char*)binary.Data.data(), binary.Data.size());
+	if (!file)
+	{
+		LOG_WARN("Corrupted shader cache entry {}, compiling again", path.string());
+		return std::nullopt;
+	}
+
+	return binary;
+}
+
+bool ShaderCache::Write(const std::filesystem::path& path, const ProgramBinary& binary)
+{
+	std::error_code ec;
+	std::filesystem::create_directories(path.parent_path(), ec);
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open())
+	{
+		LOG_WARN("Failed to write shader cache entry {}", path.string());
+		return false;
+	}
+
+	uint32_t header[4] = { CACHE_MAGIC, CACHE_VERSION, binary.Format, (uint32_t)binary.Data.size() };
+	file.write((const char*)header, sizeof(header));
+	file.write((const char*)binary.Data.data(), binary.Data.size());
+
+	return (bool)file;
+}
+
+std::string ShaderCache::Driver()
+{
+	std::string driver{};
+	for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+	{
+		GLCall(const char* value = (const char*)glGetString(name));
+		driver += value != nullptr ? value : "";
+		driver += '\n';
+	}
+
+	return driver;
+}
+
+uint32_t ShaderCache::Load(const ProgramBinary& binary)
+{
+	int32_t formatCount = 0;
+	GLCall(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount));
+	std::vector<int32_t> formats(formatCount);
+	if (formatCount > 0)
+	{
+		GLCall(glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data()));
+	}
+
+	if (std::find(formats.begin(), formats.end(), (int32_t)binary.Format) == formats.end())
+	{
+		return 0;
+	}
+
+	// A stale or damaged binary fails the link, some drivers raise an error on top of that which isn't worth a break
+	GLCall(uint32_t program = glCreateProgram());
+	glProgramBinary(program, binary.Format, binary.Data.data(), (GLsizei)binary.Data.size());
+	GLClearErrors();
+
+	int32_t success = 0;
+	GLCall(glGetProgramiv(program, GL_LINK_STATUS, &success));
+	if (success == GL_FALSE)
+	{
+		GLCall(glDeleteProgram(program));
+		return 0;
+	}
+
+	return program;
+}
+
+std::optional<ProgramBinary> ShaderCache::Download(uint32_t program)
+{
+	int32_t length = 0;
+	GLCall(glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length));
+	if (length <= 0)
+	{
+		return std::nullopt;
+	}
+
+	ProgramBinary binary{};
+	binary.Data.resize(length);
+	GLCall(glGetProgramBinary(program, length, &length, &binary.Format, binary.Data.data()));
+	binary.Data.resize(length);
+
+	return binary;
+}
+
+bool ShaderCache::Supported()
+{
+	int32_t formatCount = 0;
+	GLCall(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount));
+
+	return formatCount > 0;
+}
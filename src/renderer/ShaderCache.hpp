@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <filesystem>
+#include <initializer_list>
+
+struct ProgramBinary
+{
+	uint32_t Format = 0;
+	std::vector<uint8_t> Data;
+};
+
+class ShaderCache
+{
+public:
+	// Keyed by the final source of every stage, in order, and the driver that built the program
+	static std::filesystem::path EntryPath(std::initializer_list<std::string_view> sources, std::string_view driver);
+
+	static std::optional<ProgramBinary> Read(const std::filesystem::path& path);
+	static bool Write(const std::filesystem::path& path, const ProgramBinary& binary);
+
+	// Vendor, renderer and version strings of the current context, binaries don't survive a change to any of them
+	static std::string Driver();
+
+	// Program linked from the binary, 0 if the driver doesn't accept the format or rejects the data
+	static uint32_t Load(const ProgramBinary& binary);
+	static std::optional<ProgramBinary> Download(uint32_t program);
+
+	// The driver has to expose at least one binary format for the cache to be used at all
+	static bool Supported();
+};
@@ -0,0 +1,210 @@
+#include "SphericalHarmonics.hpp"
+#include "../JobSystem.hpp"
+
+#include <glm/gtc/constants.hpp>
+
+#include <cmath>
+#include <mutex>
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define SH_SSE 1
+#endif
+
+// Cosine lobe convolution of each band divided by pi
+static constexpr float BAND_SCALE[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+
+static void Basis(float x, float y, float z, float* basis)
+{
+	basis[0] = 0.282095f;
+	basis[1] = 0.488603f * y;
+	basis[2] = 0.488603f * z;
+	basis[3] = 0.488603f * x;
+	basis[4] = 1.092548f * x * y;
+	basis[5] = 1.092548f * y * z;
+	basis[6] = 0.315392f * (3.0f * z * z - 1.0f);
+	basis[7] = 1.092548f * x * z;
+	basis[8] = 0.546274f * (x * x - y * y);
+}
+
+// Unnormalized direction through the texel at u, v in [-1, 1], following the GL cube map face selection table
+static void FaceDirection(uint32_t face, float u, float v, float& x, float& y, float& z)
+{
+	switch (face)
+	{
+	case 0: x =  1.0f; y = -v;	  z = -u;	 break;
+	case 1: x = -1.0f; y = -v;	  z =  u;	 break;
+	case 2: x =  u;	   y =  1.0f; z =  v;	 break;
+	case 3: x =  u;	   y = -1.0f; z = -v;	 break;
+	case 4: x =  u;	   y = -v;	  z =  1.0f; break;
+	default: x = -u;   y = -v;	  z = -1.0f; break;
+	}
+}
+
+struct SHAccumulator
+{
+	float Sums[27]{};
+	float Weight = 0.0f;
+
+	// Texels are weighted by their solid angle, up to the constant texel area which cancels out when normalizing
+	void AddTexel(uint32_t face, float u, float v, const float* rgb)
+	{
+		float x, y, z;
+		FaceDirection(face, u, v, x, y, z);
+		float invLength = 1.0f / std::sqrt(1.0f + u * u + v * v);
+		float weight = invLength * invLength * invLength;
+
+		float basis[9];
+		Basis(x * invLength, y * invLength, z * invLength, basis);
+		for (uint32_t i = 0; i < 9; i++)
+		{
+			Sums[i * 3 + 0] += basis[i] * weight * rgb[0];
+			Sums[i * 3 + 1] += basis[i] * weight * rgb[1];
+			Sums[i * 3 + 2] += basis[i] * weight * rgb[2];
+		}
+		Weight += weight;
+	}
+};
+
+#ifdef SH_SSE
+static float HorizontalSum(__m128 value)
+{
+	alignas(16) float lanes[4];
+	_mm_store_ps(lanes, value);
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+// Four texels of a row at once, lanes past the end of the row get zero weight
+static void AccumulateRow(uint32_t face, float v, const float* row, int32_t faceSize, SHAccumulator& accumulator)
+{
+	__m128 sums[27];
+	for (__m128& sum : sums)
+	{
+		sum = _mm_setzero_ps();
+	}
+	__m128 weights = _mm_setzero_ps();
+
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 negOne = _mm_set1_ps(-1.0f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 V = _mm_set1_ps(v);
+	for (int32_t x = 0; x < faceSize; x += 4)
+	{
+		alignas(16) float u[4], r[4], g[4], b[4], mask[4];
+		for (int32_t lane = 0; lane < 4; lane++)
+		{
+			int32_t px = std::min(x + lane, faceSize - 1);
+			u[lane] = ((float)px + 0.5f) * 2.0f / (float)faceSize - 1.0f;
+			r[lane] = row[px * 3 + 0];
+			g[lane] = row[px * 3 + 1];
+			b[lane] = row[px * 3 + 2];
+			mask[lane] = x + lane < faceSize ? 1.0f : 0.0f;
+		}
+
+		__m128 U = _mm_load_ps(u);
+		__m128 negU = _mm_sub_ps(zero, U);
+		__m128 negV = _mm_sub_ps(zero, V);
+		__m128 dx, dy, dz;
+		switch (face)
+		{
+		case 0: dx = one;	 dy = negV;	 dz = negU; break;
+		case 1: dx = negOne; dy = negV;	 dz = U;	break;
+		case 2: dx = U;		 dy = one;	 dz = V;	break;
+		case 3: dx = U;		 dy = negOne; dz = negV; break;
+		case 4: dx = U;		 dy = negV;	 dz = one;	break;
+		default: dx = negU;	 dy = negV;	 dz = negOne; break;
+		}
+
+		__m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(one, _mm_add_ps(_mm_mul_ps(U, U), _mm_mul_ps(V, V)))));
+		__m128 weight = _mm_mul_ps(_mm_mul_ps(invLength, _mm_mul_ps(invLength, invLength)), _mm_load_ps(mask));
+		dx = _mm_mul_ps(dx, invLength);
+		dy = _mm_mul_ps(dy, invLength);
+		dz = _mm_mul_ps(dz, invLength);
+
+		__m128 basis[9];
+		basis[0] = _mm_set1_ps(0.282095f);
+		basis[1] = _mm_mul_ps(_mm_set1_ps(0.488603f), dy);
+		basis[2] = _mm_mul_ps(_mm_set1_ps(0.488603f), dz);
+		basis[3] = _mm_mul_ps(_mm_set1_ps(0.488603f), dx);
+		basis[4] = _mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(dx, dy));
+		basis[5] = _mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(dy, dz));
+		basis[6] = _mm_mul_ps(_mm_set1_ps(0.315392f), _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(3.0f), _mm_mul_ps(dz, dz)), one));
+		basis[7] = _mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(dx, dz));
+		basis[8] = _mm_mul_ps(_mm_set1_ps(0.546274f), _mm_sub_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+
+		__m128 R = _mm_mul_ps(_mm_load_ps(r), weight);
+		__m128 G = _mm_mul_ps(_mm_load_ps(g), weight);
+		__m128 B = _mm_mul_ps(_mm_load_ps(b), weight);
+		for (uint32_t i = 0; i < 9; i++)
+		{
+			sums[i * 3 + 0] = _mm_add_ps(sums[i * 3 + 0], _mm_mul_ps(basis[i], R));
+			sums[i * 3 + 1] = _mm_add_ps(sums[i * 3 + 1], _mm_mul_ps(basis[i], G));
+			sums[i * 3 + 2] = _mm_add_ps(sums[i * 3 + 2], _mm_mul_ps(basis[i], B));
+		}
+		weights = _mm_add_ps(weights, weight);
+	}
+
+	for (uint32_t i = 0; i < 27; i++)
+	{
+		accumulator.Sums[i] += HorizontalSum(sums[i]);
+	}
+	accumulator.Weight += HorizontalSum(weights);
+}
+#else
+static void AccumulateRow(uint32_t face, float v, const float* row, int32_t faceSize, SHAccumulator& accumulator)
+{
+	for (int32_t x = 0; x < faceSize; x++)
+	{
+		accumulator.AddTexel(face, ((float)x + 0.5f) * 2.0f / (float)faceSize - 1.0f, v, row + (size_t)x * 3);
+	}
+}
+#endif
+
+SH9 SphericalHarmonics::ProjectIrradiance(const float* faces, int32_t faceSize)
+{
+	std::mutex mutex;
+	SHAccumulator total;
+	JobSystem::ParallelFor(6 * faceSize,
+		[&](uint32_t begin, uint32_t end)
+		{
+			SHAccumulator local;
+			for (uint32_t row = begin; row < end; row++)
+			{
+				uint32_t face = row / faceSize;
+				uint32_t y = row % faceSize;
+				float v = ((float)y + 0.5f) * 2.0f / (float)faceSize - 1.0f;
+				AccumulateRow(face, v, faces + (size_t)row * faceSize * 3, faceSize, local);
+			}
+
+			std::lock_guard lock(mutex);
+			for (uint32_t i = 0; i < 27; i++)
+			{
+				total.Sums[i] += local.Sums[i];
+			}
+			total.Weight += local.Weight;
+		}, 16);
+
+	SH9 coefficients{};
+	float normalization = total.Weight > 0.0f ? 4.0f * glm::pi<float>() / total.Weight : 0.0f;
+	for (uint32_t i = 0; i < 9; i++)
+	{
+		coefficients[i] = glm::vec3(total.Sums[i * 3], total.Sums[i * 3 + 1], total.Sums[i * 3 + 2]) * normalization * BAND_SCALE[i];
+	}
+
+	return coefficients;
+}
+
+glm::vec3 SphericalHarmonics::Evaluate(const SH9& coefficients, const glm::vec3& normal)
+{
+	float basis[9];
+	Basis(normal.x, normal.y, normal.z, basis);
+
+	glm::vec3 result(0.0f);
+	for (uint32_t i = 0; i < 9; i++)
+	{
+		result += coefficients[i] * basis[i];
+	}
+
+	return result;
+}
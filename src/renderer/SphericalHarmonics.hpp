@@ -0,0 +1,19 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+
+// First three bands, one RGB coefficient per basis function
+using SH9 = std::array<glm::vec3, 9>;
+
+class SphericalHarmonics
+{
+public:
+	// Faces are float RGB in GL face order with rows as returned by glGetTexImage. The result is already convolved with the
+	// clamped cosine lobe and divided by pi, so evaluating it gives the same value the irradiance cubemap stores
+	static SH9 ProjectIrradiance(const float* faces, int32_t faceSize);
+
+	static glm::vec3 Evaluate(const SH9& coefficients, const glm::vec3& normal);
+};
@@ -0,0 +1,823 @@
+#include "TextureCompressor.hpp"
+#include "MipGenerator.hpp"
+#include "../Logger.hpp"
+#include "../Clock.hpp"
+#include "../RandomUtils.hpp"
+#include "../JobSystem.hpp"
+
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <cassert>
+#include "stb/stb_image.h"
+
+static const std::filesystem::path CACHE_DIRECTORY = "resources/cache/textures";
+static constexpr uint32_t CACHE_MAGIC = 0x58544342; // "BCTX"
+static constexpr uint32_t CACHE_VERSION = 2;
+
+// 4-bit BPTC interpolation weights, shared by BC6H and BC7
+static constexpr int32_t BPTC_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+static constexpr float BPTC_WEIGHTS_NORM[16] = {
+	0.0f, 4.0f / 64.0f, 9.0f / 64.0f, 13.0f / 64.0f, 17.0f / 64.0f, 21.0f / 64.0f, 26.0f / 64.0f, 30.0f / 64.0f,
+	34.0f / 64.0f, 38.0f / 64.0f, 43.0f / 64.0f, 47.0f / 64.0f, 51.0f / 64.0f, 55.0f / 64.0f, 60.0f / 64.0f, 1.0f
+};
+static constexpr float BC1_WEIGHTS[4] = { 0.0f, 1.0f / 3.0f, 2.0f / 3.0f, 1.0f };
+
+using Block = float[16][4];
+
+struct BlockWriter
+{
+	uint8_t* Data;
+	uint32_t Bit = 0;
+
+	void Write(uint32_t value, uint32_t bits)
+	{
+		for (uint32_t i = 0; i < bits; i++, Bit++)
+		{
+			if ((value >> i) & 1)
+			{
+				Data[Bit >> 3] |= (uint8_t)(1 << (Bit & 7));
+			}
+		}
+	}
+};
+
+static uint16_t FloatToHalf(float value)
+{
+	if (!(value > 0.0f))
+	{
+		return 0;
+	}
+
+	value = std::min(value, 65504.0f);
+	uint32_t bits = 0;
+	std::memcpy(&bits, &value, sizeof(bits));
+
+	uint32_t exponent = (bits >> 23) & 0xFF;
+	if (exponent < 113)
+	{
+		// Below the smallest normal half, store as denormal
+		return (uint16_t)std::lround(value * 16777216.0f);
+	}
+
+	uint32_t mantissa = bits & 0x7FFFFF;
+	uint32_t half = ((exponent - 112) << 10) | (mantissa >> 13);
+	half += (mantissa >> 12) & 1;
+
+	return (uint16_t)std::min(half, 0x7BFFu);
+}
+
+template<typename T, uint32_t Channels>
+static void FetchBlock(const T* source, int32_t width, int32_t height, int32_t blockX, int32_t blockY, Block& block)
+{
+	for (int32_t i = 0; i < 16; i++)
+	{
+		int32_t x = std::min(blockX * 4 + i % 4, width - 1);
+		int32_t y = std::min(blockY * 4 + i / 4, height - 1);
+		const T* texel = source + ((size_t)y * width + x) * Channels;
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			block[i][c] = c < Channels ? (float)texel[c] : 0.0f;
+		}
+	}
+}
+
+// Endpoints of the block's principal axis, found with a few power iterations on the covariance matrix
+static void FitEndpoints(const Block& block, uint32_t channels, float (&lo)[4], float (&hi)[4])
+{
+	float mean[4]{};
+	float minVal[4] = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
+	float maxVal[4] = { -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		for (uint32_t c = 0; c < channels; c++)
+		{
+			mean[c] += block[i][c] / 16.0f;
+			minVal[c] = std::min(minVal[c], block[i][c]);
+			maxVal[c] = std::max(maxVal[c], block[i][c]);
+		}
+	}
+
+	float cov[4][4]{};
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		for (uint32_t a = 0; a < channels; a++)
+		{
+			for (uint32_t b = 0; b < channels; b++)
+			{
+				cov[a][b] += (block[i][a] - mean[a]) * (block[i][b] - mean[b]);
+			}
+		}
+	}
+
+	float axis[4]{};
+	float length = 0.0f;
+	for (uint32_t c = 0; c < channels; c++)
+	{
+		axis[c] = maxVal[c] - minVal[c];
+		length += axis[c] * axis[c];
+	}
+
+	if (length < 1e-8f)
+	{
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			lo[c] = hi[c] = mean[c];
+		}
+
+		return;
+	}
+
+	length = std::sqrt(length);
+	for (uint32_t c = 0; c < channels; c++)
+	{
+		axis[c] /= length;
+	}
+
+	for (uint32_t iter = 0; iter < 8; iter++)
+	{
+		float next[4]{};
+		float nextLength = 0.0f;
+		for (uint32_t a = 0; a < channels; a++)
+		{
+			for (uint32_t b = 0; b < channels; b++)
+			{
+				next[a] += cov[a][b] * axis[b];
+			}
+
+			nextLength += next[a] * next[a];
+		}
+
+		nextLength = std::sqrt(nextLength);
+		if (nextLength < 1e-6f)
+		{
+			break;
+		}
+
+		for (uint32_t c = 0; c < channels; c++)
+		{
+			axis[c] = next[c] / nextLength;
+		}
+	}
+
+	float tMin = FLT_MAX;
+	float tMax = -FLT_MAX;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		float t = 0.0f;
+		for (uint32_t c = 0; c < channels; c++)
+		{
+			t += (block[i][c] - mean[c]) * axis[c];
+		}
+
+		tMin = std::min(tMin, t);
+		tMax = std::max(tMax, t);
+	}
+
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		lo[c] = mean[c] + axis[c] * tMin;
+		hi[c] = mean[c] + axis[c] * tMax;
+	}
+}
+
+// Least squares fit of the endpoints to the texels, given each texel snaps to the closest of the format's interpolation weights
+template<uint32_t Count>
+static void RefineEndpoints(const Block& block, uint32_t channels, const float (&weights)[Count], float (&lo)[4], float (&hi)[4])
+{
+	for (uint32_t iter = 0; iter < 2; iter++)
+	{
+		float dir[4]{};
+		float lengthSq = 0.0f;
+		for (uint32_t c = 0; c < channels; c++)
+		{
+			dir[c] = hi[c] - lo[c];
+			lengthSq += dir[c] * dir[c];
+		}
+
+		if (lengthSq < 1e-8f)
+		{
+			return;
+		}
+
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float ax[4]{}, bx[4]{};
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			float t = 0.0f;
+			for (uint32_t c = 0; c < channels; c++)
+			{
+				t += (block[i][c] - lo[c]) * dir[c];
+			}
+
+			t /= lengthSq;
+			float w = weights[0];
+			for (float weight : weights)
+			{
+				w = std::abs(weight - t) < std::abs(w - t) ? weight : w;
+			}
+
+			float a = 1.0f - w;
+			aa += a * a;
+			ab += a * w;
+			bb += w * w;
+			for (uint32_t c = 0; c < channels; c++)
+			{
+				ax[c] += a * block[i][c];
+				bx[c] += w * block[i][c];
+			}
+		}
+
+		float det = aa * bb - ab * ab;
+		if (std::abs(det) < 1e-6f)
+		{
+			return;
+		}
+
+		for (uint32_t c = 0; c < channels; c++)
+		{
+			lo[c] = (bb * ax[c] - ab * bx[c]) / det;
+			hi[c] = (aa * bx[c] - ab * ax[c]) / det;
+		}
+	}
+}
+
+template<uint32_t Count>
+static uint32_t ClosestIndex(const float* texel, const float (&palette)[Count][4], uint32_t channels)
+{
+	uint32_t best = 0;
+	float bestError = FLT_MAX;
+	for (uint32_t i = 0; i < Count; i++)
+	{
+		float error = 0.0f;
+		for (uint32_t c = 0; c < channels; c++)
+		{
+			float diff = texel[c] - palette[i][c];
+			error += diff * diff;
+		}
+
+		if (error < bestError)
+		{
+			bestError = error;
+			best = i;
+		}
+	}
+
+	return best;
+}
+
+static uint16_t Pack565(const float (&color)[4])
+{
+	uint32_t r = (uint32_t)std::clamp(std::lround(color[0] * 31.0f / 255.0f), 0l, 31l);
+	uint32_t g = (uint32_t)std::clamp(std::lround(color[1] * 63.0f / 255.0f), 0l, 63l);
+	uint32_t b = (uint32_t)std::clamp(std::lround(color[2] * 31.0f / 255.0f), 0l, 31l);
+
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void Unpack565(uint16_t packed, float (&color)[4])
+{
+	uint32_t r = (packed >> 11) & 31;
+	uint32_t g = (packed >> 5) & 63;
+	uint32_t b = packed & 31;
+
+	color[0] = (float)((r << 3) | (r >> 2));
+	color[1] = (float)((g << 2) | (g >> 4));
+	color[2] = (float)((b << 3) | (b >> 2));
+	color[3] = 255.0f;
+}
+
+static void EncodeBC1(const Block& block, uint8_t* output)
+{
+	float lo[4], hi[4];
+	FitEndpoints(block, 3, lo, hi);
+	RefineEndpoints(block, 3, BC1_WEIGHTS, lo, hi);
+
+	uint16_t c0 = Pack565(hi);
+	uint16_t c1 = Pack565(lo);
+	if (c0 < c1)
+	{
+		std::swap(c0, c1);
+	}
+
+	std::memcpy(output, &c0, 2);
+	std::memcpy(output + 2, &c1, 2);
+	std::memset(output + 4, 0, 4);
+	if (c0 == c1)
+	{
+		return;
+	}
+
+	float palette[4][4];
+	Unpack565(c0, palette[0]);
+	Unpack565(c1, palette[1]);
+	for (uint32_t c = 0; c < 3; c++)
+	{
+		palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+		palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+	}
+
+	uint32_t indices = 0;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		indices |= ClosestIndex(block[i], palette, 3) << (i * 2);
+	}
+
+	std::memcpy(output + 4, &indices, 4);
+}
+
+static void EncodeBC4(const Block& block, uint32_t channel, uint8_t* output)
+{
+	float minVal = 255.0f;
+	float maxVal = 0.0f;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		minVal = std::min(minVal, block[i][channel]);
+		maxVal = std::max(maxVal, block[i][channel]);
+	}
+
+	uint8_t r0 = (uint8_t)std::clamp(std::lround(maxVal), 0l, 255l);
+	uint8_t r1 = (uint8_t)std::clamp(std::lround(minVal), 0l, 255l);
+	std::memset(output, 0, 8);
+	output[0] = r0;
+	output[1] = r1;
+	if (r0 == r1)
+	{
+		return;
+	}
+
+	float palette[8][4]{};
+	palette[0][0] = r0;
+	palette[1][0] = r1;
+	for (uint32_t i = 2; i < 8; i++)
+	{
+		palette[i][0] = ((8.0f - i) * r0 + (i - 1.0f) * r1) / 7.0f;
+	}
+
+	uint64_t indices = 0;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		float value[4] = { block[i][channel] };
+		indices |= (uint64_t)ClosestIndex(value, palette, 1) << (i * 3);
+	}
+
+	std::memcpy(output + 2, &indices, 6);
+}
+
+static void EncodeBC3(const Block& block, uint8_t* output)
+{
+	EncodeBC4(block, 3, output);
+	EncodeBC1(block, output + 8);
+}
+
+static void EncodeBC5(const Block& block, uint8_t* output)
+{
+	EncodeBC4(block, 0, output);
+	EncodeBC4(block, 1, output + 8);
+}
+
+// Mode 6 only: single subset, RGBA 7.7.7.7 endpoints with a p-bit each and 4-bit indices
+static void EncodeBC7(const Block& block, uint8_t* output)
+{
+	float lo[4], hi[4];
+	FitEndpoints(block, 4, lo, hi);
+	RefineEndpoints(block, 4, BPTC_WEIGHTS_NORM, lo, hi);
+
+	uint32_t quantized[2][4]{};
+	uint32_t pbits[2]{};
+	float* endpoints[2] = { lo, hi };
+	for (uint32_t e = 0; e < 2; e++)
+	{
+		float bestError = FLT_MAX;
+		for (uint32_t p = 0; p < 2; p++)
+		{
+			uint32_t q[4]{};
+			float error = 0.0f;
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				float value = std::clamp(endpoints[e][c], 0.0f, 255.0f);
+				q[c] = (uint32_t)std::clamp(std::lround((value - p) / 2.0f), 0l, 127l);
+
+				float diff = (float)((q[c] << 1) | p) - value;
+				error += diff * diff;
+			}
+
+			if (error < bestError)
+			{
+				bestError = error;
+				pbits[e] = p;
+				std::memcpy(quantized[e], q, sizeof(q));
+			}
+		}
+	}
+
+	float palette[16][4];
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			int32_t e0 = (int32_t)((quantized[0][c] << 1) | pbits[0]);
+			int32_t e1 = (int32_t)((quantized[1][c] << 1) | pbits[1]);
+			palette[i][c] = (float)(((64 - BPTC_WEIGHTS[i]) * e0 + BPTC_WEIGHTS[i] * e1 + 32) >> 6);
+		}
+	}
+
+	uint32_t indices[16];
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		indices[i] = ClosestIndex(block[i], palette, 4);
+	}
+
+	// Anchor index has its top bit implied to be 0
+	if (indices[0] & 8)
+	{
+		std::swap(quantized[0], quantized[1]);
+		std::swap(pbits[0], pbits[1]);
+		for (uint32_t& index : indices)
+		{
+			index = 15 - index;
+		}
+	}
+
+	std::memset(output, 0, 16);
+	BlockWriter writer{ output };
+	writer.Write(1 << 6, 7);
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		writer.Write(quantized[0][c], 7);
+		writer.Write(quantized[1][c], 7);
+	}
+
+	writer.Write(pbits[0], 1);
+	writer.Write(pbits[1], 1);
+	writer.Write(indices[0], 3);
+	for (uint32_t i = 1; i < 16; i++)
+	{
+		writer.Write(indices[i], 4);
+	}
+}
+
+// Mode 11 only: single region, unsigned 10-bit endpoints and 4-bit indices, block holds half float bit patterns
+static void EncodeBC6H(const Block& block, uint8_t* output)
+{
+	float lo[4], hi[4];
+	FitEndpoints(block, 3, lo, hi);
+	RefineEndpoints(block, 3, BPTC_WEIGHTS_NORM, lo, hi);
+
+	auto unquantize = [](int32_t q) -> int32_t
+		{
+			if (q == 0)
+			{
+				return 0;
+			}
+
+			if (q == 1023)
+			{
+				return 0xFFFF;
+			}
+
+			return ((q << 16) + 0x8000) >> 10;
+		};
+
+	int32_t quantized[2][3]{};
+	for (uint32_t c = 0; c < 3; c++)
+	{
+		quantized[0][c] = (int32_t)std::clamp(std::lround((lo[c] - 15.0f) / 31.0f), 0l, 1023l);
+		quantized[1][c] = (int32_t)std::clamp(std::lround((hi[c] - 15.0f) / 31.0f), 0l, 1023l);
+	}
+
+	float palette[16][4]{};
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			int32_t e0 = unquantize(quantized[0][c]);
+			int32_t e1 = unquantize(quantized[1][c]);
+			int32_t interpolated = ((64 - BPTC_WEIGHTS[i]) * e0 + BPTC_WEIGHTS[i] * e1 + 32) >> 6;
+			palette[i][c] = (float)((interpolated * 31) >> 6);
+		}
+	}
+
+	uint32_t indices[16];
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		indices[i] = ClosestIndex(block[i], palette, 3);
+	}
+
+	if (indices[0] & 8)
+	{
+		std::swap(quantized[0], quantized[1]);
+		for (uint32_t& index : indices)
+		{
+			index = 15 - index;
+		}
+	}
+
+	std::memset(output, 0, 16);
+	BlockWriter writer{ output };
+	writer.Write(0x03, 5);
+	for (uint32_t e = 0; e < 2; e++)
+	{
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			writer.Write((uint32_t)quantized[e][c], 10);
+		}
+	}
+
+	writer.Write(indices[0], 3);
+	for (uint32_t i = 1; i < 16; i++)
+	{
+		writer.Write(indices[i], 4);
+	}
+}
+
+static CompressedMip CompressLevel(const uint8_t* rgba, int32_t width, int32_t height, TextureFormat format)
+{
+	int32_t blocksX = (width + 3) / 4;
+	int32_t blocksY = (height + 3) / 4;
+	uint32_t blockSize = TextureCompressor::BlockSize(format);
+
+	CompressedMip mip{ width, height };
+	mip.Data.resize((size_t)blocksX * blocksY * blockSize);
+	JobSystem::ParallelFor(blocksY,
+		[&](uint32_t begin, uint32_t end)
+		{
+			Block block;
+			for (int32_t y = begin; y < (int32_t)end; y++)
+			{
+				for (int32_t x = 0; x < blocksX; x++)
+				{
+					FetchBlock<uint8_t, 4>(rgba, width, height, x, y, block);
+					uint8_t* output = mip.Data.data() + ((size_t)y * blocksX + x) * blockSize;
+
+					switch (format)
+					{
+					case TextureFormat::BC1: EncodeBC1(block, output);	  break;
+					case TextureFormat::BC3: EncodeBC3(block, output);	  break;
+					case TextureFormat::BC4: EncodeBC4(block, 0, output); break;
+					case TextureFormat::BC5: EncodeBC5(block, output);	  break;
+					case TextureFormat::BC7: EncodeBC7(block, output);	  break;
+					default:
+						assert(false && "Format isn't an 8-bit block format");
+						break;
+					}
+				}
+			}
+		}, 4);
+
+	return mip;
+}
+
+static CompressedMip CompressLevelHDR(const uint16_t* halfRGB, int32_t width, int32_t height)
+{
+	int32_t blocksX = (width + 3) / 4;
+	int32_t blocksY = (height + 3) / 4;
+
+	CompressedMip mip{ width, height };
+	mip.Data.resize((size_t)blocksX * blocksY * 16);
+	JobSystem::ParallelFor(blocksY,
+		[&](uint32_t begin, uint32_t end)
+		{
+			Block block;
+			for (int32_t y = begin; y < (int32_t)end; y++)
+			{
+				for (int32_t x = 0; x < blocksX; x++)
+				{
+					FetchBlock<uint16_t, 3>(halfRGB, width, height, x, y, block);
+					EncodeBC6H(block, mip.Data.data() + ((size_t)y * blocksX + x) * 16);
+				}
+			}
+		}, 4);
+
+	return mip;
+}
+
+static std::optional<CompressedImage> ReadCache(const std::filesystem::path& path, TextureFormat format)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+	{
+		return std::nullopt;
+	}
+
+	uint32_t header[6]{};
+	file.read((char*)header, sizeof(header));
+	if (!file || header[0] != CACHE_MAGIC || header[1] != CACHE_VERSION || header[2] != (uint32_t)format)
+	{
+		return std::nullopt;
+	}
+
+	// Nothing read from the entry is trusted further than the file goes, a truncated or garbled one can't ask for huge allocations
+	std::error_code ec;
+	uint64_t remaining = std::filesystem::file_size(path, ec);
+	remaining = ec || remaining < sizeof(header) ? 0 : remaining - sizeof(header);
+
+	uint32_t maxMips = header[3] == 0 || header[4] == 0 ? 0 : (uint32_t)std::bit_width(std::max(header[3], header[4]));
+	if (header[3] > 16384 || header[4] > 16384 || header[5] == 0 || header[5] > maxMips)
+	{
+		LOG_WARN("Corrupted texture cache entry {}, recompressing", path.string());
+		return std::nullopt;
+	}
+
+	CompressedImage image{ format, (int32_t)header[3], (int32_t)header[4] };
+	image.Mips.resize(header[5]);
+	for (CompressedMip& mip : image.Mips)
+	{
+		uint32_t mipHeader[3]{};
+		file.read((char*)mipHeader, sizeof(mipHeader));
+		if (!file || remaining < sizeof(mipHeader) || mipHeader[2] > remaining - sizeof(mipHeader))
+		{
+			LOG_WARN("Corrupted texture cache entry {}, recompressing", path.string());
+			return std::nullopt;
+		}
+
+		remaining -= sizeof(mipHeader) + mipHeader[2];
+		mip.Width = (int32_t)mipHeader[0];
+		mip.Height = (int32_t)mipHeader[1];
+		mip.Data.resize(mipHeader[2]);
+		file.read((char*)mip.Data.data(), mip.Data.size());
+	}
+
+	if (!file)
+	{
+		LOG_WARN("Corrupted texture cache entry {}, recompressing", path.string());
+		return std::nullopt;
+	}
+
+	return image;
+}
+
+static void WriteCache(const std::filesystem::path& path, const CompressedImage& image)
+{
+	std::error_code ec;
+	std::filesystem::create_directories(path.parent_path(), ec);
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open())
+	{
+		LOG_WARN("Failed to write texture cache entry {}", path.string());
+		return;
+	}
+
+	uint32_t header[6] = { CACHE_MAGIC, CACHE_VERSION, (uint32_t)image.Format, (uint32_t)image.Width, (uint32_t)image.Height, (uint32_t)image.Mips.size() };
+	file.write((const char*)header, sizeof(header));
+	for (const CompressedMip& mip : image.Mips)
+	{
+		uint32_t mipHeader[3] = { (uint32_t)mip.Width, (uint32_t)mip.Height, (uint32_t)mip.Data.size() };
+		file.write((const char*)mipHeader, sizeof(mipHeader));
+		file.write((const char*)mip.Data.data(), mip.Data.size());
+	}
+}
+
+std::optional<CompressedImage> TextureCompressor::LoadOrCompress(const std::string& path, TextureFormat format, MipContent content)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+	{
+		LOG_ERROR("Failed to open texture {}", path);
+		return std::nullopt;
+	}
+
+	std::vector<uint8_t> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	uint64_t hash = FNV1a(contents.data(), contents.size());
+	hash = FNV1a(&format, sizeof(format), hash);
+	hash = FNV1a(&content, sizeof(content), hash);
+
+	char fileName[32]{};
+	snprintf(fileName, sizeof(fileName), "%016llx.bct", (unsigned long long)hash);
+	std::filesystem::path cachePath = CACHE_DIRECTORY / fileName;
+	if (std::optional<CompressedImage> cached = ReadCache(cachePath, format); cached.has_value())
+	{
+		return cached;
+	}
+
+	Clock clock;
+	int32_t width = 0;
+	int32_t height = 0;
+	int32_t channels = 0;
+	CompressedImage image{};
+	stbi_set_flip_vertically_on_load(1);
+	if (format == TextureFormat::BC6H)
+	{
+		float* pixels = stbi_loadf_from_memory(contents.data(), (int32_t)contents.size(), &width, &height, &channels, 3);
+		if (pixels == nullptr)
+		{
+			LOG_ERROR("Failed to decode texture {}", path);
+			return std::nullopt;
+		}
+
+		image = CompressHDR(pixels, width, height);
+		stbi_image_free(pixels);
+	}
+	else
+	{
+		uint8_t* pixels = stbi_load_from_memory(contents.data(), (int32_t)contents.size(), &width, &height, &channels, 4);
+		if (pixels == nullptr)
+		{
+			LOG_ERROR("Failed to decode texture {}", path);
+			return std::nullopt;
+		}
+
+		image = Compress(pixels, width, height, format, content);
+		stbi_image_free(pixels);
+	}
+
+	LOG_INFO("Compressed {} ({}x{}) to {} in {}ms", path, width, height, FormatName(format), clock.GetElapsedTime());
+	WriteCache(cachePath, image);
+
+	return image;
+}
+
+CompressedImage TextureCompressor::Compress(const uint8_t* rgba, int32_t width, int32_t height, TextureFormat format, MipContent content)
+{
+	CompressedImage image{ format, width, height };
+	image.Mips.push_back(CompressLevel(rgba, width, height, format));
+	for (const MipLevel<uint8_t>& level : MipGenerator::Generate(rgba, width, height, 4, content))
+	{
+		image.Mips.push_back(CompressLevel(level.Data.data(), level.Width, level.Height, format));
+	}
+
+	return image;
+}
+
+CompressedImage TextureCompressor::CompressHDR(const float* rgb, int32_t width, int32_t height)
+{
+	auto toHalves = [](const float* pixels, size_t count)
+		{
+			std::vector<uint16_t> halves(count);
+			for (size_t i = 0; i < count; i++)
+			{
+				halves[i] = FloatToHalf(pixels[i]);
+			}
+
+			return halves;
+		};
+
+	CompressedImage image{ TextureFormat::BC6H, width, height };
+	image.Mips.push_back(CompressLevelHDR(toHalves(rgb, (size_t)width * height * 3).data(), width, height));
+	for (const MipLevel<float>& level : MipGenerator::Generate(rgb, width, height, 3))
+	{
+		image.Mips.push_back(CompressLevelHDR(toHalves(level.Data.data(), level.Data.size()).data(), level.Width, level.Height));
+	}
+
+	return image;
+}
+
+bool TextureCompressor::IsCompressed(TextureFormat format)
+{
+	switch (format)
+	{
+	case TextureFormat::BC1:
+	case TextureFormat::BC3:
+	case TextureFormat::BC4:
+	case TextureFormat::BC5:
+	case TextureFormat::BC6H:
+	case TextureFormat::BC7:
+		return true;
+	default:
+		return false;
+	}
+}
+
+uint32_t TextureCompressor::BlockSize(TextureFormat format)
+{
+	switch (format)
+	{
+	case TextureFormat::BC1:
+	case TextureFormat::BC4:
+		return 8;
+	case TextureFormat::BC3:
+	case TextureFormat::BC5:
+	case TextureFormat::BC6H:
+	case TextureFormat::BC7:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+const char* TextureCompressor::FormatName(TextureFormat format)
+{
+	switch (format)
+	{
+	case TextureFormat::RGBA8:		 return "RGBA8";
+	case TextureFormat::RGB8:		 return "RGB8";
+	case TextureFormat::RGBA16F:	 return "RGBA16F";
+	case TextureFormat::RGB16F:		 return "RGB16F";
+	case TextureFormat::RG16F:		 return "RG16F";
+	case TextureFormat::RGB32F:		 return "RGB32F";
+	case TextureFormat::R11_G11_B10: return "R11G11B10F";
+	case TextureFormat::DEPTH_32F:	 return "DEPTH32F";
+	case TextureFormat::BC1:		 return "BC1";
+	case TextureFormat::BC3:		 return "BC3";
+	case TextureFormat::BC4:		 return "BC4";
+	case TextureFormat::BC5:		 return "BC5";
+	case TextureFormat::BC6H:		 return "BC6H";
+	case TextureFormat::BC7:		 return "BC7";
+	default:						 return "Unknown";
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "OpenGL.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <optional>
+
+struct CompressedMip
+{
+	int32_t Width = 0;
+	int32_t Height = 0;
+	std::vector<uint8_t> Data;
+};
+
+struct CompressedImage
+{
+	TextureFormat Format = TextureFormat::BC7;
+	int32_t Width = 0;
+	int32_t Height = 0;
+	std::vector<CompressedMip> Mips;
+};
+
+class TextureCompressor
+{
+public:
+	// Returns the cached block data for the file if its contents didn't change, compresses and caches it otherwise.
+	// The content decides how mips are filtered, HDR files ignore it
+	static std::optional<CompressedImage> LoadOrCompress(const std::string& path, TextureFormat format, MipContent content);
+
+	// Full mip chain, rgba is 4 channels per texel
+	static CompressedImage Compress(const uint8_t* rgba, int32_t width, int32_t height, TextureFormat format, MipContent content);
+
+	// Full mip chain encoded as BC6H, rgb is 3 floats per texel
+	static CompressedImage CompressHDR(const float* rgb, int32_t width, int32_t height);
+
+	static bool IsCompressed(TextureFormat format);
+	static uint32_t BlockSize(TextureFormat format);
+	static const char* FormatName(TextureFormat format);
+};
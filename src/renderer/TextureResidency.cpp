@@ -0,0 +1,100 @@
+#include "TextureResidency.hpp"
+#include "AssetManager.hpp"
+
+#include <algorithm>
+#include <vector>
+
+std::unordered_map<int32_t, uint64_t> TextureResidency::s_LastUsedFrame;
+uint64_t TextureResidency::s_Frame = 1;
+
+uint64_t TextureResidency::s_Budget = 512ull * 1024ull * 1024ull;
+uint64_t TextureResidency::s_CurrentUsage = 0;
+uint64_t TextureResidency::s_PeakUsage = 0;
+
+void TextureResidency::MarkUsed(int32_t textureID, Texture& texture)
+{
+	uint64_t& lastUsed = s_LastUsedFrame[textureID];
+	if (lastUsed == s_Frame)
+	{
+		return;
+	}
+
+	lastUsed = s_Frame;
+	if (texture.DroppedMips() > 0)
+	{
+		uint64_t evicted = texture.VRAMSize();
+		texture.DropMips(0);
+		s_CurrentUsage += texture.VRAMSize() - evicted;
+		s_PeakUsage = std::max(s_PeakUsage, s_CurrentUsage);
+	}
+}
+
+void TextureResidency::EndFrame()
+{
+	const std::unordered_map<int32_t, std::shared_ptr<Texture>>& textures = AssetManager::AllTextures();
+	std::vector<std::pair<uint64_t, Texture*>> candidates;
+
+	uint64_t usage = 0;
+	for (const auto& [id, texture] : textures)
+	{
+		texture->FinishMips();
+
+		auto it = s_LastUsedFrame.find(id);
+		uint64_t lastUsed = it != s_LastUsedFrame.end() ? it->second : 0;
+		if (lastUsed != s_Frame && texture->MipCount() > 1)
+		{
+			candidates.push_back({ lastUsed, texture.get() });
+		}
+
+		usage += texture->VRAMSize();
+	}
+
+	if (usage > s_Budget)
+	{
+		std::sort(candidates.begin(), candidates.end(),
+			[](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+
+		for (auto& [lastUsed, texture] : candidates)
+		{
+			if (usage <= s_Budget)
+			{
+				break;
+			}
+
+			uint32_t maxDropped = 0;
+			while (maxDropped + 1 < texture->MipCount()
+				&& (texture->GetWidth() >> (maxDropped + 1)) >= MIN_RESIDENT_SIZE
+				&& (texture->GetHeight() >> (maxDropped + 1)) >= MIN_RESIDENT_SIZE)
+			{
+				maxDropped++;
+			}
+
+			// Drop just enough to fit, the texture is respecified once
+			uint64_t otherUsage = usage - texture->VRAMSize();
+			uint32_t dropped = texture->DroppedMips();
+			while (dropped < maxDropped && otherUsage + texture->ResidentSize(dropped) > s_Budget)
+			{
+				dropped++;
+			}
+
+			texture->DropMips(dropped);
+			usage = otherUsage + texture->VRAMSize();
+		}
+	}
+
+	s_CurrentUsage = usage;
+	s_PeakUsage = std::max(s_PeakUsage, usage);
+	s_Frame++;
+
+	std::erase_if(s_LastUsedFrame, [&textures](const auto& entry) { return !textures.contains(entry.first); });
+}
+
+void TextureResidency::SetBudget(uint64_t bytes)
+{
+	s_Budget = bytes;
+}
+
+void TextureResidency::ResetPeak()
+{
+	s_PeakUsage = s_CurrentUsage;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+
+class Texture;
+
+class TextureResidency
+{
+public:
+	// Called for every texture bound by a submitted mesh, dropped mips are restored right away so the draw samples the full texture
+	static void MarkUsed(int32_t textureID, Texture& texture);
+
+	// Drops top mips of the least recently used textures until under budget
+	static void EndFrame();
+
+	static void SetBudget(uint64_t bytes);
+	static void ResetPeak();
+
+	inline static uint64_t Budget()		  { return s_Budget; }
+	inline static uint64_t CurrentUsage() { return s_CurrentUsage; }
+	inline static uint64_t PeakUsage()	  { return s_PeakUsage; }
+
+	// Textures aren't shrunk below this size on either axis
+	static constexpr int32_t MIN_RESIDENT_SIZE = 64;
+
+private:
+	static std::unordered_map<int32_t, uint64_t> s_LastUsedFrame;
+	static uint64_t s_Frame;
+
+	static uint64_t s_Budget;
+	static uint64_t s_CurrentUsage;
+	static uint64_t s_PeakUsage;
+};
@@ -0,0 +1,817 @@
+#include "VirtualTexture.hpp"
+#include "MipGenerator.hpp"
+#include "../Logger.hpp"
+#include "../Clock.hpp"
+#include "../JobSystem.hpp"
+
+#include <thread>
+#include <condition_variable>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <cassert>
+#include "stb/stb_image.h"
+
+static const std::filesystem::path CACHE_DIRECTORY = "resources/cache/vt";
+static constexpr uint32_t FILE_MAGIC = 0x58455456; // "VTEX"
+static constexpr uint32_t FILE_VERSION = 1;
+static constexpr uint64_t HEADER_SIZE = 6 * sizeof(uint32_t);
+
+static constexpr uint32_t INVALID_KEY = 0xFFFFFFFF;
+
+static uint32_t PagesFor(int32_t size, uint32_t mip)
+{
+	int32_t mipSize = std::max(size >> mip, 1);
+	return (uint32_t)((mipSize + VirtualTextureFile::PAGE_SIZE - 1) / VirtualTextureFile::PAGE_SIZE);
+}
+
+static int32_t WrapCoord(int32_t coord, int32_t size)
+{
+	coord %= size;
+	return coord < 0 ? coord + size : coord;
+}
+
+// Border texels come from the opposite edge so bilinear filtering matches GL_REPEAT across page seams
+static void FillPage(const uint8_t* source, int32_t width, int32_t height, uint32_t pageX, uint32_t pageY, uint8_t* output)
+{
+	constexpr int32_t PADDED = VirtualTextureFile::PADDED_PAGE_SIZE;
+	int32_t startX = (int32_t)pageX * VirtualTextureFile::PAGE_SIZE - VirtualTextureFile::PAGE_BORDER;
+	int32_t startY = (int32_t)pageY * VirtualTextureFile::PAGE_SIZE - VirtualTextureFile::PAGE_BORDER;
+
+	for (int32_t y = 0; y < PADDED; y++)
+	{
+		const uint8_t* row = source + (size_t)WrapCoord(startY + y, height) * width * 4;
+		uint8_t* out = output + (size_t)y * PADDED * 4;
+		for (int32_t x = 0; x < PADDED; x++)
+		{
+			memcpy(out + (size_t)x * 4, row + (size_t)WrapCoord(startX + x, width) * 4, 4);
+		}
+	}
+}
+
+bool VirtualTextureFile::Bake(const uint8_t* rgba, int32_t width, int32_t height, const std::filesystem::path& path)
+{
+	std::error_code ec;
+	std::filesystem::create_directories(path.parent_path(), ec);
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open())
+	{
+		LOG_WARN("Failed to write virtual texture {}", path.string());
+		return false;
+	}
+
+	uint32_t mipCount = 1;
+	while (PagesFor(width, mipCount - 1) > 1 || PagesFor(height, mipCount - 1) > 1)
+	{
+		mipCount++;
+	}
+
+	uint32_t header[6] = { FILE_MAGIC, FILE_VERSION, (uint32_t)width, (uint32_t)height, mipCount, (uint32_t)PAGE_SIZE };
+	file.write((const char*)header, sizeof(header));
+
+	std::vector<MipLevel<uint8_t>> levels = MipGenerator::Generate(rgba, width, height, 4, MipContent::COLOR_SRGB);
+	std::vector<uint8_t> pageRow;
+	for (uint32_t mip = 0; mip < mipCount; mip++)
+	{
+		const uint8_t* source = mip == 0 ? rgba : levels[mip - 1].Data.data();
+		int32_t mipWidth = std::max(width >> mip, 1);
+		int32_t mipHeight = std::max(height >> mip, 1);
+		uint32_t pagesX = PagesFor(width, mip);
+		uint32_t pagesY = PagesFor(height, mip);
+
+		pageRow.resize(pagesX * PAGE_BYTES);
+		for (uint32_t pageY = 0; pageY < pagesY; pageY++)
+		{
+			JobSystem::ParallelFor(pagesX,
+				[&](uint32_t begin, uint32_t end)
+				{
+					for (uint32_t pageX = begin; pageX < end; pageX++)
+					{
+						FillPage(source, mipWidth, mipHeight, pageX, pageY, pageRow.data() + pageX * PAGE_BYTES);
+					}
+				});
+
+			file.write((const char*)pageRow.data(), pageRow.size());
+		}
+	}
+
+	return (bool)file;
+}
+
+bool VirtualTextureFile::Open(const std::filesystem::path& path)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	m_File = std::ifstream(path, std::ios::binary);
+	if (!m_File.is_open())
+	{
+		return false;
+	}
+
+	uint32_t header[6]{};
+	m_File.read((char*)header, sizeof(header));
+	if (!m_File || header[0] != FILE_MAGIC || header[1] != FILE_VERSION || header[5] != (uint32_t)PAGE_SIZE)
+	{
+		m_File.close();
+		return false;
+	}
+
+	m_Width = (int32_t)header[2];
+	m_Height = (int32_t)header[3];
+	m_MipCount = header[4];
+
+	m_MipFirstPage.resize(m_MipCount);
+	uint64_t pages = 0;
+	for (uint32_t mip = 0; mip < m_MipCount; mip++)
+	{
+		m_MipFirstPage[mip] = pages;
+		pages += (uint64_t)PagesX(mip) * PagesY(mip);
+	}
+
+	// A bake that got interrupted leaves a truncated file behind
+	std::error_code ec;
+	if (std::filesystem::file_size(path, ec) != HEADER_SIZE + pages * PAGE_BYTES)
+	{
+		m_File.close();
+		return false;
+	}
+
+	return true;
+}
+
+bool VirtualTextureFile::ReadPage(uint32_t mip, uint32_t pageX, uint32_t pageY, uint8_t* output)
+{
+	if (mip >= m_MipCount || pageX >= PagesX(mip) || pageY >= PagesY(mip))
+	{
+		return false;
+	}
+
+	uint64_t page = m_MipFirstPage[mip] + (uint64_t)pageY * PagesX(mip) + pageX;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_File.seekg(HEADER_SIZE + page * PAGE_BYTES);
+	m_File.read((char*)output, PAGE_BYTES);
+
+	return (bool)m_File;
+}
+
+uint32_t VirtualTextureFile::PagesX(uint32_t mip) const
+{
+	return PagesFor(m_Width, mip);
+}
+
+uint32_t VirtualTextureFile::PagesY(uint32_t mip) const
+{
+	return PagesFor(m_Height, mip);
+}
+
+struct VirtualTextureEntry
+{
+	std::string Name;
+	std::shared_ptr<VirtualTextureFile> File;
+	glm::ivec2 PageOrigin;
+};
+
+struct PhysicalSlot
+{
+	uint32_t Key = INVALID_KEY;
+	uint64_t LastUsed = 0;
+	bool Pinned = false;
+};
+
+struct PageRequest
+{
+	uint32_t Key = INVALID_KEY;
+	std::shared_ptr<VirtualTextureFile> File;
+	uint32_t Mip = 0;
+	uint32_t PageX = 0;
+	uint32_t PageY = 0;
+};
+
+struct LoadedPage
+{
+	uint32_t Key = INVALID_KEY;
+	bool Success = false;
+	std::vector<uint8_t> Data;
+};
+
+struct VirtualTexturingData
+{
+	std::vector<VirtualTextureEntry> Textures;
+	std::vector<glm::vec4> Regions;
+	std::vector<int32_t> MaxMips;
+	std::unordered_map<std::string, int32_t> LoadedPaths;
+
+	// Owning texture ID + 1 of every mip 0 page
+	std::vector<uint8_t> Occupancy;
+
+	std::vector<PhysicalSlot> Slots;
+	std::unordered_map<uint32_t, uint32_t> ResidentPages;
+	std::unordered_set<uint32_t> PendingPages;
+	std::unordered_set<uint32_t> RequestedPages;
+
+	std::vector<std::vector<uint32_t>> PageTable;
+	bool PageTableDirty = false;
+
+	uint32_t PageTableID = 0;
+	uint32_t PhysicalID = 0;
+
+	std::unique_ptr<Framebuffer> FeedbackFBO;
+	std::shared_ptr<Shader> FeedbackShader;
+	VirtualTextureUniforms FeedbackUniforms;
+	UniformHandle FeedbackBias;
+	std::unique_ptr<PixelReadback> FeedbackReadback;
+	std::vector<uint8_t> FeedbackPixels;
+	bool FeedbackWritten = false;
+
+	std::vector<std::thread> Streamers;
+	std::mutex QueueMutex;
+	std::condition_variable QueueCondition;
+	std::deque<PageRequest> Requests;
+	std::deque<LoadedPage> Loaded;
+	bool StreamerRunning = false;
+
+	uint64_t Frame = 1;
+	VirtualTexturingStats Stats;
+};
+
+static VirtualTexturingData s_Data{};
+
+static uint32_t PageKey(uint32_t mip, uint32_t pageX, uint32_t pageY)
+{
+	return (mip << 16) | (pageY << 8) | pageX;
+}
+
+static void StreamerLoop()
+{
+	while (true)
+	{
+		PageRequest request;
+		{
+			std::unique_lock<std::mutex> lock(s_Data.QueueMutex);
+			s_Data.QueueCondition.wait(lock, []() { return !s_Data.Requests.empty() || !s_Data.StreamerRunning; });
+			if (!s_Data.StreamerRunning)
+			{
+				return;
+			}
+
+			request = std::move(s_Data.Requests.front());
+			s_Data.Requests.pop_front();
+		}
+
+		LoadedPage page{ request.Key };
+		page.Data.resize(VirtualTextureFile::PAGE_BYTES);
+		page.Success = request.File->ReadPage(request.Mip, request.PageX, request.PageY, page.Data.data());
+
+		std::lock_guard<std::mutex> lock(s_Data.QueueMutex);
+		s_Data.Loaded.push_back(std::move(page));
+	}
+}
+
+// Free slot first, otherwise the least recently used one that wasn't needed this frame
+static int32_t AcquireSlot()
+{
+	int32_t best = -1;
+	for (int32_t i = 0; i < (int32_t)s_Data.Slots.size(); i++)
+	{
+		const PhysicalSlot& slot = s_Data.Slots[i];
+		if (slot.Key == INVALID_KEY)
+		{
+			return i;
+		}
+
+		if (!slot.Pinned && slot.LastUsed < s_Data.Frame && (best == -1 || slot.LastUsed < s_Data.Slots[best].LastUsed))
+		{
+			best = i;
+		}
+	}
+
+	if (best != -1)
+	{
+		s_Data.ResidentPages.erase(s_Data.Slots[best].Key);
+		s_Data.Slots[best] = PhysicalSlot{};
+	}
+
+	return best;
+}
+
+static void UploadPage(uint32_t slot, uint32_t key, const uint8_t* data, bool pinned)
+{
+	s_Data.Slots[slot] = { key, s_Data.Frame, pinned };
+	s_Data.ResidentPages[key] = slot;
+	s_Data.PageTableDirty = true;
+
+	int32_t x = (int32_t)(slot % VirtualTexturing::PHYSICAL_PAGES) * VirtualTextureFile::PADDED_PAGE_SIZE;
+	int32_t y = (int32_t)(slot / VirtualTexturing::PHYSICAL_PAGES) * VirtualTextureFile::PADDED_PAGE_SIZE;
+	GLState::BindTexture(GL_TEXTURE_2D, s_Data.PhysicalID);
+	GLCall(glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, VirtualTextureFile::PADDED_PAGE_SIZE, VirtualTextureFile::PADDED_PAGE_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, data));
+}
+
+// Pages that aren't resident point at their closest resident ancestor
+static void RebuildPageTable()
+{
+	GLState::BindTexture(GL_TEXTURE_2D, s_Data.PageTableID);
+	for (int32_t mip = VirtualTexturing::PAGE_TABLE_MIPS - 1; mip >= 0; mip--)
+	{
+		uint32_t size = VirtualTexturing::VIRTUAL_PAGES >> mip;
+		std::vector<uint32_t>& level = s_Data.PageTable[mip];
+		for (uint32_t y = 0; y < size; y++)
+		{
+			for (uint32_t x = 0; x < size; x++)
+			{
+				uint32_t entry = 0;
+				if (auto it = s_Data.ResidentPages.find(PageKey(mip, x, y)); it != s_Data.ResidentPages.end())
+				{
+					uint32_t slotX = it->second % VirtualTexturing::PHYSICAL_PAGES;
+					uint32_t slotY = it->second / VirtualTexturing::PHYSICAL_PAGES;
+					entry = slotX | (slotY << 8) | ((uint32_t)mip << 16) | (0xFFu << 24);
+				}
+				else if (mip + 1 < VirtualTexturing::PAGE_TABLE_MIPS)
+				{
+					entry = s_Data.PageTable[mip + 1][(y >> 1) * (size >> 1) + (x >> 1)];
+				}
+
+				level[y * size + x] = entry;
+			}
+		}
+
+		GLCall(glTexSubImage2D(GL_TEXTURE_2D, mip, 0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, level.data()));
+	}
+
+	s_Data.PageTableDirty = false;
+}
+
+// Feedback of a frame or two ago, queued reads make it so the CPU never waits on the GPU for it
+static void ReadFeedback()
+{
+	bool arrived = false;
+	while (s_Data.FeedbackReadback->Poll(s_Data.FeedbackPixels))
+	{
+		arrived = true;
+	}
+
+	if (s_Data.FeedbackWritten)
+	{
+		s_Data.FeedbackReadback->Request(*s_Data.FeedbackFBO, 0, { 0, 0 }, s_Data.FeedbackFBO->ColorAttachmentSize(0));
+		s_Data.FeedbackFBO->Unbind();
+		s_Data.FeedbackWritten = false;
+	}
+
+	if (!arrived)
+	{
+		return;
+	}
+
+	// Every visible page brings its ancestors along, they're the fallback while it streams in
+	s_Data.RequestedPages.clear();
+	for (size_t i = 0; i < s_Data.FeedbackPixels.size(); i += 4)
+	{
+		const uint8_t* texel = s_Data.FeedbackPixels.data() + i;
+		if (texel[3] == 0)
+		{
+			continue;
+		}
+
+		uint32_t x = texel[0];
+		uint32_t y = texel[1];
+		for (uint32_t mip = texel[2]; mip < VirtualTexturing::PAGE_TABLE_MIPS; mip++, x >>= 1, y >>= 1)
+		{
+			if (!s_Data.RequestedPages.insert(PageKey(mip, x, y)).second)
+			{
+				break;
+			}
+		}
+	}
+
+	std::vector<PageRequest> missing;
+	for (uint32_t key : s_Data.RequestedPages)
+	{
+		if (auto it = s_Data.ResidentPages.find(key); it != s_Data.ResidentPages.end())
+		{
+			s_Data.Slots[it->second].LastUsed = s_Data.Frame;
+			continue;
+		}
+
+		if (s_Data.PendingPages.contains(key))
+		{
+			continue;
+		}
+
+		uint32_t mip = key >> 16;
+		uint32_t x = key & 0xFF;
+		uint32_t y = (key >> 8) & 0xFF;
+		uint8_t owner = s_Data.Occupancy[(size_t)(y << mip) * VirtualTexturing::VIRTUAL_PAGES + (x << mip)];
+		if (owner == 0)
+		{
+			continue;
+		}
+
+		const VirtualTextureEntry& texture = s_Data.Textures[owner - 1];
+		if (mip >= texture.File->MipCount())
+		{
+			continue;
+		}
+
+		uint32_t pageX = x - (texture.PageOrigin.x >> mip);
+		uint32_t pageY = y - (texture.PageOrigin.y >> mip);
+		if (pageX < texture.File->PagesX(mip) && pageY < texture.File->PagesY(mip))
+		{
+			missing.push_back({ key, texture.File, mip, pageX, pageY });
+		}
+	}
+
+	// Coarse pages first, they cover the most screen
+	std::sort(missing.begin(), missing.end(),
+		[](const PageRequest& lhs, const PageRequest& rhs) { return lhs.Mip > rhs.Mip; });
+
+	size_t room = VirtualTexturing::MAX_PENDING_PAGES - std::min<size_t>(s_Data.PendingPages.size(), VirtualTexturing::MAX_PENDING_PAGES);
+	missing.resize(std::min(missing.size(), room));
+	if (missing.empty())
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(s_Data.QueueMutex);
+		for (PageRequest& request : missing)
+		{
+			s_Data.PendingPages.insert(request.Key);
+			s_Data.Requests.push_back(std::move(request));
+		}
+	}
+	s_Data.QueueCondition.notify_all();
+}
+
+static void UploadLoadedPages()
+{
+	std::vector<LoadedPage> loaded;
+	{
+		std::lock_guard<std::mutex> lock(s_Data.QueueMutex);
+		while (!s_Data.Loaded.empty() && loaded.size() < VirtualTexturing::MAX_UPLOADS_PER_FRAME)
+		{
+			loaded.push_back(std::move(s_Data.Loaded.front()));
+			s_Data.Loaded.pop_front();
+		}
+	}
+
+	for (const LoadedPage& page : loaded)
+	{
+		s_Data.PendingPages.erase(page.Key);
+		if (!page.Success)
+		{
+			continue;
+		}
+
+		// Everything is in use this frame, the page gets requested again once something frees up
+		int32_t slot = AcquireSlot();
+		if (slot == -1)
+		{
+			continue;
+		}
+
+		UploadPage(slot, page.Key, page.Data.data(), false);
+		s_Data.Stats.UploadedPages++;
+	}
+}
+
+void VirtualTexturing::Init(int32_t maxMaterials)
+{
+	s_Data.Occupancy.assign((size_t)VIRTUAL_PAGES * VIRTUAL_PAGES, 0);
+	s_Data.Slots.assign((size_t)PHYSICAL_PAGES * PHYSICAL_PAGES, PhysicalSlot{});
+	s_Data.PageTable.resize(PAGE_TABLE_MIPS);
+	for (int32_t mip = 0; mip < PAGE_TABLE_MIPS; mip++)
+	{
+		s_Data.PageTable[mip].assign((size_t)(VIRTUAL_PAGES >> mip) * (VIRTUAL_PAGES >> mip), 0);
+	}
+
+	GLCall(glGenTextures(1, &s_Data.PageTableID));
+	GLState::BindTexture(GL_TEXTURE_2D, s_Data.PageTableID);
+	GLCall(glTexStorage2D(GL_TEXTURE_2D, PAGE_TABLE_MIPS, GL_RGBA8, VIRTUAL_PAGES, VIRTUAL_PAGES));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+
+	int32_t physicalSize = PHYSICAL_PAGES * VirtualTextureFile::PADDED_PAGE_SIZE;
+	GLCall(glGenTextures(1, &s_Data.PhysicalID));
+	GLState::BindTexture(GL_TEXTURE_2D, s_Data.PhysicalID);
+	GLCall(glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, physicalSize, physicalSize));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+	GLState::BindTexture(GL_TEXTURE_2D, 0);
+	RebuildPageTable();
+
+	glm::ivec2 feedbackSize(160, 90);
+	s_Data.FeedbackFBO = std::make_unique<Framebuffer>();
+	s_Data.FeedbackFBO->AddRenderbuffer({ .Type = RenderbufferType::DEPTH, .Size = feedbackSize });
+	s_Data.FeedbackFBO->AddColorAttachment({
+		.Type = ColorAttachmentType::TEX_2D,
+		.Format = TextureFormat::RGBA8,
+		.Wrap = GL_CLAMP_TO_EDGE,
+		.MinFilter = GL_NEAREST,
+		.MagFilter = GL_NEAREST,
+		.Size = feedbackSize,
+		.GenMipmaps = false
+	});
+	s_Data.FeedbackFBO->DrawToColorAttachment(0, 0);
+	s_Data.FeedbackFBO->FillDrawBuffers();
+	assert(s_Data.FeedbackFBO->IsComplete() && "Incomplete framebuffer!");
+	s_Data.FeedbackFBO->Unbind();
+
+	ShaderSpec spec{};
+	spec.Vertex	  = { "resources/shaders/Default.vert", {} };
+	spec.Fragment = {
+		"resources/shaders/VTFeedback.frag",
+		{
+			{ "${MATERIALS_COUNT}",			std::to_string(maxMaterials)		 },
+			{ "${MAX_VIRTUAL_TEXTURES}",	std::to_string(MAX_VIRTUAL_TEXTURES) }
+		}
+	};
+	s_Data.FeedbackShader = std::make_shared<Shader>(spec);
+	s_Data.FeedbackUniforms = ResolveUniforms(*s_Data.FeedbackShader);
+	s_Data.FeedbackBias = s_Data.FeedbackShader->Uniform("u_FeedbackBias");
+	s_Data.FeedbackReadback = std::make_unique<PixelReadback>(FEEDBACK_READBACKS);
+
+	s_Data.StreamerRunning = true;
+	for (uint32_t i = 0; i < STREAMER_THREADS; i++)
+	{
+		s_Data.Streamers.emplace_back(StreamerLoop);
+	}
+}
+
+void VirtualTexturing::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(s_Data.QueueMutex);
+		s_Data.StreamerRunning = false;
+		s_Data.Requests.clear();
+		s_Data.Loaded.clear();
+	}
+	s_Data.QueueCondition.notify_all();
+	for (std::thread& streamer : s_Data.Streamers)
+	{
+		streamer.join();
+	}
+	s_Data.Streamers.clear();
+
+	s_Data.FeedbackFBO = nullptr;
+	s_Data.FeedbackShader = nullptr;
+	s_Data.FeedbackReadback = nullptr;
+	s_Data.FeedbackWritten = false;
+
+	if (s_Data.PageTableID != 0)
+	{
+		GLState::ForgetTexture(s_Data.PageTableID);
+		GLCall(glDeleteTextures(1, &s_Data.PageTableID));
+		s_Data.PageTableID = 0;
+	}
+
+	if (s_Data.PhysicalID != 0)
+	{
+		GLState::ForgetTexture(s_Data.PhysicalID);
+		GLCall(glDeleteTextures(1, &s_Data.PhysicalID));
+		s_Data.PhysicalID = 0;
+	}
+
+	s_Data.Textures.clear();
+	s_Data.Regions.clear();
+	s_Data.MaxMips.clear();
+	s_Data.LoadedPaths.clear();
+	s_Data.ResidentPages.clear();
+	s_Data.PendingPages.clear();
+}
+
+int32_t VirtualTexturing::Load(const std::string& path)
+{
+	if (auto it = s_Data.LoadedPaths.find(path); it != s_Data.LoadedPaths.end())
+	{
+		return it->second;
+	}
+
+	if (s_Data.Textures.size() >= MAX_VIRTUAL_TEXTURES)
+	{
+		LOG_ERROR("Can't load {}, all {} virtual textures are in use", path, MAX_VIRTUAL_TEXTURES);
+		return -1;
+	}
+
+	std::error_code ec;
+	uint64_t fileSize = std::filesystem::file_size(path, ec);
+	if (ec)
+	{
+		LOG_ERROR("Failed to open virtual texture source {}", path);
+		return -1;
+	}
+
+	// The source can be huge, so the cache is keyed by its path, size and modification time instead of its contents
+	auto writeTime = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+	size_t hash = std::hash<std::string>{}(path + ':' + std::to_string(fileSize) + ':' + std::to_string(writeTime));
+
+	char fileName[32]{};
+	snprintf(fileName, sizeof(fileName), "%016llx.vtex", (unsigned long long)hash);
+	std::filesystem::path cachePath = CACHE_DIRECTORY / fileName;
+
+	std::shared_ptr<VirtualTextureFile> file = std::make_shared<VirtualTextureFile>();
+	if (!file->Open(cachePath))
+	{
+		Clock clock;
+		int32_t width = 0;
+		int32_t height = 0;
+		int32_t channels = 0;
+		stbi_set_flip_vertically_on_load(1);
+		uint8_t* pixels = stbi_load(path.c_str(), &width, &height, &channels, 4);
+		if (pixels == nullptr)
+		{
+			LOG_ERROR("Failed to decode virtual texture source {}", path);
+			return -1;
+		}
+
+		bool baked = VirtualTextureFile::Bake(pixels, width, height, cachePath);
+		stbi_image_free(pixels);
+		if (!baked || !file->Open(cachePath))
+		{
+			LOG_ERROR("Failed to bake virtual texture {}", path);
+			return -1;
+		}
+
+		LOG_INFO("Baked virtual texture {} ({}x{}, {} mips) in {}ms", path, width, height, file->MipCount(), clock.GetElapsedTime());
+	}
+
+	// Square power of two region aligned to its size, so every page of every mip up to the last one belongs to this texture only
+	int32_t regionPages = 1;
+	while (regionPages < (int32_t)std::max(file->PagesX(0), file->PagesY(0)))
+	{
+		regionPages *= 2;
+	}
+
+	if (regionPages > VIRTUAL_PAGES)
+	{
+		LOG_ERROR("{} doesn't fit into the virtual address space", path);
+		return -1;
+	}
+
+	auto isFree = [regionPages](int32_t originX, int32_t originY)
+		{
+			for (int32_t y = originY; y < originY + regionPages; y++)
+			{
+				for (int32_t x = originX; x < originX + regionPages; x++)
+				{
+					if (s_Data.Occupancy[(size_t)y * VIRTUAL_PAGES + x] != 0)
+					{
+						return false;
+					}
+				}
+			}
+
+			return true;
+		};
+
+	std::optional<glm::ivec2> origin;
+	for (int32_t y = 0; y < VIRTUAL_PAGES && !origin.has_value(); y += regionPages)
+	{
+		for (int32_t x = 0; x < VIRTUAL_PAGES; x += regionPages)
+		{
+			if (isFree(x, y))
+			{
+				origin = glm::ivec2(x, y);
+				break;
+			}
+		}
+	}
+
+	if (!origin.has_value())
+	{
+		LOG_ERROR("Virtual address space is full, can't load {}", path);
+		return -1;
+	}
+
+	int32_t id = (int32_t)s_Data.Textures.size();
+	for (int32_t y = origin->y; y < origin->y + regionPages; y++)
+	{
+		std::fill_n(s_Data.Occupancy.begin() + (size_t)y * VIRTUAL_PAGES + origin->x, regionPages, (uint8_t)(id + 1));
+	}
+
+	s_Data.Textures.push_back({ std::filesystem::path(path).filename().string(), file, origin.value() });
+	s_Data.Regions.push_back(glm::vec4(
+		(float)(origin->x * VirtualTextureFile::PAGE_SIZE), (float)(origin->y * VirtualTextureFile::PAGE_SIZE),
+		(float)file->Width(), (float)file->Height()
+	));
+	s_Data.MaxMips.push_back((int32_t)file->MipCount() - 1);
+	s_Data.LoadedPaths[path] = id;
+
+	// The last mip stays resident, so there's always something to fall back to
+	uint32_t lastMip = file->MipCount() - 1;
+	std::vector<uint8_t> page(VirtualTextureFile::PAGE_BYTES);
+	int32_t slot = AcquireSlot();
+	if (slot != -1 && file->ReadPage(lastMip, 0, 0, page.data()))
+	{
+		UploadPage(slot, PageKey(lastMip, origin->x >> lastMip, origin->y >> lastMip), page.data(), true);
+	}
+	else
+	{
+		LOG_WARN("Failed to pin the last mip of {}", path);
+	}
+
+	return id;
+}
+
+const std::string& VirtualTexturing::Name(int32_t id)
+{
+	return s_Data.Textures[id].Name;
+}
+
+bool VirtualTexturing::HasTextures()
+{
+	return !s_Data.Textures.empty();
+}
+
+VirtualTextureUniforms VirtualTexturing::ResolveUniforms(Shader& shader)
+{
+	return { shader.Uniform("u_VirtualTextures"), shader.Uniform("u_VirtualMaxMips") };
+}
+
+void VirtualTexturing::ApplyUniforms(const std::shared_ptr<Shader>& shader, const VirtualTextureUniforms& uniforms)
+{
+	if (s_Data.Regions.empty())
+	{
+		return;
+	}
+
+	shader->Bind();
+	shader->SetUniform4fv(uniforms.Regions, s_Data.Regions.data(), (uint32_t)s_Data.Regions.size());
+	shader->SetUniform1iv(uniforms.MaxMips, s_Data.MaxMips.data(), (uint32_t)s_Data.MaxMips.size());
+}
+
+void VirtualTexturing::BindTextures(int32_t pageTableSlot, int32_t physicalSlot)
+{
+	GLState::BindTexture(pageTableSlot, GL_TEXTURE_2D, s_Data.PageTableID);
+	GLState::BindTexture(physicalSlot, GL_TEXTURE_2D, s_Data.PhysicalID);
+}
+
+std::shared_ptr<Shader> VirtualTexturing::BeginFeedback(const glm::ivec2& viewportSize)
+{
+	// Resizing drops what earlier passes of this frame wrote, so it only happens on the first one
+	glm::ivec2 size = glm::max(viewportSize / FEEDBACK_DIVISOR, glm::ivec2(1));
+	if (!s_Data.FeedbackWritten && size != s_Data.FeedbackFBO->ColorAttachmentSize(0))
+	{
+		s_Data.FeedbackFBO->ResizeEverything(size);
+	}
+	size = s_Data.FeedbackFBO->ColorAttachmentSize(0);
+
+	s_Data.FeedbackFBO->Bind();
+	GLCall(glViewport(0, 0, size.x, size.y));
+	GLState::DepthMask(true);
+
+	const float clearColor[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	const float clearDepth = 1.0f;
+	if (!s_Data.FeedbackWritten)
+	{
+		GLCall(glClearBufferfv(GL_COLOR, 0, clearColor));
+	}
+	GLCall(glClearBufferfv(GL_DEPTH, 0, &clearDepth));
+	s_Data.FeedbackWritten = true;
+
+	// Derivatives are FEEDBACK_DIVISOR times larger than in the full resolution pass
+	ApplyUniforms(s_Data.FeedbackShader, s_Data.FeedbackUniforms);
+	s_Data.FeedbackShader->SetUniform1f(s_Data.FeedbackBias, std::log2((float)viewportSize.x / (float)size.x));
+
+	return s_Data.FeedbackShader;
+}
+
+std::shared_ptr<Shader> VirtualTexturing::FeedbackShader()
+{
+	return s_Data.FeedbackShader;
+}
+
+void VirtualTexturing::EndFrame()
+{
+	if (s_Data.Textures.empty())
+	{
+		return;
+	}
+
+	s_Data.Stats.UploadedPages = 0;
+	ReadFeedback();
+
+	UploadLoadedPages();
+	if (s_Data.PageTableDirty)
+	{
+		RebuildPageTable();
+	}
+
+	s_Data.Stats.RequestedPages = (uint32_t)s_Data.RequestedPages.size();
+	s_Data.Frame++;
+}
+
+VirtualTexturingStats VirtualTexturing::Stats()
+{
+	VirtualTexturingStats stats = s_Data.Stats;
+	stats.ResidentPages = (uint32_t)s_Data.ResidentPages.size();
+	stats.PageCapacity = (uint32_t)s_Data.Slots.size();
+	stats.PendingPages = (uint32_t)s_Data.PendingPages.size();
+
+	return stats;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "OpenGL.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <filesystem>
+
+// Tiled on-disk layout: a small header followed by every page of every mip, each page padded with a wrapped border
+class VirtualTextureFile
+{
+public:
+	static constexpr int32_t PAGE_SIZE = 128;
+	static constexpr int32_t PAGE_BORDER = 4;
+	static constexpr int32_t PADDED_PAGE_SIZE = PAGE_SIZE + 2 * PAGE_BORDER;
+	static constexpr size_t PAGE_BYTES = (size_t)PADDED_PAGE_SIZE * PADDED_PAGE_SIZE * 4;
+
+	// Splits an RGBA8 image and its mip chain into pages, the last mip always fits in a single page
+	static bool Bake(const uint8_t* rgba, int32_t width, int32_t height, const std::filesystem::path& path);
+
+	bool Open(const std::filesystem::path& path);
+
+	// Thread safe, output has to hold PAGE_BYTES
+	bool ReadPage(uint32_t mip, uint32_t pageX, uint32_t pageY, uint8_t* output);
+
+	inline int32_t Width() const	  { return m_Width; }
+	inline int32_t Height() const	  { return m_Height; }
+	inline uint32_t MipCount() const { return m_MipCount; }
+	uint32_t PagesX(uint32_t mip) const;
+	uint32_t PagesY(uint32_t mip) const;
+
+private:
+	std::mutex m_Mutex;
+	std::ifstream m_File;
+
+	int32_t m_Width = 0;
+	int32_t m_Height = 0;
+	uint32_t m_MipCount = 0;
+	std::vector<uint64_t> m_MipFirstPage;
+};
+
+struct VirtualTexturingStats
+{
+	uint32_t ResidentPages = 0;
+	uint32_t PageCapacity = 0;
+	uint32_t PendingPages = 0;
+	uint32_t UploadedPages = 0;
+	uint32_t RequestedPages = 0;
+};
+
+class Shader;
+
+// Handles of the uniforms ApplyUniforms sets, resolved once per shader
+struct VirtualTextureUniforms
+{
+	UniformHandle Regions;
+	UniformHandle MaxMips;
+};
+
+class VirtualTexturing
+{
+public:
+	static void Init(int32_t maxMaterials);
+	static void Shutdown();
+
+	// Bakes the image into the tiled format on first use and maps it into the virtual address space, -1 on failure
+	static int32_t Load(const std::string& path);
+	static const std::string& Name(int32_t id);
+
+	static bool HasTextures();
+
+	// Origin and size in mip 0 virtual texels plus the last mip of every loaded texture, indexed by the ID returned from Load
+	static VirtualTextureUniforms ResolveUniforms(Shader& shader);
+	static void ApplyUniforms(const std::shared_ptr<Shader>& shader, const VirtualTextureUniforms& uniforms);
+
+	static void BindTextures(int32_t pageTableSlot, int32_t physicalSlot);
+
+	// Binds the low resolution feedback target sized after the given viewport, the caller draws the visible meshes with the returned shader
+	static std::shared_ptr<Shader> BeginFeedback(const glm::ivec2& viewportSize);
+	static std::shared_ptr<Shader> FeedbackShader();
+
+	// Queues the feedback for readback, queues missing pages from an earlier one that arrived and uploads the ones the streamer finished
+	static void EndFrame();
+
+	static VirtualTexturingStats Stats();
+
+	static constexpr int32_t VIRTUAL_PAGES = 256;
+	static constexpr int32_t PAGE_TABLE_MIPS = 9;
+	static constexpr int32_t PHYSICAL_PAGES = 16;
+	static constexpr int32_t MAX_VIRTUAL_TEXTURES = 32;
+	static constexpr int32_t FEEDBACK_DIVISOR = 8;
+	static constexpr uint32_t FEEDBACK_READBACKS = 3;
+	static constexpr uint32_t MAX_UPLOADS_PER_FRAME = 16;
+	static constexpr uint32_t MAX_PENDING_PAGES = 64;
+	static constexpr uint32_t STREAMER_THREADS = 2;
+};
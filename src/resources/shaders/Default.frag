@@ -1,13 +1,17 @@
 #version 430 core
 
+// PARALLAX, NORMAL_MAP and PBR_TEXTURES of the material variant this program draws
+${MATERIAL_FEATURES}
 #define MATERIALS_COUNT ${MATERIALS_COUNT}
 #define TEXTURE_UNITS ${TEXTURE_UNITS}
 #define MAX_DIR_LIGHTS ${MAX_DIR_LIGHTS}
 #define MAX_POINT_LIGHTS ${MAX_POINT_LIGHTS}
 #define MAX_SPOTLIGHTS ${MAX_SPOTLIGHTS}
+#define MAX_VIRTUAL_TEXTURES ${MAX_VIRTUAL_TEXTURES}
+#define VT_PAGE_SIZE 128.0
+#define VT_PAGE_BORDER 4.0
 
 layout(location = 0) out vec4 gDefault;
-layout(location = 1) out vec4 gPicker;
 
 struct DirectionalLight
 {
@@ -60,7 +64,7 @@ struct Material
 	int ambientOccTextureSlot;
 	float ambientOccFactor;
 
-	float padding;
+	int virtualTextureID;
 };
 
 in VS_OUT
@@ -114,9 +118,15 @@ layout(std140, binding = 4) uniform Spotlights
 
 uniform bool u_IsLightSource = false;
 uniform samplerCube u_IrradianceMap;
+uniform vec3 u_IrradianceSH[9];
+uniform bool u_UseIrradianceSH = false;
 uniform samplerCube u_PrefilterMap;
 uniform sampler2D u_BRDF_LUT;
 uniform sampler2D u_Textures[TEXTURE_UNITS];
+uniform sampler2D u_VirtualPageTable;
+uniform sampler2D u_VirtualPhysical;
+uniform vec4 u_VirtualTextures[MAX_VIRTUAL_TEXTURES];
+uniform int u_VirtualMaxMips[MAX_VIRTUAL_TEXTURES];
 
 uniform float u_CascadeDistances[${CASCADES_COUNT}];
 uniform sampler2DArrayShadow u_DirLightCSM;
@@ -132,6 +142,38 @@ uniform bool u_FasterShadows = true;
 
 const float PI = 3.14159265359;
 
+// Looks the page up in the page table, which points non-resident pages at their closest resident ancestor
+vec4 sampleVirtual(int id, vec2 texCoords)
+{
+	vec4 region = u_VirtualTextures[id];
+	vec2 dx = dFdx(texCoords * region.zw);
+	vec2 dy = dFdy(texCoords * region.zw);
+	float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy)));
+	int mip = int(clamp(floor(lod), 0.0, float(u_VirtualMaxMips[id])));
+
+	vec2 virtualTexel = fract(texCoords) * region.zw + region.xy;
+	vec4 entry = texelFetch(u_VirtualPageTable, ivec2(virtualTexel / VT_PAGE_SIZE) >> mip, mip) * 255.0;
+	vec2 inPage = mod(virtualTexel / exp2(round(entry.b)), VT_PAGE_SIZE);
+	vec2 physical = round(entry.rg) * (VT_PAGE_SIZE + 2.0 * VT_PAGE_BORDER) + VT_PAGE_BORDER + inPage;
+
+	return textureLod(u_VirtualPhysical, physical / vec2(textureSize(u_VirtualPhysical, 0)), 0.0);
+}
+
+// Coefficients are already convolved with the cosine lobe and divided by pi, ringing can push the result below zero
+vec3 irradianceSH(vec3 n)
+{
+	vec3 result = u_IrradianceSH[0] * 0.282095
+		+ u_IrradianceSH[1] * 0.488603 * n.y
+		+ u_IrradianceSH[2] * 0.488603 * n.z
+		+ u_IrradianceSH[3] * 0.488603 * n.x
+		+ u_IrradianceSH[4] * 1.092548 * n.x * n.y
+		+ u_IrradianceSH[5] * 1.092548 * n.y * n.z
+		+ u_IrradianceSH[6] * 0.315392 * (3.0 * n.z * n.z - 1.0)
+		+ u_IrradianceSH[7] * 1.092548 * n.x * n.z
+		+ u_IrradianceSH[8] * 0.546274 * (n.x * n.x - n.y * n.y);
+	return max(result, vec3(0.0));
+}
+
 vec3 fresnelSchlick(float cosTheta, vec3 F0)
 {
 	return F0 + (1.0 - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
@@ -421,19 +463,11 @@ float worseShadowFactor(sampler2DArrayShadow shadowMaps, mat4 lightSpaceMat, int
 
 void main()
 {
-	int entID = int(fs_in.entityID);
-	int rInt = int(mod(int(entID / 65025.0), 255));
-	int gInt = int(mod(int(entID / 255.0), 255));
-	int bInt = int(mod(entID, 255));
-	float r = float(rInt) / 255.0;
-	float g = float(gInt) / 255.0;
-	float b = float(bInt) / 255.0;
-	gPicker = vec4(r, g, b, 1.0);
-	
 	Material mat = u_Materials.materials[int(fs_in.materialSlot)];
 	vec3 V = normalize(fs_in.tangentViewPos - fs_in.tangentWorldPos);
 
 	vec2 texCoords = fs_in.textureUV * mat.tilingFactor + mat.texOffset;
+#ifdef PARALLAX
 	if(bool(mat.isDepthMap))
 	{
 		texCoords = depthMapUV(texCoords, V, u_Textures[mat.heightTextureSlot], mat.heightFactor);
@@ -442,6 +476,7 @@ void main()
 	{
 		texCoords = heightMapUV(texCoords, V, u_Textures[mat.heightTextureSlot], mat.heightFactor);
 	}
+#endif
 
 	if(texCoords.x < -0.01 || texCoords.y < -0.01
 		|| texCoords.x > mat.tilingFactor.x + mat.texOffset.x + 0.01 
@@ -450,7 +485,9 @@ void main()
 		discard;
 	}
 
-	vec4 diffuseColor = texture(u_Textures[mat.albedoTextureSlot], texCoords);
+	vec4 diffuseColor = mat.virtualTextureID >= 0
+		? sampleVirtual(mat.virtualTextureID, texCoords)
+		: texture(u_Textures[mat.albedoTextureSlot], texCoords);
 	if(diffuseColor.a == 0.0)
 	{
 		gDefault = vec4(0.0);
@@ -464,11 +501,23 @@ void main()
 		return;
 	}
 	
+#ifdef PBR_TEXTURES
 	float roughness = texture(u_Textures[mat.roughnessTextureSlot], texCoords).r * mat.roughnessFactor;
 	float metallic = texture(u_Textures[mat.metallicTextureSlot], texCoords).r * mat.metallicFactor;
 	float AO = texture(u_Textures[mat.ambientOccTextureSlot], texCoords).r * mat.ambientOccFactor;
-	vec3 N = texture(u_Textures[mat.normalTextureSlot], texCoords).rgb;
-	N = N * 2.0 - 1.0;
+#else
+	float roughness = mat.roughnessFactor;
+	float metallic = mat.metallicFactor;
+	float AO = mat.ambientOccFactor;
+#endif
+
+#ifdef NORMAL_MAP
+	// Z is rebuilt from XY so two-channel (BC5) normal maps work the same as RGB ones
+	vec3 N = vec3(texture(u_Textures[mat.normalTextureSlot], texCoords).rg * 2.0 - 1.0, 0.0);
+	N.z = sqrt(max(1.0 - dot(N.xy, N.xy), 0.0));
+#else
+	vec3 N = vec3(0.0, 0.0, 1.0);
+#endif
 	
 	vec3 Lo = vec3(0.0);
 	vec3 F0 = mix(vec3(0.04), diffuseColor.rgb, metallic);
@@ -609,7 +658,7 @@ void main()
 	vec3 kD = 1.0 - kS;
 	kD *= 1.0 - metallic;
 
-	vec3 irradiance = texture(u_IrradianceMap, N).rgb;
+	vec3 irradiance = u_UseIrradianceSH ? irradianceSH(N) : texture(u_IrradianceMap, N).rgb;
 	vec3 diffuse = irradiance * diffuseColor.rgb;
 	vec3 ambient = (kD * diffuse + specular) * AO;
 	
@@ -28,7 +28,7 @@ struct Material
 	int ambientOccTextureSlot;
 	float ambientOccFactor;
 
-	float padding;
+	int virtualTextureID;
 };
 
 layout(std140, binding = 1) uniform Materials
@@ -0,0 +1,75 @@
+#version 430 core
+
+#define MATERIALS_COUNT ${MATERIALS_COUNT}
+#define MAX_VIRTUAL_TEXTURES ${MAX_VIRTUAL_TEXTURES}
+#define VT_PAGE_SIZE 128.0
+
+layout (location = 0) out vec4 o_Feedback;
+
+struct Material
+{
+	vec4 color;
+	vec2 tilingFactor;
+	vec2 texOffset;
+
+	int albedoTextureSlot;
+	int normalTextureSlot;
+
+	int heightTextureSlot;
+	float heightFactor;
+	int isDepthMap;
+
+	int	roughnessTextureSlot;
+	float roughnessFactor;
+
+	int metallicTextureSlot;
+	float metallicFactor;
+
+	int ambientOccTextureSlot;
+	float ambientOccFactor;
+
+	int virtualTextureID;
+};
+
+layout(std140, binding = 1) uniform Materials
+{
+	Material materials[MATERIALS_COUNT];
+} u_Materials;
+
+in VS_OUT
+{
+	vec3 worldPos;
+	vec3 viewSpacePos;
+	vec3 eyePos;
+	vec3 normal;
+	mat3 TBN;
+	vec3 tangentWorldPos;
+	vec3 tangentViewPos;
+	vec2 textureUV;
+	flat float materialSlot;
+	flat float entityID;
+} fs_in;
+
+uniform vec4 u_VirtualTextures[MAX_VIRTUAL_TEXTURES];
+uniform int u_VirtualMaxMips[MAX_VIRTUAL_TEXTURES];
+uniform float u_FeedbackBias;
+
+// Page and mip the main pass is going to sample, alpha marks a written request
+void main()
+{
+	Material mat = u_Materials.materials[int(fs_in.materialSlot)];
+	if(mat.virtualTextureID < 0)
+	{
+		discard;
+	}
+
+	vec4 region = u_VirtualTextures[mat.virtualTextureID];
+	vec2 texCoords = fs_in.textureUV * mat.tilingFactor + mat.texOffset;
+	vec2 dx = dFdx(texCoords * region.zw);
+	vec2 dy = dFdy(texCoords * region.zw);
+	float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy))) - u_FeedbackBias;
+	int mip = int(clamp(floor(lod), 0.0, float(u_VirtualMaxMips[mat.virtualTextureID])));
+
+	ivec2 page = ivec2((fract(texCoords) * region.zw + region.xy) / VT_PAGE_SIZE) >> mip;
+	o_Feedback = vec4(page.x, page.y, mip, 255) / 255.0;
+}
\ No newline at end of file
@@ -1,7 +1,12 @@
 #version 430 core
 
+// PARALLAX, NORMAL_MAP and PBR_TEXTURES of the material variant this program draws
+${MATERIAL_FEATURES}
 #define MATERIALS_COUNT ${MATERIALS_COUNT}
 #define TEXTURE_UNITS ${TEXTURE_UNITS}
+#define MAX_VIRTUAL_TEXTURES ${MAX_VIRTUAL_TEXTURES}
+#define VT_PAGE_SIZE 128.0
+#define VT_PAGE_BORDER 4.0
 
 layout (location = 0) out vec4 gPosition;
 layout (location = 1) out vec4 gNormal;
@@ -30,7 +35,7 @@ struct Material
 	int ambientOccTextureSlot;
 	float ambientOccFactor;
 
-	float padding;
+	int virtualTextureID;
 };
 
 layout(std140, binding = 1) uniform Materials
@@ -39,6 +44,10 @@ layout(std140, binding = 1) uniform Materials
 } u_Materials;
 
 uniform sampler2D u_Textures[TEXTURE_UNITS];
+uniform sampler2D u_VirtualPageTable;
+uniform sampler2D u_VirtualPhysical;
+uniform vec4 u_VirtualTextures[MAX_VIRTUAL_TEXTURES];
+uniform int u_VirtualMaxMips[MAX_VIRTUAL_TEXTURES];
 
 in VS_OUT
 {
@@ -54,6 +63,23 @@ in VS_OUT
 	flat float entityID;
 } fs_in;
 
+// Looks the page up in the page table, which points non-resident pages at their closest resident ancestor
+vec4 sampleVirtual(int id, vec2 texCoords)
+{
+	vec4 region = u_VirtualTextures[id];
+	vec2 dx = dFdx(texCoords * region.zw);
+	vec2 dy = dFdy(texCoords * region.zw);
+	float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy)));
+	int mip = int(clamp(floor(lod), 0.0, float(u_VirtualMaxMips[id])));
+
+	vec2 virtualTexel = fract(texCoords) * region.zw + region.xy;
+	vec4 entry = texelFetch(u_VirtualPageTable, ivec2(virtualTexel / VT_PAGE_SIZE) >> mip, mip) * 255.0;
+	vec2 inPage = mod(virtualTexel / exp2(round(entry.b)), VT_PAGE_SIZE);
+	vec2 physical = round(entry.rg) * (VT_PAGE_SIZE + 2.0 * VT_PAGE_BORDER) + VT_PAGE_BORDER + inPage;
+
+	return textureLod(u_VirtualPhysical, physical / vec2(textureSize(u_VirtualPhysical, 0)), 0.0);
+}
+
 vec2 heightMapUV(vec2 texCoords, vec3 viewDir, sampler2D depthMap, float heightScale, bool isDepthMap)
 {
 	const float minLayers = 8.0;
@@ -105,15 +131,31 @@ void main()
 	Material mat = u_Materials.materials[int(fs_in.materialSlot)];
 	vec2 texCoords = fs_in.textureUV * mat.tilingFactor + mat.texOffset;
 	vec3 V = normalize(fs_in.tangentViewPos - fs_in.tangentWorldPos);
+#ifdef PARALLAX
 	texCoords = heightMapUV(texCoords, V, u_Textures[mat.heightTextureSlot], mat.heightFactor, bool(mat.isDepthMap));
-	gColor = texture(u_Textures[mat.albedoTextureSlot], texCoords) * mat.color;
-
-	vec3 N = texture(u_Textures[mat.normalTextureSlot], texCoords).rgb;
-	N = N * 2.0 - 1.0;
+#endif
+	vec4 albedo = mat.virtualTextureID >= 0
+		? sampleVirtual(mat.virtualTextureID, texCoords)
+		: texture(u_Textures[mat.albedoTextureSlot], texCoords);
+	gColor = albedo * mat.color;
+
+#ifdef NORMAL_MAP
+	// Z is rebuilt from XY so two-channel (BC5) normal maps work the same as RGB ones
+	vec3 N = vec3(texture(u_Textures[mat.normalTextureSlot], texCoords).rg * 2.0 - 1.0, 0.0);
+	N.z = sqrt(max(1.0 - dot(N.xy, N.xy), 0.0));
+#else
+	vec3 N = vec3(0.0, 0.0, 1.0);
+#endif
 	gNormal = vec4(normalize(transpose(fs_in.TBN) * N), 1.0);
 
+#ifdef PBR_TEXTURES
 	float roughness = texture(u_Textures[mat.roughnessTextureSlot], texCoords).r * mat.roughnessFactor;
 	float metallic = texture(u_Textures[mat.metallicTextureSlot], texCoords).r * mat.metallicFactor;
 	float AO = texture(u_Textures[mat.ambientOccTextureSlot], texCoords).r * mat.ambientOccFactor;
+#else
+	float roughness = mat.roughnessFactor;
+	float metallic = mat.metallicFactor;
+	float AO = mat.ambientOccFactor;
+#endif
 	gMaterial = vec4(roughness, metallic, AO, 1.0);
 }
\ No newline at end of file
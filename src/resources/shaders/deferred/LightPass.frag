@@ -20,7 +20,6 @@ struct Spotlight
 };
 
 layout (location = 0) out vec4 o_Color;
-layout (location = 1) out vec4 o_Picker;
 
 uniform sampler2D gPosition;
 uniform sampler2D gNormal;
@@ -28,6 +27,8 @@ uniform sampler2D gColor;
 uniform sampler2D gMaterial;
 uniform sampler2D gLights;
 uniform samplerCube u_IrradianceMap;
+uniform vec3 u_IrradianceSH[9];
+uniform bool u_UseIrradianceSH = false;
 uniform samplerCube u_PrefilterMap;
 uniform sampler2D u_BRDF_LUT;
 
@@ -71,6 +72,21 @@ in VS_OUT
 
 const float PI = 3.14159265359;
 
+// Coefficients are already convolved with the cosine lobe and divided by pi, ringing can push the result below zero
+vec3 irradianceSH(vec3 n)
+{
+	vec3 result = u_IrradianceSH[0] * 0.282095
+		+ u_IrradianceSH[1] * 0.488603 * n.y
+		+ u_IrradianceSH[2] * 0.488603 * n.z
+		+ u_IrradianceSH[3] * 0.488603 * n.x
+		+ u_IrradianceSH[4] * 1.092548 * n.x * n.y
+		+ u_IrradianceSH[5] * 1.092548 * n.y * n.z
+		+ u_IrradianceSH[6] * 0.315392 * (3.0 * n.z * n.z - 1.0)
+		+ u_IrradianceSH[7] * 1.092548 * n.x * n.z
+		+ u_IrradianceSH[8] * 0.546274 * (n.x * n.x - n.y * n.y);
+	return max(result, vec3(0.0));
+}
+
 vec3 fresnelSchlick(float cosTheta, vec3 F0)
 {
 	return F0 + (1.0 - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
@@ -263,14 +279,6 @@ void main()
 		discard;
 	}
 
-	int rInt = int(mod(int(entID / 65025.0), 255));
-	int gInt = int(mod(int(entID / 255.0), 255));
-	int bInt = int(mod(entID, 255));
-	float r = float(rInt) / 255.0;
-	float g = float(gInt) / 255.0;
-	float b = float(bInt) / 255.0;
-	o_Picker = vec4(r, g, b, 1.0);
-
 	vec3 worldPos = texture(gPosition, fs_in.textureUV).rgb;
 	vec3 N = texture(gNormal, fs_in.textureUV).rgb;
 
@@ -364,7 +372,7 @@ void main()
 	vec3 kD = 1.0 - kS;
 	kD *= 1.0 - metallic;
 
-	vec3 irradiance = texture(u_IrradianceMap, N).rgb;
+	vec3 irradiance = u_UseIrradianceSH ? irradianceSH(N) : texture(u_IrradianceMap, N).rgb;
 	vec3 diffuse = irradiance * diffuseColor.rgb;
 	vec3 ambient = (kD * diffuse + specular) * ao;
 
@@ -6,6 +6,8 @@ in vec3 localPos;
 
 uniform samplerCube u_EnvironmentMap;
 uniform float u_Roughness;
+uniform float u_Resolution;
+uniform int u_SampleCount;
 
 const float PI = 3.14159265359;
 
@@ -64,12 +66,15 @@ void main()
 	vec3 R = N;
 	vec3 V = R;
 
-	const uint SAMPLE_COUNT = 1024u;
+	// Filtered importance sampling, each sample reads the source mip whose texels cover the solid angle it stands for,
+	// so a few dozen samples converge where plain importance sampling needs thousands
+	uint sampleCount = uint(u_SampleCount);
+	float saTexel = 4.0 * PI / (6.0 * u_Resolution * u_Resolution);
 	float totalWeight = 0.0;
 	vec3 prefilteredColor = vec3(0.0);
-	for(uint i = 0u; i < SAMPLE_COUNT; i++)
+	for(uint i = 0u; i < sampleCount; i++)
 	{
-		vec2 Xi = hammersley(i, SAMPLE_COUNT);
+		vec2 Xi = hammersley(i, sampleCount);
 		vec3 H  = importanceSampleGGX(Xi, N, u_Roughness);
 		vec3 L  = normalize(2.0 * dot(V, H) * H - V);
 
@@ -77,15 +82,12 @@ void main()
 		if(NL > 0.0)
 		{
 			float D = distGGX(N, H, u_Roughness);
-            float NH = max(dot(N, H), 0.0);
-            float HV = max(dot(H, V), 0.0);
-            float pdf = D * NH / (4.0 * HV) + 0.0001; 
+			float NH = max(dot(N, H), 0.0);
+			float HV = max(dot(H, V), 0.0);
+			float pdf = D * NH / (4.0 * HV) + 0.0001;
+			float saSample = 1.0 / (float(sampleCount) * pdf + 0.0001);
 
-            float resolution = 1024.0;
-            float saTexel = 4.0 * PI / (6.0 * resolution * resolution);
-            float saSample = 1.0 / (float(SAMPLE_COUNT) * pdf + 0.0001);
-
-            float mipLevel = u_Roughness == 0.0 ? 0.0 : 0.5 * log2(saSample / saTexel); 
+			float mipLevel = u_Roughness == 0.0 ? 0.0 : 0.5 * log2(saSample / saTexel) + 1.0;
 			prefilteredColor += textureLod(u_EnvironmentMap, L, mipLevel).rgb * NL;
 			totalWeight += NL;
 		}
@@ -2,6 +2,7 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <entt/entt.hpp>
 #include <memory>
 #include <string>
 
@@ -29,6 +30,33 @@ struct TransformComponent
 	glm::mat4 ToMat4() const;
 };
 
+// Local transform combined with every parent's, rebuilt only when the entity or one of its parents changed
+struct WorldTransformComponent
+{
+	glm::mat4 Matrix = glm::mat4(1.0f);
+
+	WorldTransformComponent() = default;
+	WorldTransformComponent(const WorldTransformComponent& other) = default;
+};
+
+// Children are linked through their siblings, so reparenting never allocates
+struct RelationshipComponent
+{
+	entt::entity Parent		 = entt::null;
+	entt::entity FirstChild	 = entt::null;
+	entt::entity PrevSibling = entt::null;
+	entt::entity NextSibling = entt::null;
+	uint32_t Depth = 0;
+
+	RelationshipComponent() = default;
+	RelationshipComponent(const RelationshipComponent& other) = default;
+};
+
+// Set when the transform is patched or replaced. Systems patching transforms have to declare writing this too
+struct TransformDirtyComponent
+{
+};
+
 struct MaterialComponent
 {
 	int32_t MaterialID = AssetManager::MATERIAL_DEFAULT;
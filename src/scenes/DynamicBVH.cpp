@@ -0,0 +1,511 @@
+#include "DynamicBVH.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Queries may run on several threads at once, each gets its own traversal stack
+static thread_local std::vector<uint32_t> s_Stack;
+
+float AABB::SurfaceArea() const
+{
+	glm::vec3 size = Max - Min;
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+bool AABB::Contains(const AABB& other) const
+{
+	return Min.x <= other.Min.x && Min.y <= other.Min.y && Min.z <= other.Min.z
+		&& Max.x >= other.Max.x && Max.y >= other.Max.y && Max.z >= other.Max.z;
+}
+
+bool AABB::Overlaps(const AABB& other) const
+{
+	return Min.x <= other.Max.x && Min.y <= other.Max.y && Min.z <= other.Max.z
+		&& Max.x >= other.Min.x && Max.y >= other.Min.y && Max.z >= other.Min.z;
+}
+
+float AABB::DistanceSquared(const glm::vec3& point) const
+{
+	glm::vec3 outside = glm::max(glm::max(Min - point, point - Max), glm::vec3(0.0f));
+	return glm::dot(outside, outside);
+}
+
+AABB AABB::Transform(const glm::mat4& matrix) const
+{
+	glm::vec3 center = glm::vec3(matrix * glm::vec4(Center(), 1.0f));
+	glm::vec3 extents = Extents();
+	glm::vec3 transformed = glm::abs(glm::vec3(matrix[0])) * extents.x + glm::abs(glm::vec3(matrix[1])) * extents.y + glm::abs(glm::vec3(matrix[2])) * extents.z;
+	return { center - transformed, center + transformed };
+}
+
+AABB AABB::Union(const AABB& a, const AABB& b)
+{
+	return { glm::min(a.Min, b.Min), glm::max(a.Max, b.Max) };
+}
+
+Frustum Frustum::FromMatrix(const glm::mat4& projView)
+{
+	glm::vec4 rows[4];
+	for (int32_t i = 0; i < 4; i++)
+	{
+		rows[i] = glm::vec4(projView[0][i], projView[1][i], projView[2][i], projView[3][i]);
+	}
+
+	Frustum frustum{};
+	for (int32_t i = 0; i < 3; i++)
+	{
+		frustum.Planes[i * 2 + 0] = rows[3] + rows[i];
+		frustum.Planes[i * 2 + 1] = rows[3] - rows[i];
+	}
+
+	return frustum;
+}
+
+bool Frustum::Overlaps(const AABB& box) const
+{
+	// Outside once the corner furthest along a plane's normal is behind it
+	glm::vec3 center = box.Center();
+	glm::vec3 extents = box.Extents();
+	for (const glm::vec4& plane : Planes)
+	{
+		glm::vec3 normal = glm::vec3(plane);
+		if (glm::dot(normal, center) + glm::dot(glm::abs(normal), extents) + plane.w < 0.0f)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Entry distance of the ray into the box, if it gets there before maxDistance
+static bool RayEnters(const glm::vec3& origin, const glm::vec3& inverseDirection, const AABB& box, float maxDistance, float& distance)
+{
+	glm::vec3 t0 = (box.Min - origin) * inverseDirection;
+	glm::vec3 t1 = (box.Max - origin) * inverseDirection;
+	glm::vec3 near = glm::min(t0, t1);
+	glm::vec3 far = glm::max(t0, t1);
+
+	distance = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+	return distance <= std::min(std::min(far.x, far.y), std::min(far.z, maxDistance));
+}
+
+uint32_t DynamicBVH::Insert(const AABB& bounds, entt::entity entity)
+{
+	uint32_t leaf = Allocate();
+	Node& node = m_Nodes[leaf];
+	m_Tight[leaf] = bounds;
+	node.Bounds = { bounds.Min - glm::vec3(MARGIN), bounds.Max + glm::vec3(MARGIN) };
+	node.Entity = entity;
+
+	InsertLeaf(leaf);
+	m_LeafCount++;
+	return leaf;
+}
+
+void DynamicBVH::Remove(uint32_t proxy)
+{
+	RemoveLeaf(proxy);
+	Release(proxy);
+	m_LeafCount--;
+}
+
+bool DynamicBVH::Move(uint32_t proxy, const AABB& bounds)
+{
+	m_Tight[proxy] = bounds;
+	if (m_Nodes[proxy].Bounds.Contains(bounds))
+	{
+		return false;
+	}
+
+	RemoveLeaf(proxy);
+	m_Nodes[proxy].Bounds = { bounds.Min - glm::vec3(MARGIN), bounds.Max + glm::vec3(MARGIN) };
+	InsertLeaf(proxy);
+	return true;
+}
+
+void DynamicBVH::Clear()
+{
+	m_Nodes.clear();
+	m_Tight.clear();
+	m_Root = NULL_NODE;
+	m_FreeList = NULL_NODE;
+	m_LeafCount = 0;
+}
+
+float DynamicBVH::AreaRatio() const
+{
+	if (m_Root == NULL_NODE)
+	{
+		return 0.0f;
+	}
+
+	float area = 0.0f;
+	for (uint32_t i = 0; i < m_Nodes.size(); i++)
+	{
+		// Released nodes are marked by a height no live node has
+		const Node& node = m_Nodes[i];
+		if (i != m_Root && !node.IsLeaf() && node.Height != NULL_NODE)
+		{
+			area += node.Bounds.SurfaceArea();
+		}
+	}
+
+	return area / m_Nodes[m_Root].Bounds.SurfaceArea();
+}
+
+bool DynamicBVH::Validate() const
+{
+	if (m_Root == NULL_NODE)
+	{
+		return m_LeafCount == 0;
+	}
+
+	uint32_t leaves = 0;
+	std::vector<uint32_t> stack = { m_Root };
+	if (m_Nodes[m_Root].Parent != NULL_NODE)
+	{
+		return false;
+	}
+
+	while (!stack.empty())
+	{
+		uint32_t index = stack.back();
+		stack.pop_back();
+
+		const Node& node = m_Nodes[index];
+		if (node.IsLeaf())
+		{
+			leaves++;
+			if (node.Height != 0 || !node.Bounds.Contains(m_Tight[index]))
+			{
+				return false;
+			}
+
+			continue;
+		}
+
+		const Node& first = m_Nodes[node.Children[0]];
+		const Node& second = m_Nodes[node.Children[1]];
+		if (first.Parent != index || second.Parent != index || node.Height != 1 + std::max(first.Height, second.Height)
+			|| !node.Bounds.Contains(first.Bounds) || !node.Bounds.Contains(second.Bounds))
+		{
+			return false;
+		}
+
+		stack.push_back(node.Children[0]);
+		stack.push_back(node.Children[1]);
+	}
+
+	return leaves == m_LeafCount;
+}
+
+template<typename Test>
+void DynamicBVH::Collect(const Test& test, std::vector<entt::entity>& results) const
+{
+	if (m_Root == NULL_NODE)
+	{
+		return;
+	}
+
+	s_Stack.clear();
+	s_Stack.push_back(m_Root);
+	while (!s_Stack.empty())
+	{
+		uint32_t index = s_Stack.back();
+		const Node& node = m_Nodes[index];
+		s_Stack.pop_back();
+		if (!test(node.Bounds))
+		{
+			continue;
+		}
+
+		if (node.IsLeaf())
+		{
+			if (test(m_Tight[index]))
+			{
+				results.push_back(node.Entity);
+			}
+
+			continue;
+		}
+
+		s_Stack.push_back(node.Children[0]);
+		s_Stack.push_back(node.Children[1]);
+	}
+}
+
+void DynamicBVH::Query(const AABB& box, std::vector<entt::entity>& results) const
+{
+	Collect([&](const AABB& bounds) { return bounds.Overlaps(box); }, results);
+}
+
+void DynamicBVH::QuerySphere(const glm::vec3& center, float radius, std::vector<entt::entity>& results) const
+{
+	Collect([&](const AABB& bounds) { return bounds.DistanceSquared(center) <= radius * radius; }, results);
+}
+
+void DynamicBVH::QueryFrustum(const Frustum& frustum, std::vector<entt::entity>& results) const
+{
+	Collect([&](const AABB& bounds) { return frustum.Overlaps(bounds); }, results);
+}
+
+std::optional<SpatialHit> DynamicBVH::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const
+{
+	if (m_Root == NULL_NODE)
+	{
+		return std::nullopt;
+	}
+
+	glm::vec3 inverseDirection = 1.0f / direction;
+	std::optional<SpatialHit> hit;
+	s_Stack.clear();
+	s_Stack.push_back(m_Root);
+	while (!s_Stack.empty())
+	{
+		uint32_t index = s_Stack.back();
+		const Node& node = m_Nodes[index];
+		s_Stack.pop_back();
+
+		// Every hit shortens the ray, which prunes what's behind it
+		float distance = 0.0f;
+		if (!RayEnters(origin, inverseDirection, node.Bounds, maxDistance, distance))
+		{
+			continue;
+		}
+
+		if (node.IsLeaf())
+		{
+			if (RayEnters(origin, inverseDirection, m_Tight[index], maxDistance, distance))
+			{
+				maxDistance = distance;
+				hit = SpatialHit{ node.Entity, distance };
+			}
+
+			continue;
+		}
+
+		s_Stack.push_back(node.Children[0]);
+		s_Stack.push_back(node.Children[1]);
+	}
+
+	return hit;
+}
+
+std::optional<SpatialHit> DynamicBVH::Nearest(const glm::vec3& point, float maxDistance) const
+{
+	if (m_Root == NULL_NODE)
+	{
+		return std::nullopt;
+	}
+
+	std::optional<SpatialHit> nearest;
+	float best = maxDistance * maxDistance;
+	s_Stack.clear();
+	s_Stack.push_back(m_Root);
+	while (!s_Stack.empty())
+	{
+		uint32_t index = s_Stack.back();
+		const Node& node = m_Nodes[index];
+		s_Stack.pop_back();
+		if (node.Bounds.DistanceSquared(point) > best)
+		{
+			continue;
+		}
+
+		if (node.IsLeaf())
+		{
+			float distance = m_Tight[index].DistanceSquared(point);
+			if (distance <= best)
+			{
+				best = distance;
+				nearest = SpatialHit{ node.Entity, std::sqrt(distance) };
+			}
+
+			continue;
+		}
+
+		// The closer child goes on top, so it's searched first and shrinks the radius for the other one
+		uint32_t first = node.Children[0];
+		uint32_t second = node.Children[1];
+		if (m_Nodes[first].Bounds.DistanceSquared(point) < m_Nodes[second].Bounds.DistanceSquared(point))
+		{
+			std::swap(first, second);
+		}
+
+		s_Stack.push_back(first);
+		s_Stack.push_back(second);
+	}
+
+	return nearest;
+}
+
+uint32_t DynamicBVH::Allocate()
+{
+	if (m_FreeList == NULL_NODE)
+	{
+		m_Nodes.emplace_back();
+		m_Tight.emplace_back();
+		return (uint32_t)m_Nodes.size() - 1;
+	}
+
+	uint32_t node = m_FreeList;
+	m_FreeList = m_Nodes[node].Parent;
+	m_Nodes[node] = Node();
+	return node;
+}
+
+void DynamicBVH::Release(uint32_t node)
+{
+	m_Nodes[node].Parent = m_FreeList;
+	m_Nodes[node].Height = NULL_NODE;
+	m_FreeList = node;
+}
+
+void DynamicBVH::InsertLeaf(uint32_t leaf)
+{
+	if (m_Root == NULL_NODE)
+	{
+		m_Root = leaf;
+		m_Nodes[leaf].Parent = NULL_NODE;
+		return;
+	}
+
+	// Walks down while pushing the leaf further costs less than pairing it with the current node, every node passed on the way grows
+	const AABB& box = m_Nodes[leaf].Bounds;
+	uint32_t sibling = m_Root;
+	while (!m_Nodes[sibling].IsLeaf())
+	{
+		const Node& node = m_Nodes[sibling];
+		float combinedArea = AABB::Union(node.Bounds, box).SurfaceArea();
+		float pairCost = 2.0f * combinedArea;
+		float inheritedCost = 2.0f * (combinedArea - node.Bounds.SurfaceArea());
+
+		float childCosts[2];
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			const Node& child = m_Nodes[node.Children[i]];
+			float grownArea = AABB::Union(child.Bounds, box).SurfaceArea();
+			childCosts[i] = (child.IsLeaf() ? grownArea : grownArea - child.Bounds.SurfaceArea()) + inheritedCost;
+		}
+
+		if (pairCost < childCosts[0] && pairCost < childCosts[1])
+		{
+			break;
+		}
+
+		sibling = node.Children[childCosts[0] < childCosts[1] ? 0 : 1];
+	}
+
+	uint32_t oldParent = m_Nodes[sibling].Parent;
+	uint32_t parent = Allocate();
+	Node& node = m_Nodes[parent];
+	node.Parent = oldParent;
+	node.Bounds = AABB::Union(m_Nodes[sibling].Bounds, m_Nodes[leaf].Bounds);
+	node.Height = m_Nodes[sibling].Height + 1;
+	node.Children[0] = sibling;
+	node.Children[1] = leaf;
+
+	if (oldParent == NULL_NODE)
+	{
+		m_Root = parent;
+	}
+	else
+	{
+		Node& old = m_Nodes[oldParent];
+		old.Children[old.Children[0] == sibling ? 0 : 1] = parent;
+	}
+
+	m_Nodes[sibling].Parent = parent;
+	m_Nodes[leaf].Parent = parent;
+	Refit(oldParent);
+}
+
+void DynamicBVH::RemoveLeaf(uint32_t leaf)
+{
+	if (leaf == m_Root)
+	{
+		m_Root = NULL_NODE;
+		return;
+	}
+
+	uint32_t parent = m_Nodes[leaf].Parent;
+	uint32_t grandparent = m_Nodes[parent].Parent;
+	uint32_t sibling = m_Nodes[parent].Children[m_Nodes[parent].Children[0] == leaf ? 1 : 0];
+	Release(parent);
+
+	m_Nodes[sibling].Parent = grandparent;
+	if (grandparent == NULL_NODE)
+	{
+		m_Root = sibling;
+		return;
+	}
+
+	Node& node = m_Nodes[grandparent];
+	node.Children[node.Children[0] == parent ? 0 : 1] = sibling;
+	Refit(grandparent);
+}
+
+void DynamicBVH::Refit(uint32_t node)
+{
+	for (; node != NULL_NODE; node = m_Nodes[node].Parent)
+	{
+		Node& current = m_Nodes[node];
+		const Node& first = m_Nodes[current.Children[0]];
+		const Node& second = m_Nodes[current.Children[1]];
+		current.Bounds = AABB::Union(first.Bounds, second.Bounds);
+		current.Height = 1 + std::max(first.Height, second.Height);
+
+		Rotate(node);
+	}
+}
+
+void DynamicBVH::Rotate(uint32_t node)
+{
+	// A child can trade places with a grandchild under the other child, which keeps the node's bounds but changes the other child's.
+	// The trade shrinking that child the most is made, if any does
+	float bestGain = 0.0f;
+	uint32_t bestChild = 0;
+	uint32_t bestGrandchild = 0;
+	for (uint32_t child = 0; child < 2; child++)
+	{
+		const Node& other = m_Nodes[m_Nodes[node].Children[1 - child]];
+		if (other.IsLeaf())
+		{
+			continue;
+		}
+
+		const AABB& moved = m_Nodes[m_Nodes[node].Children[child]].Bounds;
+		for (uint32_t grandchild = 0; grandchild < 2; grandchild++)
+		{
+			const AABB& kept = m_Nodes[other.Children[1 - grandchild]].Bounds;
+			float gain = other.Bounds.SurfaceArea() - AABB::Union(moved, kept).SurfaceArea();
+			if (gain > bestGain)
+			{
+				bestGain = gain;
+				bestChild = child;
+				bestGrandchild = grandchild;
+			}
+		}
+	}
+
+	if (bestGain <= 0.0f)
+	{
+		return;
+	}
+
+	Node& current = m_Nodes[node];
+	uint32_t child = current.Children[bestChild];
+	uint32_t other = current.Children[1 - bestChild];
+	uint32_t grandchild = m_Nodes[other].Children[bestGrandchild];
+
+	current.Children[bestChild] = grandchild;
+	m_Nodes[grandchild].Parent = node;
+	m_Nodes[other].Children[bestGrandchild] = child;
+	m_Nodes[child].Parent = other;
+
+	Node& refit = m_Nodes[other];
+	refit.Bounds = AABB::Union(m_Nodes[refit.Children[0]].Bounds, m_Nodes[refit.Children[1]].Bounds);
+	refit.Height = 1 + std::max(m_Nodes[refit.Children[0]].Height, m_Nodes[refit.Children[1]].Height);
+	current.Height = 1 + std::max(m_Nodes[grandchild].Height, refit.Height);
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <entt/entt.hpp>
+#include <optional>
+#include <vector>
+
+struct AABB
+{
+	glm::vec3 Min = glm::vec3(0.0f);
+	glm::vec3 Max = glm::vec3(0.0f);
+
+	inline glm::vec3 Center() const	 { return (Min + Max) * 0.5f; }
+	inline glm::vec3 Extents() const { return (Max - Min) * 0.5f; }
+
+	float SurfaceArea() const;
+	bool Contains(const AABB& other) const;
+	bool Overlaps(const AABB& other) const;
+	// Zero when the point is inside
+	float DistanceSquared(const glm::vec3& point) const;
+
+	// Box around this one after the transform
+	AABB Transform(const glm::mat4& matrix) const;
+
+	static AABB Union(const AABB& a, const AABB& b);
+};
+
+// Planes point inwards, taken from a projection * view matrix with OpenGL's clip space
+struct Frustum
+{
+	glm::vec4 Planes[6];
+
+	static Frustum FromMatrix(const glm::mat4& projView);
+	bool Overlaps(const AABB& box) const;
+};
+
+struct SpatialHit
+{
+	entt::entity Entity = entt::null;
+	float Distance = 0.0f;
+};
+
+// Bounding volume hierarchy that stays valid while boxes are added, moved and removed. Leaves are kept enlarged by MARGIN, so boxes moving
+// within it cost nothing, the rest are taken out and inserted where they grow the tree's surface area the least. Ancestors are refit on the way
+// back up and rotated when swapping a child with a grandchild shrinks them.
+// Queries test the exact boxes and append to the results, nothing is cleared
+class DynamicBVH
+{
+public:
+	static constexpr uint32_t NULL_NODE = UINT32_MAX;
+	static constexpr float MARGIN = 0.1f;
+
+	// Returned proxies stay the same until they're removed
+	uint32_t Insert(const AABB& bounds, entt::entity entity);
+	void Remove(uint32_t proxy);
+	// True when the box left its enlarged bounds and the leaf was reinserted
+	bool Move(uint32_t proxy, const AABB& bounds);
+	void Clear();
+
+	inline const AABB& Bounds(uint32_t proxy) const { return m_Tight[proxy]; }
+	inline entt::entity Entity(uint32_t proxy) const { return m_Nodes[proxy].Entity; }
+	inline uint32_t LeafCount() const { return m_LeafCount; }
+	inline uint32_t Height() const { return m_Root == NULL_NODE ? 0 : m_Nodes[m_Root].Height; }
+	// Summed surface area of the internal nodes over the root's, what SAH minimizes. Lower is better
+	float AreaRatio() const;
+	// Every link, bound and height is consistent
+	bool Validate() const;
+
+	void Query(const AABB& box, std::vector<entt::entity>& results) const;
+	void QuerySphere(const glm::vec3& center, float radius, std::vector<entt::entity>& results) const;
+	void QueryFrustum(const Frustum& frustum, std::vector<entt::entity>& results) const;
+	// Closest box along the ray, the direction is expected to be normalized
+	std::optional<SpatialHit> Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+	std::optional<SpatialHit> Nearest(const glm::vec3& point, float maxDistance) const;
+
+private:
+	struct Node
+	{
+		AABB Bounds;
+		uint32_t Parent = NULL_NODE; // Next free node once released
+		uint32_t Children[2] = { NULL_NODE, NULL_NODE };
+		uint32_t Height = 0;
+		entt::entity Entity = entt::null;
+
+		inline bool IsLeaf() const { return Children[0] == NULL_NODE; }
+	};
+
+	uint32_t Allocate();
+	void Release(uint32_t node);
+	void InsertLeaf(uint32_t leaf);
+	void RemoveLeaf(uint32_t leaf);
+	void Refit(uint32_t node);
+	void Rotate(uint32_t node);
+
+	template<typename Test>
+	void Collect(const Test& test, std::vector<entt::entity>& results) const;
+
+	std::vector<Node> m_Nodes;
+	// Exact leaf boxes by node, kept apart so walking the tree doesn't pull them into the cache
+	std::vector<AABB> m_Tight;
+	uint32_t m_Root = NULL_NODE;
+	uint32_t m_FreeList = NULL_NODE;
+	uint32_t m_LeafCount = 0;
+};
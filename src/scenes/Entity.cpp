@@ -24,6 +24,7 @@ Entity Entity::Clone()
 
 	Entity newEntity = m_Scene->SpawnEntity(GetComponent<TagComponent>().Tag);
 	newEntity.GetComponent<TransformComponent>() = GetComponent<TransformComponent>();
+	m_Scene->SetParent(newEntity, Entity(GetComponent<RelationshipComponent>().Parent, m_Scene));
 
 	if (HasComponent<MaterialComponent>())
 	{
@@ -55,6 +55,14 @@ public:
 		return m_Scene->m_Registry.get<T>(m_Handle);
 	}
 
+	// Runs the functions on the component and notifies its update listeners, writes through GetComponent go unnoticed
+	template<typename T, typename... Func>
+	T& PatchComponent(Func&&... func)
+	{
+		assert(HasComponent<T>() && "Entity doesn't have the component");
+		return m_Scene->m_Registry.patch<T>(m_Handle, std::forward<Func>(func)...);
+	}
+
 	template<typename T>
 	bool HasComponent()
 	{
@@ -80,6 +88,18 @@ public:
 		assert(false && "Can't remove the tag component");
 	}
 
+	template<>
+	void RemoveComponent<WorldTransformComponent>()
+	{
+		assert(false && "Can't remove the world transform component");
+	}
+
+	template<>
+	void RemoveComponent<RelationshipComponent>()
+	{
+		assert(false && "Can't remove the relationship component");
+	}
+
 private:
 	entt::entity m_Handle = entt::null;
 	Scene* m_Scene = nullptr;
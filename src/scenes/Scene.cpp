@@ -2,165 +2,419 @@
 #include "Entity.hpp"
 #include "Components.hpp"
 #include "../Logger.hpp"
+#include "../JobSystem.hpp"
+#include "../RandomUtils.hpp"
+
+// Enough entities per chunk that a bucket outweighs handing it to a thread
+static constexpr uint32_t RECORDING_GRAIN = 4096;
+// The compose kernel is a lot cheaper per entity, so its chunks are larger
+static constexpr uint32_t COMPOSE_GRAIN = 8192;
+
+// Every primitive fits the unit cube around the origin, so for now that's the local bounds of all entities
+static const AABB UNIT_BOUNDS = { glm::vec3(-0.5f), glm::vec3(0.5f) };
+
+uint32_t Scene::s_RecordingWorkers = 0;
+
+static void MarkTransformDirty(entt::registry& registry, entt::entity entity)
+{
+	registry.emplace_or_replace<TransformDirtyComponent>(entity);
+}
+
+// Lights take their direction from the rotation, so parented ones have theirs decomposed from the world matrix
+static TransformComponent LightTransform(entt::registry& registry, entt::entity entity)
+{
+	if (registry.get<RelationshipComponent>(entity).Parent == entt::null)
+	{
+		return registry.get<TransformComponent>(entity);
+	}
+
+	TransformComponent world{};
+	TransformDecompose(registry.get<WorldTransformComponent>(entity).Matrix, world.Position, world.Rotation, world.Scale);
+	return world;
+}
 
 Entity Scene::SpawnEntity(const std::string& name)
 {
 	Entity ent(m_Registry.create((entt::entity)(m_Entities.size() + 1)), this);
 	ent.AddComponent<TagComponent>().Tag = name.empty() ? "Entity" : name;
 	ent.AddComponent<TransformComponent>();
+	ent.AddComponent<WorldTransformComponent>();
+	ent.AddComponent<RelationshipComponent>();
 	m_Entities.push_back(ent);
+	m_HierarchyChanged = true;
 	return ent;
 }
 
 void Scene::DestroyEntity(Entity entity)
 {
+	// Destroying a child moves components around, so the parent's are looked up again every time
+	entt::entity child = entt::null;
+	while ((child = m_Registry.get<RelationshipComponent>(entity.Handle()).FirstChild) != entt::null)
+	{
+		DestroyEntity(Entity(child, this));
+	}
+
+	Detach(entity.Handle());
+	RemoveFromSpatialIndex(entity.Handle());
 	m_Entities.erase(std::find_if(m_Entities.begin(), m_Entities.end(), [&](const Entity& other) { return entity.Handle() == other.Handle(); }));
 	m_Registry.destroy(entity.Handle());
+	m_HierarchyChanged = true;
 }
 
-void Scene::RenderShadowMaps()
+void Scene::SetParent(Entity child, Entity parent)
 {
-	Renderer::BeginShadowMapPass();
-
-	// Add directional lights
+	entt::entity handle = child.Handle();
+	for (entt::entity ancestor = parent.Handle(); ancestor != entt::null; ancestor = m_Registry.get<RelationshipComponent>(ancestor).Parent)
 	{
-		auto view = m_Registry.view<TransformComponent, DirectionalLightComponent>();
-		for (entt::entity entity : view)
+		if (ancestor == handle)
 		{
-			auto [transform, light] = view.get<TransformComponent, DirectionalLightComponent>(entity);
-			Renderer::AddDirectionalLight(transform, light);
+			LOG_WARN("Can't parent an entity to itself or one of its children.");
+			return;
 		}
 	}
 
-	// Add point lights
+	Detach(handle);
+	if (parent.Handle() != entt::null)
 	{
-		auto view = m_Registry.view<TransformComponent, PointLightComponent>();
-		for (entt::entity entity : view)
+		RelationshipComponent& relationship = m_Registry.get<RelationshipComponent>(handle);
+		RelationshipComponent& parentRelationship = m_Registry.get<RelationshipComponent>(parent.Handle());
+		if (parentRelationship.FirstChild != entt::null)
 		{
-			auto [transform, light] = view.get<TransformComponent, PointLightComponent>(entity);
-			Renderer::AddPointLight(transform.Position, light);
+			m_Registry.get<RelationshipComponent>(parentRelationship.FirstChild).PrevSibling = handle;
 		}
+
+		relationship.Parent = parent.Handle();
+		relationship.NextSibling = parentRelationship.FirstChild;
+		parentRelationship.FirstChild = handle;
 	}
 
-	// Add spotlights
+	UpdateDepths(handle);
+	MarkTransformDirty(m_Registry, handle);
+	m_HierarchyChanged = true;
+}
+
+glm::mat4 Scene::ParentTransform(Entity entity)
+{
+	entt::entity parent = m_Registry.get<RelationshipComponent>(entity.Handle()).Parent;
+	return parent == entt::null ? glm::mat4(1.0f) : m_Registry.get<WorldTransformComponent>(parent).Matrix;
+}
+
+void Scene::Detach(entt::entity entity)
+{
+	RelationshipComponent& relationship = m_Registry.get<RelationshipComponent>(entity);
+	if (relationship.Parent == entt::null)
 	{
-		auto view = m_Registry.view<TransformComponent, SpotLightComponent>();
-		for (entt::entity entity : view)
-		{
-			auto [transform, light] = view.get<TransformComponent, SpotLightComponent>(entity);
-			Renderer::AddSpotLight(transform, light);
-		}
+		return;
 	}
 
-	// Render meshes
+	if (relationship.PrevSibling != entt::null)
 	{
-		auto view = m_Registry.view<TransformComponent, MeshComponent, MaterialComponent>(entt::exclude<DirectionalLightComponent, PointLightComponent, SpotLightComponent>);
-		for (entt::entity entity : view)
-		{
-			auto [transform, mesh, material] = view.get<TransformComponent, MeshComponent, MaterialComponent>(entity);
-			Renderer::SubmitMesh(
-				transform.ToMat4(),
-				mesh,
-				AssetManager::GetMaterial(material.MaterialID),
-				(int32_t)entity
-			);
-		}
+		m_Registry.get<RelationshipComponent>(relationship.PrevSibling).NextSibling = relationship.NextSibling;
+	}
+	else
+	{
+		m_Registry.get<RelationshipComponent>(relationship.Parent).FirstChild = relationship.NextSibling;
 	}
 
-	Renderer::EndShadowMapPass();
+	if (relationship.NextSibling != entt::null)
+	{
+		m_Registry.get<RelationshipComponent>(relationship.NextSibling).PrevSibling = relationship.PrevSibling;
+	}
+
+	relationship.Parent = entt::null;
+	relationship.PrevSibling = entt::null;
+	relationship.NextSibling = entt::null;
 }
 
-void Scene::Render(Camera& editorCamera, RenderMode mode)
+void Scene::RemoveFromSpatialIndex(entt::entity entity)
 {
-	Renderer::SceneBegin(editorCamera);
+	// Entities get their leaf on the first propagation after they're spawned
+	uint32_t id = entt::to_entity(entity);
+	if (id < m_SpatialProxies.size() && m_SpatialProxies[id] != DynamicBVH::NULL_NODE)
+	{
+		m_SpatialIndex.Remove(m_SpatialProxies[id]);
+		m_SpatialProxies[id] = DynamicBVH::NULL_NODE;
+	}
+}
 
-	// Add directional lights
+void Scene::UpdateDepths(entt::entity entity)
+{
+	RelationshipComponent& relationship = m_Registry.get<RelationshipComponent>(entity);
+	relationship.Depth = relationship.Parent == entt::null ? 0 : m_Registry.get<RelationshipComponent>(relationship.Parent).Depth + 1;
+	for (entt::entity child = relationship.FirstChild; child != entt::null; child = m_Registry.get<RelationshipComponent>(child).NextSibling)
 	{
-		auto view = m_Registry.view<TransformComponent, DirectionalLightComponent>();
-		for (entt::entity entity : view)
+		UpdateDepths(child);
+	}
+}
+
+void Scene::PropagateTransforms(entt::registry& registry)
+{
+	// Parents are sorted before their children and siblings kept together, so walks mostly move forward in memory
+	if (m_HierarchyChanged)
+	{
+		registry.sort<RelationshipComponent>([](const RelationshipComponent& a, const RelationshipComponent& b)
+			{
+				return a.Depth != b.Depth ? a.Depth < b.Depth : a.Parent < b.Parent;
+			});
+		registry.sort<WorldTransformComponent, RelationshipComponent>();
+		m_HierarchyChanged = false;
+	}
+
+	auto& dirty = registry.storage<TransformDirtyComponent>();
+	if (dirty.empty())
+	{
+		return;
+	}
+
+	// Walks start at the topmost changed entities, the ones below them are reached through the walk
+	m_PropagationQueue.clear();
+	for (entt::entity entity : dirty)
+	{
+		bool covered = false;
+		for (entt::entity parent = registry.get<RelationshipComponent>(entity).Parent; parent != entt::null && !covered; parent = registry.get<RelationshipComponent>(parent).Parent)
 		{
-			auto [transform, light] = view.get<TransformComponent, DirectionalLightComponent>(entity);
-			Renderer::AddDirectionalLight(transform, light);
+			covered = dirty.contains(parent);
+		}
+
+		if (!covered)
+		{
+			m_PropagationQueue.push_back(entity);
 		}
 	}
 
-	// Add point lights
+	// Breadth first, so a parent comes before its children
+	for (size_t i = 0; i < m_PropagationQueue.size(); i++)
 	{
-		auto view = m_Registry.view<TransformComponent, PointLightComponent>();
-		for (entt::entity entity : view)
+		for (entt::entity child = registry.get<RelationshipComponent>(m_PropagationQueue[i]).FirstChild; child != entt::null; child = registry.get<RelationshipComponent>(child).NextSibling)
 		{
-			auto [transform, light] = view.get<TransformComponent, PointLightComponent>(entity);
-			Renderer::AddPointLight(transform.Position, light);
+			m_PropagationQueue.push_back(child);
 		}
 	}
 
-	// Add spotlights
+	// Local matrices don't depend on each other, they're built in batches before the parents are applied in walk order
+	uint32_t count = (uint32_t)m_PropagationQueue.size();
+	m_LocalTransforms.Clear();
+	for (entt::entity entity : m_PropagationQueue)
 	{
-		auto view = m_Registry.view<TransformComponent, SpotLightComponent>();
-		for (entt::entity entity : view)
+		m_LocalTransforms.Add(registry.get<TransformComponent>(entity));
+	}
+
+	m_LocalMatrices.resize(count);
+	JobSystem::ParallelFor(count, [&](uint32_t begin, uint32_t end) { ComposeMatrices(m_LocalTransforms, begin, end, m_LocalMatrices.data()); }, COMPOSE_GRAIN);
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		entt::entity entity = m_PropagationQueue[i];
+		entt::entity parent = registry.get<RelationshipComponent>(entity).Parent;
+		glm::mat4& world = registry.get<WorldTransformComponent>(entity).Matrix;
+		world = parent == entt::null ? m_LocalMatrices[i] : registry.get<WorldTransformComponent>(parent).Matrix * m_LocalMatrices[i];
+
+		uint32_t id = entt::to_entity(entity);
+		if (id >= m_SpatialProxies.size())
 		{
-			auto [transform, light] = view.get<TransformComponent, SpotLightComponent>(entity);
-			Renderer::AddSpotLight(transform, light);
+			m_SpatialProxies.resize(id + 1, DynamicBVH::NULL_NODE);
+		}
+
+		if (m_SpatialProxies[id] == DynamicBVH::NULL_NODE)
+		{
+			m_SpatialProxies[id] = m_SpatialIndex.Insert(UNIT_BOUNDS.Transform(world), entity);
+		}
+		else
+		{
+			m_SpatialIndex.Move(m_SpatialProxies[id], UNIT_BOUNDS.Transform(world));
 		}
 	}
 
-	// Render meshes without point light component (shading)
-	Renderer::SetRenderMode(mode);
+	dirty.clear();
+}
+
+void SceneSnapshot::Clear()
+{
+	DirLights.clear();
+	PointLights.clear();
+	SpotLights.clear();
+	for (std::vector<MeshCommand>& bucket : MeshBuckets)
 	{
-		auto view = m_Registry.view<TransformComponent, MeshComponent, MaterialComponent>(entt::exclude<DirectionalLightComponent, PointLightComponent, SpotLightComponent>);
-		for (entt::entity entity : view)
+		bucket.clear();
+	}
+
+	LightMeshes.clear();
+}
+
+Scene::Scene()
+{
+	m_Registry.on_construct<TransformComponent>().connect<&MarkTransformDirty>();
+	m_Registry.on_update<TransformComponent>().connect<&MarkTransformDirty>();
+
+	m_ExtractSystems.Add("Transforms", [this](entt::registry& registry) { PropagateTransforms(registry); })
+		.Read<TransformComponent>().Write<WorldTransformComponent, RelationshipComponent, TransformDirtyComponent>();
+
+	// The rest only reads the registry and every system fills its own part of the snapshot, so they all run at once
+	m_ExtractSystems.Add("Directional lights", [this](entt::registry& registry)
 		{
-			auto[transform, mesh, material] = view.get<TransformComponent, MeshComponent, MaterialComponent>(entity);
-			Renderer::SubmitMesh(
-				transform.ToMat4(),
-				mesh,
-				AssetManager::GetMaterial(material.MaterialID),
-				(int32_t)entity
-			);
-		}
+			auto view = registry.view<TransformComponent, DirectionalLightComponent>();
+			for (entt::entity entity : view)
+			{
+				m_Extracting->DirLights.emplace_back(LightTransform(registry, entity), view.get<DirectionalLightComponent>(entity));
+			}
+		}).Read<TransformComponent, WorldTransformComponent, RelationshipComponent, DirectionalLightComponent>();
+
+	m_ExtractSystems.Add("Point lights", [this](entt::registry& registry)
+		{
+			auto view = registry.view<WorldTransformComponent, PointLightComponent>();
+			for (entt::entity entity : view)
+			{
+				auto [world, light] = view.get<WorldTransformComponent, PointLightComponent>(entity);
+				m_Extracting->PointLights.emplace_back(glm::vec3(world.Matrix[3]), light);
+			}
+		}).Read<WorldTransformComponent, PointLightComponent>();
+
+	m_ExtractSystems.Add("Spotlights", [this](entt::registry& registry)
+		{
+			auto view = registry.view<TransformComponent, SpotLightComponent>();
+			for (entt::entity entity : view)
+			{
+				m_Extracting->SpotLights.emplace_back(LightTransform(registry, entity), view.get<SpotLightComponent>(entity));
+			}
+		}).Read<TransformComponent, WorldTransformComponent, RelationshipComponent, SpotLightComponent>();
+
+	m_ExtractSystems.Add("Meshes", [this](entt::registry& registry) { ExtractMeshes(registry); })
+		.Read<WorldTransformComponent, MeshComponent, MaterialComponent, DirectionalLightComponent, PointLightComponent, SpotLightComponent>();
+
+	m_ExtractSystems.Add("Light meshes", [this](entt::registry& registry) { ExtractLightMeshes(registry); })
+		.Read<WorldTransformComponent, MeshComponent, MaterialComponent, DirectionalLightComponent, PointLightComponent, SpotLightComponent>();
+}
+
+void Scene::Update()
+{
+	m_Systems.Run(m_Registry);
+}
+
+void Scene::Extract(SceneSnapshot& snapshot)
+{
+	snapshot.Clear();
+
+	m_Extracting = &snapshot;
+	m_ExtractSystems.Run(m_Registry);
+	m_Extracting = nullptr;
+
+	// Assigning into the existing entries reuses their names' storage
+	for (const auto& [id, material] : AssetManager::AllMaterials())
+	{
+		snapshot.Materials[id] = material;
 	}
+}
 
-	Renderer::SceneEnd();
-	Renderer::SceneBegin(editorCamera);
+void Scene::ExtractMeshes(entt::registry& registry)
+{
+	SceneSnapshot& snapshot = *m_Extracting;
+	auto view = registry.view<WorldTransformComponent, MeshComponent, MaterialComponent>(entt::exclude<DirectionalLightComponent, PointLightComponent, SpotLightComponent>);
 
-	// Render meshes with light component (no shading)
-	Renderer::SetRenderMode(RenderMode::FLAT_SHADING);
+	// Chunks of the smallest storage are recorded in parallel, each into its own bucket
+	const entt::entity* entities = view.handle()->data();
+	uint32_t count = (uint32_t)view.handle()->size();
+	uint32_t chunks = (count + RECORDING_GRAIN - 1) / RECORDING_GRAIN;
+	if (snapshot.MeshBuckets.size() < chunks)
 	{
-		auto view = m_Registry.view<TransformComponent, DirectionalLightComponent, MeshComponent, MaterialComponent>();
+		snapshot.MeshBuckets.resize(chunks);
+	}
+
+	JobSystem::ParallelFor(count, [&](uint32_t begin, uint32_t end)
+		{
+			std::vector<MeshCommand>& bucket = snapshot.MeshBuckets[begin / RECORDING_GRAIN];
+			for (uint32_t i = begin; i < end; i++)
+			{
+				entt::entity entity = entities[i];
+				if (!view.contains(entity))
+				{
+					continue;
+				}
+
+				auto [world, mesh, material] = view.get<WorldTransformComponent, MeshComponent, MaterialComponent>(entity);
+				bucket.push_back({ world.Matrix, mesh.MeshID, material.MaterialID, (int32_t)entity });
+			}
+		}, RECORDING_GRAIN, s_RecordingWorkers);
+}
+
+void Scene::ExtractLightMeshes(entt::registry& registry)
+{
+	SceneSnapshot& snapshot = *m_Extracting;
+	{
+		auto view = registry.view<WorldTransformComponent, DirectionalLightComponent, MeshComponent, MaterialComponent>();
 		for (entt::entity entity : view)
 		{
-			auto [transform, mesh, material, light] = view.get<TransformComponent, MeshComponent, MaterialComponent, DirectionalLightComponent>(entity);
-			Material& mat = AssetManager::GetMaterial(material.MaterialID);
-			Material intensified = mat;
-			
-			intensified.Color = glm::vec4(glm::vec3(mat.Color * light.Intensity), 1.0f);
-			Renderer::SubmitMesh(transform.ToMat4(), mesh, intensified, (int32_t)entity);
+			auto [world, mesh, material, light] = view.get<WorldTransformComponent, MeshComponent, MaterialComponent, DirectionalLightComponent>(entity);
+			snapshot.LightMeshes.push_back({ world.Matrix, mesh, material.MaterialID, (int32_t)entity, light.Intensity });
 		}
 	}
 	{
-		auto view = m_Registry.view<TransformComponent, PointLightComponent, MeshComponent, MaterialComponent>();
+		auto view = registry.view<WorldTransformComponent, PointLightComponent, MeshComponent, MaterialComponent>();
 		for (entt::entity entity : view)
 		{
-			auto [transform, mesh, material, light] = view.get<TransformComponent, MeshComponent, MaterialComponent, PointLightComponent>(entity);
-			Material& mat = AssetManager::GetMaterial(material.MaterialID);
-			Material intensified = mat;
-
-			intensified.Color = glm::vec4(glm::vec3(mat.Color * light.Intensity), 1.0f);
-			Renderer::SubmitMesh(transform.ToMat4(), mesh, intensified, (int32_t)entity);
+			auto [world, mesh, material, light] = view.get<WorldTransformComponent, MeshComponent, MaterialComponent, PointLightComponent>(entity);
+			snapshot.LightMeshes.push_back({ world.Matrix, mesh, material.MaterialID, (int32_t)entity, light.Intensity });
 		}
 	}
 	{
-		auto view = m_Registry.view<TransformComponent, SpotLightComponent, MeshComponent, MaterialComponent>();
+		auto view = registry.view<WorldTransformComponent, SpotLightComponent, MeshComponent, MaterialComponent>();
 		for (entt::entity entity : view)
 		{
-			auto [transform, mesh, material, light] = view.get<TransformComponent, MeshComponent, MaterialComponent, SpotLightComponent>(entity);
-			Material& mat = AssetManager::GetMaterial(material.MaterialID);
-			Material intensified = mat;
-
-			intensified.Color = glm::vec4(glm::vec3(mat.Color * light.Intensity), 1.0f);
-			Renderer::SubmitMesh(transform.ToMat4(), mesh, intensified, (int32_t)entity);
+			auto [world, mesh, material, light] = view.get<WorldTransformComponent, MeshComponent, MaterialComponent, SpotLightComponent>(entity);
+			snapshot.LightMeshes.push_back({ world.Matrix, mesh, material.MaterialID, (int32_t)entity, light.Intensity });
 		}
 	}
+}
+
+static void AddLights(const SceneSnapshot& snapshot)
+{
+	for (const auto& [transform, light] : snapshot.DirLights)
+	{
+		Renderer::AddDirectionalLight(transform, light);
+	}
+
+	for (const auto& [position, light] : snapshot.PointLights)
+	{
+		Renderer::AddPointLight(position, light);
+	}
+
+	for (const auto& [transform, light] : snapshot.SpotLights)
+	{
+		Renderer::AddSpotLight(transform, light);
+	}
+}
+
+void Scene::RenderShadowMaps(const SceneSnapshot& snapshot)
+{
+	Renderer::BeginShadowMapPass();
+	AddLights(snapshot);
+
+	Renderer::SubmitMeshes(snapshot.MeshBuckets, snapshot.Materials);
+
+	Renderer::EndShadowMapPass();
+}
+
+void Scene::Render(const SceneSnapshot& snapshot, Camera& camera, RenderMode mode)
+{
+	Renderer::SceneBegin(camera);
+	AddLights(snapshot);
+
+	// Render meshes without light component (shading)
+	Renderer::SetRenderMode(mode);
+	Renderer::SubmitMeshes(snapshot.MeshBuckets, snapshot.Materials);
+
+	Renderer::SceneEnd();
+	Renderer::SceneBegin(camera);
+
+	// Render meshes with light component (no shading)
+	Renderer::SetRenderMode(RenderMode::FLAT_SHADING);
+	for (const SceneSnapshot::MeshEntry& entry : snapshot.LightMeshes)
+	{
+		const Material& mat = snapshot.Materials.at(entry.MaterialID);
+		Material intensified = mat;
+
+		intensified.Color = glm::vec4(glm::vec3(mat.Color * entry.Intensity), 1.0f);
+		Renderer::SubmitMesh(entry.Transform, entry.Mesh, intensified, entry.EntityID);
+	}
 
 	Renderer::SceneEnd();
 	Renderer::SetRenderMode(RenderMode::FORWARD);
@@ -2,24 +2,97 @@
 
 #include <entt/entt.hpp>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
+#include "SystemScheduler.hpp"
+#include "DynamicBVH.hpp"
+#include "TransformBatch.hpp"
 #include "../renderer/Camera.hpp"
 #include "../renderer/Renderer.hpp"
 
 class Entity;
 
+// Copy of what a scene draws, so it can be rendered while the registry keeps changing
+struct SceneSnapshot
+{
+	struct MeshEntry
+	{
+		glm::mat4 Transform;
+		MeshComponent Mesh;
+		int32_t MaterialID;
+		int32_t EntityID;
+		float Intensity = 1.0f; // Light meshes are drawn without shading at the light's intensity
+	};
+
+	std::vector<std::pair<TransformComponent, DirectionalLightComponent>> DirLights;
+	std::vector<std::pair<glm::vec3, PointLightComponent>> PointLights;
+	std::vector<std::pair<TransformComponent, SpotLightComponent>> SpotLights;
+	// One bucket per chunk of recorded entities, merged when submitted
+	std::vector<std::vector<MeshCommand>> MeshBuckets;
+	std::vector<MeshEntry> LightMeshes;
+	std::unordered_map<int32_t, Material> Materials;
+
+	void Clear();
+};
+
 struct Scene
 {
+	Scene();
+	Scene(const Scene& other) = delete;
+	Scene& operator= (const Scene& other) = delete;
+
 	Entity SpawnEntity(const std::string& name);
+	// Children are destroyed along with their parent
 	void DestroyEntity(Entity entity);
 
-	void RenderShadowMaps();
-	void Render(Camera& editorCamera, RenderMode mode);
+	// The child keeps its local transform and moves along with the new parent, a null parent makes it a root
+	void SetParent(Entity child, Entity parent);
+	// Identity for roots
+	glm::mat4 ParentTransform(Entity entity);
+
+	inline const std::vector<Entity>& Entities() const { return m_Entities; }
+	// World bounds of every entity as of the last Extract, which is when world transforms are propagated
+	inline const DynamicBVH& SpatialIndex() const { return m_SpatialIndex; }
+
+	// Game logic, run once a frame by Update
+	inline SystemScheduler& Systems() { return m_Systems; }
+	void Update();
+
+	void Extract(SceneSnapshot& snapshot);
+
+	// Caps the threads recording meshes in Extract, 0 uses every core
+	static void SetRecordingWorkers(uint32_t workers) { s_RecordingWorkers = workers; }
+	static uint32_t RecordingWorkers() { return s_RecordingWorkers; }
+
+	static void RenderShadowMaps(const SceneSnapshot& snapshot);
+	static void Render(const SceneSnapshot& snapshot, Camera& camera, RenderMode mode);
 
 private:
+	void Detach(entt::entity entity);
+	void UpdateDepths(entt::entity entity);
+	void RemoveFromSpatialIndex(entt::entity entity);
+	void PropagateTransforms(entt::registry& registry);
+	void ExtractMeshes(entt::registry& registry);
+	void ExtractLightMeshes(entt::registry& registry);
+
 	entt::registry m_Registry;
 	std::vector<Entity> m_Entities;
 
+	SystemScheduler m_Systems;
+	SystemScheduler m_ExtractSystems;
+	SceneSnapshot* m_Extracting = nullptr;
+
+	std::vector<entt::entity> m_PropagationQueue;
+	TransformBatch m_LocalTransforms;
+	std::vector<glm::mat4> m_LocalMatrices;
+	DynamicBVH m_SpatialIndex;
+	std::vector<uint32_t> m_SpatialProxies; // By entity ID
+	bool m_HierarchyChanged = false;
+
+	static uint32_t s_RecordingWorkers;
+
 	friend class Entity;
 	friend class EditorLayer;
+	friend class SceneSerializer;
 };
\ No newline at end of file
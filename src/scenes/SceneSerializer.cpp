@@ -0,0 +1,478 @@
+#include "SceneSerializer.hpp"
+#include "Scene.hpp"
+#include "Entity.hpp"
+#include "Components.hpp"
+#include "../MappedFile.hpp"
+#include "../Logger.hpp"
+
+#include <fstream>
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+static constexpr uint32_t SCENE_MAGIC = 0x454E4353; // "SCNE"
+static constexpr uint32_t SCENE_VERSION = 1;
+static constexpr uint64_t CHUNK_ALIGNMENT = 8;
+static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+enum class ChunkType : uint32_t
+{
+	Tags,
+	Transforms,
+	Parents,
+	Meshes,
+	Materials,
+	DirectionalLights,
+	PointLights,
+	SpotLights,
+	MaterialTable,
+	MaterialNames,
+	Count
+};
+
+struct FileHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t Entities;
+	uint32_t Chunks;
+};
+
+struct ChunkHeader
+{
+	ChunkType Type;
+	uint32_t Count;
+	uint64_t Size; // Padded to CHUNK_ALIGNMENT, so every chunk starts aligned
+};
+
+struct ChunkPart
+{
+	const void* Data;
+	uint64_t Size;
+};
+
+struct Chunk
+{
+	const uint8_t* Data = nullptr;
+	uint32_t Count = 0;
+	uint64_t Size = 0;
+};
+
+// Material without its name, names are a string column of their own
+struct MaterialRecord
+{
+	int32_t ID;
+	glm::vec4 Color;
+	glm::vec2 TilingFactor;
+	glm::vec2 TextureOffset;
+	float Emission;
+	uint32_t Emissive;
+	int32_t AlbedoTextureID;
+	int32_t NormalTextureID;
+	int32_t HeightTextureID;
+	float HeightFactor;
+	uint32_t IsDepthMap;
+	int32_t RoughnessTextureID;
+	float RoughnessFactor;
+	int32_t MetallicTextureID;
+	float MetallicFactor;
+	int32_t AmbientOccTextureID;
+	float AmbientOccFactor;
+	int32_t VirtualTextureID;
+};
+
+static MaterialRecord ToRecord(int32_t id, const Material& material)
+{
+	return {
+		id, material.Color, material.TilingFactor, material.TextureOffset, material.Emission, material.Emissive,
+		material.AlbedoTextureID, material.NormalTextureID, material.HeightTextureID, material.HeightFactor, material.IsDepthMap,
+		material.RoughnessTextureID, material.RoughnessFactor, material.MetallicTextureID, material.MetallicFactor,
+		material.AmbientOccTextureID, material.AmbientOccFactor, material.VirtualTextureID
+	};
+}
+
+static Material FromRecord(const MaterialRecord& record)
+{
+	Material material;
+	material.Color = record.Color;
+	material.TilingFactor = record.TilingFactor;
+	material.TextureOffset = record.TextureOffset;
+	material.Emission = record.Emission;
+	material.Emissive = record.Emissive != 0;
+	material.AlbedoTextureID = record.AlbedoTextureID;
+	material.NormalTextureID = record.NormalTextureID;
+	material.HeightTextureID = record.HeightTextureID;
+	material.HeightFactor = record.HeightFactor;
+	material.IsDepthMap = record.IsDepthMap != 0;
+	material.RoughnessTextureID = record.RoughnessTextureID;
+	material.RoughnessFactor = record.RoughnessFactor;
+	material.MetallicTextureID = record.MetallicTextureID;
+	material.MetallicFactor = record.MetallicFactor;
+	material.AmbientOccTextureID = record.AmbientOccTextureID;
+	material.AmbientOccFactor = record.AmbientOccFactor;
+	material.VirtualTextureID = record.VirtualTextureID;
+	return material;
+}
+
+static void WriteChunk(std::ofstream& file, ChunkType type, uint32_t count, std::initializer_list<ChunkPart> parts)
+{
+	uint64_t size = 0;
+	for (const ChunkPart& part : parts)
+	{
+		size += part.Size;
+	}
+
+	uint64_t padding = (CHUNK_ALIGNMENT - size % CHUNK_ALIGNMENT) % CHUNK_ALIGNMENT;
+	ChunkHeader header{ type, count, size + padding };
+	file.write((const char*)&header, sizeof(header));
+	for (const ChunkPart& part : parts)
+	{
+		file.write((const char*)part.Data, part.Size);
+	}
+
+	const char zeros[CHUNK_ALIGNMENT]{};
+	file.write(zeros, padding);
+}
+
+// Offset of every string and one past the last, followed by the characters without terminators
+static void WriteStrings(std::ofstream& file, ChunkType type, const std::vector<const std::string*>& strings)
+{
+	std::vector<uint32_t> offsets;
+	offsets.reserve(strings.size() + 1);
+	std::string characters;
+	for (const std::string* string : strings)
+	{
+		offsets.push_back((uint32_t)characters.size());
+		characters += *string;
+	}
+
+	offsets.push_back((uint32_t)characters.size());
+	WriteChunk(file, type, (uint32_t)strings.size(), { { offsets.data(), offsets.size() * sizeof(uint32_t) }, { characters.data(), characters.size() } });
+}
+
+template<typename T>
+static void WriteSparseColumn(std::ofstream& file, ChunkType type, entt::registry& registry, const std::vector<entt::entity>& entities)
+{
+	static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= alignof(uint32_t), "Columns are raw component memory following the entity indices");
+
+	auto& storage = registry.storage<T>();
+	std::vector<uint32_t> owners;
+	std::vector<T> values;
+	owners.reserve(storage.size());
+	values.reserve(storage.size());
+	for (uint32_t i = 0; i < entities.size(); i++)
+	{
+		if (storage.contains(entities[i]))
+		{
+			owners.push_back(i);
+			values.push_back(storage.get(entities[i]));
+		}
+	}
+
+	WriteChunk(file, type, (uint32_t)owners.size(), { { owners.data(), owners.size() * sizeof(uint32_t) }, { values.data(), values.size() * sizeof(T) } });
+}
+
+static bool ValidStrings(const Chunk& chunk, uint32_t count)
+{
+	uint64_t offsetsSize = (count + 1ull) * sizeof(uint32_t);
+	if (chunk.Count != count || chunk.Size < offsetsSize)
+	{
+		return false;
+	}
+
+	const uint32_t* offsets = (const uint32_t*)chunk.Data;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (offsets[i + 1] < offsets[i])
+		{
+			return false;
+		}
+	}
+
+	return offsets[0] == 0 && offsets[count] <= chunk.Size - offsetsSize;
+}
+
+template<typename T>
+static bool ValidSparseColumn(const Chunk& chunk, uint32_t entities)
+{
+	if (chunk.Size < chunk.Count * (sizeof(uint32_t) + sizeof(T)))
+	{
+		return false;
+	}
+
+	// Strictly increasing, so no entity gets the component twice
+	const uint32_t* owners = (const uint32_t*)chunk.Data;
+	for (uint32_t i = 0; i < chunk.Count; i++)
+	{
+		if (owners[i] >= entities || (i > 0 && owners[i] <= owners[i - 1]))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+template<typename T>
+static void InsertSparseColumn(entt::registry& registry, const Chunk& chunk, const std::vector<entt::entity>& entities)
+{
+	const uint32_t* owners = (const uint32_t*)chunk.Data;
+	std::vector<entt::entity> handles(chunk.Count);
+	for (uint32_t i = 0; i < chunk.Count; i++)
+	{
+		handles[i] = entities[owners[i]];
+	}
+
+	registry.insert<T>(handles.begin(), handles.end(), (const T*)(owners + chunk.Count));
+}
+
+static bool Validate(const std::array<Chunk, (size_t)ChunkType::Count>& chunks, uint32_t entities)
+{
+	for (const Chunk& chunk : chunks)
+	{
+		if (!chunk.Data)
+		{
+			return false;
+		}
+	}
+
+	const Chunk& transforms = chunks[(size_t)ChunkType::Transforms];
+	const Chunk& parents = chunks[(size_t)ChunkType::Parents];
+	if (transforms.Count != entities || transforms.Size < entities * sizeof(TransformComponent) || parents.Count != entities || parents.Size < entities * sizeof(uint32_t))
+	{
+		return false;
+	}
+
+	// Parents come before their children, which also rules out cycles
+	const uint32_t* parentIndices = (const uint32_t*)parents.Data;
+	for (uint32_t i = 0; i < entities; i++)
+	{
+		if (parentIndices[i] != NO_PARENT && parentIndices[i] >= i)
+		{
+			return false;
+		}
+	}
+
+	const Chunk& materials = chunks[(size_t)ChunkType::MaterialTable];
+	return ValidStrings(chunks[(size_t)ChunkType::Tags], entities)
+		&& ValidSparseColumn<MeshComponent>(chunks[(size_t)ChunkType::Meshes], entities)
+		&& ValidSparseColumn<MaterialComponent>(chunks[(size_t)ChunkType::Materials], entities)
+		&& ValidSparseColumn<DirectionalLightComponent>(chunks[(size_t)ChunkType::DirectionalLights], entities)
+		&& ValidSparseColumn<PointLightComponent>(chunks[(size_t)ChunkType::PointLights], entities)
+		&& ValidSparseColumn<SpotLightComponent>(chunks[(size_t)ChunkType::SpotLights], entities)
+		&& materials.Size >= materials.Count * sizeof(MaterialRecord)
+		&& ValidStrings(chunks[(size_t)ChunkType::MaterialNames], materials.Count);
+}
+
+bool SceneSerializer::Save(Scene& scene, const std::filesystem::path& path)
+{
+	entt::registry& registry = scene.m_Registry;
+
+	// Parents are written before their children, so loading links the hierarchy in one pass
+	std::vector<entt::entity> entities;
+	entities.reserve(scene.m_Entities.size());
+	for (const Entity& entity : scene.m_Entities)
+	{
+		entities.push_back(entity.Handle());
+	}
+
+	std::stable_sort(entities.begin(), entities.end(), [&](entt::entity a, entt::entity b)
+		{
+			return registry.get<RelationshipComponent>(a).Depth < registry.get<RelationshipComponent>(b).Depth;
+		});
+
+	std::vector<uint32_t> indices;
+	std::vector<const std::string*> tags;
+	std::vector<TransformComponent> transforms;
+	std::vector<uint32_t> parents;
+	tags.reserve(entities.size());
+	transforms.reserve(entities.size());
+	parents.reserve(entities.size());
+	for (uint32_t i = 0; i < entities.size(); i++)
+	{
+		uint32_t id = entt::to_entity(entities[i]);
+		if (id >= indices.size())
+		{
+			indices.resize(id + 1);
+		}
+
+		indices[id] = i;
+		tags.push_back(&registry.get<TagComponent>(entities[i]).Tag);
+		transforms.push_back(registry.get<TransformComponent>(entities[i]));
+
+		entt::entity parent = registry.get<RelationshipComponent>(entities[i]).Parent;
+		parents.push_back(parent == entt::null ? NO_PARENT : indices[entt::to_entity(parent)]);
+	}
+
+	// Sorted by ID, so adding them back leaves AssetManager counting from the highest one
+	std::vector<std::pair<int32_t, const Material*>> materials;
+	for (const auto& [id, material] : AssetManager::AllMaterials())
+	{
+		materials.emplace_back(id, &material);
+	}
+
+	std::sort(materials.begin(), materials.end());
+	std::vector<MaterialRecord> records;
+	std::vector<const std::string*> names;
+	for (const auto& [id, material] : materials)
+	{
+		records.push_back(ToRecord(id, *material));
+		names.push_back(&material->Name);
+	}
+
+	std::error_code ec;
+	std::filesystem::create_directories(path.parent_path(), ec);
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open())
+	{
+		LOG_WARN("Failed to write scene {}", path.string());
+		return false;
+	}
+
+	FileHeader header{ SCENE_MAGIC, SCENE_VERSION, (uint32_t)entities.size(), (uint32_t)ChunkType::Count };
+	file.write((const char*)&header, sizeof(header));
+	WriteStrings(file, ChunkType::Tags, tags);
+	WriteChunk(file, ChunkType::Transforms, (uint32_t)transforms.size(), { { transforms.data(), transforms.size() * sizeof(TransformComponent) } });
+	WriteChunk(file, ChunkType::Parents, (uint32_t)parents.size(), { { parents.data(), parents.size() * sizeof(uint32_t) } });
+	WriteSparseColumn<MeshComponent>(file, ChunkType::Meshes, registry, entities);
+	WriteSparseColumn<MaterialComponent>(file, ChunkType::Materials, registry, entities);
+	WriteSparseColumn<DirectionalLightComponent>(file, ChunkType::DirectionalLights, registry, entities);
+	WriteSparseColumn<PointLightComponent>(file, ChunkType::PointLights, registry, entities);
+	WriteSparseColumn<SpotLightComponent>(file, ChunkType::SpotLights, registry, entities);
+	WriteChunk(file, ChunkType::MaterialTable, (uint32_t)records.size(), { { records.data(), records.size() * sizeof(MaterialRecord) } });
+	WriteStrings(file, ChunkType::MaterialNames, names);
+
+	return (bool)file;
+}
+
+bool SceneSerializer::Load(Scene& scene, const std::filesystem::path& path)
+{
+	MappedFile file(path);
+	if (!file.IsOpen())
+	{
+		LOG_WARN("Failed to open scene {}", path.string());
+		return false;
+	}
+
+	FileHeader header{};
+	if (file.Size() >= sizeof(header))
+	{
+		memcpy(&header, file.Data(), sizeof(header));
+	}
+
+	if (header.Magic != SCENE_MAGIC || header.Version != SCENE_VERSION)
+	{
+		LOG_WARN("{} isn't a scene saved by this version", path.string());
+		return false;
+	}
+
+	std::array<Chunk, (size_t)ChunkType::Count> chunks{};
+	uint64_t offset = sizeof(header);
+	bool valid = true;
+	for (uint32_t i = 0; i < header.Chunks && valid; i++)
+	{
+		ChunkHeader chunk{};
+		valid = file.Size() - offset >= sizeof(chunk);
+		if (valid)
+		{
+			memcpy(&chunk, file.Data() + offset, sizeof(chunk));
+			offset += sizeof(chunk);
+			valid = (uint32_t)chunk.Type < (uint32_t)ChunkType::Count && chunk.Size % CHUNK_ALIGNMENT == 0 && chunk.Size <= file.Size() - offset;
+		}
+
+		if (valid)
+		{
+			chunks[(size_t)chunk.Type] = { file.Data() + offset, chunk.Count, chunk.Size };
+			offset += chunk.Size;
+		}
+	}
+
+	if (!valid || !Validate(chunks, header.Entities))
+	{
+		LOG_WARN("Corrupted scene {}", path.string());
+		return false;
+	}
+
+	entt::registry& registry = scene.m_Registry;
+	registry.clear();
+	scene.m_Entities.clear();
+	scene.m_SpatialIndex.Clear();
+	scene.m_SpatialProxies.clear();
+
+	// Same handles SpawnEntity gives out
+	uint32_t count = header.Entities;
+	std::vector<entt::entity> entities(count);
+	scene.m_Entities.reserve(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		entities[i] = registry.create((entt::entity)(i + 1));
+		scene.m_Entities.emplace_back(entities[i], &scene);
+	}
+
+	const Chunk& tags = chunks[(size_t)ChunkType::Tags];
+	const uint32_t* tagOffsets = (const uint32_t*)tags.Data;
+	const char* tagCharacters = (const char*)(tagOffsets + count + 1);
+	registry.insert<TagComponent>(entities.begin(), entities.end());
+	auto& tagStorage = registry.storage<TagComponent>();
+	for (uint32_t i = 0; i < count; i++)
+	{
+		tagStorage.get(entities[i]).Tag.assign(tagCharacters + tagOffsets[i], tagOffsets[i + 1] - tagOffsets[i]);
+	}
+
+	registry.insert<TransformComponent>(entities.begin(), entities.end(), (const TransformComponent*)chunks[(size_t)ChunkType::Transforms].Data);
+	registry.insert<WorldTransformComponent>(entities.begin(), entities.end());
+	registry.insert<RelationshipComponent>(entities.begin(), entities.end());
+
+	// Children are prepended to their parent's list, going backwards keeps siblings in file order
+	const uint32_t* parents = (const uint32_t*)chunks[(size_t)ChunkType::Parents].Data;
+	auto& relationships = registry.storage<RelationshipComponent>();
+	for (uint32_t i = count; i-- > 0;)
+	{
+		if (parents[i] == NO_PARENT)
+		{
+			continue;
+		}
+
+		entt::entity parent = entities[parents[i]];
+		RelationshipComponent& relationship = relationships.get(entities[i]);
+		RelationshipComponent& parentRelationship = relationships.get(parent);
+		if (parentRelationship.FirstChild != entt::null)
+		{
+			relationships.get(parentRelationship.FirstChild).PrevSibling = entities[i];
+		}
+
+		relationship.Parent = parent;
+		relationship.NextSibling = parentRelationship.FirstChild;
+		parentRelationship.FirstChild = entities[i];
+	}
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (parents[i] != NO_PARENT)
+		{
+			relationships.get(entities[i]).Depth = relationships.get(entities[parents[i]]).Depth + 1;
+		}
+	}
+
+	InsertSparseColumn<MeshComponent>(registry, chunks[(size_t)ChunkType::Meshes], entities);
+	InsertSparseColumn<MaterialComponent>(registry, chunks[(size_t)ChunkType::Materials], entities);
+	InsertSparseColumn<DirectionalLightComponent>(registry, chunks[(size_t)ChunkType::DirectionalLights], entities);
+	InsertSparseColumn<PointLightComponent>(registry, chunks[(size_t)ChunkType::PointLights], entities);
+	InsertSparseColumn<SpotLightComponent>(registry, chunks[(size_t)ChunkType::SpotLights], entities);
+	scene.m_HierarchyChanged = true;
+
+	const Chunk& materials = chunks[(size_t)ChunkType::MaterialTable];
+	const MaterialRecord* records = (const MaterialRecord*)materials.Data;
+	const uint32_t* nameOffsets = (const uint32_t*)chunks[(size_t)ChunkType::MaterialNames].Data;
+	const char* nameCharacters = (const char*)(nameOffsets + materials.Count + 1);
+	AssetManager::ClearMaterials();
+	for (uint32_t i = 0; i < materials.Count; i++)
+	{
+		Material material = FromRecord(records[i]);
+		material.Name.assign(nameCharacters + nameOffsets[i], nameOffsets[i + 1] - nameOffsets[i]);
+		AssetManager::AddMaterial(material, records[i].ID);
+	}
+
+	return true;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <filesystem>
+
+struct Scene;
+
+// Binary scene files, a header followed by one chunk per component type. Components every entity has are stored as columns in entity order,
+// the rest as the indices of their entities followed by the values. Loading maps the file and inserts whole columns into the registry.
+// Columns are raw component memory and meshes and textures are referenced by ID, so a file only loads with the same build and assets
+class SceneSerializer
+{
+public:
+	// The AssetManager materials are saved along with the entities
+	static bool Save(Scene& scene, const std::filesystem::path& path);
+	// Replaces every entity of the scene and the AssetManager materials. Damaged files are rejected before anything changes
+	static bool Load(Scene& scene, const std::filesystem::path& path);
+};
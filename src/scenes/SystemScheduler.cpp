@@ -0,0 +1,99 @@
+#include "SystemScheduler.hpp"
+#include "../JobSystem.hpp"
+
+#include <algorithm>
+
+static bool Overlaps(const std::vector<entt::id_type>& a, const std::vector<entt::id_type>& b)
+{
+	for (entt::id_type id : a)
+	{
+		if (std::find(b.begin(), b.end(), id) != b.end())
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+SystemScheduler::System& SystemScheduler::Add(const std::string& name, SystemFunc&& func)
+{
+	System& system = m_Systems.emplace_back();
+	system.Name = name;
+	system.Func = std::move(func);
+
+	return system;
+}
+
+void SystemScheduler::Run(entt::registry& registry)
+{
+	if (m_Systems.empty())
+	{
+		return;
+	}
+
+	for (System& system : m_Systems)
+	{
+		for (void(*storage)(entt::registry&) : system.Storages)
+		{
+			storage(registry);
+		}
+	}
+
+	BuildGraph();
+
+	JobCounter counter;
+	for (uint32_t i = 0; i < m_Systems.size(); i++)
+	{
+		if (m_Dependencies[i].empty())
+		{
+			JobSystem::Run([this, i, &registry, &counter]() { Dispatch(i, registry, counter); }, &counter);
+		}
+	}
+
+	JobSystem::Wait(counter);
+}
+
+void SystemScheduler::BuildGraph()
+{
+	uint32_t count = (uint32_t)m_Systems.size();
+	if (m_Dependencies.size() != count)
+	{
+		m_Dependencies.resize(count);
+		m_Dependents.resize(count);
+		m_Remaining = std::make_unique<std::atomic<uint32_t>[]>(count);
+	}
+
+	// Registration order decides which of two conflicting systems goes first
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const System& system = m_Systems[i];
+		m_Dependencies[i].clear();
+		m_Dependents[i].clear();
+		for (uint32_t j = 0; j < i; j++)
+		{
+			const System& earlier = m_Systems[j];
+			if (Overlaps(earlier.Writes, system.Reads) || Overlaps(earlier.Writes, system.Writes) || Overlaps(earlier.Reads, system.Writes))
+			{
+				m_Dependencies[i].push_back(j);
+				m_Dependents[j].push_back(i);
+			}
+		}
+
+		m_Remaining[i] = (uint32_t)m_Dependencies[i].size();
+	}
+}
+
+void SystemScheduler::Dispatch(uint32_t system, entt::registry& registry, JobCounter& counter)
+{
+	m_Systems[system].Func(registry);
+
+	// Dependents are queued before this job counts as done, so the counter can't reach zero in between
+	for (uint32_t dependent : m_Dependents[system])
+	{
+		if (m_Remaining[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			JobSystem::Run([this, dependent, &registry, &counter]() { Dispatch(dependent, registry, counter); }, &counter);
+		}
+	}
+}
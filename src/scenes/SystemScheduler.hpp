@@ -0,0 +1,74 @@
+#pragma once
+
+#include <entt/entt.hpp>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class JobCounter;
+
+// Runs systems over a registry on the job system. Each system declares the components it reads and writes, one waits only for the systems
+// added before it that write what it touches or read what it writes, the rest run concurrently.
+// Systems may only touch the components they declared and can't create or destroy entities
+class SystemScheduler
+{
+public:
+	using SystemFunc = std::function<void(entt::registry&)>;
+
+	struct System
+	{
+		std::string Name;
+		SystemFunc Func;
+		std::vector<entt::id_type> Reads;
+		std::vector<entt::id_type> Writes;
+
+		template<typename... Components>
+		System& Read()
+		{
+			(Declare<Components>(Reads), ...);
+			return *this;
+		}
+
+		template<typename... Components>
+		System& Write()
+		{
+			(Declare<Components>(Writes), ...);
+			return *this;
+		}
+
+	private:
+		template<typename Component>
+		void Declare(std::vector<entt::id_type>& access)
+		{
+			access.push_back(entt::type_hash<Component>::value());
+			Storages.push_back([](entt::registry& registry) { registry.storage<Component>(); });
+		}
+
+		// Storage is created on first use, which changes the registry, so it's made before the systems run
+		std::vector<void(*)(entt::registry&)> Storages;
+
+		friend class SystemScheduler;
+	};
+
+	// The returned system stays valid until the next one is added
+	System& Add(const std::string& name, SystemFunc&& func);
+
+	// Builds the dependency graph and runs every system, blocks until all finished
+	void Run(entt::registry& registry);
+
+	inline uint32_t SystemCount() const { return (uint32_t)m_Systems.size(); }
+	// Systems the given one waited for in the last run
+	inline const std::vector<uint32_t>& Dependencies(uint32_t system) const { return m_Dependencies[system]; }
+
+private:
+	void BuildGraph();
+	void Dispatch(uint32_t system, entt::registry& registry, JobCounter& counter);
+
+	std::vector<System> m_Systems;
+
+	std::vector<std::vector<uint32_t>> m_Dependencies;
+	std::vector<std::vector<uint32_t>> m_Dependents;
+	std::unique_ptr<std::atomic<uint32_t>[]> m_Remaining;
+};
@@ -0,0 +1,128 @@
+#include "TransformBatch.hpp"
+#include "TransformKernels.hpp"
+#include "Components.hpp"
+
+#include <cassert>
+
+#if defined(CONF_AVX2_KERNELS) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+void TransformBatch::Clear()
+{
+	for (std::vector<float>* component : { &PositionX, &PositionY, &PositionZ, &RotationX, &RotationY, &RotationZ, &RotationW, &ScaleX, &ScaleY, &ScaleZ })
+	{
+		component->clear();
+	}
+}
+
+void TransformBatch::Add(const TransformComponent& transform)
+{
+	assert(!QuaternionRotations && "Batch holds quaternions");
+	PositionX.push_back(transform.Position.x);
+	PositionY.push_back(transform.Position.y);
+	PositionZ.push_back(transform.Position.z);
+	RotationX.push_back(transform.Rotation.x);
+	RotationY.push_back(transform.Rotation.y);
+	RotationZ.push_back(transform.Rotation.z);
+	ScaleX.push_back(transform.Scale.x);
+	ScaleY.push_back(transform.Scale.y);
+	ScaleZ.push_back(transform.Scale.z);
+}
+
+void TransformBatch::Add(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	assert(QuaternionRotations && "Batch holds Euler angles");
+	PositionX.push_back(position.x);
+	PositionY.push_back(position.y);
+	PositionZ.push_back(position.z);
+	RotationX.push_back(rotation.x);
+	RotationY.push_back(rotation.y);
+	RotationZ.push_back(rotation.z);
+	RotationW.push_back(rotation.w);
+	ScaleX.push_back(scale.x);
+	ScaleY.push_back(scale.y);
+	ScaleZ.push_back(scale.z);
+}
+
+static void ComposeScalar(const TransformBatch& batch, uint32_t i, float* matrix)
+{
+	Quaternion<float> q{ batch.RotationX[i], batch.RotationY[i], batch.RotationZ[i], 0.0f };
+	if (batch.QuaternionRotations)
+	{
+		q.W = batch.RotationW[i];
+	}
+	else
+	{
+		q = FromEuler(q.X, q.Y, q.Z, 0.5f, [](float angle, float& s, float& c) { s = std::sin(angle); c = std::cos(angle); });
+	}
+
+	float columns[12];
+	Compose(q, batch.PositionX[i], batch.PositionY[i], batch.PositionZ[i], batch.ScaleX[i], batch.ScaleY[i], batch.ScaleZ[i], 1.0f, 2.0f, columns);
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		matrix[c * 4 + 0] = columns[c * 3 + 0];
+		matrix[c * 4 + 1] = columns[c * 3 + 1];
+		matrix[c * 4 + 2] = columns[c * 3 + 2];
+		matrix[c * 4 + 3] = c == 3 ? 1.0f : 0.0f;
+	}
+}
+
+#ifdef CONF_AVX2_KERNELS
+// Both the instructions and the OS saving the upper halves of the registers are needed
+static bool CpuHasAVX2()
+{
+#ifdef _MSC_VER
+	int32_t info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+	{
+		return false;
+	}
+
+	__cpuid(info, 1);
+	bool savesYMM = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+	__cpuidex(info, 7, 0);
+
+	return savesYMM && (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+bool UsesAVX2Kernel()
+{
+#ifdef CONF_AVX2_KERNELS
+	static const bool hasAVX2 = CpuHasAVX2();
+	return hasAVX2;
+#else
+	return false;
+#endif
+}
+
+void ComposeMatrices(const TransformBatch& batch, uint32_t begin, uint32_t end, glm::mat4* matrices)
+{
+	float* output = &matrices[0][0][0];
+	uint32_t i = begin;
+
+#ifdef CONF_AVX2_KERNELS
+	if (UsesAVX2Kernel())
+	{
+		i = ComposeMatricesAVX2(batch, i, end, output);
+	}
+#endif
+
+#ifdef TRS_SSE
+	for (; i + 4 <= end; i += 4)
+	{
+		ComposeLanes<Lanes4>(batch, i, output + (size_t)i * 16);
+	}
+#endif
+
+	for (; i < end; i++)
+	{
+		ComposeScalar(batch, i, output + (size_t)i * 16);
+	}
+}
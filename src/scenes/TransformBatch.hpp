@@ -0,0 +1,39 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+
+struct TransformComponent;
+
+// Transforms stored component by component, so the kernel loads several of them per instruction.
+// Rotations are Euler angles like TransformComponent keeps them, or quaternions for batches made with QuaternionRotations
+struct TransformBatch
+{
+	std::vector<float> PositionX;
+	std::vector<float> PositionY;
+	std::vector<float> PositionZ;
+	std::vector<float> RotationX;
+	std::vector<float> RotationY;
+	std::vector<float> RotationZ;
+	std::vector<float> RotationW; // Only filled for quaternions
+	std::vector<float> ScaleX;
+	std::vector<float> ScaleY;
+	std::vector<float> ScaleZ;
+
+	bool QuaternionRotations = false;
+
+	inline uint32_t Size() const { return (uint32_t)PositionX.size(); }
+
+	// Keeps the capacity for the next frame
+	void Clear();
+	void Add(const TransformComponent& transform);
+	void Add(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+};
+
+// Writes translate * rotate * scale of transforms [begin, end) into matrices[begin, end), the same as TransformComponent::ToMat4.
+// CPUs with AVX2 do 8 transforms per iteration, the others 4 with SSE
+void ComposeMatrices(const TransformBatch& batch, uint32_t begin, uint32_t end, glm::mat4* matrices);
+
+// Whether the AVX2 kernel is built in and this CPU can run it
+bool UsesAVX2Kernel();
@@ -0,0 +1,58 @@
+// Built with AVX2 enabled when CONF_AVX2_KERNELS is set, TransformBatch.cpp only calls into it after checking the CPU
+#ifdef CONF_AVX2_KERNELS
+#include "TransformKernels.hpp"
+
+#include <immintrin.h>
+
+namespace
+{
+
+struct Lanes8
+{
+	__m256 V;
+
+	static Lanes8 Load(const float* p) { return { _mm256_loadu_ps(p) }; }
+	static Lanes8 Set(float f)		   { return { _mm256_set1_ps(f) }; }
+
+	friend Lanes8 operator+ (Lanes8 a, Lanes8 b) { return { _mm256_add_ps(a.V, b.V) }; }
+	friend Lanes8 operator- (Lanes8 a, Lanes8 b) { return { _mm256_sub_ps(a.V, b.V) }; }
+	friend Lanes8 operator* (Lanes8 a, Lanes8 b) { return { _mm256_mul_ps(a.V, b.V) }; }
+};
+
+// Both halves go through the SSE version, sincos is a small part of the kernel and this keeps a single copy of it
+static void SinCos(Lanes8 angle, Lanes8& sine, Lanes8& cosine)
+{
+	Lanes4 lowSin, lowCos, highSin, highCos;
+	SinCos(Lanes4{ _mm256_castps256_ps128(angle.V) }, lowSin, lowCos);
+	SinCos(Lanes4{ _mm256_extractf128_ps(angle.V, 1) }, highSin, highCos);
+	sine = { _mm256_set_m128(highSin.V, lowSin.V) };
+	cosine = { _mm256_set_m128(highCos.V, lowCos.V) };
+}
+
+static void Store(const Lanes8 columns[12], float* matrices)
+{
+	Lanes4 low[12];
+	Lanes4 high[12];
+	for (uint32_t i = 0; i < 12; i++)
+	{
+		low[i] = { _mm256_castps256_ps128(columns[i].V) };
+		high[i] = { _mm256_extractf128_ps(columns[i].V, 1) };
+	}
+
+	Store(low, matrices);
+	Store(high, matrices + 4 * 16);
+}
+
+}
+
+uint32_t ComposeMatricesAVX2(const TransformBatch& batch, uint32_t begin, uint32_t end, float* matrices)
+{
+	uint32_t i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		ComposeLanes<Lanes8>(batch, i, matrices + (size_t)i * 16);
+	}
+
+	return i;
+}
+#endif
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "TransformBatch.hpp"
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TRS_SSE 1
+#endif
+
+// Shared with TransformBatchAVX2.cpp, which is compiled for a wider instruction set. Nothing in here may have external linkage,
+// the linker could otherwise keep the AVX2 build of a function and run it on CPUs without it
+namespace
+{
+
+// The kernel is written once over these lane types, T is either float or a SIMD register of them
+template<typename T>
+struct Quaternion
+{
+	T X, Y, Z, W;
+};
+
+// Same as glm::quat(eulerAngles)
+template<typename T, typename SinCos>
+static Quaternion<T> FromEuler(T x, T y, T z, T half, SinCos sinCos)
+{
+	T sx, cx, sy, cy, sz, cz;
+	sinCos(x * half, sx, cx);
+	sinCos(y * half, sy, cy);
+	sinCos(z * half, sz, cz);
+
+	return {
+		sx * cy * cz - cx * sy * sz,
+		cx * sy * cz + sx * cy * sz,
+		cx * cy * sz - sx * sy * cz,
+		cx * cy * cz + sx * sy * sz
+	};
+}
+
+// Columns of translate * toMat4(q) * scale, without the constant last row
+template<typename T>
+static void Compose(const Quaternion<T>& q, T px, T py, T pz, T sx, T sy, T sz, T one, T two, T columns[12])
+{
+	T xx = q.X * q.X, yy = q.Y * q.Y, zz = q.Z * q.Z;
+	T xy = q.X * q.Y, xz = q.X * q.Z, yz = q.Y * q.Z;
+	T wx = q.W * q.X, wy = q.W * q.Y, wz = q.W * q.Z;
+
+	columns[0]  = (one - two * (yy + zz)) * sx;
+	columns[1]  = two * (xy + wz) * sx;
+	columns[2]  = two * (xz - wy) * sx;
+	columns[3]  = two * (xy - wz) * sy;
+	columns[4]  = (one - two * (xx + zz)) * sy;
+	columns[5]  = two * (yz + wx) * sy;
+	columns[6]  = two * (xz + wy) * sz;
+	columns[7]  = two * (yz - wx) * sz;
+	columns[8]  = (one - two * (xx + yy)) * sz;
+	columns[9]  = px;
+	columns[10] = py;
+	columns[11] = pz;
+}
+
+#ifdef TRS_SSE
+struct Lanes4
+{
+	__m128 V;
+
+	static Lanes4 Load(const float* p) { return { _mm_loadu_ps(p) }; }
+	static Lanes4 Set(float f)		   { return { _mm_set1_ps(f) }; }
+
+	friend Lanes4 operator+ (Lanes4 a, Lanes4 b) { return { _mm_add_ps(a.V, b.V) }; }
+	friend Lanes4 operator- (Lanes4 a, Lanes4 b) { return { _mm_sub_ps(a.V, b.V) }; }
+	friend Lanes4 operator* (Lanes4 a, Lanes4 b) { return { _mm_mul_ps(a.V, b.V) }; }
+};
+
+// Cephes' single precision sincos, accurate to a few ulps for the angles transforms use
+static void SinCos(Lanes4 angle, Lanes4& sine, Lanes4& cosine)
+{
+	const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32((int32_t)0x80000000));
+	__m128 x = _mm_andnot_ps(signMask, angle.V);
+	__m128 sinSign = _mm_and_ps(angle.V, signMask);
+
+	// Octant of the angle rounded up to even, the remainder is reduced in three steps to keep its precision
+	__m128i octant = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.27323954473516f)));
+	octant = _mm_and_si128(_mm_add_epi32(octant, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+	__m128 y = _mm_cvtepi32_ps(octant);
+	x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(0.78515625f)));
+	x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(2.4187564849853515625e-4f)));
+	x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(3.77489497744594108e-8f)));
+
+	__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(octant, _mm_set1_epi32(2)), _mm_set1_epi32(2)));
+	sinSign = _mm_xor_ps(sinSign, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(octant, _mm_set1_epi32(4)), 29)));
+	__m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(octant, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+
+	__m128 x2 = _mm_mul_ps(x, x);
+	__m128 cosPoly = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.443315711809948e-5f), x2), _mm_set1_ps(-1.388731625493765e-3f));
+	cosPoly = _mm_add_ps(_mm_mul_ps(cosPoly, x2), _mm_set1_ps(4.166664568298827e-2f));
+	cosPoly = _mm_mul_ps(_mm_mul_ps(cosPoly, x2), x2);
+	cosPoly = _mm_add_ps(_mm_sub_ps(cosPoly, _mm_mul_ps(x2, _mm_set1_ps(0.5f))), _mm_set1_ps(1.0f));
+
+	__m128 sinPoly = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-1.9515295891e-4f), x2), _mm_set1_ps(8.3321608736e-3f));
+	sinPoly = _mm_add_ps(_mm_mul_ps(sinPoly, x2), _mm_set1_ps(-1.6666654611e-1f));
+	sinPoly = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sinPoly, x2), x), x);
+
+	__m128 s = _mm_or_ps(_mm_and_ps(swap, cosPoly), _mm_andnot_ps(swap, sinPoly));
+	__m128 c = _mm_or_ps(_mm_and_ps(swap, sinPoly), _mm_andnot_ps(swap, cosPoly));
+	sine = { _mm_xor_ps(s, sinSign) };
+	cosine = { _mm_xor_ps(c, cosSign) };
+}
+
+// Turns the lanes of 12 column registers into 4 column major matrices
+static void Store(const Lanes4 columns[12], float* matrices)
+{
+	const __m128 zero = _mm_setzero_ps();
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		__m128 x = columns[c * 3 + 0].V;
+		__m128 y = columns[c * 3 + 1].V;
+		__m128 z = columns[c * 3 + 2].V;
+		__m128 w = c == 3 ? _mm_set1_ps(1.0f) : zero;
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		_mm_storeu_ps(matrices + 0 * 16 + c * 4, x);
+		_mm_storeu_ps(matrices + 1 * 16 + c * 4, y);
+		_mm_storeu_ps(matrices + 2 * 16 + c * 4, z);
+		_mm_storeu_ps(matrices + 3 * 16 + c * 4, w);
+	}
+}
+#endif
+
+#ifdef TRS_SSE
+template<typename Lanes>
+static void ComposeLanes(const TransformBatch& batch, uint32_t i, float* matrices)
+{
+	const Lanes one = Lanes::Set(1.0f);
+	const Lanes two = Lanes::Set(2.0f);
+
+	Quaternion<Lanes> q{ Lanes::Load(&batch.RotationX[i]), Lanes::Load(&batch.RotationY[i]), Lanes::Load(&batch.RotationZ[i]), one };
+	if (batch.QuaternionRotations)
+	{
+		q.W = Lanes::Load(&batch.RotationW[i]);
+	}
+	else
+	{
+		q = FromEuler(q.X, q.Y, q.Z, Lanes::Set(0.5f), [](Lanes angle, Lanes& s, Lanes& c) { SinCos(angle, s, c); });
+	}
+
+	Lanes columns[12];
+	Compose(q, Lanes::Load(&batch.PositionX[i]), Lanes::Load(&batch.PositionY[i]), Lanes::Load(&batch.PositionZ[i]),
+		Lanes::Load(&batch.ScaleX[i]), Lanes::Load(&batch.ScaleY[i]), Lanes::Load(&batch.ScaleZ[i]), one, two, columns);
+
+	Store(columns, matrices);
+}
+#endif
+
+}
+
+#ifdef CONF_AVX2_KERNELS
+// Composes 8 transforms per iteration starting at begin and returns the first one it left for narrower kernels.
+// Only call it where the CPU supports AVX2
+uint32_t ComposeMatricesAVX2(const TransformBatch& batch, uint32_t begin, uint32_t end, float* matrices);
+#endif
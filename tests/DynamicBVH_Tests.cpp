@@ -0,0 +1,242 @@
+#include <gtest/gtest.h>
+
+#include "scenes/DynamicBVH.hpp"
+#include "scenes/Scene.hpp"
+#include "scenes/Entity.hpp"
+#include "Clock.hpp"
+#include "Logger.hpp"
+#include "RandomUtils.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <random>
+
+static AABB RandomBox(std::mt19937& rng, float worldSize)
+{
+	std::uniform_real_distribution<float> position(-worldSize, worldSize);
+	std::uniform_real_distribution<float> size(0.1f, 2.0f);
+
+	glm::vec3 min(position(rng), position(rng), position(rng));
+	return { min, min + glm::vec3(size(rng), size(rng), size(rng)) };
+}
+
+static std::vector<entt::entity> Sorted(std::vector<entt::entity> entities)
+{
+	std::sort(entities.begin(), entities.end());
+	return entities;
+}
+
+TEST(DynamicBVH, QueriesMatchFullScan)
+{
+	static constexpr uint32_t BOXES = 2000;
+	std::mt19937 rng(5);
+
+	DynamicBVH tree;
+	std::vector<AABB> boxes;
+	std::vector<uint32_t> proxies;
+	for (uint32_t i = 0; i < BOXES; i++)
+	{
+		boxes.push_back(RandomBox(rng, 50.0f));
+		proxies.push_back(tree.Insert(boxes.back(), (entt::entity)i));
+	}
+
+	// Small moves stay in the enlarged leaves, big ones are reinserted, removed boxes must not come back
+	std::uniform_real_distribution<float> nudge(-0.05f, 0.05f);
+	std::vector<bool> removed(BOXES, false);
+	for (uint32_t i = 0; i < BOXES; i++)
+	{
+		if (i % 3 == 0)
+		{
+			glm::vec3 offset(nudge(rng), nudge(rng), nudge(rng));
+			boxes[i] = { boxes[i].Min + offset, boxes[i].Max + offset };
+			EXPECT_FALSE(tree.Move(proxies[i], boxes[i]));
+		}
+		else if (i % 3 == 1)
+		{
+			boxes[i] = RandomBox(rng, 50.0f);
+			tree.Move(proxies[i], boxes[i]);
+		}
+		else if (i % 7 == 2)
+		{
+			tree.Remove(proxies[i]);
+			removed[i] = true;
+		}
+	}
+
+	ASSERT_TRUE(tree.Validate());
+
+	for (uint32_t query = 0; query < 100; query++)
+	{
+		AABB box = RandomBox(rng, 50.0f);
+		box.Max += glm::vec3(5.0f);
+		glm::vec3 center = box.Center();
+		float radius = 6.0f;
+		glm::vec3 direction = glm::normalize(RandomBox(rng, 1.0f).Min);
+		Frustum frustum = Frustum::FromMatrix(glm::perspective(glm::radians(45.0f), 1.5f, 0.1f, 40.0f) * glm::lookAt(center, center + direction, glm::vec3(0.0f, 1.0f, 0.0f)));
+
+		std::vector<entt::entity> expectedBox, expectedSphere, expectedFrustum;
+		std::optional<SpatialHit> expectedHit, expectedNearest;
+		for (uint32_t i = 0; i < BOXES; i++)
+		{
+			if (removed[i])
+			{
+				continue;
+			}
+
+			if (boxes[i].Overlaps(box))
+			{
+				expectedBox.push_back((entt::entity)i);
+			}
+
+			if (boxes[i].DistanceSquared(center) <= radius * radius)
+			{
+				expectedSphere.push_back((entt::entity)i);
+			}
+
+			if (frustum.Overlaps(boxes[i]))
+			{
+				expectedFrustum.push_back((entt::entity)i);
+			}
+
+			// Slab test, the brute force twin of the tree's
+			glm::vec3 t0 = (boxes[i].Min - center) * (1.0f / direction);
+			glm::vec3 t1 = (boxes[i].Max - center) * (1.0f / direction);
+			float enter = std::max(MaxComponent(glm::min(t0, t1)), 0.0f);
+			float exit = std::min(-MaxComponent(-glm::max(t0, t1)), 100.0f);
+			if (enter <= exit && (!expectedHit || enter < expectedHit->Distance))
+			{
+				expectedHit = SpatialHit{ (entt::entity)i, enter };
+			}
+
+			float distance = std::sqrt(boxes[i].DistanceSquared(center));
+			if (!expectedNearest || distance < expectedNearest->Distance)
+			{
+				expectedNearest = SpatialHit{ (entt::entity)i, distance };
+			}
+		}
+
+		std::vector<entt::entity> found;
+		tree.Query(box, found);
+		EXPECT_EQ(Sorted(found), expectedBox);
+
+		found.clear();
+		tree.QuerySphere(center, radius, found);
+		EXPECT_EQ(Sorted(found), expectedSphere);
+
+		found.clear();
+		tree.QueryFrustum(frustum, found);
+		EXPECT_EQ(Sorted(found), expectedFrustum);
+
+		// Boxes can be hit at the same distance, only the distance has to agree
+		std::optional<SpatialHit> hit = tree.Raycast(center, direction, 100.0f);
+		ASSERT_EQ(hit.has_value(), expectedHit.has_value());
+		if (hit)
+		{
+			EXPECT_FLOAT_EQ(hit->Distance, expectedHit->Distance);
+		}
+
+		std::optional<SpatialHit> nearest = tree.Nearest(center, FLT_MAX);
+		ASSERT_TRUE(nearest.has_value());
+		EXPECT_FLOAT_EQ(nearest->Distance, expectedNearest->Distance);
+	}
+}
+
+TEST(DynamicBVH, SceneKeepsItUpToDate)
+{
+	Scene scene{};
+	Entity first = scene.SpawnEntity("First");
+	Entity second = scene.SpawnEntity("Second");
+	scene.SetParent(second, first);
+	second.GetComponent<TransformComponent>().Position = glm::vec3(10.0f, 0.0f, 0.0f);
+
+	SceneSnapshot snapshot;
+	scene.Extract(snapshot);
+	EXPECT_EQ(scene.SpatialIndex().LeafCount(), 2u);
+
+	std::vector<entt::entity> found;
+	scene.SpatialIndex().QuerySphere(glm::vec3(10.0f, 0.0f, 0.0f), 0.1f, found);
+	EXPECT_EQ(found, std::vector<entt::entity>{ second.Handle() });
+
+	// Children move along with their parent
+	first.PatchComponent<TransformComponent>([](TransformComponent& transform) { transform.Position.y = 20.0f; });
+	scene.Extract(snapshot);
+	std::optional<SpatialHit> hit = scene.SpatialIndex().Raycast(glm::vec3(10.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), 100.0f);
+	ASSERT_TRUE(hit.has_value());
+	EXPECT_EQ(hit->Entity, second.Handle());
+	EXPECT_FLOAT_EQ(hit->Distance, 19.5f);
+
+	scene.DestroyEntity(first);
+	EXPECT_EQ(scene.SpatialIndex().LeafCount(), 0u);
+	EXPECT_TRUE(scene.SpatialIndex().Validate());
+}
+
+// Takes seconds, run it with --gtest_also_run_disabled_tests
+TEST(DynamicBVH, DISABLED_Benchmark)
+{
+	std::mt19937 rng(9);
+	for (uint32_t count : { 10000u, 100000u, 1000000u })
+	{
+		// Same density at every size, so queries find about as much each time
+		float worldSize = std::cbrt((float)count) * 4.0f;
+		std::vector<AABB> boxes(count);
+		for (AABB& box : boxes)
+		{
+			box = RandomBox(rng, worldSize);
+		}
+
+		DynamicBVH tree;
+		std::vector<uint32_t> proxies(count);
+		Clock clock;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			proxies[i] = tree.Insert(boxes[i], (entt::entity)i);
+		}
+		float build = clock.GetElapsedTime();
+
+		// A tenth of the boxes move, most of them a little and some far enough to leave their leaves
+		std::uniform_real_distribution<float> step(-0.05f, 0.05f);
+		std::uniform_real_distribution<float> jump(-3.0f, 3.0f);
+		uint32_t reinserted = 0;
+		clock.Restart();
+		for (uint32_t i = 0; i < count; i += 10)
+		{
+			std::uniform_real_distribution<float>& distance = i % 100 == 0 ? jump : step;
+			glm::vec3 offset(distance(rng), distance(rng), distance(rng));
+			boxes[i] = { boxes[i].Min + offset, boxes[i].Max + offset };
+			reinserted += tree.Move(proxies[i], boxes[i]) ? 1 : 0;
+		}
+		float update = clock.GetElapsedTime();
+
+		static constexpr uint32_t QUERIES = 10000;
+		std::vector<entt::entity> found;
+		clock.Restart();
+		for (uint32_t i = 0; i < QUERIES; i++)
+		{
+			AABB box = RandomBox(rng, worldSize);
+			box.Max += glm::vec3(2.0f);
+			tree.Query(box, found);
+		}
+		float boxQueries = clock.GetElapsedTime();
+
+		uint32_t hits = 0;
+		clock.Restart();
+		for (uint32_t i = 0; i < QUERIES; i++)
+		{
+			glm::vec3 direction = glm::normalize(RandomBox(rng, 1.0f).Min + glm::vec3(0.001f));
+			hits += tree.Raycast(RandomBox(rng, worldSize).Min, direction, worldSize).has_value() ? 1 : 0;
+		}
+		float raycasts = clock.GetElapsedTime();
+
+		clock.Restart();
+		for (uint32_t i = 0; i < QUERIES; i++)
+		{
+			tree.Nearest(RandomBox(rng, worldSize).Min, FLT_MAX);
+		}
+		float nearest = clock.GetElapsedTime();
+
+		LOG_INFO("{} boxes: build {:.2f} ms, moving {} ({} reinserted) {:.2f} ms, height {}, area ratio {:.1f}", count, build, count / 10, reinserted, update, tree.Height(), tree.AreaRatio());
+		LOG_INFO("{} boxes: {} box queries {:.2f} ms ({} found), raycasts {:.2f} ms ({} hits), nearest {:.2f} ms", count, QUERIES, boxQueries, found.size(), raycasts, hits, nearest);
+		EXPECT_TRUE(tree.Validate());
+	}
+}
@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 
+#include "JobSystem.hpp"
 #include "Logger.hpp"
 #include "TriggerClock.hpp"
 
@@ -9,6 +10,10 @@ int main(int argc, char** argv)
 
 	Logger::Init();
 	TriggerClock::UpdateClocks();
+	JobSystem::Init();
 
-	return RUN_ALL_TESTS();
+	int result = RUN_ALL_TESTS();
+	JobSystem::Shutdown();
+
+	return result;
 }
\ No newline at end of file
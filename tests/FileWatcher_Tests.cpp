@@ -0,0 +1,43 @@
+#include <gtest/gtest.h>
+
+#include "FileWatcher.hpp"
+
+#include <fstream>
+#include <thread>
+#include <chrono>
+
+// Polling watchers only look at the files every PollInterval
+static std::vector<std::filesystem::path> WaitForChanges(FileWatcher& watcher)
+{
+	std::vector<std::filesystem::path> changes;
+	Clock clock;
+	while (changes.empty() && clock.GetElapsedTime() < FileWatcher::PollInterval * 4.0f)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		changes = watcher.Changes();
+	}
+
+	return changes;
+}
+
+TEST(FileWatcher, ReportsWrittenFiles)
+{
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "FileWatcherTest";
+	std::filesystem::remove_all(directory);
+	std::filesystem::create_directories(directory / "nested");
+	std::ofstream(directory / "nested" / "Test.frag") << "void main() {}";
+
+	FileWatcher watcher(directory);
+	EXPECT_TRUE(watcher.Changes().empty()) << "Files that existed before aren't changes";
+
+	// Some filesystems only store write times in whole seconds
+	std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+	std::ofstream(directory / "nested" / "Test.frag") << "void main() { }";
+
+	std::vector<std::filesystem::path> changes = WaitForChanges(watcher);
+	ASSERT_EQ(changes.size(), 1u);
+	EXPECT_EQ(changes[0].lexically_normal(), (directory / "nested" / "Test.frag").lexically_normal());
+	EXPECT_TRUE(watcher.Changes().empty()) << "Every change is reported once";
+
+	std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+
+#include "renderer/IBLCache.hpp"
+
+#include <fstream>
+
+static CubemapLevels Levels(int32_t faceSize, uint32_t mips, uint16_t seed)
+{
+	CubemapLevels levels{ faceSize, mips };
+	uint64_t texels = 0;
+	for (uint32_t mip = 0; mip < mips; mip++)
+	{
+		texels += IBLCache::LevelTexels(faceSize, mip);
+	}
+
+	levels.Texels.resize(texels * 3);
+	for (size_t i = 0; i < levels.Texels.size(); i++)
+	{
+		levels.Texels[i] = (uint16_t)(seed + i);
+	}
+
+	return levels;
+}
+
+TEST(IBLCache, RoundTrip)
+{
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "RoundTrip.ibl";
+	IBLData data{};
+	data.Environment = Levels(16, 5, 1);
+	data.Irradiance = Levels(4, 1, 2);
+	data.Prefilter = Levels(8, 4, 3);
+	data.IrradianceSH[4] = glm::vec3(0.25f, -1.0f, 3.0f);
+	ASSERT_TRUE(IBLCache::Write(path, data));
+
+	std::optional<IBLData> read = IBLCache::Read(path);
+	ASSERT_TRUE(read.has_value());
+	EXPECT_EQ(read->Environment.FaceSize, 16);
+	EXPECT_EQ(read->Environment.Mips, 5);
+	EXPECT_EQ(read->Environment.Texels, data.Environment.Texels);
+	EXPECT_EQ(read->Irradiance.Texels, data.Irradiance.Texels);
+	EXPECT_EQ(read->Prefilter.Mips, 4);
+	EXPECT_EQ(read->Prefilter.Texels, data.Prefilter.Texels);
+	EXPECT_EQ(read->IrradianceSH[4], data.IrradianceSH[4]);
+
+	std::filesystem::resize_file(path, std::filesystem::file_size(path) - 2);
+	EXPECT_FALSE(IBLCache::Read(path).has_value()) << "Truncated entry has to be baked again";
+
+	std::filesystem::remove(path);
+}
+
+TEST(IBLCache, KeyedByContentsAndFaceSize)
+{
+	std::filesystem::path first = std::filesystem::temp_directory_path() / "KeyedFirst.hdr";
+	std::filesystem::path second = std::filesystem::temp_directory_path() / "KeyedSecond.hdr";
+	std::ofstream(first, std::ios::binary) << "same contents";
+	std::ofstream(second, std::ios::binary) << "same contents";
+
+	std::optional<std::filesystem::path> firstEntry = IBLCache::EntryPath(first.string(), { 64, 64 });
+	ASSERT_TRUE(firstEntry.has_value());
+	EXPECT_EQ(firstEntry, IBLCache::EntryPath(second.string(), { 64, 64 }));
+	EXPECT_NE(firstEntry, IBLCache::EntryPath(first.string(), { 128, 128 }));
+
+	std::ofstream(second, std::ios::binary) << "other contents";
+	EXPECT_NE(firstEntry, IBLCache::EntryPath(second.string(), { 64, 64 }));
+	EXPECT_FALSE(IBLCache::EntryPath("missing.hdr", { 64, 64 }).has_value());
+
+	std::filesystem::remove(first);
+	std::filesystem::remove(second);
+}
+
+TEST(IBLCache, BRDFIntegration)
+{
+	constexpr int32_t SIZE = 64;
+	std::vector<float> lut = IBLCache::IntegrateBRDF(SIZE);
+	ASSERT_EQ(lut.size(), (size_t)SIZE * SIZE * 2);
+	EXPECT_EQ(lut, IBLCache::IntegrateBRDF(SIZE)) << "Threaded integration has to be deterministic";
+
+	// Smooth surface seen head on reflects everything through the scale term
+	const float* smooth = lut.data() + (SIZE - 1) * 2;
+	EXPECT_NEAR(smooth[0], 1.0f, 0.02f);
+	EXPECT_NEAR(smooth[1], 0.0f, 0.01f);
+
+	// Grazing, fairly rough texel checked against a double precision evaluation of the same estimator
+	const float* grazing = lut.data() + ((size_t)23 * SIZE + 2) * 2;
+	EXPECT_NEAR(grazing[0], 0.50653f, 1e-3f);
+	EXPECT_NEAR(grazing[1], 0.20345f, 1e-3f);
+}
@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+
+#include "JobSystem.hpp"
+#include "Clock.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+TEST(JobSystem, ParallelForCoversEveryIndexOnce)
+{
+	for (uint32_t grain : { 1u, 7u, 1000u, 200000u })
+	{
+		std::vector<std::atomic<uint32_t>> seen(100003);
+		JobSystem::ParallelFor((uint32_t)seen.size(), [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t i = begin; i < end; i++)
+				{
+					seen[i]++;
+				}
+			}, grain);
+
+		uint32_t once = 0;
+		for (const std::atomic<uint32_t>& count : seen)
+		{
+			once += count == 1 ? 1 : 0;
+		}
+
+		EXPECT_EQ(once, seen.size()) << "Grain size " << grain;
+	}
+}
+
+TEST(JobSystem, DependentJobsRunAfterTheirDependency)
+{
+	JobCounter first;
+	JobCounter second;
+	std::atomic<uint32_t> firstDone = 0;
+	std::atomic<uint32_t> early = 0;
+
+	for (uint32_t i = 0; i < 64; i++)
+	{
+		JobSystem::Run([&]() { firstDone++; }, &first);
+	}
+
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		JobSystem::RunAfter(first, [&]() { early += firstDone != 64 ? 1 : 0; }, &second);
+	}
+
+	JobSystem::Wait(second);
+	EXPECT_TRUE(first.Done());
+	EXPECT_EQ(early, 0u) << "A job started before the jobs it depends on finished";
+}
+
+TEST(JobSystem, NestedWaitsDontDeadlock)
+{
+	std::atomic<uint32_t> total = 0;
+	JobSystem::ParallelFor(64, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				// Waiting inside a job runs other jobs instead of blocking the worker
+				JobSystem::ParallelFor(100, [&](uint32_t innerBegin, uint32_t innerEnd) { total += innerEnd - innerBegin; }, 10);
+			}
+		});
+
+	EXPECT_EQ(total, 6400u);
+}
+
+TEST(JobSystem, ParallelForOverhead)
+{
+	std::vector<float> values(1 << 22);
+	auto work = [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				values[i] = std::sqrt((float)i) * 0.5f;
+			}
+		};
+
+	for (uint32_t count : { 1u << 10, 1u << 14, 1u << 18, 1u << 22 })
+	{
+		// Best of a few runs, the first ones also fault the pages in
+		float serial = FLT_MAX;
+		float parallel = FLT_MAX;
+		for (uint32_t run = 0; run < 5; run++)
+		{
+			Clock clock;
+			work(0, count);
+			serial = std::min(serial, clock.GetElapsedTime());
+
+			clock.Restart();
+			JobSystem::ParallelFor(count, work, 1024);
+			parallel = std::min(parallel, clock.GetElapsedTime());
+		}
+
+		LOG_INFO("{} items: serial {:.3f} ms, parallel_for on {} threads {:.3f} ms", count, serial, JobSystem::ThreadCount(), parallel);
+	}
+
+	// Below one grain the call is a direct call, nothing is queued
+	Clock clock;
+	for (uint32_t i = 0; i < 10000; i++)
+	{
+		JobSystem::ParallelFor(512, work, 1024);
+	}
+
+	LOG_INFO("Single chunk parallel_for: {:.3f} us per call", clock.GetElapsedTime() * 1000.0f / 10000.0f);
+	EXPECT_EQ(values[100], std::sqrt(100.0f) * 0.5f);
+}
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+
+#include "renderer/MipGenerator.hpp"
+
+TEST(MipGenerator, ChainDimensions)
+{
+	std::vector<uint8_t> pixels(37 * 12 * 4, 128);
+	std::vector<MipLevel<uint8_t>> levels = MipGenerator::Generate(pixels.data(), 37, 12, 4, MipContent::LINEAR);
+
+	ASSERT_EQ(levels.size(), 5) << "Expected 18x6, 9x3, 4x1, 2x1 and 1x1 levels";
+	EXPECT_EQ(levels[0].Width, 18);
+	EXPECT_EQ(levels[0].Height, 6);
+	EXPECT_EQ(levels[2].Width, 4);
+	EXPECT_EQ(levels[2].Height, 1);
+	EXPECT_EQ(levels.back().Width, 1);
+	EXPECT_EQ(levels.back().Height, 1);
+
+	for (const MipLevel<uint8_t>& level : levels)
+	{
+		EXPECT_EQ(level.Data.size(), (size_t)level.Width * level.Height * 4);
+		EXPECT_EQ(level.Data[0], 128) << "Constant image should stay constant";
+	}
+}
+
+TEST(MipGenerator, ColorFilteredInLinearLight)
+{
+	// Black and white checkerboard, averaging in gamma space would give 128
+	std::vector<uint8_t> pixels(2 * 2 * 4);
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		uint8_t value = (i == 0 || i == 3) ? 255 : 0;
+		pixels[i * 4 + 0] = value;
+		pixels[i * 4 + 1] = value;
+		pixels[i * 4 + 2] = value;
+		pixels[i * 4 + 3] = value;
+	}
+
+	std::vector<MipLevel<uint8_t>> levels = MipGenerator::Generate(pixels.data(), 2, 2, 4, MipContent::COLOR_SRGB);
+	ASSERT_EQ(levels.size(), 1);
+	EXPECT_NEAR(levels[0].Data[0], 188, 1) << "50% linear intensity is 188 in sRGB";
+	EXPECT_NEAR(levels[0].Data[3], 128, 1) << "Alpha must be filtered linearly";
+}
+
+TEST(MipGenerator, NormalsRenormalized)
+{
+	// Two normals tilted 45 degrees in opposite directions average out to +Z
+	auto encode = [](float v) { return (uint8_t)((v * 0.5f + 0.5f) * 255.0f + 0.5f); };
+	const float s = 0.70710678f;
+	std::vector<uint8_t> pixels = {
+		encode(s), 128, encode(s), 255,		encode(-s), 128, encode(s), 255
+	};
+
+	std::vector<MipLevel<uint8_t>> levels = MipGenerator::Generate(pixels.data(), 2, 1, 4, MipContent::NORMAL_MAP);
+	ASSERT_EQ(levels.size(), 1);
+	EXPECT_NEAR(levels[0].Data[0], 128, 1);
+	EXPECT_NEAR(levels[0].Data[1], 128, 1);
+	EXPECT_EQ(levels[0].Data[2], 255) << "Averaged normal should be unit length again";
+}
+
+TEST(MipGenerator, FloatAverage)
+{
+	std::vector<float> pixels = {
+		1.0f, 2.0f, 3.0f,	3.0f, 4.0f, 5.0f,
+		5.0f, 6.0f, 7.0f,	7.0f, 8.0f, 9.0f
+	};
+
+	std::vector<MipLevel<float>> levels = MipGenerator::Generate(pixels.data(), 2, 2, 3);
+	ASSERT_EQ(levels.size(), 1);
+	EXPECT_FLOAT_EQ(levels[0].Data[0], 4.0f);
+	EXPECT_FLOAT_EQ(levels[0].Data[1], 5.0f);
+	EXPECT_FLOAT_EQ(levels[0].Data[2], 6.0f);
+}
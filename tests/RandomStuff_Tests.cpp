@@ -46,6 +46,10 @@ TEST(StringUtils, StringReplaceAll)
 	s = "";
 	ReplaceAll(s, "", "b");
 	EXPECT_EQ(s, "") << "Empty pattern recognized?";
+
+	s = "#define A A #define A";
+	ReplaceAll(s, "A", "AA");
+	EXPECT_EQ(s, "#define AA AA #define AA") << "Replacement containing the pattern replaced again, got: " << s;
 }
 
 TEST(VectorUtils, MaxComponent)
@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+
+#include "renderer/RenderGraph.hpp"
+
+static const RenderGraphTextureDesc HALF = { { 640, 360 }, TextureFormat::R11_G11_B10 };
+static const RenderGraphTextureDesc QUARTER = { { 320, 180 }, TextureFormat::R11_G11_B10 };
+
+static void Nothing(const RenderGraph&) {}
+
+TEST(RenderGraph, CullsPassesNothingDependsOn)
+{
+	RenderGraph graph;
+	RenderGraphResource source = graph.Import("Source", 7, HALF);
+	RenderGraphResource a = 0, b = 0, unused = 0;
+
+	uint32_t first = graph.AddPass("First", [&](RenderGraphBuilder& builder) { builder.Read(source); a = builder.Create("A", HALF); }, Nothing);
+	uint32_t orphan = graph.AddPass("Orphan", [&](RenderGraphBuilder& builder) { builder.Read(a); unused = builder.Create("Unused", HALF); }, Nothing);
+	uint32_t second = graph.AddPass("Second", [&](RenderGraphBuilder& builder) { builder.Read(a); b = builder.Create("B", QUARTER); }, Nothing);
+	uint32_t debug = graph.AddPass("Debug", [&](RenderGraphBuilder& builder) { builder.Read(source); builder.SideEffect(); }, Nothing);
+	graph.Export(b);
+	graph.Compile();
+
+	EXPECT_FALSE(graph.IsCulled(first));
+	EXPECT_TRUE(graph.IsCulled(orphan));
+	EXPECT_FALSE(graph.IsCulled(second));
+	EXPECT_FALSE(graph.IsCulled(debug)) << "Side effects keep a pass even though nothing reads its results";
+	EXPECT_EQ(graph.PhysicalTexture(unused), -1);
+	EXPECT_EQ(graph.PhysicalTexture(source), -1) << "Imported textures aren't pooled";
+	EXPECT_EQ(graph.Texture(source), 7u);
+}
+
+TEST(RenderGraph, OrdersByDependencies)
+{
+	RenderGraph graph;
+	RenderGraphResource history = 0, overwritten = 0;
+
+	uint32_t create = graph.AddPass("Create", [&](RenderGraphBuilder& builder) { history = builder.Create("History", HALF); }, Nothing);
+	uint32_t overwrite = graph.AddPass("Overwrite", [&](RenderGraphBuilder& builder) { overwritten = builder.Write(history); }, Nothing);
+
+	// Declared last but reads the contents before the overwrite, so it has to run in between
+	uint32_t readOld = graph.AddPass("ReadOld", [&](RenderGraphBuilder& builder) { builder.Read(history); builder.SideEffect(); }, Nothing);
+	graph.Export(overwritten);
+	graph.Compile();
+
+	std::vector<uint32_t> expected = { create, readOld, overwrite };
+	EXPECT_EQ(graph.ExecutionOrder(), expected);
+}
+
+TEST(RenderGraph, AliasesDisjointLifetimes)
+{
+	RenderGraph graph;
+	RenderGraphResource a = 0, b = 0, c = 0, d = 0;
+
+	graph.AddPass("A", [&](RenderGraphBuilder& builder) { a = builder.Create("A", HALF); }, Nothing);
+	graph.AddPass("B", [&](RenderGraphBuilder& builder) { builder.Read(a); b = builder.Create("B", HALF); }, Nothing);
+	graph.AddPass("C", [&](RenderGraphBuilder& builder) { builder.Read(b); c = builder.Create("C", HALF); }, Nothing);
+	graph.AddPass("D", [&](RenderGraphBuilder& builder) { builder.Read(c); d = builder.Create("D", QUARTER); }, Nothing);
+	graph.Export(d);
+	graph.Compile();
+
+	EXPECT_EQ(graph.PhysicalTexture(a), graph.PhysicalTexture(c)) << "A is dead once B ran";
+	EXPECT_NE(graph.PhysicalTexture(a), graph.PhysicalTexture(b)) << "A and B are both used by pass B";
+	EXPECT_NE(graph.PhysicalTexture(c), graph.PhysicalTexture(d)) << "Descriptions differ";
+	EXPECT_EQ(graph.PhysicalTextureCount(), 3u);
+	EXPECT_EQ(graph.UnaliasedMemory() - graph.TransientMemory(), TexturePool::TextureSize(HALF.Size, HALF.Format));
+}
+
+TEST(RenderGraph, ExportedTexturesAreNotReused)
+{
+	RenderGraph graph;
+	RenderGraphResource a = 0, b = 0;
+
+	graph.AddPass("A", [&](RenderGraphBuilder& builder) { a = builder.Create("A", HALF); }, Nothing);
+	graph.AddPass("B", [&](RenderGraphBuilder& builder) { builder.Read(a); builder.SideEffect(); }, Nothing);
+	graph.AddPass("C", [&](RenderGraphBuilder& builder) { b = builder.Create("B", HALF); }, Nothing);
+	graph.Export(a);
+	graph.Export(b);
+	graph.Compile();
+
+	EXPECT_NE(graph.PhysicalTexture(a), graph.PhysicalTexture(b));
+	EXPECT_EQ(graph.PhysicalTextureCount(), 2u);
+}
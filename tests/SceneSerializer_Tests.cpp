@@ -0,0 +1,152 @@
+#include <gtest/gtest.h>
+
+#include "scenes/SceneSerializer.hpp"
+#include "scenes/Scene.hpp"
+#include "scenes/Entity.hpp"
+#include "scenes/Components.hpp"
+#include "Clock.hpp"
+#include "Logger.hpp"
+
+#include <filesystem>
+
+static Entity FindByTag(Scene& scene, const std::string& tag)
+{
+	for (Entity entity : scene.Entities())
+	{
+		if (entity.GetComponent<TagComponent>().Tag == tag)
+		{
+			return entity;
+		}
+	}
+
+	return Entity();
+}
+
+TEST(SceneSerializer, RoundTrip)
+{
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "RoundTrip.scene";
+
+	Material material;
+	material.Name = "Glowing";
+	material.Color = glm::vec4(0.2f, 0.4f, 0.6f, 1.0f);
+	material.Emissive = true;
+	material.RoughnessFactor = 0.75f;
+	int32_t materialID = AssetManager::AddMaterial(material);
+	size_t materialCount = AssetManager::AllMaterials().size();
+
+	{
+		Scene scene{};
+		// Spawned before its parents, so saving has to reorder it
+		Entity grandchild = scene.SpawnEntity("Grandchild");
+		Entity root = scene.SpawnEntity("Root");
+		Entity child = scene.SpawnEntity("Child");
+		Entity sibling = scene.SpawnEntity("Sibling");
+		Entity sun = scene.SpawnEntity("Sun");
+		Entity lamp = scene.SpawnEntity("Lamp");
+		Entity torch = scene.SpawnEntity("");
+
+		scene.SetParent(grandchild, child);
+		scene.SetParent(child, root);
+		scene.SetParent(sibling, root);
+
+		root.GetComponent<TransformComponent>().Scale = glm::vec3(2.0f);
+		child.GetComponent<TransformComponent>().Position = glm::vec3(1.0f, 0.0f, 0.0f);
+		grandchild.GetComponent<TransformComponent>().Position = glm::vec3(0.0f, 1.0f, 0.0f);
+		grandchild.GetComponent<TransformComponent>().Rotation = glm::vec3(0.5f, 0.25f, 0.0f);
+		grandchild.AddComponent<MeshComponent>().MeshID = AssetManager::MESH_SPHERE;
+		grandchild.AddComponent<MaterialComponent>().MaterialID = materialID;
+		sun.AddComponent<DirectionalLightComponent>().Intensity = 3.0f;
+		lamp.AddComponent<PointLightComponent>().QuadraticTerm = 0.5f;
+		torch.AddComponent<SpotLightComponent>().Cutoff = 30.0f;
+
+		ASSERT_TRUE(SceneSerializer::Save(scene, path));
+	}
+
+	AssetManager::RemoveMaterial(materialID);
+
+	Scene scene{};
+	scene.SpawnEntity("Replaced");
+	ASSERT_TRUE(SceneSerializer::Load(scene, path));
+
+	ASSERT_EQ(scene.Entities().size(), 7u);
+	EXPECT_EQ(FindByTag(scene, "Replaced").Handle(), entt::null) << "Loading replaces the scene";
+
+	Entity root = FindByTag(scene, "Root");
+	Entity child = FindByTag(scene, "Child");
+	Entity grandchild = FindByTag(scene, "Grandchild");
+	Entity sibling = FindByTag(scene, "Sibling");
+	ASSERT_NE(grandchild.Handle(), entt::null);
+	EXPECT_EQ(grandchild.GetComponent<RelationshipComponent>().Parent, child.Handle());
+	EXPECT_EQ(child.GetComponent<RelationshipComponent>().Parent, root.Handle());
+	EXPECT_EQ(sibling.GetComponent<RelationshipComponent>().Parent, root.Handle());
+	EXPECT_EQ(grandchild.GetComponent<RelationshipComponent>().Depth, 2u);
+	EXPECT_EQ(root.GetComponent<RelationshipComponent>().FirstChild, child.Handle()) << "Siblings are linked in spawn order";
+	EXPECT_EQ(child.GetComponent<RelationshipComponent>().NextSibling, sibling.Handle());
+	EXPECT_EQ(sibling.GetComponent<RelationshipComponent>().PrevSibling, child.Handle());
+
+	EXPECT_EQ(grandchild.GetComponent<TransformComponent>().Rotation, glm::vec3(0.5f, 0.25f, 0.0f));
+	EXPECT_EQ(grandchild.GetComponent<MeshComponent>().MeshID, AssetManager::MESH_SPHERE);
+	EXPECT_EQ(grandchild.GetComponent<MaterialComponent>().MaterialID, materialID);
+	EXPECT_FALSE(root.HasComponent<MeshComponent>());
+	EXPECT_EQ(FindByTag(scene, "Sun").GetComponent<DirectionalLightComponent>().Intensity, 3.0f);
+	EXPECT_EQ(FindByTag(scene, "Lamp").GetComponent<PointLightComponent>().QuadraticTerm, 0.5f);
+	EXPECT_EQ(FindByTag(scene, "Entity").GetComponent<SpotLightComponent>().Cutoff, 30.0f) << "Empty names are saved as the spawned default";
+
+	// Loaded transforms count as changed, so world matrices are built on the next extraction
+	SceneSnapshot snapshot;
+	scene.Extract(snapshot);
+	EXPECT_EQ(glm::vec3(child.GetComponent<WorldTransformComponent>().Matrix[3]), glm::vec3(2.0f, 0.0f, 0.0f));
+
+	ASSERT_EQ(AssetManager::AllMaterials().size(), materialCount);
+	const Material& loaded = AssetManager::GetMaterial(materialID);
+	EXPECT_EQ(loaded.Name, "Glowing");
+	EXPECT_EQ(loaded.Color, material.Color);
+	EXPECT_TRUE(loaded.Emissive);
+	EXPECT_EQ(loaded.RoughnessFactor, 0.75f);
+
+	// Damaged files leave the scene alone
+	std::filesystem::resize_file(path, std::filesystem::file_size(path) - 8);
+	EXPECT_FALSE(SceneSerializer::Load(scene, path));
+	EXPECT_EQ(scene.Entities().size(), 7u);
+
+	AssetManager::RemoveMaterial(materialID);
+	std::filesystem::remove(path);
+}
+
+// Takes seconds, run it with --gtest_also_run_disabled_tests
+TEST(SceneSerializer, DISABLED_LoadBenchmark)
+{
+	static constexpr uint32_t ENTITIES = 1000000;
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "Benchmark.scene";
+
+	{
+		Scene scene{};
+		for (uint32_t i = 0; i < ENTITIES; i++)
+		{
+			Entity entity = scene.SpawnEntity("Mesh");
+			entity.GetComponent<TransformComponent>().Position = glm::vec3((float)i, 0.0f, 0.0f);
+			entity.AddComponent<MeshComponent>();
+			entity.AddComponent<MaterialComponent>();
+			if (i % 100 == 0)
+			{
+				entity.AddComponent<PointLightComponent>();
+			}
+		}
+
+		Clock clock;
+		ASSERT_TRUE(SceneSerializer::Save(scene, path));
+		LOG_INFO("Saved {} entities in {:.2f} ms, {} MB", ENTITIES, clock.GetElapsedTime(), std::filesystem::file_size(path) / (1024 * 1024));
+	}
+
+	Scene scene{};
+	Clock clock;
+	ASSERT_TRUE(SceneSerializer::Load(scene, path));
+	LOG_INFO("Loaded {} entities in {:.2f} ms", ENTITIES, clock.GetElapsedTime());
+
+	ASSERT_EQ(scene.Entities().size(), ENTITIES);
+	Entity last = scene.Entities().back();
+	EXPECT_EQ(last.GetComponent<TransformComponent>().Position.x, (float)(ENTITIES - 1));
+	EXPECT_TRUE(last.HasComponent<MeshComponent>());
+
+	std::filesystem::remove(path);
+}
@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+
+#include "scenes/Scene.hpp"
+#include "scenes/Entity.hpp"
+#include "scenes/Components.hpp"
+#include "Clock.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <thread>
+
+TEST(Scene, ParallelRecordingCoversEveryMesh)
+{
+	static constexpr uint32_t ENTITIES = 100000;
+
+	Scene scene{};
+	for (uint32_t i = 0; i < ENTITIES; i++)
+	{
+		Entity ent = scene.SpawnEntity("Mesh");
+		ent.GetComponent<TransformComponent>().Position = glm::vec3((float)i, 0.0f, 0.0f);
+		ent.AddComponent<MeshComponent>();
+		ent.AddComponent<MaterialComponent>();
+	}
+
+	// Light meshes are recorded separately and must not end up in the buckets
+	Entity light = scene.SpawnEntity("Light");
+	light.AddComponent<MeshComponent>();
+	light.AddComponent<MaterialComponent>();
+	light.AddComponent<PointLightComponent>();
+
+	SceneSnapshot snapshot;
+	uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+	for (uint32_t workers = 1; workers <= cores; workers *= 2)
+	{
+		Scene::SetRecordingWorkers(workers);
+
+		// The first extraction grows the buckets, later ones reuse them
+		scene.Extract(snapshot);
+		Clock clock;
+		scene.Extract(snapshot);
+		LOG_INFO("Recorded {} meshes with {} workers in {:.2f} ms", ENTITIES, workers, clock.GetElapsedTime());
+
+		std::vector<uint32_t> seen(ENTITIES + 2, 0);
+		size_t recorded = 0;
+		for (const std::vector<MeshCommand>& bucket : snapshot.MeshBuckets)
+		{
+			for (const MeshCommand& command : bucket)
+			{
+				ASSERT_LT((size_t)command.EntityID, seen.size());
+				seen[command.EntityID]++;
+				EXPECT_EQ(command.Transform[3].x, (float)(command.EntityID - 1)) << "Transform recorded for the wrong entity";
+			}
+
+			recorded += bucket.size();
+		}
+
+		EXPECT_EQ(recorded, ENTITIES) << workers << " workers";
+		EXPECT_EQ(std::count(seen.begin(), seen.end(), 1u), ENTITIES) << "Every mesh is recorded exactly once";
+	}
+
+	Scene::SetRecordingWorkers(0);
+}
+
+static glm::mat4 WorldOf(Entity entity)
+{
+	return entity.GetComponent<WorldTransformComponent>().Matrix;
+}
+
+TEST(Scene, ChildrenFollowTheirParents)
+{
+	Scene scene{};
+	Entity root = scene.SpawnEntity("Root");
+	Entity child = scene.SpawnEntity("Child");
+	Entity grandchild = scene.SpawnEntity("Grandchild");
+	scene.SetParent(child, root);
+	scene.SetParent(grandchild, child);
+
+	root.GetComponent<TransformComponent>().Scale = glm::vec3(2.0f);
+	child.GetComponent<TransformComponent>().Position = glm::vec3(1.0f, 0.0f, 0.0f);
+	grandchild.GetComponent<TransformComponent>().Position = glm::vec3(0.0f, 1.0f, 0.0f);
+
+	SceneSnapshot snapshot;
+	scene.Extract(snapshot);
+	EXPECT_EQ(glm::vec3(WorldOf(grandchild)[3]), glm::vec3(2.0f, 2.0f, 0.0f));
+	EXPECT_EQ(child.GetComponent<RelationshipComponent>().Depth, 1u);
+	EXPECT_EQ(grandchild.GetComponent<RelationshipComponent>().Depth, 2u);
+
+	// Only patched transforms are rebuilt, a write through GetComponent keeps the cached matrix
+	root.GetComponent<TransformComponent>().Position = glm::vec3(5.0f, 0.0f, 0.0f);
+	scene.Extract(snapshot);
+	EXPECT_EQ(glm::vec3(WorldOf(grandchild)[3]), glm::vec3(2.0f, 2.0f, 0.0f));
+
+	root.PatchComponent<TransformComponent>();
+	scene.Extract(snapshot);
+	EXPECT_EQ(glm::vec3(WorldOf(grandchild)[3]), glm::vec3(7.0f, 2.0f, 0.0f)) << "Patching a parent rebuilds its subtree";
+
+	// Reparenting keeps the local transform
+	scene.SetParent(grandchild, Entity());
+	scene.Extract(snapshot);
+	EXPECT_EQ(glm::vec3(WorldOf(grandchild)[3]), glm::vec3(0.0f, 1.0f, 0.0f));
+	EXPECT_EQ(grandchild.GetComponent<RelationshipComponent>().Depth, 0u);
+	EXPECT_EQ(child.GetComponent<RelationshipComponent>().FirstChild, entt::null);
+}
+
+TEST(Scene, HierarchyStaysAcyclicAndDiesTogether)
+{
+	Scene scene{};
+	Entity root = scene.SpawnEntity("Root");
+	Entity first = scene.SpawnEntity("First");
+	Entity second = scene.SpawnEntity("Second");
+	Entity other = scene.SpawnEntity("Other");
+	scene.SetParent(first, root);
+	scene.SetParent(second, root);
+
+	scene.SetParent(root, second);
+	EXPECT_EQ(root.GetComponent<RelationshipComponent>().Parent, entt::null) << "An entity can't become its own ancestor";
+
+	for (Entity entity : { first, second, other })
+	{
+		entity.AddComponent<MeshComponent>();
+		entity.AddComponent<MaterialComponent>();
+	}
+
+	scene.DestroyEntity(root);
+
+	SceneSnapshot snapshot;
+	scene.Extract(snapshot);
+	size_t recorded = 0;
+	for (const std::vector<MeshCommand>& bucket : snapshot.MeshBuckets)
+	{
+		recorded += bucket.size();
+	}
+
+	EXPECT_EQ(recorded, 1u) << "Children are destroyed with their parent";
+}
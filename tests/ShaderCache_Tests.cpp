@@ -0,0 +1,45 @@
+#include <gtest/gtest.h>
+
+#include "renderer/ShaderCache.hpp"
+
+#include <fstream>
+
+TEST(ShaderCache, RoundTrip)
+{
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "RoundTrip.bin";
+	ProgramBinary binary{ 0x8740 };
+	for (uint32_t i = 0; i < 1000; i++)
+	{
+		binary.Data.push_back((uint8_t)(i * 7));
+	}
+	ASSERT_TRUE(ShaderCache::Write(path, binary));
+
+	std::optional<ProgramBinary> read = ShaderCache::Read(path);
+	ASSERT_TRUE(read.has_value());
+	EXPECT_EQ(read->Format, binary.Format);
+	EXPECT_EQ(read->Data, binary.Data);
+
+	std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+	EXPECT_FALSE(ShaderCache::Read(path).has_value()) << "Truncated entry has to be compiled again";
+
+	// A garbled length is caught before anything is allocated for it
+	{
+		std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+		uint32_t length = 0xFFFFFFFF;
+		file.seekp(3 * sizeof(uint32_t));
+		file.write((const char*)&length, sizeof(length));
+	}
+	EXPECT_FALSE(ShaderCache::Read(path).has_value()) << "Length past the end of the file";
+
+	std::filesystem::remove(path);
+}
+
+TEST(ShaderCache, KeyedBySourcesAndDriver)
+{
+	std::filesystem::path entry = ShaderCache::EntryPath({ "void main() {}", "out vec4 color;" }, "Vendor\nGPU\n4.6\n");
+	EXPECT_EQ(entry, ShaderCache::EntryPath({ "void main() {}", "out vec4 color;" }, "Vendor\nGPU\n4.6\n"));
+
+	EXPECT_NE(entry, ShaderCache::EntryPath({ "void main() {}", "out vec4 colour;" }, "Vendor\nGPU\n4.6\n"));
+	EXPECT_NE(entry, ShaderCache::EntryPath({ "void main() {}", "out vec4 color;" }, "Vendor\nGPU\n4.6.1\n")) << "Driver update has to invalidate the binaries";
+	EXPECT_NE(entry, ShaderCache::EntryPath({ "void main() {}out vec4 color;", "" }, "Vendor\nGPU\n4.6\n")) << "Same text split between other stages";
+}
@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+
+#include "renderer/SphericalHarmonics.hpp"
+
+#include <vector>
+#include <functional>
+
+// Same face layout as glGetTexImage on a cube map, radiance given per direction
+static std::vector<float> Cubemap(int32_t faceSize, const std::function<glm::vec3(uint32_t face, const glm::vec3& dir)>& radiance)
+{
+	std::vector<float> faces((size_t)faceSize * faceSize * 6 * 3);
+	for (uint32_t face = 0; face < 6; face++)
+	{
+		for (int32_t y = 0; y < faceSize; y++)
+		{
+			for (int32_t x = 0; x < faceSize; x++)
+			{
+				float u = ((float)x + 0.5f) * 2.0f / faceSize - 1.0f;
+				float v = ((float)y + 0.5f) * 2.0f / faceSize - 1.0f;
+				glm::vec3 dirs[6] = { { 1.0f, -v, -u }, { -1.0f, -v, u }, { u, 1.0f, v }, { u, -1.0f, -v }, { u, -v, 1.0f }, { -u, -v, -1.0f } };
+
+				glm::vec3 value = radiance(face, glm::normalize(dirs[face]));
+				float* texel = faces.data() + (((size_t)face * faceSize + y) * faceSize + x) * 3;
+				texel[0] = value.r;
+				texel[1] = value.g;
+				texel[2] = value.b;
+			}
+		}
+	}
+
+	return faces;
+}
+
+TEST(SphericalHarmonics, ConstantEnvironment)
+{
+	// Uniform radiance L gives pi * L irradiance in every direction, stored divided by pi. 30 isn't a multiple of the SIMD width
+	std::vector<float> faces = Cubemap(30, [](uint32_t, const glm::vec3&) { return glm::vec3(0.5f, 1.0f, 2.0f); });
+	SH9 sh = SphericalHarmonics::ProjectIrradiance(faces.data(), 30);
+
+	for (const glm::vec3& normal : { glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::normalize(glm::vec3(1.0f, 1.0f, -1.0f)) })
+	{
+		glm::vec3 irradiance = SphericalHarmonics::Evaluate(sh, normal);
+		EXPECT_NEAR(irradiance.r, 0.5f, 1e-3f);
+		EXPECT_NEAR(irradiance.g, 1.0f, 1e-3f);
+		EXPECT_NEAR(irradiance.b, 2.0f, 1e-3f);
+	}
+}
+
+TEST(SphericalHarmonics, LinearGradientConvolved)
+{
+	// L = 1 + y lies in the first two bands, the cosine lobe scales the linear band by 2/3
+	std::vector<float> faces = Cubemap(32, [](uint32_t, const glm::vec3& dir) { return glm::vec3(1.0f + dir.y); });
+	SH9 sh = SphericalHarmonics::ProjectIrradiance(faces.data(), 32);
+
+	EXPECT_NEAR(SphericalHarmonics::Evaluate(sh, { 0.0f, 1.0f, 0.0f }).r, 1.0f + 2.0f / 3.0f, 5e-3f);
+	EXPECT_NEAR(SphericalHarmonics::Evaluate(sh, { 0.0f, -1.0f, 0.0f }).r, 1.0f - 2.0f / 3.0f, 5e-3f);
+	EXPECT_NEAR(SphericalHarmonics::Evaluate(sh, { 1.0f, 0.0f, 0.0f }).r, 1.0f, 5e-3f);
+}
+
+TEST(SphericalHarmonics, FaceOrientation)
+{
+	// Only the +Y face is lit, so the result can't depend on the direction math shared with the projection
+	std::vector<float> faces = Cubemap(16, [](uint32_t face, const glm::vec3&) { return glm::vec3(face == 2 ? 1.0f : 0.0f); });
+	SH9 sh = SphericalHarmonics::ProjectIrradiance(faces.data(), 16);
+
+	float up = SphericalHarmonics::Evaluate(sh, { 0.0f, 1.0f, 0.0f }).r;
+	float down = SphericalHarmonics::Evaluate(sh, { 0.0f, -1.0f, 0.0f }).r;
+	EXPECT_GT(up, 0.3f);
+	EXPECT_LT(down, 0.05f);
+	EXPECT_NEAR(SphericalHarmonics::Evaluate(sh, { 1.0f, 0.0f, 0.0f }).r, SphericalHarmonics::Evaluate(sh, { 0.0f, 0.0f, -1.0f }).r, 1e-3f);
+}
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+
+#include "scenes/SystemScheduler.hpp"
+#include "JobSystem.hpp"
+
+#include <chrono>
+#include <thread>
+
+struct Position { float Value = 0.0f; };
+struct Velocity { float Value = 1.0f; };
+struct Health	{ float Value = 100.0f; };
+
+static entt::registry MakeRegistry(uint32_t entities)
+{
+	entt::registry registry;
+	for (uint32_t i = 0; i < entities; i++)
+	{
+		entt::entity entity = registry.create();
+		registry.emplace<Position>(entity);
+		registry.emplace<Velocity>(entity, (float)i);
+		registry.emplace<Health>(entity);
+	}
+
+	return registry;
+}
+
+TEST(SystemScheduler, ConflictingSystemsRunInOrder)
+{
+	entt::registry registry = MakeRegistry(1000);
+	float recorded = 0.0f;
+
+	SystemScheduler scheduler;
+	scheduler.Add("Integrate", [](entt::registry& registry)
+		{
+			registry.view<Position, Velocity>().each([](Position& position, const Velocity& velocity) { position.Value += velocity.Value; });
+		}).Write<Position>().Read<Velocity>();
+	scheduler.Add("Record", [&](entt::registry& registry)
+		{
+			registry.view<Position>().each([&](const Position& position) { recorded += position.Value; });
+		}).Read<Position>();
+	scheduler.Add("Damage", [](entt::registry& registry)
+		{
+			registry.view<Health, Velocity>().each([](Health& health, const Velocity& velocity) { health.Value -= velocity.Value; });
+		}).Write<Health>().Read<Velocity>();
+	scheduler.Add("Stop", [](entt::registry& registry)
+		{
+			registry.view<Velocity>().each([](Velocity& velocity) { velocity.Value = 0.0f; });
+		}).Write<Velocity>();
+
+	scheduler.Run(registry);
+
+	EXPECT_EQ(recorded, 999.0f * 1000.0f / 2.0f) << "Positions were read before they were written";
+	EXPECT_EQ(scheduler.Dependencies(1), std::vector<uint32_t>{ 0 }) << "Read after write";
+	EXPECT_TRUE(scheduler.Dependencies(2).empty()) << "Systems reading the same component don't conflict";
+	EXPECT_EQ(scheduler.Dependencies(3), (std::vector<uint32_t>{ 0, 2 })) << "Write after read";
+
+	registry.view<Health>().each([](entt::entity entity, const Health& health) { EXPECT_EQ(health.Value, 100.0f - (float)entt::to_entity(entity)); });
+}
+
+TEST(SystemScheduler, IndependentSystemsRunConcurrently)
+{
+	if (JobSystem::ThreadCount() < 2)
+	{
+		GTEST_SKIP() << "Needs at least two threads";
+	}
+
+	entt::registry registry = MakeRegistry(10);
+
+	// Each system waits until the other one started, which only finishes if they overlap
+	std::atomic<uint32_t> started = 0;
+	std::atomic<bool> overlapped = true;
+	auto meet = [&]()
+		{
+			started++;
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+			while (started < 2)
+			{
+				if (std::chrono::steady_clock::now() > deadline)
+				{
+					overlapped = false;
+					return;
+				}
+
+				std::this_thread::yield();
+			}
+		};
+
+	SystemScheduler scheduler;
+	scheduler.Add("Move", [&](entt::registry&) { meet(); }).Write<Position>().Read<Velocity>();
+	scheduler.Add("Heal", [&](entt::registry&) { meet(); }).Write<Health>().Read<Velocity>();
+	scheduler.Run(registry);
+
+	EXPECT_TRUE(overlapped);
+}
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include "Application.hpp"
+#include "renderer/TextureResidency.hpp"
+#include "renderer/AssetManager.hpp"
+
+#include <vector>
+
+TEST(TextureResidency, EvictsAndRestores)
+{
+	Application app;
+
+	static constexpr int32_t SIZE = 256;
+	std::vector<uint8_t> pixels((size_t)SIZE * SIZE * 4);
+	for (size_t i = 0; i < pixels.size(); i++)
+	{
+		pixels[i] = (uint8_t)(i * 7);
+	}
+
+	std::shared_ptr<Texture> texture = std::make_shared<Texture>(pixels.data(), SIZE, SIZE, "Residency", TextureFormat::RGBA8, MipContent::LINEAR);
+	texture->WaitForMips();
+	ASSERT_EQ(texture->MipCount(), 9u) << "The chain is built in a job and uploaded once it's done";
+	int32_t id = AssetManager::AddTexture(texture);
+	uint64_t full = texture->VRAMSize();
+	EXPECT_EQ(full, texture->ResidentSize(0));
+	EXPECT_EQ(texture->EvictedSize(), 0u) << "Resident levels have no system memory copy";
+
+	// Everything else is in use, this texture has to lose its two top levels to get under
+	auto markOthers = [id]()
+	{
+		uint64_t others = 0;
+		for (const auto& [otherID, other] : AssetManager::AllTextures())
+		{
+			if (otherID != id)
+			{
+				other->WaitForMips();
+				TextureResidency::MarkUsed(otherID, *other);
+				others += other->VRAMSize();
+			}
+		}
+		return others;
+	};
+	uint64_t others = markOthers();
+
+	uint64_t previousBudget = TextureResidency::Budget();
+	uint64_t budget = others + texture->ResidentSize(2);
+	TextureResidency::SetBudget(budget);
+	TextureResidency::EndFrame();
+
+	EXPECT_EQ(texture->DroppedMips(), 2u);
+	EXPECT_EQ(texture->VRAMSize(), texture->ResidentSize(2));
+	EXPECT_EQ(texture->EvictedSize(), (uint64_t)(SIZE * SIZE * 4 + (SIZE / 2) * (SIZE / 2) * 4)) << "Only the dropped levels are kept";
+	EXPECT_EQ(TextureResidency::CurrentUsage(), budget);
+
+	// Binding it restores it within the frame, the evicted copy is given up
+	TextureResidency::MarkUsed(id, *texture);
+	EXPECT_EQ(texture->DroppedMips(), 0u);
+	EXPECT_EQ(texture->VRAMSize(), full);
+	EXPECT_EQ(texture->EvictedSize(), 0u);
+	EXPECT_EQ(TextureResidency::CurrentUsage(), others + full);
+
+	std::vector<uint8_t> restored(pixels.size());
+	texture->Bind();
+	GLCall(glPixelStorei(GL_PACK_ALIGNMENT, 1));
+	GLCall(glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, restored.data()));
+	GLCall(glPixelStorei(GL_PACK_ALIGNMENT, 4));
+	texture->Unbind();
+	EXPECT_EQ(restored, pixels);
+
+	// Used this frame, so it stays whole even over budget
+	markOthers();
+	TextureResidency::EndFrame();
+	EXPECT_EQ(texture->DroppedMips(), 0u);
+	EXPECT_EQ(TextureResidency::CurrentUsage(), others + full);
+
+	TextureResidency::SetBudget(previousBudget);
+	AssetManager::RemoveTexture(id);
+}
@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+
+#include "scenes/TransformBatch.hpp"
+#include "scenes/Components.hpp"
+#include "Clock.hpp"
+#include "Logger.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <random>
+
+static void ExpectNear(const glm::mat4& result, const glm::mat4& expected, uint32_t index)
+{
+	for (int c = 0; c < 4; c++)
+	{
+		for (int r = 0; r < 4; r++)
+		{
+			// Relative past one, positions go up to a thousand
+			float tolerance = 1e-5f * std::max(1.0f, std::abs(expected[c][r]));
+			ASSERT_NEAR(result[c][r], expected[c][r], tolerance) << "Transform " << index << ", column " << c << ", row " << r;
+		}
+	}
+}
+
+static TransformComponent RandomTransform(std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+	std::uniform_real_distribution<float> angle(-20.0f, 20.0f);
+	std::uniform_real_distribution<float> scale(-3.0f, 3.0f);
+
+	TransformComponent transform;
+	transform.Position = glm::vec3(position(rng), position(rng), position(rng));
+	transform.Rotation = glm::vec3(angle(rng), angle(rng), angle(rng));
+	transform.Scale = glm::vec3(scale(rng), scale(rng), scale(rng));
+	return transform;
+}
+
+TEST(TransformBatch, EulerMatchesToMat4)
+{
+	// Not a multiple of the lane count, so the scalar tail runs too
+	const uint32_t count = 1003;
+	std::mt19937 rng(7);
+
+	std::vector<TransformComponent> transforms;
+	TransformBatch batch;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		transforms.push_back(RandomTransform(rng));
+		batch.Add(transforms.back());
+	}
+
+	// Starting at an odd index leaves the first matrix alone and shifts every SIMD block
+	std::vector<glm::mat4> matrices(count, glm::mat4(0.0f));
+	ComposeMatrices(batch, 1, count, matrices.data());
+
+	EXPECT_EQ(matrices[0], glm::mat4(0.0f));
+	for (uint32_t i = 1; i < count; i++)
+	{
+		ExpectNear(matrices[i], transforms[i].ToMat4(), i);
+	}
+}
+
+TEST(TransformBatch, QuaternionsMatchMatCast)
+{
+	const uint32_t count = 517;
+	std::mt19937 rng(11);
+	std::uniform_real_distribution<float> component(-1.0f, 1.0f);
+
+	std::vector<glm::mat4> expected;
+	TransformBatch batch;
+	batch.QuaternionRotations = true;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		TransformComponent transform = RandomTransform(rng);
+		glm::quat rotation = glm::normalize(glm::quat(component(rng), component(rng), component(rng), component(rng)));
+		batch.Add(transform.Position, rotation, transform.Scale);
+		expected.push_back(glm::translate(glm::mat4(1.0f), transform.Position) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(1.0f), transform.Scale));
+	}
+
+	std::vector<glm::mat4> matrices(count);
+	ComposeMatrices(batch, 0, count, matrices.data());
+	for (uint32_t i = 0; i < count; i++)
+	{
+		ExpectNear(matrices[i], expected[i], i);
+	}
+}
+
+TEST(TransformBatch, PicksAVX2WhereSupported)
+{
+#if defined(CONF_AVX2_KERNELS) && (defined(__GNUC__) || defined(__clang__))
+	EXPECT_EQ(UsesAVX2Kernel(), __builtin_cpu_supports("avx2") != 0);
+#elif !defined(CONF_AVX2_KERNELS)
+	EXPECT_FALSE(UsesAVX2Kernel());
+#endif
+
+	// The matching tests above ran on whichever kernel this reports
+	LOG_INFO("Transform batches compose with {}", UsesAVX2Kernel() ? "AVX2" : "SSE");
+}
+
+// Takes seconds, run it with --gtest_also_run_disabled_tests
+TEST(TransformBatch, DISABLED_Benchmark)
+{
+	const uint32_t count = 1 << 20;
+	std::mt19937 rng(3);
+
+	std::vector<TransformComponent> transforms;
+	TransformBatch batch;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		transforms.push_back(RandomTransform(rng));
+		batch.Add(transforms.back());
+	}
+
+	std::vector<glm::mat4> matrices(count);
+	float perEntity = FLT_MAX;
+	float kernel = FLT_MAX;
+	for (uint32_t run = 0; run < 5; run++)
+	{
+		Clock clock;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			matrices[i] = transforms[i].ToMat4();
+		}
+		perEntity = std::min(perEntity, clock.GetElapsedTime());
+
+		clock.Restart();
+		ComposeMatrices(batch, 0, count, matrices.data());
+		kernel = std::min(kernel, clock.GetElapsedTime());
+	}
+
+	LOG_INFO("{} transforms: ToMat4 {:.3f} ms, batch kernel {:.3f} ms", count, perEntity, kernel);
+	ExpectNear(matrices[count - 1], transforms[count - 1].ToMat4(), count - 1);
+}
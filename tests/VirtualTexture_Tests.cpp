@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+
+#include "renderer/VirtualTexture.hpp"
+
+static std::vector<uint8_t> CoordinateImage(int32_t width, int32_t height)
+{
+	std::vector<uint8_t> pixels((size_t)width * height * 4);
+	for (int32_t y = 0; y < height; y++)
+	{
+		for (int32_t x = 0; x < width; x++)
+		{
+			uint8_t* texel = pixels.data() + ((size_t)y * width + x) * 4;
+			texel[0] = (uint8_t)x;
+			texel[1] = (uint8_t)y;
+			texel[2] = (uint8_t)(x >> 8);
+			texel[3] = 255;
+		}
+	}
+
+	return pixels;
+}
+
+TEST(VirtualTexture, BakedLayout)
+{
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "BakedLayout.vtex";
+	std::vector<uint8_t> pixels = CoordinateImage(300, 200);
+	ASSERT_TRUE(VirtualTextureFile::Bake(pixels.data(), 300, 200, path));
+
+	VirtualTextureFile file;
+	ASSERT_TRUE(file.Open(path));
+	EXPECT_EQ(file.Width(), 300);
+	EXPECT_EQ(file.Height(), 200);
+	ASSERT_EQ(file.MipCount(), 3) << "Expected 300x200, 150x100 and a single page 75x50 mip";
+	EXPECT_EQ(file.PagesX(0), 3);
+	EXPECT_EQ(file.PagesY(0), 2);
+	EXPECT_EQ(file.PagesX(1), 2);
+	EXPECT_EQ(file.PagesY(1), 1);
+	EXPECT_EQ(file.PagesX(2), 1);
+
+	std::vector<uint8_t> page(VirtualTextureFile::PAGE_BYTES);
+	EXPECT_FALSE(file.ReadPage(0, 3, 0, page.data()));
+	EXPECT_FALSE(file.ReadPage(3, 0, 0, page.data()));
+
+	std::filesystem::remove(path);
+}
+
+TEST(VirtualTexture, PageBordersWrap)
+{
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "PageBordersWrap.vtex";
+	std::vector<uint8_t> pixels = CoordinateImage(300, 200);
+	ASSERT_TRUE(VirtualTextureFile::Bake(pixels.data(), 300, 200, path));
+
+	VirtualTextureFile file;
+	ASSERT_TRUE(file.Open(path));
+
+	constexpr int32_t PADDED = VirtualTextureFile::PADDED_PAGE_SIZE;
+	constexpr int32_t BORDER = VirtualTextureFile::PAGE_BORDER;
+	auto texelX = [](const uint8_t* texel) { return texel[0] | (texel[2] << 8); };
+
+	std::vector<uint8_t> page(VirtualTextureFile::PAGE_BYTES);
+	ASSERT_TRUE(file.ReadPage(0, 1, 1, page.data()));
+	const uint8_t* first = page.data() + ((size_t)BORDER * PADDED + BORDER) * 4;
+	EXPECT_EQ(texelX(first), 128);
+	EXPECT_EQ(first[1], 128);
+
+	// Left border continues the neighbouring page, the bottom one wraps past the top edge of the image
+	const uint8_t* corner = page.data();
+	EXPECT_EQ(texelX(corner), 128 - BORDER);
+	EXPECT_EQ(corner[1], 128 - BORDER);
+
+	const uint8_t* top = page.data() + ((size_t)(PADDED - 1) * PADDED + BORDER) * 4;
+	EXPECT_EQ(top[1], (128 + VirtualTextureFile::PAGE_SIZE + BORDER - 1) % 200);
+
+	// The last page column is only partially covered, the rest repeats the image
+	ASSERT_TRUE(file.ReadPage(0, 2, 0, page.data()));
+	const uint8_t* past = page.data() + ((size_t)BORDER * PADDED + BORDER + 300 - 256) * 4;
+	EXPECT_EQ(texelX(past), 0);
+
+	std::filesystem::remove(path);
+}
+
+TEST(VirtualTexture, TruncatedFileRejected)
+{
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "TruncatedFileRejected.vtex";
+	std::vector<uint8_t> pixels = CoordinateImage(64, 64);
+	ASSERT_TRUE(VirtualTextureFile::Bake(pixels.data(), 64, 64, path));
+	std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+
+	VirtualTextureFile file;
+	EXPECT_FALSE(file.Open(path));
+
+	std::filesystem::remove(path);
+}
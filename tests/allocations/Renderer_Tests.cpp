@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+
+#include "Application.hpp"
+#include "renderer/Renderer.hpp"
+#include "renderer/Camera.hpp"
+#include "renderer/AssetManager.hpp"
+#include "scenes/Components.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<bool> s_CountAllocations = false;
+static std::atomic<uint64_t> s_Allocations = 0;
+
+void* operator new(size_t size)
+{
+	if (s_CountAllocations)
+	{
+		s_Allocations++;
+	}
+
+	if (void* ptr = std::malloc(size == 0 ? 1 : size))
+	{
+		return ptr;
+	}
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	std::free(ptr);
+}
+
+// Submits a frame and returns how many allocations the flush at its end made
+static uint64_t FlushAllocations(Camera& camera, RenderMode mode)
+{
+	MeshComponent cube{};
+	MeshComponent sphere{};
+	sphere.MeshID = AssetManager::MESH_SPHERE;
+
+	// Second material variant of the same mesh, drawn from its own bucket
+	Material parallax = AssetManager::GetMaterial(AssetManager::MATERIAL_DEFAULT);
+	parallax.HeightFactor = 0.05f;
+	parallax.NormalTextureID = AssetManager::TEXTURE_WHITE;
+
+	Renderer::ResetStats();
+	Renderer::SceneBegin(camera);
+	Renderer::AddPointLight(glm::vec3(0.0f, 2.0f, 0.0f), PointLightComponent{});
+	Renderer::SetRenderMode(mode);
+	Renderer::SubmitMesh(glm::mat4(1.0f), cube, AssetManager::GetMaterial(AssetManager::MATERIAL_DEFAULT), 0);
+	Renderer::SubmitMesh(glm::mat4(1.0f), sphere, AssetManager::GetMaterial(AssetManager::MATERIAL_DEFAULT), 1);
+	Renderer::SubmitMesh(glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, 0.0f, 0.0f)), sphere, parallax, 2);
+
+	s_Allocations = 0;
+	s_CountAllocations = true;
+	Renderer::SceneEnd();
+	s_CountAllocations = false;
+
+	// Same as after ImGui drew the frame
+	GLState::Invalidate();
+
+	return s_Allocations;
+}
+
+TEST(Renderer, FlushDoesNotAllocate)
+{
+	Application app;
+	Renderer::Init();
+
+	std::shared_ptr<Framebuffer> target = std::make_shared<Framebuffer>();
+	target->AddRenderbuffer({ .Type = RenderbufferType::DEPTH_STENCIL, .Size = { 320, 180 } });
+	target->AddColorAttachment({ .Type = ColorAttachmentType::TEX_2D, .Format = TextureFormat::RGBA16F, .Size = { 320, 180 } });
+	target->AddColorAttachment({ .Type = ColorAttachmentType::TEX_2D, .Format = TextureFormat::RGBA8, .Size = { 320, 180 } });
+	Renderer::SetTargetFBO(target);
+
+	Camera camera;
+	for (RenderMode mode : { RenderMode::FORWARD, RenderMode::DEFERRED })
+	{
+		// Deferred programs and material variants compile in the background after the first request, other programs draw until then
+		while (!Renderer::RenderModeReady(mode))
+		{
+			FlushAllocations(camera, mode);
+		}
+
+		// The first frame still grows the state cache and instance buffers
+		FlushAllocations(camera, mode);
+
+		EXPECT_EQ(FlushAllocations(camera, mode), 0u) << "Render mode " << (int32_t)mode;
+		EXPECT_GT(Renderer::Stats().DrawCalls, 0u);
+	}
+
+	target = nullptr;
+}